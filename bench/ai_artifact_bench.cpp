@@ -1,4 +1,5 @@
 #include "pomai_cache/ai_cache.hpp"
+#include "pomai_cache/hash.hpp"
 
 #include <algorithm>
 #include <chrono>
@@ -9,6 +10,7 @@
 #include <iostream>
 #include <random>
 #include <string>
+#include <utility>
 #include <vector>
 
 using namespace pomai_cache;
@@ -55,6 +57,108 @@ run_workload(AiArtifactCache &ai, const std::string &name, int ops,
           gets ? static_cast<double>(hits) / gets : 0.0};
 }
 
+// Mean nanoseconds to decode a fully populated AI.PUT metadata object, from
+// JSON or from its AI.PUT.BIN encoding.
+double time_meta_parse(int iters, bool binary) {
+  const std::string meta =
+      "{\"artifact_type\":\"rag_chunk\",\"owner\":\"rag\","
+      "\"schema_version\":\"v1\",\"model_id\":\"e5-large\","
+      "\"tokenizer_id\":\"tok-v2\",\"dataset_id\":\"wiki-2024\","
+      "\"source_id\":\"doc-1842\",\"chunk_id\":\"17\","
+      "\"source_rev\":\"r9\",\"snapshot_epoch\":\"ix42\","
+      "\"created_at\":1718000000000,\"ttl_deadline\":3600000,"
+      "\"size_bytes\":2048,\"content_hash\":\"9f2c4e1ab03d77e5\","
+      "\"miss_cost\":2.75,\"title\":\"say \\\"hi\\\"\","
+      "\"tags\":{\"lang\":\"en\",\"tier\":\"gold\"}}";
+  ArtifactMeta m;
+  AiArtifactCache::parse_meta_json(meta, m);
+  const std::string bin = AiArtifactCache::meta_to_binary(m);
+  std::size_t sink = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < iters; ++i) {
+    if (binary)
+      AiArtifactCache::parse_meta_binary(bin, m);
+    else
+      AiArtifactCache::parse_meta_json(meta, m);
+    sink += m.owner.size();
+  }
+  const auto ns = std::chrono::duration<double, std::nano>(
+                      std::chrono::steady_clock::now() - t0)
+                      .count();
+  return sink == 0 ? 0.0 : ns / iters;
+}
+
+// Content hashing throughput in MB/s over an 8 MiB payload: the hash AI.PUT
+// uses for content_hash, or the byte-wise FNV-1a 64 it replaced.
+double time_content_hash(bool legacy) {
+  std::vector<std::uint8_t> buf(8 << 20);
+  std::mt19937_64 rng(7);
+  for (auto &b : buf)
+    b = static_cast<std::uint8_t>(rng());
+  const int iters = legacy ? 4 : 32;
+  std::uint64_t sink = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < iters; ++i) {
+    if (legacy) {
+      std::uint64_t h = 1469598103934665603ULL;
+      for (auto b : buf) {
+        h ^= b;
+        h *= 1099511628211ULL;
+      }
+      sink += h;
+    } else {
+      sink += hash128(buf.data(), buf.size()).lo;
+    }
+  }
+  const auto s = std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - t0)
+                     .count();
+  const double mb = static_cast<double>(buf.size()) * iters / (1024 * 1024);
+  return sink == 0 ? 0.0 : mb / s;
+}
+
+// AI.EMB.SEARCH over 50k clustered float16 vectors of dim 256: mean
+// microseconds per top-10 query, and recall@10 against an exhaustive scan.
+std::pair<double, double> time_vector_search() {
+  constexpr std::size_t kDim = 256, kCount = 50000, kQueries = 200;
+  std::mt19937_64 rng(11);
+  std::normal_distribution<float> noise(0.0f, 1.0f);
+  std::vector<float> centers(256 * kDim);
+  for (auto &c : centers)
+    c = noise(rng);
+  VectorIndex ivf(kDim, VectorType::Float16);
+  VectorIndex exact(kDim, VectorType::Float16, {kCount + 1, 1});
+  std::vector<std::uint16_t> v(kDim);
+  for (std::size_t i = 0; i < kCount; ++i) {
+    const float *c = &centers[(rng() % 256) * kDim];
+    for (std::size_t d = 0; d < kDim; ++d)
+      v[d] = float_to_half(c[d] + 0.5f * noise(rng));
+    const auto *bytes = reinterpret_cast<const std::uint8_t *>(v.data());
+    ivf.add(static_cast<std::uint32_t>(i), bytes);
+    exact.add(static_cast<std::uint32_t>(i), bytes);
+  }
+  std::vector<std::vector<std::uint16_t>> queries(kQueries);
+  for (auto &q : queries) {
+    const float *c = &centers[(rng() % 256) * kDim];
+    for (std::size_t d = 0; d < kDim; ++d)
+      q.push_back(float_to_half(c[d] + 0.5f * noise(rng)));
+  }
+  std::size_t found = 0;
+  double us = 0;
+  for (const auto &q : queries) {
+    const auto *bytes = reinterpret_cast<const std::uint8_t *>(q.data());
+    auto t0 = std::chrono::steady_clock::now();
+    const auto hits = ivf.search(bytes, 10);
+    us += std::chrono::duration<double, std::micro>(
+              std::chrono::steady_clock::now() - t0)
+              .count();
+    for (const auto &want : exact.search(bytes, 10))
+      for (const auto &got : hits)
+        found += got.first == want.first;
+  }
+  return {us / kQueries, static_cast<double>(found) / (kQueries * 10)};
+}
+
 } // namespace
 
 int main(int argc, char **argv) {
@@ -207,6 +311,12 @@ int main(int argc, char **argv) {
                      std::chrono::steady_clock::now() - r0)
                      .count();
 
+  const double meta_parse_ns = time_meta_parse(20000, false);
+  const double meta_parse_bin_ns = time_meta_parse(20000, true);
+  const double hash_mb_s = time_content_hash(false);
+  const double hash_legacy_mb_s = time_content_hash(true);
+  const auto [emb_search_us, emb_search_recall] = time_vector_search();
+
   std::ofstream os(out);
   os << "{\n  \"workloads\": [\n";
   for (std::size_t i = 0; i < results.size(); ++i) {
@@ -222,6 +332,14 @@ int main(int argc, char **argv) {
   os << "  ],\n";
   os << "  \"ssd_mb_s\": 0.0,\n";
   os << "  \"warm_restart_ms\": " << warm_ms << ",\n";
+  os << "  \"meta_parse_ns\": " << meta_parse_ns << ",\n";
+  os << "  \"meta_parse_bin_ns\": " << meta_parse_bin_ns << ",\n";
+  os << "  \"hash_mb_s\": " << hash_mb_s << ",\n";
+  os << "  \"hash_legacy_mb_s\": " << hash_legacy_mb_s << ",\n";
+  os << "  \"hash_impl\": \"" << hash128_impl_name() << "\",\n";
+  os << "  \"emb_search_us\": " << emb_search_us << ",\n";
+  os << "  \"emb_search_recall\": " << emb_search_recall << ",\n";
+  os << "  \"vector_impl\": \"" << vector_kernel_impl_name() << "\",\n";
   os << "  \"dedup_ratio\": 0.0\n";
   os << "}\n";
 
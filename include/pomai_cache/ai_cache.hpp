@@ -1,12 +1,18 @@
 #pragma once
 
+#include "pomai_cache/bitmap.hpp"
+#include "pomai_cache/chunking.hpp"
 #include "pomai_cache/engine.hpp"
+#include "pomai_cache/radix_tree.hpp"
+#include "pomai_cache/vector_index.hpp"
 
+#include <array>
 #include <cstdint>
+#include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <unordered_map>
-#include <unordered_set>
 #include <vector>
 
 namespace pomai_cache {
@@ -26,13 +32,71 @@ struct ArtifactMeta {
   std::uint64_t ttl_ms{0};
   std::size_t size_bytes{0};
   std::string content_hash;
+  // The "tags" member as written, and its entries as "k=v" (object members)
+  // or "v" (array elements).
   std::string tags_json{"{}"};
+  std::vector<std::string> tags;
   double miss_cost{1.0};
 };
 
+// How metadata is returned to clients: the JSON object, or the length-
+// prefixed binary layout described in docs/AI_COMMANDS.md.
+enum class MetaEncoding { Json, Binary };
+
 struct ArtifactValue {
-  ArtifactMeta meta;
-  std::vector<std::uint8_t> payload;
+  // Shares the engine's blob buffer rather than copying it. A chunked
+  // payload leaves it null and lists its chunks in order instead.
+  ValueRef payload;
+  std::vector<ValueRef> chunks;
+  // The metadata in the encoding asked for; produced once at put time and
+  // shared with the key's entry, so a hit copies no metadata.
+  std::shared_ptr<const std::string> encoded_meta;
+
+  std::size_t payload_size() const;
+  // The payload as one buffer; copies only when it is chunked.
+  std::vector<std::uint8_t> payload_bytes() const;
+};
+
+// One term of a tag expression. Terms combine left to right, with no
+// precedence: a AND b OR c is (a AND b) OR c. The first term's op is unused.
+enum class TagOp { And, Or };
+struct TagTerm {
+  TagOp op{TagOp::And};
+  // As listed in ArtifactMeta::tags: "k=v" or "v".
+  std::string tag;
+};
+
+struct EmbeddingHit {
+  std::string key;
+  // Cosine similarity to the query.
+  float score{0};
+};
+
+// Upper bounds of the AI.RSP.LOOKUP distance histogram buckets; a last
+// bucket takes everything above.
+inline constexpr std::array<float, 8> kRspDistanceBounds{
+    0.01f, 0.02f, 0.05f, 0.1f, 0.2f, 0.3f, 0.5f, 1.0f};
+using DistanceHistogram =
+    std::array<std::uint64_t, kRspDistanceBounds.size() + 1>;
+
+struct ResponseMatch {
+  std::string key;
+  // Cosine distance (1 - similarity) between the query and the prompt.
+  float distance{0};
+  ArtifactValue value;
+};
+
+struct AiCacheConfig {
+  // Payloads of at least chunk_min_payload bytes are split into content-
+  // defined chunks, each stored and refcounted as a blob of its own, so
+  // near-duplicates share everything but the chunks that differ. 0 = off.
+  std::size_t chunk_min_payload{0};
+  std::size_t chunk_avg_bytes{4 * 1024};
+  VectorIndexConfig vector_index{};
+  // How put_embedding stores float vectors: as sent, as float16, or as
+  // Int8Scaled. Other dtypes are stored as sent. The similarity index keeps
+  // the same precision (int8 codes without the scale for Int8Scaled).
+  VectorCodec emb_store{VectorCodec::Float32};
 };
 
 struct AiStats {
@@ -42,6 +106,33 @@ struct AiStats {
   std::uint64_t misses{0};
   std::uint64_t dedup_hits{0};
   std::uint64_t dedup_blobs{0};
+  std::uint64_t chunked_puts{0};
+  std::uint64_t chunk_dedup_hits{0};
+  // Live: payload bytes of chunked keys, and of the distinct chunks storing
+  // them.
+  std::uint64_t chunk_logical_bytes{0};
+  std::uint64_t chunk_stored_bytes{0};
+  std::uint64_t chunk_blobs{0};
+  // Time spent finding cut points and hashing chunks, and bytes chunked.
+  std::uint64_t chunking_ns{0};
+  std::uint64_t chunked_bytes{0};
+  std::uint64_t vector_searches{0};
+  // Search candidates found evicted or expired and dropped on the spot.
+  std::uint64_t vector_reaped{0};
+  // put_embedding payload bytes received and stored after emb_store.
+  std::uint64_t emb_bytes_in{0};
+  std::uint64_t emb_bytes_stored{0};
+  std::uint64_t emb_conversions{0};
+  // AI.RSP.LOOKUP outcomes, and the nearest prompt's distance for each. A
+  // near miss is nearest within twice the threshold; lookups in an empty
+  // scope count as misses with no distance.
+  std::uint64_t rsp_lookups{0};
+  std::uint64_t rsp_hits{0};
+  std::uint64_t rsp_near_misses{0};
+  std::uint64_t rsp_misses{0};
+  DistanceHistogram rsp_hit_distance{};
+  DistanceHistogram rsp_near_miss_distance{};
+  DistanceHistogram rsp_miss_distance{};
 };
 
 std::string canonical_embedding_key(const std::string &model_id,
@@ -61,19 +152,72 @@ std::string canonical_response_key(const std::string &prompt_hash,
 
 class AiArtifactCache {
 public:
-  explicit AiArtifactCache(Engine &engine);
+  explicit AiArtifactCache(Engine &engine, AiCacheConfig cfg = {});
 
   bool put(const std::string &type, const std::string &key,
            const std::string &meta_json,
            const std::vector<std::uint8_t> &payload,
            std::string *err = nullptr);
-  std::optional<ArtifactValue> get(const std::string &key);
+  bool put_binary(const std::string &type, const std::string &key,
+                  std::string_view meta_bin,
+                  const std::vector<std::uint8_t> &payload,
+                  std::string *err = nullptr);
+  bool put(const std::string &type, const std::string &key, ArtifactMeta meta,
+           const std::vector<std::uint8_t> &payload,
+           std::string *err = nullptr);
+  // Stores `vec` (dim elements of `type`) and indexes it for similarity
+  // search among `model_id`'s vectors. A model's first vector fixes the dim
+  // and type of the rest.
+  bool put_embedding(const std::string &key, const std::string &model_id,
+                     std::size_t dim, VectorType type, std::uint64_t ttl_ms,
+                     const std::vector<std::uint8_t> &vec,
+                     std::string *err = nullptr);
+  // The k keys of `model_id` whose vectors are most similar to `query`,
+  // which must have the model's dim and type.
+  bool search_embeddings(const std::string &model_id,
+                         const std::vector<std::uint8_t> &query, std::size_t k,
+                         std::vector<EmbeddingHit> *out,
+                         std::string *err = nullptr);
+  // Stores `response` under canonical_response_key(prompt_hash, params_hash,
+  // model_id), indexed by the prompt's embedding among responses with the
+  // same model_id and params_hash.
+  bool put_response(const std::string &model_id,
+                    const std::string &params_hash,
+                    const std::string &prompt_hash, std::size_t dim,
+                    VectorType type, std::uint64_t ttl_ms,
+                    const std::vector<std::uint8_t> &prompt_vec,
+                    const std::vector<std::uint8_t> &response,
+                    std::string *err = nullptr);
+  // The response whose prompt is nearest `query` in that scope, if its
+  // cosine distance is at most max_distance; *out is left empty otherwise.
+  bool lookup_response(const std::string &model_id,
+                       const std::string &params_hash,
+                       const std::vector<std::uint8_t> &query,
+                       float max_distance, std::optional<ResponseMatch> *out,
+                       std::string *err = nullptr);
+  // get() of a put_embedding key with the payload decoded to `as` (float or
+  // float16); *out is left empty on a miss.
+  bool get_embedding(const std::string &key, VectorType as,
+                     std::optional<ArtifactValue> *out,
+                     std::string *err = nullptr);
+  std::optional<ArtifactValue> get(const std::string &key,
+                                   MetaEncoding enc = MetaEncoding::Json);
   std::vector<std::optional<ArtifactValue>>
-  mget(const std::vector<std::string> &keys);
+  mget(const std::vector<std::string> &keys,
+       MetaEncoding enc = MetaEncoding::Json);
 
   std::size_t invalidate_epoch(const std::string &epoch);
   std::size_t invalidate_model(const std::string &model_id);
   std::size_t invalidate_prefix(const std::string &prefix);
+  std::size_t invalidate_tags(const std::vector<TagTerm> &expr);
+  // Up to `limit` keys matching `expr`, in key-id order.
+  std::vector<std::string> query_tags(const std::vector<TagTerm> &expr,
+                                      std::size_t limit) const;
+  // Up to `count` cached keys starting with `prefix` that sort after
+  // `after`, in order; pass the last key returned to continue.
+  std::vector<std::string> scan(const std::string &prefix,
+                                const std::string &after,
+                                std::size_t count) const;
 
   std::string stats() const;
   std::string top_hot(std::size_t n) const;
@@ -83,35 +227,88 @@ public:
   static bool parse_meta_json(const std::string &json, ArtifactMeta &out,
                               std::string *err = nullptr);
   static std::string meta_to_json(const ArtifactMeta &meta);
+  static bool parse_meta_binary(std::string_view bin, ArtifactMeta &out,
+                                std::string *err = nullptr);
+  static std::string meta_to_binary(const ArtifactMeta &meta);
   static std::string fast_hash_hex(const std::vector<std::uint8_t> &payload);
 
 private:
   struct BlobInfo {
     std::size_t refcount{0};
     std::size_t size_bytes{0};
+    // "blob:<content_hash>", the payload's engine key.
+    std::string engine_key;
+    // Referenced as a chunk at least once; counted in chunk_stored_bytes.
+    bool chunk{false};
   };
   struct KeyInfo {
-    ArtifactMeta meta;
-    std::string blob_hash;
+    // The only copies of the metadata; decode_meta() rebuilds the struct on
+    // the paths that need its fields.
+    std::shared_ptr<const std::string> meta_json;
+    std::shared_ptr<const std::string> meta_bin;
+    // Entry of blob_index_ under meta.content_hash; map nodes do not move.
+    // Chunked keys hold their chunks' entries, in payload order, instead.
+    BlobInfo *blob{nullptr};
+    std::vector<BlobInfo *> chunks;
     std::uint64_t hits{0};
     std::string explain;
+    // Slot in id_keys_; what the bitmap indexes store.
+    std::uint32_t id{0};
+    // Key of the vector_index_ entry holding this key's vector, if any.
+    std::string vector_scope;
+    // Set by put_embedding: element count and payload layout.
+    std::uint32_t vector_dim{0};
+    VectorCodec vector_codec{VectorCodec::Float32};
+  };
+  struct VectorScope {
+    // The dtype clients send; the index may hold a narrower one.
+    VectorType input;
+    VectorIndex index;
   };
 
   std::uint64_t ttl_default_ms(const std::string &owner) const;
-  void index_key(const std::string &key, const ArtifactMeta &meta);
+  static ArtifactMeta decode_meta(const KeyInfo &ki);
+  void index_key(const std::string &key, const KeyInfo &ki,
+                 const ArtifactMeta &meta);
   void deindex_key(const std::string &key, const KeyInfo &ki);
-  std::size_t invalidate_keys(const std::unordered_set<std::string> &keys);
+  void release_blobs(const KeyInfo &ki);
+  bool store_chunks(const std::vector<std::uint8_t> &payload,
+                    std::optional<std::uint64_t> ttl_ms,
+                    std::vector<std::pair<std::string, std::size_t>> *parts,
+                    std::string *err);
+  std::vector<std::string> blob_keys(const KeyInfo &ki) const;
+  bool invalidate_key(const std::string &key);
+  std::size_t invalidate_ids(const RoaringBitmap &ids);
+  RoaringBitmap match_tags(const std::vector<TagTerm> &expr) const;
+  bool check_vector(const std::string &scope, std::size_t dim,
+                    VectorType type, const std::vector<std::uint8_t> &vec,
+                    std::string *err) const;
+  void add_vector(const std::string &key, const std::string &scope,
+                  std::size_t dim, VectorType type,
+                  const std::vector<std::uint8_t> &vec);
+  bool search_scope(const std::string &scope,
+                    const std::vector<std::uint8_t> &query, std::size_t k,
+                    std::vector<EmbeddingHit> *out, std::string *err);
 
   Engine &engine_;
+  AiCacheConfig cfg_;
+  ChunkParams chunk_params_;
   mutable AiStats stats_{};
   std::unordered_map<std::string, BlobInfo> blob_index_;
   std::unordered_map<std::string, KeyInfo> key_index_;
-  std::unordered_map<std::string, std::unordered_set<std::string>> epoch_index_;
-  std::unordered_map<std::string, std::unordered_set<std::string>> model_index_;
-  std::unordered_map<std::string, std::unordered_set<std::string>>
-      prefix_index_;
+  // Dense ids for live keys, reused once freed, so the bitmaps stay compact.
+  std::vector<std::string> id_keys_;
+  std::vector<std::uint32_t> free_ids_;
+  // Epoch, model and tag values to the ids of the keys carrying them.
+  std::unordered_map<std::string, RoaringBitmap> epoch_index_;
+  std::unordered_map<std::string, RoaringBitmap> model_index_;
+  std::unordered_map<std::string, RoaringBitmap> tag_index_;
+  // Over the ids of keys stored with put_embedding, per model, and with
+  // put_response, per model and params hash.
+  std::unordered_map<std::string, VectorScope> vector_index_;
+  // Every key in key_index_, for prefix invalidation and AI.SCAN.
+  RadixTree key_tree_;
   std::unordered_map<std::string, std::uint64_t> owner_ttl_defaults_;
-  std::size_t prefix_index_cap_{4096};
 };
 
 } // namespace pomai_cache
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace pomai_cache {
+
+// Compressed set of 32-bit ids, Roaring style: ids are grouped by their high
+// 16 bits, and each group is a sorted array of low halves while it holds at
+// most kArrayMax of them, a 65536-bit bitmap beyond that. Intersections and
+// unions work container by container, so their cost follows the smaller
+// operand and the density of the groups rather than the id range.
+class RoaringBitmap {
+public:
+  static constexpr std::size_t kArrayMax = 4096;
+
+  // False when the id was already present / absent.
+  bool add(std::uint32_t v);
+  bool remove(std::uint32_t v);
+  bool contains(std::uint32_t v) const;
+
+  std::uint64_t cardinality() const;
+  bool empty() const { return containers_.empty(); }
+  void clear() { containers_.clear(); }
+  std::size_t memory_bytes() const;
+
+  void intersect_with(const RoaringBitmap &other);
+  void union_with(const RoaringBitmap &other);
+
+  // Calls f(id) for every id in ascending order.
+  template <typename F> void for_each(F &&f) const {
+    for (const auto &c : containers_) {
+      const std::uint32_t high = std::uint32_t{c.key} << 16;
+      if (!c.is_bitmap()) {
+        for (const auto low : c.array)
+          f(high | low);
+        continue;
+      }
+      for (std::size_t w = 0; w < c.words.size(); ++w) {
+        const auto base = high | static_cast<std::uint32_t>(w * 64);
+        for (auto bits = c.words[w]; bits != 0; bits &= bits - 1)
+          f(base | static_cast<std::uint32_t>(std::countr_zero(bits)));
+      }
+    }
+  }
+  std::vector<std::uint32_t> to_vector() const;
+
+private:
+  struct Container {
+    std::uint16_t key{0};
+    std::uint32_t card{0};
+    // Exactly one is in use: words (1024 of them) once card > kArrayMax.
+    std::vector<std::uint16_t> array;
+    std::vector<std::uint64_t> words;
+
+    bool is_bitmap() const { return !words.empty(); }
+    bool test(std::uint16_t low) const;
+    void to_bitmap();
+    void to_array();
+  };
+
+  std::vector<Container>::iterator find(std::uint16_t key);
+  std::vector<Container>::const_iterator find(std::uint16_t key) const;
+  static Container intersect(const Container &a, const Container &b);
+  static Container unite(const Container &a, const Container &b);
+
+  // Sorted by key; empty containers are dropped.
+  std::vector<Container> containers_;
+};
+
+} // namespace pomai_cache
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace pomai_cache {
+
+struct ChunkParams {
+  std::size_t min_bytes{1024};
+  std::size_t avg_bytes{4 * 1024};
+  std::size_t max_bytes{16 * 1024};
+};
+
+// Chunk sizes derived from a target average: min = avg / 4, max = avg * 4.
+ChunkParams chunk_params_for(std::size_t avg_bytes);
+
+// FastCDC: the length of the first content-defined chunk of `data`. A gear
+// rolling hash is tested against a harder mask before avg_bytes and an easier
+// one after it (normalized chunking), so cut points depend on nearby content
+// only and survive edits earlier in the buffer.
+std::size_t cdc_next_cut(const std::uint8_t *data, std::size_t len,
+                         const ChunkParams &p);
+// End offsets of every chunk of `data`; the last one is `len`.
+std::vector<std::size_t> cdc_chunk_ends(const std::uint8_t *data,
+                                        std::size_t len, const ChunkParams &p);
+
+} // namespace pomai_cache
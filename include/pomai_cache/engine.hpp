@@ -1,6 +1,9 @@
 #pragma once
 
 #include "pomai_cache/policy.hpp"
+#include "pomai_cache/sketch.hpp"
+#include "pomai_cache/ssd_admission.hpp"
+#include "pomai_cache/ssd_read_cache.hpp"
 #include "pomai_cache/ssd_store.hpp"
 
 #include <cstdint>
@@ -22,8 +25,33 @@ struct TierConfig {
   std::size_t ram_max_bytes{64 * 1024 * 1024};
   std::uint64_t promotion_hits{3};
   double demotion_pressure{0.90};
+  // A demotion batch frees RAM down to this fraction of the limit, taking at
+  // most demotion_batch victims.
+  double demotion_target{0.80};
+  std::size_t demotion_batch{256};
   std::size_t ssd_max_read_mb_s{256};
   std::size_t ssd_max_write_mb_s{256};
+  std::size_t ssd_append_buffer_bytes{256 * 1024};
+  std::uint32_t ssd_group_commit_ms{2};
+  double ssd_verify_read_sample{1.0};
+  std::size_t ssd_segment_bytes{256 * 1024 * 1024};
+  std::size_t ssd_small_object_bytes{0};
+  std::size_t ssd_small_store_bytes{64 * 1024 * 1024};
+  std::uint32_t ssd_admit_min_accesses{2};
+  double ssd_dwpd{0.0};
+  // RAM budget for recently read values >= ssd_value_min_bytes; 0 = off.
+  std::size_t ssd_read_cache_bytes{0};
+  // Parallel record reads per MGET batch.
+  std::size_t ssd_read_threads{8};
+  // O_DIRECT segment I/O with 4 KiB-aligned flushes; falls back to buffered
+  // I/O where the filesystem refuses it.
+  bool ssd_direct_io{false};
+  // Segment scan threads at startup; 0 = one per core.
+  std::size_t ssd_recovery_threads{0};
+  // Serve while segments are scanned in the background; SSD lookups wait up
+  // to ssd_recovery_wait_ms for a key's segments before reporting a miss.
+  bool ssd_online_recovery{false};
+  std::uint32_t ssd_recovery_wait_ms{10};
 };
 
 struct EngineConfig {
@@ -43,6 +71,10 @@ struct EngineStats {
   std::uint64_t evictions{0};
   std::uint64_t expirations{0};
   std::uint64_t admissions_rejected{0};
+  std::uint64_t promotions{0};
+  std::uint64_t demotions{0};
+  std::uint64_t demotion_batches{0};
+  std::uint64_t demotion_failures{0};
 };
 
 class Engine {
@@ -53,13 +85,22 @@ public:
            std::optional<std::uint64_t> ttl_ms, std::string owner,
            std::string *err = nullptr);
   std::optional<std::vector<std::uint8_t>> get(const std::string &key);
+  // get() without the copy: a RAM hit shares the stored buffer.
+  ValueRef get_ref(const std::string &key);
+  // Counts a hit on `key` as get() would, without reading the value. SSD
+  // residents are checked in the index only and never promoted.
+  bool touch(const std::string &key);
+  // Whether `key` is live in either tier; counts nothing.
+  bool contains(const std::string &key);
   std::size_t del(const std::vector<std::string> &keys);
   bool expire(const std::string &key, std::uint64_t ttl_seconds);
   std::optional<std::int64_t> ttl(const std::string &key);
   std::vector<std::optional<std::vector<std::uint8_t>>>
   mget(const std::vector<std::string> &keys);
+  std::vector<ValueRef> mget_ref(const std::vector<std::string> &keys);
 
   void tick();
+  bool commit(std::string *err = nullptr);
 
   std::string info() const;
   bool reload_params(const std::string &path, std::string *err = nullptr);
@@ -82,12 +123,22 @@ private:
     }
   };
 
-  bool exists_and_not_expired(const std::string &key);
+  Entry *find_live(const std::string &key);
+  void record_hit(const std::string &key, Entry &e);
   void erase_internal(const std::string &key, bool eviction, bool expiration);
   void evict_until_fit();
   double owner_miss_cost(const std::string &owner) const;
   std::size_t bucket_for(std::size_t size) const;
   void maybe_enqueue_demotion();
+  void enqueue_demotions();
+  void demote_pending(std::size_t max_items);
+  void install_entry(const std::string &key, Entry entry);
+  std::optional<std::vector<std::uint8_t>>
+  get_from_ram(const std::string &key);
+  std::optional<std::vector<std::uint8_t>>
+  finish_ssd_read(const std::string &key,
+                  std::optional<std::vector<std::uint8_t>> v,
+                  const SsdMeta &m);
 
   EngineConfig cfg_;
   std::unique_ptr<IEvictionPolicy> policy_;
@@ -96,8 +147,8 @@ private:
   std::priority_queue<ExpiryNode, std::vector<ExpiryNode>,
                       std::greater<ExpiryNode>>
       expiry_heap_;
-  std::unordered_map<std::string, std::uint64_t> ssd_hit_count_;
-  std::deque<std::string> promote_queue_;
+  // SSD hits per key, decaying; drives promotion.
+  CountMinSketch ssd_hits_{1 << 14};
   std::deque<std::string> demote_queue_;
   std::unordered_map<std::string, double> owner_miss_cost_default_;
   std::unordered_map<std::string, std::size_t> owner_usage_;
@@ -108,6 +159,8 @@ private:
   std::uint64_t seq_{0};
 
   SsdStore ssd_;
+  SsdAdmission ssd_admission_;
+  SsdReadCache ssd_read_cache_;
 };
 
 std::unique_ptr<IEvictionPolicy> make_policy_by_name(const std::string &mode);
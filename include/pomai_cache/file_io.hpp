@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/types.h>
+#endif
+
+namespace pomai_cache {
+
+// Thin POSIX/Windows file wrappers shared by the SSD tier's stores.
+
+#ifdef _WIN32
+using ssize_t = std::ptrdiff_t;
+constexpr int PC_O_RDONLY = _O_RDONLY;
+constexpr int PC_O_RDWR = _O_RDWR;
+constexpr int PC_O_CREAT = _O_CREAT;
+constexpr int PC_O_APPEND = _O_APPEND;
+constexpr int PC_O_TRUNC = _O_TRUNC;
+#else
+constexpr int PC_O_RDONLY = O_RDONLY;
+constexpr int PC_O_RDWR = O_RDWR;
+constexpr int PC_O_CREAT = O_CREAT;
+constexpr int PC_O_APPEND = O_APPEND;
+constexpr int PC_O_TRUNC = O_TRUNC;
+#endif
+#ifdef O_DIRECT
+constexpr int PC_O_DIRECT = O_DIRECT;
+#else
+constexpr int PC_O_DIRECT = 0; // never reported as supported
+#endif
+
+// O_DIRECT offsets, lengths and buffer addresses are multiples of this.
+constexpr std::size_t kDirectIoAlign = 4096;
+
+template <typename T> struct AlignedAllocator {
+  using value_type = T;
+  AlignedAllocator() = default;
+  template <typename U> AlignedAllocator(const AlignedAllocator<U> &) {}
+  T *allocate(std::size_t n) {
+    return static_cast<T *>(::operator new(
+        n * sizeof(T), std::align_val_t(kDirectIoAlign)));
+  }
+  void deallocate(T *p, std::size_t) {
+    ::operator delete(p, std::align_val_t(kDirectIoAlign));
+  }
+  template <typename U> bool operator==(const AlignedAllocator<U> &) const {
+    return true;
+  }
+};
+
+// Byte buffer whose data() is kDirectIoAlign-aligned.
+using AlignedBytes = std::vector<std::uint8_t, AlignedAllocator<std::uint8_t>>;
+
+int pc_open(const char *path, int flags);
+int pc_close(int fd);
+ssize_t pc_write(int fd, const void *buf, std::size_t len);
+ssize_t pc_read(int fd, void *buf, std::size_t len);
+std::int64_t pc_seek(int fd, std::int64_t off, int whence);
+int pc_fsync(int fd);
+int pc_truncate(int fd, std::int64_t len);
+ssize_t pc_pread(int fd, void *buf, std::size_t len, std::int64_t off);
+// Writes all of `len` at `off`, retrying short writes.
+bool pc_pwrite_all(int fd, const void *buf, std::size_t len,
+                   std::int64_t off);
+
+struct IoSlice {
+  const void *data;
+  std::size_t len;
+};
+
+// Writes every slice in order, retrying short writes. On POSIX the slices go
+// out through writev so a flush is a single syscall in the common case.
+bool pc_write_all(int fd, IoSlice *slices, int count);
+
+bool fsync_dir(const std::string &dir);
+// Drops the page cache for `fd`; best effort.
+void pc_drop_cache(int fd);
+// Writes and reads back one aligned block with O_DIRECT in `dir`. False on
+// filesystems (tmpfs, some FUSE/overlay mounts) or platforms without it.
+bool pc_direct_io_supported(const std::string &dir);
+
+} // namespace pomai_cache
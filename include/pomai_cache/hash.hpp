@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace pomai_cache {
+
+// CRC32C (Castagnoli). Uses the SSE4.2 / ARMv8 CRC instructions when the CPU
+// has them and a slicing-by-8 table otherwise. `crc` is the running value
+// returned by a previous call (0 to start).
+std::uint32_t crc32c(std::uint32_t crc, const void *data, std::size_t len);
+const char *crc32c_impl_name();
+
+struct Hash128 {
+  std::uint64_t lo{0};
+  std::uint64_t hi{0};
+  bool operator==(const Hash128 &) const = default;
+};
+
+// 128-bit content hash in the XXH3 style: 64-byte stripes folded into eight
+// 64-bit lanes with 32x32-bit multiplies, then a 128-bit multiply-fold
+// finish. Not bit-compatible with XXH3. The AVX2, SSE2 and scalar kernels
+// return identical values.
+Hash128 hash128(const void *data, std::size_t len);
+const char *hash128_impl_name();
+// hash128 with the named kernel ("avx2", "sse2" or "scalar"); false if it is
+// not built here or the CPU lacks it. For checking the kernels agree.
+bool hash128_using(const char *impl, const void *data, std::size_t len,
+                   Hash128 *out);
+// The 32 lowercase hex digits of `h`, hi word first, with no terminator.
+void hash128_hex(const Hash128 &h, char *out);
+
+} // namespace pomai_cache
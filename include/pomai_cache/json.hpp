@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace pomai_cache {
+
+// Forward-only JSON reader over a caller-owned buffer. It walks objects member
+// by member without building a tree and allocates only into the strings it is
+// asked to fill. Typed reads consume the next value; when the value has a
+// different type it is skipped and the read returns false. The first syntax
+// error stops the reader (ok() turns false and every call fails).
+//
+//   JsonReader r(text);
+//   std::string_view name;
+//   if (r.begin_object())
+//     while (r.next_member(&name))
+//       if (name == "owner") r.read_string(&owner); else r.skip();
+class JsonReader {
+public:
+  explicit JsonReader(std::string_view text) : text_(text) {}
+
+  // Enters the object that is the next value. Returns false, consuming
+  // nothing, when the next value is not an object.
+  bool begin_object();
+  // Enters the array that is the next value, like begin_object().
+  bool begin_array();
+  // Moves to the next member of the innermost open object and returns its
+  // name as written (escapes are not decoded). Returns false after consuming
+  // the closing brace, or on a syntax error.
+  bool next_member(std::string_view *name);
+  // Moves to the next element of the innermost open array. Returns false
+  // after consuming the closing bracket, or on a syntax error.
+  bool next_element();
+
+  bool read_string(std::string *out);
+  // Non-negative integer without fraction or exponent.
+  bool read_u64(std::uint64_t *out);
+  bool read_double(double *out);
+  // A string (decoded) or a number, true, false or null (as written).
+  // Objects and arrays are skipped.
+  bool read_scalar(std::string *out);
+  // Raw text of the next value, whatever its type.
+  bool read_raw(std::string_view *out);
+  bool skip();
+
+  bool ok() const { return !failed_; }
+  // True when only whitespace is left and no error occurred.
+  bool at_end();
+
+private:
+  char peek();
+  bool fail();
+  bool value_done();
+  bool scan_string(std::size_t *end, bool *escaped) const;
+  bool scan_number(std::size_t *end) const;
+  bool skip_value();
+  bool decode_string(std::size_t begin, std::size_t end, std::string *out);
+
+  std::string_view text_;
+  std::size_t pos_{0};
+  // A value was just read, so a separator or a closer must come next.
+  bool after_value_{false};
+  bool failed_{false};
+  int depth_{0};
+};
+
+// Appends `s` to `out` as a quoted JSON string.
+void append_json_string(std::string *out, std::string_view s);
+
+} // namespace pomai_cache
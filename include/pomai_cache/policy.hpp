@@ -6,6 +6,7 @@
 #include <optional>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 namespace pomai_cache {
 
@@ -39,6 +40,12 @@ public:
   virtual std::optional<std::string>
   pick_victim(const std::unordered_map<std::string, Entry> &entries,
               std::size_t memory_used, std::size_t memory_limit) = 0;
+  // Worst-first victims from one pass over `entries`: stops once their sizes
+  // cover `bytes_to_free` or `max_victims` keys were chosen.
+  virtual std::vector<std::string>
+  pick_victims(const std::unordered_map<std::string, Entry> &entries,
+               std::size_t memory_used, std::size_t memory_limit,
+               std::size_t bytes_to_free, std::size_t max_victims) = 0;
   virtual void set_params(const PolicyParams &params) = 0;
   virtual const PolicyParams &params() const = 0;
 };
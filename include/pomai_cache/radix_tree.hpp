@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace pomai_cache {
+
+// Set of strings as a compressed radix tree: each edge carries a run of
+// bytes and single-child interior nodes are merged away, so shared prefixes
+// are stored once. Iteration is in lexicographic (byte) order.
+class RadixTree {
+public:
+  RadixTree();
+  ~RadixTree();
+  RadixTree(const RadixTree &) = delete;
+  RadixTree &operator=(const RadixTree &) = delete;
+
+  // False when the key was already present / absent.
+  bool insert(std::string_view key);
+  bool erase(std::string_view key);
+  bool contains(std::string_view key) const;
+
+  // Detaches the whole subtree under `prefix` and returns its keys in order.
+  std::vector<std::string> erase_prefix(std::string_view prefix);
+  // Up to `limit` keys starting with `prefix` that sort after `after`, in
+  // order; subtrees entirely before `after` are skipped without a visit.
+  std::vector<std::string> scan(std::string_view prefix, std::string_view after,
+                                std::size_t limit) const;
+
+  std::size_t size() const { return size_; }
+  std::size_t node_count() const { return nodes_; }
+  void clear();
+
+private:
+  struct Node;
+  struct Hit;
+
+  Hit locate(std::string_view prefix) const;
+  void merge_into(Node *n);
+
+  std::unique_ptr<Node> root_;
+  std::size_t size_{0};
+  std::size_t nodes_{1};
+};
+
+} // namespace pomai_cache
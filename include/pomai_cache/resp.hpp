@@ -2,6 +2,7 @@
 
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace pomai_cache {
@@ -22,5 +23,10 @@ std::string resp_integer(long long v);
 std::string resp_bulk(const std::string &s);
 std::string resp_null();
 std::string resp_array(const std::vector<std::string> &items);
+// Write straight into an output buffer, for large values.
+void resp_append_bulk(std::string *out, std::string_view s);
+// "$<len>\r\n"; the caller appends the len bytes and the closing "\r\n".
+void resp_append_bulk_header(std::string *out, std::size_t len);
+void resp_append_array_header(std::string *out, std::size_t n);
 
 } // namespace pomai_cache
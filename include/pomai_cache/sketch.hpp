@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace pomai_cache {
+
+// Count-min sketch of access frequency with 8-bit saturating counters and
+// TinyLFU-style aging: once `10 * width` increments have been recorded every
+// counter is halved, so estimates track recent popularity.
+class CountMinSketch {
+public:
+  static constexpr int kRows = 4;
+
+  // `width` is rounded up to a power of two (minimum 64).
+  explicit CountMinSketch(std::size_t width = 1 << 16);
+
+  void increment(std::uint64_t key_hash);
+  std::uint32_t estimate(std::uint64_t key_hash) const;
+  void clear();
+
+  std::size_t memory_bytes() const { return counters_.size(); }
+  std::uint64_t resets() const { return resets_; }
+
+private:
+  std::size_t slot(int row, std::uint64_t key_hash) const;
+  void halve();
+
+  std::vector<std::uint8_t> counters_;
+  std::size_t mask_{0};
+  std::uint64_t additions_{0};
+  std::uint64_t sample_size_{0};
+  std::uint64_t resets_{0};
+};
+
+} // namespace pomai_cache
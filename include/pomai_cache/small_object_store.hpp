@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace pomai_cache {
+
+struct SmallObjectConfig {
+  std::string path{"./data/small_objects.dat"};
+  // File size; rounded down to whole pages.
+  std::size_t capacity_bytes{64 * 1024 * 1024};
+  // Inserts are batched in RAM per page until the log reaches this size.
+  std::size_t log_bytes{1024 * 1024};
+};
+
+struct SmallObjectStats {
+  std::size_t objects{0};
+  std::size_t pages{0};
+  std::uint64_t page_reads{0};
+  std::uint64_t page_writes{0};
+  std::uint64_t bloom_false_positives{0};
+  std::uint64_t evicted_objects{0};
+  std::size_t log_bytes{0};
+  // Bloom filters + per-page counts, i.e. the per-object RAM cost.
+  std::size_t ram_bytes{0};
+};
+
+// Set-associative store for objects well under a page. A key hashes to one
+// 4 KiB page; RAM holds only a 128-bit bloom filter and an object count per
+// page. New objects wait in an in-memory log and are merged into their page in
+// page order when the log fills, so one 4 KiB write carries every pending
+// object for that page. Pages overflow FIFO: the oldest objects are dropped.
+class SmallObjectStore {
+public:
+  static constexpr std::size_t kPageBytes = 4096;
+
+  explicit SmallObjectStore(SmallObjectConfig cfg);
+  ~SmallObjectStore();
+  SmallObjectStore(const SmallObjectStore &) = delete;
+  SmallObjectStore &operator=(const SmallObjectStore &) = delete;
+
+  bool init(std::string *err = nullptr);
+  static bool fits(std::size_t key_len, std::size_t value_len);
+
+  bool put(const std::string &key, const std::vector<std::uint8_t> &value,
+           std::int64_t ttl_epoch_ms, std::string *err = nullptr);
+  std::optional<std::vector<std::uint8_t>>
+  get(const std::string &key, std::int64_t *ttl_epoch_ms = nullptr);
+  // Removes `key`, rewriting its page right away so the next sync() makes
+  // the delete durable. Returns false when the key was not present.
+  bool erase(const std::string &key, std::string *err = nullptr);
+  // Merges the whole log into its pages.
+  bool flush(std::string *err = nullptr);
+  // fsyncs the page file if any page was written since the last sync.
+  bool sync();
+
+  const SmallObjectStats &stats() const { return stats_; }
+
+private:
+  struct Object {
+    std::string key;
+    std::vector<std::uint8_t> value;
+    std::int64_t ttl_epoch_ms{-1};
+    bool tombstone{false};
+  };
+  struct Bloom {
+    std::uint64_t bits[2]{0, 0};
+  };
+
+  static std::uint64_t hash_key(const std::string &key);
+  std::uint32_t page_of(std::uint64_t key_hash) const;
+  static void bloom_add(Bloom *b, std::uint64_t key_hash);
+  static bool bloom_test(const Bloom &b, std::uint64_t key_hash);
+  bool lookup(std::uint32_t page, std::uint64_t key_hash,
+              const std::string &key, Object *out);
+  bool read_page(std::uint32_t page, std::vector<Object> *out);
+  bool write_page(std::uint32_t page, std::vector<Object> *objects);
+  bool flush_page(std::uint32_t page, std::string *err);
+  const Object *find_logged(std::uint32_t page, const std::string &key) const;
+
+  SmallObjectConfig cfg_;
+  SmallObjectStats stats_;
+  int fd_{-1};
+  std::uint32_t pages_{0};
+  std::vector<Bloom> blooms_;
+  std::vector<std::uint16_t> counts_;
+  bool dirty_{false};
+  std::unordered_map<std::uint32_t, std::vector<Object>> log_;
+};
+
+} // namespace pomai_cache
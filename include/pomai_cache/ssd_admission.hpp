@@ -0,0 +1,61 @@
+#pragma once
+
+#include "pomai_cache/sketch.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace pomai_cache {
+
+struct SsdAdmissionConfig {
+  // Accesses (SETs and GETs, from the sketch) or RAM hits + 1 a demotion
+  // victim needs before it is written to SSD. 0 admits everything.
+  std::uint32_t min_accesses{2};
+  // Device write budget in drive-writes-per-day of `device_bytes`; 0 = off.
+  double dwpd{0.0};
+  std::size_t device_bytes{2ULL * 1024 * 1024 * 1024};
+  std::size_t sketch_width{1 << 16};
+};
+
+struct SsdAdmissionStats {
+  std::uint64_t admitted{0};
+  std::uint64_t rejected{0};
+  std::uint64_t admitted_bytes{0};
+  std::uint64_t rejected_bytes{0};
+  std::uint64_t rejected_budget{0};
+};
+
+// Decides which demotion victims are worth an SSD write: the victim must have
+// been reused (access sketch or RAM hit count), and the write must fit the
+// endurance budget, a token bucket refilled at dwpd * device_bytes per day
+// with one hour of burst.
+class SsdAdmission {
+public:
+  explicit SsdAdmission(SsdAdmissionConfig cfg);
+
+  void record_access(const std::string &key);
+  bool admit(const std::string &key, std::uint64_t ram_hits,
+             std::size_t bytes);
+  // Accounts a write that bypasses admission (explicit SET of a large value).
+  void charge(std::size_t bytes);
+
+  const SsdAdmissionStats &stats() const { return stats_; }
+  // Remaining write budget in bytes; -1 when unlimited.
+  std::int64_t budget_bytes() const;
+  std::size_t sketch_bytes() const { return sketch_.memory_bytes(); }
+
+private:
+  void refill();
+
+  SsdAdmissionConfig cfg_;
+  SsdAdmissionStats stats_;
+  CountMinSketch sketch_;
+  double tokens_{0.0};
+  double rate_per_s_{0.0};
+  double burst_{0.0};
+  std::chrono::steady_clock::time_point last_refill_;
+};
+
+} // namespace pomai_cache
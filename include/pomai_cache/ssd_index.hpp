@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace pomai_cache {
+
+// Open-addressing Robin Hood table mapping a 32-bit key tag to an opaque
+// 64-bit location and an optional expiry deadline. Slots are 12 bytes, plus a
+// 6-byte deadline per slot once any key has one, and the table grows by 1.5x
+// at 90% load, so steady-state cost is ~13-20 bytes per key (~20-30 with
+// deadlines). Tags are not unique: callers walk every slot carrying a tag and
+// confirm the key against the on-disk record.
+class SsdIndex {
+public:
+  static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+  // Returns the position of the first slot with `tag` for which `match(loc)`
+  // is true, or npos.
+  template <typename Match>
+  std::size_t find(std::uint32_t tag, Match &&match) const {
+    return find_slot(tag, [&](std::size_t pos) { return match(loc_at(pos)); });
+  }
+  // As find(), with `match` given the slot position.
+  template <typename Match>
+  std::size_t find_slot(std::uint32_t tag, Match &&match) const {
+    if (slots_.empty())
+      return npos;
+    tag = normalize(tag);
+    std::size_t pos = home(tag);
+    for (std::size_t dist = 0;; ++dist) {
+      const Slot &s = slots_[pos];
+      if (s.tag == 0 || displacement(pos, s.tag) < dist)
+        return npos;
+      if (s.tag == tag && match(pos))
+        return pos;
+      pos = next(pos);
+    }
+  }
+
+  // A negative deadline means none.
+  void insert(std::uint32_t tag, std::uint64_t loc,
+              std::int64_t deadline_ms = -1);
+  void erase_at(std::size_t pos);
+  std::uint64_t loc_at(std::size_t pos) const { return loc_of(slots_[pos]); }
+  void set_loc_at(std::size_t pos, std::uint64_t loc);
+  // Epoch milliseconds, or -1.
+  std::int64_t deadline_at(std::size_t pos) const;
+  void set_deadline_at(std::size_t pos, std::int64_t deadline_ms);
+  void reserve(std::size_t n);
+  void clear();
+
+  template <typename F> void for_each(F &&f) const {
+    for (const auto &s : slots_)
+      if (s.tag != 0)
+        f(s.tag, loc_of(s));
+  }
+
+  std::size_t size() const { return size_; }
+  std::size_t memory_bytes() const {
+    return slots_.size() * sizeof(Slot) + deadlines_.size() * sizeof(Deadline);
+  }
+
+  static std::uint32_t tag_for_hash(std::uint64_t key_hash) {
+    return normalize(static_cast<std::uint32_t>(key_hash >> 32));
+  }
+
+private:
+  struct Slot {
+    std::uint32_t tag;
+    std::uint32_t loc_lo;
+    std::uint32_t loc_hi;
+  };
+  static_assert(sizeof(Slot) == 12);
+  // 48-bit epoch milliseconds; 0 for none.
+  struct Deadline {
+    std::uint16_t w[3];
+  };
+  static_assert(sizeof(Deadline) == 6);
+
+  static std::uint32_t normalize(std::uint32_t tag) { return tag ? tag : 1; }
+  static std::uint64_t loc_of(const Slot &s) {
+    return (static_cast<std::uint64_t>(s.loc_hi) << 32) | s.loc_lo;
+  }
+  std::size_t home(std::uint32_t tag) const {
+    return static_cast<std::size_t>(
+        (static_cast<std::uint64_t>(tag) * slots_.size()) >> 32);
+  }
+  std::size_t next(std::size_t pos) const {
+    return pos + 1 == slots_.size() ? 0 : pos + 1;
+  }
+  std::size_t displacement(std::size_t pos, std::uint32_t tag) const {
+    const std::size_t h = home(tag);
+    return pos >= h ? pos - h : pos + slots_.size() - h;
+  }
+  static Deadline pack_deadline(std::int64_t deadline_ms);
+  void place(Slot s, Deadline d);
+  void rehash(std::size_t capacity);
+
+  std::vector<Slot> slots_;
+  // Parallel to slots_; empty until the first deadline is set.
+  std::vector<Deadline> deadlines_;
+  std::size_t size_{0};
+};
+
+} // namespace pomai_cache
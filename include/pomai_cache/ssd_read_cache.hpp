@@ -0,0 +1,63 @@
+#pragma once
+
+#include "pomai_cache/types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace pomai_cache {
+
+struct SsdReadCacheStats {
+  std::uint64_t hits{0};
+  std::uint64_t misses{0};
+  std::uint64_t inserts{0};
+  std::uint64_t evictions{0};
+  std::uint64_t invalidations{0};
+  std::size_t entries{0};
+  std::size_t bytes{0};
+};
+
+// RAM cache of large values recently read from SSD, with its own byte budget
+// so hot large objects skip the SSD read without competing with the RAM tier.
+// Replacement is CLOCK: a hit sets the slot's reference bit and the hand
+// clears bits until it finds an unreferenced slot to reuse. The owner must
+// erase() a key whenever its SSD copy is overwritten, deleted or re-TTLed.
+class SsdReadCache {
+public:
+  explicit SsdReadCache(std::size_t capacity_bytes);
+
+  std::optional<std::vector<std::uint8_t>> get(const std::string &key,
+                                               TimePoint now);
+  // Values larger than a quarter of the budget are not cached.
+  void put(const std::string &key, const std::vector<std::uint8_t> &value,
+           std::optional<TimePoint> ttl_deadline);
+  void erase(const std::string &key);
+
+  std::size_t capacity_bytes() const { return capacity_; }
+  const SsdReadCacheStats &stats() const { return stats_; }
+
+private:
+  struct Slot {
+    std::string key;
+    std::vector<std::uint8_t> value;
+    std::optional<TimePoint> ttl_deadline;
+    bool referenced{false};
+    bool used{false};
+  };
+
+  void release(std::size_t slot);
+  bool evict_one();
+
+  std::size_t capacity_;
+  SsdReadCacheStats stats_;
+  std::vector<Slot> slots_;
+  std::vector<std::size_t> free_;
+  std::unordered_map<std::string, std::size_t> index_;
+  std::size_t hand_{0};
+};
+
+} // namespace pomai_cache
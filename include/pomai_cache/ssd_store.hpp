@@ -1,17 +1,23 @@
 #pragma once
 
+#include "pomai_cache/file_io.hpp"
+#include "pomai_cache/small_object_store.hpp"
+#include "pomai_cache/ssd_index.hpp"
 #include "pomai_cache/types.hpp"
 
 #include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
 #include <optional>
 #include <string>
-#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace pomai_cache {
 
-enum class FsyncMode { Never, EverySec, Always };
+enum class FsyncMode { Never, EverySec, Always, Group };
 
 struct SsdConfig {
   bool enabled{false};
@@ -23,6 +29,31 @@ struct SsdConfig {
   std::size_t compaction_batch{256};
   double gc_fragmentation_threshold{0.25};
   FsyncMode fsync{FsyncMode::EverySec};
+  std::size_t append_buffer_bytes{256 * 1024};
+  std::uint32_t group_commit_window_ms{2};
+  // Fraction of SSD reads whose record checksum is verified (1.0 = all).
+  double verify_read_sample_rate{1.0};
+  // Active segment is sealed and a new one started past this size. Record
+  // offsets are 32-bit, so this is capped at 3 GiB.
+  std::size_t segment_bytes{256 * 1024 * 1024};
+  // Objects with key + value up to this size go to the set-associative
+  // small-object file instead of the segment log; 0 disables it.
+  std::size_t small_object_max_bytes{0};
+  std::size_t small_store_bytes{64 * 1024 * 1024};
+  std::size_t small_log_bytes{1024 * 1024};
+  // Threads issuing the record reads of one multi_get(), the caller included;
+  // the others are a pool kept for the store's lifetime.
+  std::size_t read_threads{8};
+  // Segment I/O with O_DIRECT: every flush is padded to a 4 KiB boundary and
+  // reads go through aligned buffers. Ignored where O_DIRECT is unsupported.
+  bool direct_io{false};
+  // Threads scanning segments at startup; 0 = one per core.
+  std::size_t recovery_threads{0};
+  // init() scans only the newest segment and returns; the rest are scanned by
+  // a background thread while lookups settle keys from the segments scanned
+  // so far, waiting up to recovery_wait_ms for the others.
+  bool online_recovery{false};
+  std::uint32_t recovery_wait_ms{10};
 };
 
 struct SsdStats {
@@ -30,8 +61,6 @@ struct SsdStats {
   std::uint64_t gets{0};
   std::uint64_t hits{0};
   std::uint64_t misses{0};
-  std::uint64_t promotions{0};
-  std::uint64_t demotions{0};
   double read_mb{0.0};
   double write_mb{0.0};
   std::uint64_t gc_runs{0};
@@ -39,60 +68,206 @@ struct SsdStats {
   std::uint64_t gc_time_ms{0};
   double fragmentation_estimate{0.0};
   std::size_t index_rebuild_ms{0};
+  // Breakdown of index_rebuild_ms. scan is wall time reading and parsing
+  // segments; verify is checksum time summed over scan threads; merge covers
+  // sorting, merging and replaying the scanned records.
+  std::size_t recovery_scan_ms{0};
+  std::size_t recovery_verify_ms{0};
+  std::size_t recovery_merge_ms{0};
+  std::size_t recovery_threads{0};
+  // Online recovery progress; index_rebuild_ms covers the whole rebuild.
+  bool recovering{false};
+  std::size_t recovery_segments_ready{0};
+  std::size_t recovery_segments_total{0};
+  std::uint64_t recovery_bytes_scanned{0};
+  std::uint64_t recovery_bytes_total{0};
+  std::uint64_t recovery_waits{0};
+  std::uint64_t recovery_unresolved{0};
+  std::uint64_t append_flushes{0};
+  std::uint64_t fsyncs{0};
+  std::uint64_t group_commits{0};
+  std::uint64_t checksum_verifies{0};
+  std::uint64_t checksum_failures{0};
+  std::size_t index_keys{0};
+  // Index slots plus TTL deadlines and expiry buckets.
+  std::size_t index_bytes{0};
+  double index_bytes_per_key{0.0};
+  std::size_t segments{0};
+  std::uint64_t evicted_segments{0};
+  std::uint64_t evicted_bytes{0};
+  std::uint64_t evicted_keys{0};
+  std::uint64_t reinserted_keys{0};
+  std::size_t small_objects{0};
+  std::uint64_t small_page_writes{0};
+  std::uint64_t small_bloom_false_positives{0};
+  std::uint64_t small_evicted{0};
+  std::size_t small_ram_bytes{0};
+  // Payload bytes callers asked to store vs bytes written to the device
+  // (record headers, GC copies, reinsertions, whole small-object pages).
+  std::uint64_t user_bytes_written{0};
+  std::uint64_t device_bytes_written{0};
+  double write_amplification{0.0};
+  std::uint64_t multi_gets{0};
+  std::uint64_t multi_get_reads{0};
+  bool direct_io{false};
+  std::uint64_t pad_bytes{0};
 };
 
 struct SsdMeta {
   std::uint64_t seq{0};
   std::int64_t ttl_epoch_ms{-1};
   std::size_t len{0};
+  // The log record a get() returned; record_bytes is 0 for small objects.
+  std::uint64_t loc{0};
+  std::uint32_t record_bytes{0};
+};
+
+// One item of SsdStore::put_batch; pointers must outlive the call.
+struct SsdPut {
+  const std::string *key{nullptr};
+  const std::vector<std::uint8_t> *value{nullptr};
+  std::optional<TimePoint> ttl_deadline;
+  std::uint64_t seq{0};
 };
 
 class SsdStore {
 public:
   explicit SsdStore(SsdConfig cfg);
+  ~SsdStore();
+  SsdStore(const SsdStore &) = delete;
+  SsdStore &operator=(const SsdStore &) = delete;
 
   bool init(std::string *err = nullptr);
   bool put(const std::string &key, const std::vector<std::uint8_t> &value,
            std::optional<TimePoint> ttl_deadline, std::uint64_t seq,
            std::string *err = nullptr);
+  // Appends every item back to back, then commits once. `ok` gets one flag
+  // per item; a failed commit clears all of them and returns false.
+  bool put_batch(const std::vector<SsdPut> &items, std::vector<bool> *ok,
+                 std::string *err = nullptr);
+  // Appends a tombstone if `key` is on SSD; returns false when it was not.
+  // `read` is the meta of a get() of `key`: while that record is still
+  // current it is dropped without the key-verifying record read.
   bool del(const std::string &key, std::uint64_t seq,
-           std::string *err = nullptr);
+           std::string *err = nullptr, const SsdMeta *read = nullptr);
 
   std::optional<std::vector<std::uint8_t>> get(const std::string &key,
                                                SsdMeta *meta = nullptr);
-  bool contains(const std::string &key) const;
+  // Batched get(): probes the index for every key, then issues all record
+  // reads together from up to read_threads threads in segment/offset order.
+  // Keys needing more than one probe (tag collisions, small objects, expired
+  // entries) go through get(). `metas` gets one entry per key.
+  std::vector<std::optional<std::vector<std::uint8_t>>>
+  multi_get(const std::vector<std::string> &keys,
+            std::vector<SsdMeta> *metas = nullptr);
+  bool contains(const std::string &key);
+  // Index lookup plus a key-verifying header read; the value is not read.
+  bool stat(const std::string &key, SsdMeta *meta);
+  // Replaces the TTL of `key` (nullopt clears it) by appending a header+key
+  // meta record. Returns false when `key` is not on SSD.
+  bool set_ttl(const std::string &key, std::optional<TimePoint> ttl_deadline,
+               std::uint64_t seq, std::string *err = nullptr);
   std::size_t erase_expired(std::size_t max_items, TimePoint now);
   void maybe_compact();
 
+  // Writes buffered appends to the active segment and, in Group mode, issues
+  // the fsync covering every record appended since the previous commit.
+  // Callers release write acknowledgements only after this returns true.
+  bool commit(std::string *err = nullptr);
+  // Commits once the oldest buffered record has waited group_commit_window_ms
+  // or the EverySec deadline passed; cheap no-op otherwise.
+  void maybe_commit();
+  // Publishes online recovery progress and, once the background scan is
+  // done, merges the remaining records into the index. Cheap otherwise.
+  void poll_recovery();
+
   const SsdStats &stats() const { return stats_; }
-  std::size_t size() const { return index_.size(); }
+  std::size_t size() const {
+    return index_.size() + (small_ ? small_->stats().objects : 0);
+  }
 
 private:
-  struct IndexEntry {
-    std::uint32_t segment_id{0};
-    std::uint64_t offset{0};
-    std::uint32_t len{0};
-    std::uint64_t seq{0};
-    std::int64_t ttl_epoch_ms{-1};
-    bool tombstone{false};
-  };
-
   struct SegmentMeta {
-    std::uint32_t id{0};
+    std::uint32_t id{0}; // 0 marks a free slot
     std::size_t bytes{0};
+    std::size_t live_bytes{0};
+    std::uint64_t min_seq{UINT64_MAX};
+  };
+
+  struct Record;
+  struct ScanEntry;
+  struct Recovery;
+  struct Readers;
+  struct Found {
+    std::size_t index_pos{SsdIndex::npos};
+    std::uint64_t loc{0};
+    std::uint32_t record_bytes{0};
   };
 
   std::string seg_path(std::uint32_t id) const;
   bool append_record(const std::string &key,
                      const std::vector<std::uint8_t> &value,
                      std::int64_t ttl_epoch_ms, std::uint64_t seq,
-                     bool tombstone, IndexEntry *entry, std::string *err);
+                     std::uint8_t type, std::uint64_t *loc_out,
+                     std::string *err);
   bool sync_for_policy();
+  void pad_active_tail();
+  bool flush_appends(const void *tail_a = nullptr, std::size_t tail_a_len = 0,
+                     const void *tail_b = nullptr,
+                     std::size_t tail_b_len = 0);
+  void drop_unflushed();
+  bool fsync_active();
+  bool rotate_segment(std::string *err);
+  bool open_active(std::string *err);
+  std::uint32_t alloc_segment_slot(std::uint32_t id);
   bool load_manifest(std::vector<std::uint32_t> *segments,
                      std::uint32_t *active);
   bool write_manifest();
-  bool scan_segment(std::uint32_t id, bool repair_tail);
-  bool read_entry(const IndexEntry &e, std::vector<std::uint8_t> *value_out);
+  bool recover_segments(const std::vector<std::uint32_t> &slots,
+                        std::uint32_t active_id, std::vector<ScanEntry> *out);
+  bool begin_online_recovery(const std::vector<std::uint32_t> &slots,
+                             std::uint32_t active_id,
+                             std::vector<ScanEntry> *out);
+  void recovery_worker();
+  // Runs `job` on the caller and up to `helpers` reader threads, started on
+  // first use and kept for the store's lifetime; returns once all are done.
+  void run_readers(std::size_t helpers, const std::function<void()> &job);
+  void stop_readers();
+  void finish_recovery();
+  void stop_recovery();
+  bool settle(const std::string &key,
+              std::chrono::steady_clock::time_point deadline);
+  void replay(std::vector<ScanEntry> *scanned,
+              const std::unordered_set<std::uint64_t> *skip);
+  bool scan_segment(std::uint32_t slot, std::uint32_t id, bool repair_tail,
+                    std::vector<ScanEntry> *out,
+                    std::chrono::nanoseconds *verify_time) const;
+  bool read_at(std::uint32_t slot, std::uint64_t offset, std::size_t len,
+               std::vector<std::uint8_t> *out);
+  bool read_record(std::uint64_t loc, bool want_value, Record *out);
+  bool decode_record(const std::vector<std::uint8_t> &buf, bool want_value,
+                     bool verify, Record *out);
+  int read_fd(std::uint32_t slot);
+  void close_read_fd(std::uint32_t slot);
+  // While online recovery runs, first settles `key` from the scanned
+  // segments; `wait` bounds that by recovery_wait_ms, otherwise it does not
+  // block. `unresolved` is set when the key could not be settled.
+  std::optional<Found> find(const std::string &key, bool want_value,
+                            Record *rec_out, bool *io_error,
+                            bool *unresolved = nullptr, bool wait = true);
+  void forget(const Found &f);
+  void track_ttl(std::uint32_t tag, std::int64_t deadline_ms);
+  bool shadows_older(std::uint32_t slot, std::uint64_t seq) const;
+  std::uint32_t oldest_sealed_slot() const;
+  std::uint32_t gc_candidate_slot() const;
+  bool make_room(std::size_t need);
+  bool is_small(const std::string &key, std::size_t value_len) const;
+  bool del_from_log(const std::string &key, std::uint64_t seq,
+                    std::string *err, const SsdMeta *read = nullptr);
+  void evict_segment(std::uint32_t slot);
+  bool compact_step(std::size_t budget);
+  void update_gauges();
+  bool should_verify_read();
   bool consume_write_budget(std::size_t bytes);
   bool consume_read_budget(std::size_t bytes);
   void refill_tokens();
@@ -100,17 +275,51 @@ private:
 
   SsdConfig cfg_;
   SsdStats stats_;
-  std::unordered_map<std::string, IndexEntry> index_;
+  SsdIndex index_;
+  std::unique_ptr<SmallObjectStore> small_;
+  // deadline_ms / 100 -> index tags; the deadline itself lives in the index
+  // slot. Tags of overwritten, re-timed or deleted keys are left in place and
+  // skipped when their bucket is drained.
+  std::map<std::int64_t, std::vector<std::uint32_t>> expiry_buckets_;
+  std::size_t expiry_bytes_{0};
   std::vector<SegmentMeta> segments_;
-  std::uint32_t active_segment_{1};
+  std::uint32_t active_slot_{0};
+  std::uint32_t next_segment_id_{1};
   int active_fd_{-1};
+  // Read-only descriptors by segment slot, opened on first read; -1 = closed.
+  std::vector<int> read_fds_;
+  bool direct_{false};
+  AlignedBytes append_buf_;
+  AlignedBytes read_bounce_;
+  // Bounce buffers for multi_get's parallel direct reads.
+  std::vector<AlignedBytes> read_pool_;
+  // Threads sharing multi_get's reads; null until the first parallel batch.
+  std::unique_ptr<Readers> readers_;
+  std::uint64_t active_end_{0};
+  std::uint64_t flushed_end_{0};
+  bool unsynced_{false};
+  std::chrono::steady_clock::time_point oldest_pending_{};
   std::uint64_t last_fsync_epoch_s_{0};
+  std::uint64_t last_seq_{0};
   std::size_t live_bytes_{0};
   std::size_t total_segment_bytes_{0};
+  std::uint64_t log_bytes_written_{0};
+  bool suppress_eviction_{false};
+  bool in_batch_{false};
+  // Set while online recovery is scanning segments in the background.
+  std::unique_ptr<Recovery> recovery_;
+
+  // Incremental GC: sealed segment being copied forward, and the offset of
+  // the next record to examine.
+  std::uint32_t gc_slot_{0};
+  std::uint64_t gc_offset_{0};
+  bool gc_active_{false};
+  std::chrono::steady_clock::duration gc_elapsed_{};
 
   std::chrono::steady_clock::time_point token_refill_{};
   double read_tokens_{0.0};
   double write_tokens_{0.0};
+  double verify_credit_{0.0};
 };
 
 } // namespace pomai_cache
@@ -2,6 +2,7 @@
 
 #include <chrono>
 #include <cstdint>
+#include <memory>
 #include <optional>
 #include <string>
 #include <vector>
@@ -11,8 +12,12 @@ namespace pomai_cache {
 using Clock = std::chrono::system_clock;
 using TimePoint = Clock::time_point;
 
+// Shared, immutable value buffer; a reader holding one keeps the bytes alive
+// after the entry is replaced or evicted.
+using ValueRef = std::shared_ptr<const std::vector<std::uint8_t>>;
+
 struct Entry {
-  std::vector<std::uint8_t> value;
+  ValueRef value;
   std::size_t size_bytes{0};
   TimePoint created_at{};
   TimePoint last_access{};
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace pomai_cache {
+
+// Element types of AI.EMB vectors: little-endian float32, IEEE half, int8.
+enum class VectorType { Float32, Float16, Int8 };
+
+// "float", "float16" or "int8".
+bool parse_vector_type(std::string_view name, VectorType *out);
+const char *vector_type_name(VectorType type);
+std::size_t vector_type_width(VectorType type);
+
+// How an embedding payload is laid out: elements of the matching
+// VectorType, or for Int8Scaled a float32 scale followed by int8 codes, each
+// element being code * scale.
+enum class VectorCodec { Float32, Float16, Int8, Int8Scaled };
+const char *vector_codec_name(VectorCodec codec);
+
+float half_to_float(std::uint16_t h);
+// Round to nearest even; out-of-range values become infinity.
+std::uint16_t float_to_half(float f);
+
+// Dot products with AVX2/FMA/F16C kernels on x86-64 when the CPU has them,
+// NEON on AArch64 and scalar loops otherwise.
+float dot_f32(const float *a, const float *b, std::size_t n);
+float dot_f16(const std::uint16_t *a, const std::uint16_t *b, std::size_t n);
+std::int32_t dot_i8(const std::int8_t *a, const std::int8_t *b, std::size_t n);
+// Bulk conversions on the same dispatch. quantize_i8 is symmetric: it
+// returns scale = max|x| / 127 and writes x / scale rounded to nearest
+// even, or zeros and scale 0 when max|x| is 0 or not finite.
+void f32_to_f16(const float *in, std::uint16_t *out, std::size_t n);
+void f16_to_f32(const std::uint16_t *in, float *out, std::size_t n);
+float quantize_i8(const float *in, std::int8_t *out, std::size_t n);
+void dequantize_i8(const std::int8_t *in, float scale, float *out,
+                   std::size_t n);
+const char *vector_kernel_impl_name();
+
+struct VectorIndexConfig {
+  // A list holding more vectors than this is split in two.
+  std::size_t max_list{1024};
+  // Lists scanned per query, nearest centroids first.
+  std::size_t nprobe{8};
+};
+
+// Approximate cosine-similarity search over vectors of one dim and type, as
+// an inverted file (IVF): each vector lives in the list of its nearest
+// centroid, and a query scans only the nprobe lists closest to it. Lists are
+// built incrementally: centroids follow their members as vectors come and
+// go, and a list that outgrows max_list is split by 2-means over its own
+// members, so no step ever retrains over the whole index. While there are
+// at most nprobe lists the search is exact.
+class VectorIndex {
+public:
+  VectorIndex(std::size_t dim, VectorType type, VectorIndexConfig cfg = {});
+
+  // `vec` holds vector_bytes() bytes; re-adding an id replaces its vector.
+  void add(std::uint32_t id, const std::uint8_t *vec);
+  bool remove(std::uint32_t id);
+  // Up to k (id, similarity) pairs, most similar first.
+  std::vector<std::pair<std::uint32_t, float>>
+  search(const std::uint8_t *query, std::size_t k) const;
+
+  std::size_t size() const { return slot_of_.size(); }
+  std::size_t dim() const { return dim_; }
+  VectorType type() const { return type_; }
+  std::size_t vector_bytes() const { return bytes_; }
+  std::size_t list_count() const { return lists_.size(); }
+
+private:
+  struct Slot {
+    std::uint32_t id{0};
+    float norm{0};
+    std::uint32_t list{0};
+    // Index within lists_[list].
+    std::uint32_t pos{0};
+  };
+  struct List {
+    std::vector<std::uint32_t> slots;
+    // Sum of the members' unit vectors, and its direction.
+    std::vector<float> sum;
+    std::vector<float> centroid;
+  };
+
+  const std::uint8_t *vec(std::uint32_t slot) const {
+    return data_.data() + std::size_t{slot} * bytes_;
+  }
+  float dot(const std::uint8_t *a, const std::uint8_t *b) const;
+  void unit(const std::uint8_t *v, float *out) const;
+  std::uint32_t nearest_list(const float *u) const;
+  void attach(std::uint32_t slot, std::uint32_t list, const float *u);
+  void detach(std::uint32_t slot, const float *u);
+  void refresh_centroid(List &l) const;
+  void split(std::uint32_t list);
+
+  std::size_t dim_;
+  VectorType type_;
+  std::size_t bytes_;
+  VectorIndexConfig cfg_;
+  // Slot-major vector storage; freed slots are reused.
+  std::vector<std::uint8_t> data_;
+  std::vector<Slot> slots_;
+  std::vector<std::uint32_t> free_slots_;
+  std::unordered_map<std::uint32_t, std::uint32_t> slot_of_;
+  std::vector<List> lists_;
+};
+
+} // namespace pomai_cache
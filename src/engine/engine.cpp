@@ -1,47 +1,106 @@
 #include "pomai_cache/engine.hpp"
 
+#include "pomai_cache/hash.hpp"
+#include "pomai_cache/json.hpp"
+
 #include <algorithm>
 #include <chrono>
 #include <fstream>
-#include <regex>
 #include <sstream>
 
 namespace pomai_cache {
 namespace {
-bool extract_double(const std::string &text, const std::string &key,
-                    double &out) {
-  std::regex re("\"" + key + "\"\\s*:\\s*(-?[0-9]+(?:\\.[0-9]+)?)");
-  std::smatch m;
-  if (!std::regex_search(text, m, re))
-    return false;
-  out = std::stod(m[1].str());
-  return true;
+// Reads policy params from the object just entered in `r`. Nested objects
+// ("weights", "thresholds", ...) are only grouping, so their members are read
+// as if they were top-level.
+void read_params(JsonReader &r, PolicyParams &p) {
+  auto clamp_d = [](double v, double lo, double hi) {
+    return std::min(hi, std::max(lo, v));
+  };
+  auto clamp_rate = [](std::uint64_t v) {
+    return std::clamp<std::uint64_t>(v, 1, 1000000);
+  };
+  std::string_view name;
+  double d = 0;
+  std::uint64_t u = 0;
+  while (r.next_member(&name)) {
+    if (r.begin_object()) {
+      read_params(r, p);
+    } else if (name == "w_miss") {
+      if (r.read_double(&d))
+        p.w_miss = clamp_d(d, 0.0, 1000.0);
+    } else if (name == "w_reuse") {
+      if (r.read_double(&d))
+        p.w_reuse = clamp_d(d, 0.0, 1000.0);
+    } else if (name == "w_mem") {
+      if (r.read_double(&d))
+        p.w_mem = clamp_d(d, 0.0, 1000.0);
+    } else if (name == "w_risk") {
+      if (r.read_double(&d))
+        p.w_risk = clamp_d(d, 0.0, 1000.0);
+    } else if (name == "admit_threshold") {
+      if (r.read_double(&d))
+        p.admit_threshold = clamp_d(d, -1e9, 1e9);
+    } else if (name == "evict_pressure") {
+      if (r.read_double(&d))
+        p.evict_pressure = clamp_d(d, 0.1, 1.0);
+    } else if (name == "max_evictions_per_second") {
+      if (r.read_u64(&u))
+        p.max_evictions_per_second = clamp_rate(u);
+    } else if (name == "max_admissions_per_second") {
+      if (r.read_u64(&u))
+        p.max_admissions_per_second = clamp_rate(u);
+    } else if (name == "owner_cap_bytes") {
+      if (r.read_u64(&u))
+        p.owner_cap_bytes = static_cast<std::size_t>(
+            std::min<std::uint64_t>(u, 1ULL << 40));
+    } else if (name == "version") {
+      r.read_string(&p.version);
+    } else {
+      r.skip();
+    }
+  }
 }
-bool extract_u64(const std::string &text, const std::string &key,
-                 std::uint64_t &out) {
-  std::regex re("\"" + key + "\"\\s*:\\s*([0-9]+)");
-  std::smatch m;
-  if (!std::regex_search(text, m, re))
-    return false;
-  out = static_cast<std::uint64_t>(std::stoull(m[1].str()));
-  return true;
+
+SsdConfig make_ssd_config(const EngineConfig &cfg) {
+  SsdConfig sc;
+  sc.enabled = cfg.tier.ssd_enabled;
+  sc.dir = cfg.data_dir;
+  sc.value_min_bytes = cfg.tier.ssd_value_min_bytes;
+  sc.max_bytes = cfg.tier.ssd_max_bytes;
+  sc.max_read_mb_s = cfg.tier.ssd_max_read_mb_s;
+  sc.max_write_mb_s = cfg.tier.ssd_max_write_mb_s;
+  sc.compaction_batch = 512;
+  sc.gc_fragmentation_threshold = 0.25;
+  sc.fsync = cfg.fsync_mode;
+  sc.append_buffer_bytes = cfg.tier.ssd_append_buffer_bytes;
+  sc.group_commit_window_ms = cfg.tier.ssd_group_commit_ms;
+  sc.verify_read_sample_rate = cfg.tier.ssd_verify_read_sample;
+  sc.segment_bytes = cfg.tier.ssd_segment_bytes;
+  sc.small_object_max_bytes = cfg.tier.ssd_small_object_bytes;
+  sc.small_store_bytes = cfg.tier.ssd_small_store_bytes;
+  sc.read_threads = std::max<std::size_t>(1, cfg.tier.ssd_read_threads);
+  sc.direct_io = cfg.tier.ssd_direct_io;
+  sc.recovery_threads = cfg.tier.ssd_recovery_threads;
+  sc.online_recovery = cfg.tier.ssd_online_recovery;
+  sc.recovery_wait_ms = cfg.tier.ssd_recovery_wait_ms;
+  return sc;
 }
-bool extract_string(const std::string &text, const std::string &key,
-                    std::string &out) {
-  std::regex re("\"" + key + "\"\\s*:\\s*\"([^\"]*)\"");
-  std::smatch m;
-  if (!std::regex_search(text, m, re))
-    return false;
-  out = m[1].str();
-  return true;
+
+SsdAdmissionConfig make_admission_config(const EngineConfig &cfg) {
+  SsdAdmissionConfig ac;
+  ac.min_accesses = cfg.tier.ssd_admit_min_accesses;
+  ac.dwpd = cfg.tier.ssd_dwpd;
+  ac.device_bytes = cfg.tier.ssd_max_bytes;
+  return ac;
 }
 } // namespace
 
 Engine::Engine(EngineConfig cfg, std::unique_ptr<IEvictionPolicy> policy)
     : cfg_(std::move(cfg)), policy_(std::move(policy)),
-      ssd_({cfg_.tier.ssd_enabled, cfg_.data_dir, cfg_.tier.ssd_value_min_bytes,
-            cfg_.tier.ssd_max_bytes, cfg_.tier.ssd_max_read_mb_s,
-            cfg_.tier.ssd_max_write_mb_s, 512, 0.25, cfg_.fsync_mode}) {
+      ssd_(make_ssd_config(cfg_)),
+      ssd_admission_(make_admission_config(cfg_)),
+      ssd_read_cache_(cfg_.tier.ssd_read_cache_bytes) {
   owner_miss_cost_default_["default"] = 1.0;
   owner_miss_cost_default_["premium"] = 2.0;
   owner_miss_cost_default_["vector"] = 8.0;
@@ -69,6 +128,9 @@ bool Engine::set(const std::string &key, const std::vector<std::uint8_t> &value,
     return false;
   }
 
+  if (cfg_.tier.ssd_enabled)
+    ssd_admission_.record_access(key);
+
   const std::string normalized_owner = owner.empty() ? "default" : owner;
   const auto owner_cap = policy_->params().owner_cap_bytes;
   std::size_t owner_used = owner_usage_[normalized_owner];
@@ -81,7 +143,7 @@ bool Engine::set(const std::string &key, const std::vector<std::uint8_t> &value,
   }
 
   Entry candidate;
-  candidate.value = value;
+  candidate.value = std::make_shared<const std::vector<std::uint8_t>>(value);
   candidate.size_bytes = value.size();
   candidate.created_at = Clock::now();
   candidate.last_access = candidate.created_at;
@@ -99,17 +161,24 @@ bool Engine::set(const std::string &key, const std::vector<std::uint8_t> &value,
   }
 
   ++seq_;
+  ssd_read_cache_.erase(key);
   const bool to_ssd =
       cfg_.tier.ssd_enabled && value.size() >= cfg_.tier.ssd_value_min_bytes;
   if (to_ssd) {
     if (!ssd_.put(key, value, candidate.ttl_deadline, seq_, err))
       return false;
+    ssd_admission_.charge(value.size());
     if (entries_.contains(key))
       erase_internal(key, false, false);
-    ssd_hit_count_[key] = 0;
     return true;
   }
 
+  install_entry(key, std::move(candidate));
+  return true;
+}
+
+// Puts `entry` into the RAM tier, replacing any current entry for `key`.
+void Engine::install_entry(const std::string &key, Entry entry) {
   if (entries_.contains(key)) {
     owner_usage_[entries_[key].owner] -= entries_[key].size_bytes;
     memory_used_ -= entries_[key].size_bytes;
@@ -117,7 +186,7 @@ bool Engine::set(const std::string &key, const std::vector<std::uint8_t> &value,
     policy_->on_erase(key);
   }
 
-  entries_[key] = std::move(candidate);
+  entries_[key] = std::move(entry);
   owner_usage_[entries_[key].owner] += entries_[key].size_bytes;
   memory_used_ += entries_[key].size_bytes;
   bucket_used_ += bucket_for(entries_[key].size_bytes);
@@ -129,39 +198,123 @@ bool Engine::set(const std::string &key, const std::vector<std::uint8_t> &value,
   }
 
   evict_until_fit();
-  return true;
 }
 
-std::optional<std::vector<std::uint8_t>> Engine::get(const std::string &key) {
+ValueRef Engine::get_ref(const std::string &key) {
   tick();
-  if (exists_and_not_expired(key)) {
-    auto &e = entries_[key];
-    e.last_access = Clock::now();
-    ++e.hit_count;
+  if (cfg_.tier.ssd_enabled)
+    ssd_admission_.record_access(key);
+  if (auto *e = find_live(key)) {
+    record_hit(key, *e);
+    return e->value;
+  }
+  std::optional<std::vector<std::uint8_t>> v;
+  if (cfg_.tier.ssd_enabled) {
+    if (!(v = get_from_ram(key))) {
+      SsdMeta m;
+      v = finish_ssd_read(key, ssd_.get(key, &m), m);
+    }
+  } else {
+    ++stats_.misses;
+  }
+  if (!v.has_value())
+    return nullptr;
+  return std::make_shared<const std::vector<std::uint8_t>>(std::move(*v));
+}
+
+bool Engine::touch(const std::string &key) {
+  tick();
+  if (cfg_.tier.ssd_enabled)
+    ssd_admission_.record_access(key);
+  if (auto *e = find_live(key)) {
+    record_hit(key, *e);
+    return true;
+  }
+  // The read cache only holds values that are also on SSD.
+  if (cfg_.tier.ssd_enabled && ssd_.contains(key)) {
     ++stats_.hits;
-    policy_->on_access(key, e);
-    return e.value;
+    return true;
   }
+  ++stats_.misses;
+  return false;
+}
 
+bool Engine::contains(const std::string &key) {
+  if (find_live(key))
+    return true;
+  return cfg_.tier.ssd_enabled && ssd_.contains(key);
+}
+
+std::optional<std::vector<std::uint8_t>> Engine::get(const std::string &key) {
+  tick();
+  if (cfg_.tier.ssd_enabled)
+    ssd_admission_.record_access(key);
+  if (auto v = get_from_ram(key))
+    return v;
   if (!cfg_.tier.ssd_enabled) {
     ++stats_.misses;
     return std::nullopt;
   }
   SsdMeta m;
   auto v = ssd_.get(key, &m);
+  return finish_ssd_read(key, std::move(v), m);
+}
+
+// RAM tier, then the large-value read cache. Counts hits only.
+std::optional<std::vector<std::uint8_t>>
+Engine::get_from_ram(const std::string &key) {
+  if (auto *e = find_live(key)) {
+    record_hit(key, *e);
+    return *e->value;
+  }
+  if (cfg_.tier.ssd_enabled && ssd_read_cache_.capacity_bytes() > 0) {
+    if (auto hit = ssd_read_cache_.get(key, Clock::now())) {
+      ++stats_.hits;
+      return hit;
+    }
+  }
+  return std::nullopt;
+}
+
+// Accounts an SSD read of `key` and promotes or caches the value it returned.
+std::optional<std::vector<std::uint8_t>>
+Engine::finish_ssd_read(const std::string &key,
+                        std::optional<std::vector<std::uint8_t>> v,
+                        const SsdMeta &m) {
   if (!v.has_value()) {
     ++stats_.misses;
     return std::nullopt;
   }
   ++stats_.hits;
-
-  auto &hits = ssd_hit_count_[key];
-  hits++;
-  if (hits >= cfg_.tier.promotion_hits &&
-      v->size() < cfg_.tier.ssd_value_min_bytes) {
-    promote_queue_.push_back(key);
-    hits = 0;
+  std::optional<TimePoint> deadline;
+  if (m.ttl_epoch_ms >= 0)
+    deadline = TimePoint(std::chrono::milliseconds(m.ttl_epoch_ms));
+  if (v->size() >= cfg_.tier.ssd_value_min_bytes) {
+    // Large values are never promoted; keep hot ones in the read cache.
+    if (ssd_read_cache_.capacity_bytes() > 0)
+      ssd_read_cache_.put(key, *v, deadline);
+    return v;
   }
+
+  // Promote from the buffer just read: no second SSD read, no admission,
+  // and the SSD copy is dropped with a tombstone.
+  const auto h = std::hash<std::string>{}(key);
+  ssd_hits_.increment(h);
+  if (ssd_hits_.estimate(h) < cfg_.tier.promotion_hits)
+    return v;
+  Entry e;
+  e.value = std::make_shared<const std::vector<std::uint8_t>>(*v);
+  e.size_bytes = v->size();
+  e.created_at = Clock::now();
+  e.last_access = e.created_at;
+  e.hit_count = ssd_hits_.estimate(h);
+  e.owner = "default";
+  e.ttl_deadline = deadline;
+  // `m` names the record just read, so the tombstone needs no lookup read.
+  if (ssd_.del(key, seq_ + 1, nullptr, &m))
+    ++seq_;
+  install_entry(key, std::move(e));
+  ++stats_.promotions;
   return v;
 }
 
@@ -174,9 +327,9 @@ std::size_t Engine::del(const std::vector<std::string> &keys) {
       erase_internal(k, false, false);
       deleted = true;
     }
-    if (cfg_.tier.ssd_enabled && ssd_.contains(k)) {
+    ssd_read_cache_.erase(k);
+    if (cfg_.tier.ssd_enabled && ssd_.del(k, seq_ + 1)) {
       ++seq_;
-      ssd_.del(k, seq_);
       deleted = true;
     }
     if (deleted)
@@ -195,12 +348,10 @@ bool Engine::expire(const std::string &key, std::uint64_t ttl_seconds) {
     expiry_heap_.push({*e.ttl_deadline, key, gen});
     return true;
   }
-  if (cfg_.tier.ssd_enabled) {
-    auto v = ssd_.get(key);
-    if (v.has_value()) {
-      ++seq_;
-      return ssd_.put(key, *v, deadline, seq_);
-    }
+  ssd_read_cache_.erase(key);
+  if (cfg_.tier.ssd_enabled && ssd_.set_ttl(key, deadline, seq_ + 1)) {
+    ++seq_;
+    return true;
   }
   return false;
 }
@@ -219,8 +370,7 @@ std::optional<std::int64_t> Engine::ttl(const std::string &key) {
   }
   if (cfg_.tier.ssd_enabled) {
     SsdMeta m;
-    auto v = ssd_.get(key, &m);
-    if (!v.has_value())
+    if (!ssd_.stat(key, &m))
       return std::nullopt;
     if (m.ttl_epoch_ms < 0)
       return -1;
@@ -235,10 +385,64 @@ std::optional<std::int64_t> Engine::ttl(const std::string &key) {
 
 std::vector<std::optional<std::vector<std::uint8_t>>>
 Engine::mget(const std::vector<std::string> &keys) {
-  std::vector<std::optional<std::vector<std::uint8_t>>> out;
-  out.reserve(keys.size());
-  for (const auto &k : keys)
-    out.push_back(get(k));
+  tick();
+  std::vector<std::optional<std::vector<std::uint8_t>>> out(keys.size());
+  // RAM hits are answered first; every miss goes to SSD as one batch.
+  std::vector<std::string> ssd_keys;
+  std::vector<std::size_t> ssd_slots;
+  for (std::size_t i = 0; i < keys.size(); ++i) {
+    if (cfg_.tier.ssd_enabled)
+      ssd_admission_.record_access(keys[i]);
+    out[i] = get_from_ram(keys[i]);
+    if (out[i].has_value())
+      continue;
+    if (!cfg_.tier.ssd_enabled) {
+      ++stats_.misses;
+      continue;
+    }
+    ssd_keys.push_back(keys[i]);
+    ssd_slots.push_back(i);
+  }
+  if (ssd_keys.empty())
+    return out;
+  std::vector<SsdMeta> metas;
+  auto vals = ssd_.multi_get(ssd_keys, &metas);
+  for (std::size_t j = 0; j < ssd_keys.size(); ++j)
+    out[ssd_slots[j]] = finish_ssd_read(ssd_keys[j], std::move(vals[j]),
+                                        metas[j]);
+  return out;
+}
+
+std::vector<ValueRef> Engine::mget_ref(const std::vector<std::string> &keys) {
+  tick();
+  std::vector<ValueRef> out(keys.size());
+  std::vector<std::string> ssd_keys;
+  std::vector<std::size_t> ssd_slots;
+  for (std::size_t i = 0; i < keys.size(); ++i) {
+    if (cfg_.tier.ssd_enabled)
+      ssd_admission_.record_access(keys[i]);
+    if (auto *e = find_live(keys[i])) {
+      record_hit(keys[i], *e);
+      out[i] = e->value;
+    } else if (!cfg_.tier.ssd_enabled) {
+      ++stats_.misses;
+    } else if (auto v = get_from_ram(keys[i])) {
+      out[i] = std::make_shared<const std::vector<std::uint8_t>>(std::move(*v));
+    } else {
+      ssd_keys.push_back(keys[i]);
+      ssd_slots.push_back(i);
+    }
+  }
+  if (ssd_keys.empty())
+    return out;
+  std::vector<SsdMeta> metas;
+  auto vals = ssd_.multi_get(ssd_keys, &metas);
+  for (std::size_t j = 0; j < ssd_keys.size(); ++j) {
+    auto v = finish_ssd_read(ssd_keys[j], std::move(vals[j]), metas[j]);
+    if (v.has_value())
+      out[ssd_slots[j]] =
+          std::make_shared<const std::vector<std::uint8_t>>(std::move(*v));
+  }
   return out;
 }
 
@@ -261,48 +465,17 @@ void Engine::tick() {
       erase_internal(key, false, true);
     ++cleaned;
   }
-  if (cfg_.tier.ssd_enabled)
+  if (cfg_.tier.ssd_enabled) {
+    ssd_.poll_recovery();
     ssd_.erase_expired(cfg_.ttl_cleanup_per_tick, now);
-
-  std::size_t tier_work = 0;
-  while (!promote_queue_.empty() && tier_work < cfg_.tier_work_per_tick) {
-    std::string key = promote_queue_.front();
-    promote_queue_.pop_front();
-    if (!entries_.contains(key)) {
-      SsdMeta m;
-      auto v = ssd_.get(key, &m);
-      if (v.has_value() && v->size() < cfg_.tier.ssd_value_min_bytes) {
-        std::optional<std::uint64_t> ttl_ms;
-        if (m.ttl_epoch_ms >= 0) {
-          auto now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-                            Clock::now().time_since_epoch())
-                            .count();
-          if (m.ttl_epoch_ms > now_ms)
-            ttl_ms = static_cast<std::uint64_t>(m.ttl_epoch_ms - now_ms);
-        }
-        set(key, *v, ttl_ms, "default");
-        ++seq_;
-        ssd_.del(key, seq_);
-      }
-    }
-    ++tier_work;
   }
 
   maybe_enqueue_demotion();
-  while (!demote_queue_.empty() && tier_work < cfg_.tier_work_per_tick) {
-    auto key = demote_queue_.front();
-    demote_queue_.pop_front();
-    if (!entries_.contains(key)) {
-      ++tier_work;
-      continue;
-    }
-    ++seq_;
-    ssd_.put(key, entries_[key].value, entries_[key].ttl_deadline, seq_);
-    erase_internal(key, true, false);
-    ++tier_work;
-  }
-  if (cfg_.tier.ssd_enabled)
+  demote_pending(cfg_.tier_work_per_tick);
+  if (cfg_.tier.ssd_enabled) {
     ssd_.maybe_compact();
+    ssd_.maybe_commit();
+  }
 
   expiration_backlog_ = 0;
   auto snapshot = expiry_heap_;
@@ -314,6 +487,12 @@ void Engine::tick() {
   }
 }
 
+bool Engine::commit(std::string *err) {
+  if (!cfg_.tier.ssd_enabled)
+    return true;
+  return ssd_.commit(err);
+}
+
 std::string Engine::info() const {
   std::ostringstream os;
   os << "policy_mode:" << policy_->name() << "\n";
@@ -333,11 +512,13 @@ std::string Engine::info() const {
   os << "ssd_gets:" << ssd_.stats().gets << "\n";
   os << "ssd_hits:" << ssd_.stats().hits << "\n";
   os << "ssd_misses:" << ssd_.stats().misses << "\n";
-  os << "promotions:" << ssd_.stats().promotions << "\n";
-  os << "demotions:" << ssd_.stats().demotions << "\n";
+  os << "promotions:" << stats_.promotions << "\n";
+  os << "demotions:" << stats_.demotions << "\n";
+  os << "demotion_failures:" << stats_.demotion_failures << "\n";
+  os << "demotion_batches:" << stats_.demotion_batches << "\n";
   os << "ssd_read_mb:" << ssd_.stats().read_mb << "\n";
   os << "ssd_write_mb:" << ssd_.stats().write_mb << "\n";
-  os << "tier_backlog:" << (promote_queue_.size() + demote_queue_.size())
+  os << "tier_backlog:" << demote_queue_.size()
      << "\n";
   os << "ssd_gc_runs:" << ssd_.stats().gc_runs << "\n";
   os << "ssd_gc_bytes_reclaimed:" << ssd_.stats().gc_bytes_reclaimed << "\n";
@@ -345,6 +526,66 @@ std::string Engine::info() const {
   os << "fragmentation_estimate:" << ssd_.stats().fragmentation_estimate
      << "\n";
   os << "ssd_index_rebuild_ms:" << ssd_.stats().index_rebuild_ms << "\n";
+  os << "ssd_recovery_scan_ms:" << ssd_.stats().recovery_scan_ms << "\n";
+  os << "ssd_recovery_verify_ms:" << ssd_.stats().recovery_verify_ms << "\n";
+  os << "ssd_recovery_merge_ms:" << ssd_.stats().recovery_merge_ms << "\n";
+  os << "ssd_recovery_threads:" << ssd_.stats().recovery_threads << "\n";
+  os << "ssd_recovering:" << (ssd_.stats().recovering ? 1 : 0) << "\n";
+  os << "ssd_recovery_segments_ready:"
+     << ssd_.stats().recovery_segments_ready << "\n";
+  os << "ssd_recovery_segments_total:"
+     << ssd_.stats().recovery_segments_total << "\n";
+  os << "ssd_recovery_bytes_scanned:" << ssd_.stats().recovery_bytes_scanned
+     << "\n";
+  os << "ssd_recovery_bytes_total:" << ssd_.stats().recovery_bytes_total
+     << "\n";
+  os << "ssd_recovery_waits:" << ssd_.stats().recovery_waits << "\n";
+  os << "ssd_recovery_unresolved:" << ssd_.stats().recovery_unresolved
+     << "\n";
+  os << "ssd_append_flushes:" << ssd_.stats().append_flushes << "\n";
+  os << "ssd_fsyncs:" << ssd_.stats().fsyncs << "\n";
+  os << "ssd_group_commits:" << ssd_.stats().group_commits << "\n";
+  os << "ssd_checksum_impl:" << crc32c_impl_name() << "\n";
+  os << "ssd_direct_io:" << (ssd_.stats().direct_io ? 1 : 0) << "\n";
+  os << "ssd_pad_bytes:" << ssd_.stats().pad_bytes << "\n";
+  os << "ssd_checksum_verifies:" << ssd_.stats().checksum_verifies << "\n";
+  os << "ssd_checksum_failures:" << ssd_.stats().checksum_failures << "\n";
+  os << "ssd_index_keys:" << ssd_.stats().index_keys << "\n";
+  os << "ssd_index_bytes:" << ssd_.stats().index_bytes << "\n";
+  os << "ssd_index_bytes_per_key:" << ssd_.stats().index_bytes_per_key
+     << "\n";
+  os << "ssd_segments:" << ssd_.stats().segments << "\n";
+  os << "ssd_evicted_segments:" << ssd_.stats().evicted_segments << "\n";
+  os << "ssd_evicted_bytes:" << ssd_.stats().evicted_bytes << "\n";
+  os << "ssd_evicted_keys:" << ssd_.stats().evicted_keys << "\n";
+  os << "ssd_reinserted_keys:" << ssd_.stats().reinserted_keys << "\n";
+  os << "ssd_small_objects:" << ssd_.stats().small_objects << "\n";
+  os << "ssd_small_page_writes:" << ssd_.stats().small_page_writes << "\n";
+  os << "ssd_small_bloom_false_positives:"
+     << ssd_.stats().small_bloom_false_positives << "\n";
+  os << "ssd_small_evicted:" << ssd_.stats().small_evicted << "\n";
+  os << "ssd_small_ram_bytes:" << ssd_.stats().small_ram_bytes << "\n";
+  os << "ssd_multi_gets:" << ssd_.stats().multi_gets << "\n";
+  os << "ssd_multi_get_reads:" << ssd_.stats().multi_get_reads << "\n";
+  const auto &rc = ssd_read_cache_.stats();
+  os << "ssd_read_cache_hits:" << rc.hits << "\n";
+  os << "ssd_read_cache_misses:" << rc.misses << "\n";
+  os << "ssd_read_cache_evictions:" << rc.evictions << "\n";
+  os << "ssd_read_cache_invalidations:" << rc.invalidations << "\n";
+  os << "ssd_read_cache_entries:" << rc.entries << "\n";
+  os << "ssd_read_cache_bytes:" << rc.bytes << "\n";
+  const auto &adm = ssd_admission_.stats();
+  os << "ssd_admitted:" << adm.admitted << "\n";
+  os << "ssd_rejected:" << adm.rejected << "\n";
+  os << "ssd_admitted_bytes:" << adm.admitted_bytes << "\n";
+  os << "ssd_rejected_bytes:" << adm.rejected_bytes << "\n";
+  os << "ssd_rejected_budget:" << adm.rejected_budget << "\n";
+  os << "ssd_write_budget_bytes:" << ssd_admission_.budget_bytes() << "\n";
+  os << "ssd_user_bytes_written:" << ssd_.stats().user_bytes_written << "\n";
+  os << "ssd_device_bytes_written:" << ssd_.stats().device_bytes_written
+     << "\n";
+  os << "ssd_write_amplification:" << ssd_.stats().write_amplification
+     << "\n";
 
   std::vector<std::pair<std::string, std::uint64_t>> counts;
   counts.reserve(entries_.size());
@@ -375,46 +616,17 @@ bool Engine::reload_params(const std::string &path, std::string *err) {
   std::stringstream ss;
   ss << in.rdbuf();
   const std::string text = ss.str();
-  if (text.find('{') == std::string::npos ||
-      text.find('}') == std::string::npos) {
+
+  // Parsed into a copy so a malformed file changes nothing.
+  PolicyParams p = policy_->params();
+  JsonReader r(text);
+  if (r.begin_object())
+    read_params(r, p);
+  if (!r.at_end()) {
     if (err)
       *err = "invalid schema";
     return false;
   }
-
-  PolicyParams p = policy_->params();
-  auto clamp_d = [](double v, double lo, double hi) {
-    return std::min(hi, std::max(lo, v));
-  };
-
-  double d;
-  std::uint64_t u;
-  std::string s;
-  if (extract_double(text, "w_miss", d))
-    p.w_miss = clamp_d(d, 0.0, 1000.0);
-  if (extract_double(text, "w_reuse", d))
-    p.w_reuse = clamp_d(d, 0.0, 1000.0);
-  if (extract_double(text, "w_mem", d))
-    p.w_mem = clamp_d(d, 0.0, 1000.0);
-  if (extract_double(text, "w_risk", d))
-    p.w_risk = clamp_d(d, 0.0, 1000.0);
-  if (extract_double(text, "admit_threshold", d))
-    p.admit_threshold = clamp_d(d, -1e9, 1e9);
-  if (extract_double(text, "evict_pressure", d))
-    p.evict_pressure = clamp_d(d, 0.1, 1.0);
-  if (extract_u64(text, "max_evictions_per_second", u))
-    p.max_evictions_per_second = std::clamp(
-        u, static_cast<std::uint64_t>(1), static_cast<std::uint64_t>(1000000));
-  if (extract_u64(text, "max_admissions_per_second", u))
-    p.max_admissions_per_second = std::clamp(
-        u, static_cast<std::uint64_t>(1), static_cast<std::uint64_t>(1000000));
-  if (extract_u64(text, "owner_cap_bytes", u))
-    p.owner_cap_bytes = static_cast<std::size_t>(
-        std::clamp(u, static_cast<std::uint64_t>(0),
-                   static_cast<std::uint64_t>(1ULL << 40)));
-  if (extract_string(text, "version", s))
-    p.version = s;
-
   policy_->set_params(p);
   return true;
 }
@@ -425,15 +637,24 @@ void Engine::set_policy(std::unique_ptr<IEvictionPolicy> policy) {
   policy_->set_params(p);
 }
 
-bool Engine::exists_and_not_expired(const std::string &key) {
-  if (!entries_.contains(key))
-    return false;
-  auto &e = entries_[key];
-  if (e.ttl_deadline.has_value() && *e.ttl_deadline <= Clock::now()) {
+// The RAM entry for `key` in one probe; expired entries are erased.
+Entry *Engine::find_live(const std::string &key) {
+  auto it = entries_.find(key);
+  if (it == entries_.end())
+    return nullptr;
+  const auto &deadline = it->second.ttl_deadline;
+  if (deadline.has_value() && *deadline <= Clock::now()) {
     erase_internal(key, false, true);
-    return false;
+    return nullptr;
   }
-  return true;
+  return &it->second;
+}
+
+void Engine::record_hit(const std::string &key, Entry &e) {
+  e.last_access = Clock::now();
+  ++e.hit_count;
+  ++stats_.hits;
+  policy_->on_access(key, e);
 }
 
 void Engine::erase_internal(const std::string &key, bool eviction,
@@ -453,31 +674,90 @@ void Engine::erase_internal(const std::string &key, bool eviction,
 }
 
 void Engine::evict_until_fit() {
+  if (cfg_.tier.ssd_enabled && memory_used_ > cfg_.memory_limit_bytes) {
+    // Over the hard limit: demote a batch now instead of waiting for tick().
+    enqueue_demotions();
+    demote_pending(cfg_.tier.demotion_batch);
+  }
   std::size_t safety = entries_.size() + 1;
   while (memory_used_ > cfg_.memory_limit_bytes && safety-- > 0) {
     auto victim =
         policy_->pick_victim(entries_, memory_used_, cfg_.memory_limit_bytes);
     if (!victim.has_value())
       break;
-    if (cfg_.tier.ssd_enabled) {
-      demote_queue_.push_back(*victim);
-      break;
-    }
     erase_internal(*victim, true, false);
   }
 }
 
 void Engine::maybe_enqueue_demotion() {
-  if (!cfg_.tier.ssd_enabled)
+  if (!cfg_.tier.ssd_enabled || !demote_queue_.empty())
     return;
   const double pressure = static_cast<double>(memory_used_) /
                           std::max<std::size_t>(1, cfg_.memory_limit_bytes);
   if (pressure < cfg_.tier.demotion_pressure)
     return;
-  auto victim =
-      policy_->pick_victim(entries_, memory_used_, cfg_.memory_limit_bytes);
-  if (victim.has_value())
-    demote_queue_.push_back(*victim);
+  enqueue_demotions();
+}
+
+// Queues enough victims, picked in one pass, to bring RAM down to
+// demotion_target.
+void Engine::enqueue_demotions() {
+  const auto target = static_cast<std::size_t>(
+      static_cast<double>(cfg_.memory_limit_bytes) * cfg_.tier.demotion_target);
+  if (memory_used_ <= target)
+    return;
+  auto victims =
+      policy_->pick_victims(entries_, memory_used_, cfg_.memory_limit_bytes,
+                            memory_used_ - target, cfg_.tier.demotion_batch);
+  for (auto &k : victims)
+    demote_queue_.push_back(std::move(k));
+}
+
+// Writes up to `max_items` queued victims to SSD as one sequential batch and
+// frees their RAM only after the batch is committed.
+void Engine::demote_pending(std::size_t max_items) {
+  std::vector<std::string> keys;
+  std::size_t work = 0;
+  while (!demote_queue_.empty() && work < max_items) {
+    auto key = std::move(demote_queue_.front());
+    demote_queue_.pop_front();
+    ++work;
+    auto it = entries_.find(key);
+    if (it == entries_.end() ||
+        std::find(keys.begin(), keys.end(), key) != keys.end())
+      continue;
+    if (!ssd_admission_.admit(key, it->second.hit_count,
+                              it->second.size_bytes)) {
+      // Not worth an SSD write: a plain eviction.
+      erase_internal(key, true, false);
+      continue;
+    }
+    keys.push_back(std::move(key));
+  }
+  if (keys.empty())
+    return;
+
+  std::vector<SsdPut> batch;
+  batch.reserve(keys.size());
+  for (const auto &k : keys) {
+    const auto &e = entries_.at(k);
+    batch.push_back({&k, e.value.get(), e.ttl_deadline, ++seq_});
+  }
+  std::vector<bool> ok;
+  ssd_.put_batch(batch, &ok);
+  ++stats_.demotion_batches;
+  for (std::size_t i = 0; i < keys.size(); ++i) {
+    if (ok[i]) {
+      ++stats_.demotions;
+      erase_internal(keys[i], false, false);
+      continue;
+    }
+    // Keep the entry unless RAM is over its hard limit, in which case it is
+    // an eviction and counted as one.
+    ++stats_.demotion_failures;
+    if (memory_used_ > cfg_.memory_limit_bytes)
+      erase_internal(keys[i], true, false);
+  }
 }
 
 double Engine::owner_miss_cost(const std::string &owner) const {
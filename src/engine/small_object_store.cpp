@@ -0,0 +1,404 @@
+#include "pomai_cache/small_object_store.hpp"
+
+#include "pomai_cache/file_io.hpp"
+#include "pomai_cache/hash.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+
+namespace pomai_cache {
+namespace {
+
+#pragma pack(push, 1)
+struct PageHeader {
+  std::uint32_t magic;
+  std::uint32_t checksum; // CRC32C of the page after this field
+  std::uint16_t count;
+  std::uint16_t used;
+  std::uint32_t reserved;
+};
+struct ObjectHeader {
+  std::uint16_t key_len;
+  std::uint16_t value_len;
+  std::int64_t ttl_epoch_ms;
+};
+#pragma pack(pop)
+
+constexpr std::uint32_t kPageMagic = 0x504d5331; // PMS1
+constexpr std::size_t kPageBytes = SmallObjectStore::kPageBytes;
+constexpr std::size_t kChecksumFrom = 8;
+constexpr std::size_t kScanPages = 256;
+
+std::int64_t now_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+bool expired(std::int64_t ttl_epoch_ms, std::int64_t now) {
+  return ttl_epoch_ms >= 0 && ttl_epoch_ms <= now;
+}
+
+std::size_t object_bytes(std::size_t key_len, std::size_t value_len) {
+  return sizeof(ObjectHeader) + key_len + value_len;
+}
+
+// Parses a page image; false if the magic or checksum does not match.
+template <typename F> bool parse_page(const std::uint8_t *page, F &&f) {
+  PageHeader h{};
+  std::memcpy(&h, page, sizeof(h));
+  if (h.magic != kPageMagic || h.used > kPageBytes ||
+      crc32c(0, page + kChecksumFrom, kPageBytes - kChecksumFrom) !=
+          h.checksum)
+    return false;
+  std::size_t off = sizeof(PageHeader);
+  for (std::uint16_t i = 0; i < h.count; ++i) {
+    ObjectHeader oh{};
+    if (off + sizeof(oh) > h.used)
+      return false;
+    std::memcpy(&oh, page + off, sizeof(oh));
+    off += sizeof(oh);
+    if (off + oh.key_len + oh.value_len > h.used)
+      return false;
+    f(oh, page + off);
+    off += oh.key_len + oh.value_len;
+  }
+  return true;
+}
+
+} // namespace
+
+SmallObjectStore::SmallObjectStore(SmallObjectConfig cfg)
+    : cfg_(std::move(cfg)) {}
+
+SmallObjectStore::~SmallObjectStore() {
+  if (fd_ < 0)
+    return;
+  flush();
+  sync();
+  pc_close(fd_);
+}
+
+bool SmallObjectStore::fits(std::size_t key_len, std::size_t value_len) {
+  return key_len <= UINT16_MAX && value_len <= UINT16_MAX &&
+         sizeof(PageHeader) + object_bytes(key_len, value_len) <= kPageBytes;
+}
+
+bool SmallObjectStore::init(std::string *err) {
+  pages_ = static_cast<std::uint32_t>(
+      std::max<std::size_t>(1, cfg_.capacity_bytes / kPageBytes));
+  const auto want = static_cast<std::uint64_t>(pages_) * kPageBytes;
+  std::error_code ec;
+  const auto have = std::filesystem::exists(cfg_.path, ec)
+                        ? std::filesystem::file_size(cfg_.path, ec)
+                        : 0;
+  fd_ = pc_open(cfg_.path.c_str(), PC_O_CREAT | PC_O_RDWR);
+  if (fd_ < 0) {
+    if (err)
+      *err = "failed to open small object file";
+    return false;
+  }
+  // Pages are addressed by hash modulo the page count, so a resized file
+  // cannot be reused.
+  if (have != want &&
+      (pc_truncate(fd_, 0) != 0 ||
+       pc_truncate(fd_, static_cast<std::int64_t>(want)) != 0)) {
+    if (err)
+      *err = "failed to size small object file";
+    return false;
+  }
+
+  blooms_.assign(pages_, Bloom{});
+  counts_.assign(pages_, 0);
+  stats_ = SmallObjectStats{};
+  stats_.pages = pages_;
+  stats_.ram_bytes = pages_ * (sizeof(Bloom) + sizeof(std::uint16_t));
+  if (have != want)
+    return true;
+
+  std::vector<std::uint8_t> buf(kScanPages * kPageBytes);
+  for (std::uint32_t first = 0; first < pages_; first += kScanPages) {
+    const auto n = std::min<std::size_t>(kScanPages, pages_ - first);
+    const auto r =
+        pc_pread(fd_, buf.data(), n * kPageBytes,
+                 static_cast<std::int64_t>(first) * kPageBytes);
+    if (r < 0)
+      break;
+    const auto got = static_cast<std::size_t>(r) / kPageBytes;
+    for (std::size_t i = 0; i < got; ++i) {
+      const auto page = static_cast<std::uint32_t>(first + i);
+      Bloom b;
+      std::uint16_t count = 0;
+      const bool ok = parse_page(
+          buf.data() + i * kPageBytes,
+          [&](const ObjectHeader &oh, const std::uint8_t *p) {
+            bloom_add(&b, hash_key(std::string(
+                              reinterpret_cast<const char *>(p), oh.key_len)));
+            ++count;
+          });
+      if (!ok)
+        continue;
+      blooms_[page] = b;
+      counts_[page] = count;
+      stats_.objects += count;
+    }
+    if (got < n)
+      break;
+  }
+  return true;
+}
+
+bool SmallObjectStore::put(const std::string &key,
+                           const std::vector<std::uint8_t> &value,
+                           std::int64_t ttl_epoch_ms, std::string *err) {
+  if (fd_ < 0 || !fits(key.size(), value.size())) {
+    if (err)
+      *err = "small object does not fit";
+    return false;
+  }
+  const auto page = page_of(hash_key(key));
+  auto &items = log_[page];
+  for (auto it = items.begin(); it != items.end(); ++it) {
+    if (it->key == key) {
+      stats_.log_bytes -= object_bytes(it->key.size(), it->value.size());
+      items.erase(it);
+      break;
+    }
+  }
+  items.push_back(Object{key, value, ttl_epoch_ms, false});
+  stats_.log_bytes += object_bytes(key.size(), value.size());
+  if (stats_.log_bytes >= cfg_.log_bytes)
+    return flush(err);
+  return true;
+}
+
+std::optional<std::vector<std::uint8_t>>
+SmallObjectStore::get(const std::string &key, std::int64_t *ttl_epoch_ms) {
+  if (fd_ < 0)
+    return std::nullopt;
+  const auto h = hash_key(key);
+  Object obj;
+  if (!lookup(page_of(h), h, key, &obj))
+    return std::nullopt;
+  if (ttl_epoch_ms)
+    *ttl_epoch_ms = obj.ttl_epoch_ms;
+  return std::move(obj.value);
+}
+
+bool SmallObjectStore::erase(const std::string &key, std::string *err) {
+  if (fd_ < 0)
+    return false;
+  const auto h = hash_key(key);
+  const auto page = page_of(h);
+  Object obj;
+  if (!lookup(page, h, key, &obj))
+    return false;
+  auto &items = log_[page];
+  for (auto it = items.begin(); it != items.end(); ++it) {
+    if (it->key == key) {
+      stats_.log_bytes -= object_bytes(it->key.size(), it->value.size());
+      items.erase(it);
+      break;
+    }
+  }
+  items.push_back(Object{key, {}, -1, true});
+  stats_.log_bytes += object_bytes(key.size(), 0);
+  return flush_page(page, err);
+}
+
+bool SmallObjectStore::flush(std::string *err) {
+  std::vector<std::uint32_t> pages;
+  pages.reserve(log_.size());
+  for (const auto &[page, items] : log_)
+    pages.push_back(page);
+  std::sort(pages.begin(), pages.end());
+  bool ok = true;
+  for (auto page : pages)
+    ok = flush_page(page, err) && ok;
+  return ok;
+}
+
+bool SmallObjectStore::sync() {
+  if (fd_ < 0 || !dirty_)
+    return true;
+  dirty_ = false;
+  return pc_fsync(fd_) == 0;
+}
+
+bool SmallObjectStore::lookup(std::uint32_t page, std::uint64_t key_hash,
+                              const std::string &key, Object *out) {
+  const auto now = now_ms();
+  if (const auto *o = find_logged(page, key)) {
+    if (o->tombstone || expired(o->ttl_epoch_ms, now))
+      return false;
+    *out = *o;
+    return true;
+  }
+  if (counts_[page] == 0 || !bloom_test(blooms_[page], key_hash))
+    return false;
+  std::vector<Object> objects;
+  if (!read_page(page, &objects))
+    return false;
+  for (auto &o : objects) {
+    if (o.key != key)
+      continue;
+    if (expired(o.ttl_epoch_ms, now))
+      return false;
+    *out = std::move(o);
+    return true;
+  }
+  ++stats_.bloom_false_positives;
+  return false;
+}
+
+const SmallObjectStore::Object *
+SmallObjectStore::find_logged(std::uint32_t page,
+                              const std::string &key) const {
+  auto it = log_.find(page);
+  if (it == log_.end())
+    return nullptr;
+  for (const auto &o : it->second)
+    if (o.key == key)
+      return &o;
+  return nullptr;
+}
+
+bool SmallObjectStore::read_page(std::uint32_t page,
+                                 std::vector<Object> *out) {
+  std::vector<std::uint8_t> buf(kPageBytes);
+  ++stats_.page_reads;
+  if (pc_pread(fd_, buf.data(), kPageBytes,
+               static_cast<std::int64_t>(page) * kPageBytes) !=
+      static_cast<ssize_t>(kPageBytes))
+    return false;
+  out->clear();
+  return parse_page(buf.data(),
+                    [&](const ObjectHeader &oh, const std::uint8_t *p) {
+                      Object o;
+                      o.key.assign(reinterpret_cast<const char *>(p),
+                                   oh.key_len);
+                      o.value.assign(p + oh.key_len,
+                                     p + oh.key_len + oh.value_len);
+                      o.ttl_epoch_ms = oh.ttl_epoch_ms;
+                      out->push_back(std::move(o));
+                    });
+}
+
+// Encodes `objects` (oldest first) into the page, dropping the oldest ones
+// that do not fit, and refreshes the page's bloom filter and count.
+bool SmallObjectStore::write_page(std::uint32_t page,
+                                  std::vector<Object> *objects) {
+  std::size_t used = sizeof(PageHeader);
+  for (const auto &o : *objects)
+    used += object_bytes(o.key.size(), o.value.size());
+  std::size_t drop = 0;
+  while (used > kPageBytes) {
+    const auto &o = (*objects)[drop++];
+    used -= object_bytes(o.key.size(), o.value.size());
+  }
+  stats_.evicted_objects += drop;
+  objects->erase(objects->begin(),
+                 objects->begin() + static_cast<std::ptrdiff_t>(drop));
+
+  std::vector<std::uint8_t> buf(kPageBytes, 0);
+  std::size_t off = sizeof(PageHeader);
+  Bloom b;
+  for (const auto &o : *objects) {
+    ObjectHeader oh{static_cast<std::uint16_t>(o.key.size()),
+                    static_cast<std::uint16_t>(o.value.size()),
+                    o.ttl_epoch_ms};
+    std::memcpy(buf.data() + off, &oh, sizeof(oh));
+    off += sizeof(oh);
+    std::memcpy(buf.data() + off, o.key.data(), o.key.size());
+    off += o.key.size();
+    if (!o.value.empty())
+      std::memcpy(buf.data() + off, o.value.data(), o.value.size());
+    off += o.value.size();
+    bloom_add(&b, hash_key(o.key));
+  }
+  PageHeader h{kPageMagic, 0, static_cast<std::uint16_t>(objects->size()),
+               static_cast<std::uint16_t>(used), 0};
+  std::memcpy(buf.data(), &h, sizeof(h));
+  h.checksum =
+      crc32c(0, buf.data() + kChecksumFrom, kPageBytes - kChecksumFrom);
+  std::memcpy(buf.data(), &h, sizeof(h));
+
+  ++stats_.page_writes;
+  dirty_ = true;
+  if (!pc_pwrite_all(fd_, buf.data(), kPageBytes,
+                     static_cast<std::int64_t>(page) * kPageBytes))
+    return false;
+  stats_.objects = stats_.objects - counts_[page] + objects->size();
+  counts_[page] = static_cast<std::uint16_t>(objects->size());
+  blooms_[page] = b;
+  return true;
+}
+
+bool SmallObjectStore::flush_page(std::uint32_t page, std::string *err) {
+  auto it = log_.find(page);
+  if (it == log_.end())
+    return true;
+  std::vector<Object> objects;
+  if (counts_[page] > 0)
+    read_page(page, &objects);
+  const auto now = now_ms();
+  objects.erase(std::remove_if(objects.begin(), objects.end(),
+                               [&](const Object &o) {
+                                 return expired(o.ttl_epoch_ms, now);
+                               }),
+                objects.end());
+  for (auto &item : it->second) {
+    stats_.log_bytes -= object_bytes(item.key.size(), item.value.size());
+    objects.erase(std::remove_if(objects.begin(), objects.end(),
+                                 [&](const Object &o) {
+                                   return o.key == item.key;
+                                 }),
+                  objects.end());
+    if (!item.tombstone)
+      objects.push_back(std::move(item));
+  }
+  log_.erase(it);
+  if (!write_page(page, &objects)) {
+    if (err)
+      *err = "small object page write failed";
+    return false;
+  }
+  return true;
+}
+
+std::uint64_t SmallObjectStore::hash_key(const std::string &key) {
+  std::uint64_t h = 1469598103934665603ULL;
+  for (unsigned char c : key) {
+    h ^= c;
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+std::uint32_t SmallObjectStore::page_of(std::uint64_t key_hash) const {
+  return static_cast<std::uint32_t>(key_hash % pages_);
+}
+
+// Three probes into 128 bits, taken from a remix of the key hash so they are
+// independent of the bits that chose the page.
+void SmallObjectStore::bloom_add(Bloom *b, std::uint64_t key_hash) {
+  const auto m = key_hash * 0x9E3779B97F4A7C15ULL;
+  for (int i = 0; i < 3; ++i) {
+    const auto bit = (m >> (57 - 7 * i)) & 127;
+    b->bits[bit >> 6] |= 1ULL << (bit & 63);
+  }
+}
+
+bool SmallObjectStore::bloom_test(const Bloom &b, std::uint64_t key_hash) {
+  const auto m = key_hash * 0x9E3779B97F4A7C15ULL;
+  for (int i = 0; i < 3; ++i) {
+    const auto bit = (m >> (57 - 7 * i)) & 127;
+    if ((b.bits[bit >> 6] & (1ULL << (bit & 63))) == 0)
+      return false;
+  }
+  return true;
+}
+
+} // namespace pomai_cache
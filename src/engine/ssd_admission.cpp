@@ -0,0 +1,70 @@
+#include "pomai_cache/ssd_admission.hpp"
+
+#include <algorithm>
+#include <functional>
+
+namespace pomai_cache {
+
+SsdAdmission::SsdAdmission(SsdAdmissionConfig cfg)
+    : cfg_(cfg), sketch_(cfg.sketch_width) {
+  rate_per_s_ =
+      cfg_.dwpd * static_cast<double>(cfg_.device_bytes) / 86400.0;
+  burst_ = rate_per_s_ * 3600.0;
+  tokens_ = burst_;
+  last_refill_ = std::chrono::steady_clock::now();
+}
+
+void SsdAdmission::record_access(const std::string &key) {
+  sketch_.increment(std::hash<std::string>{}(key));
+}
+
+bool SsdAdmission::admit(const std::string &key, std::uint64_t ram_hits,
+                         std::size_t bytes) {
+  const auto freq = std::max<std::uint64_t>(
+      sketch_.estimate(std::hash<std::string>{}(key)), ram_hits + 1);
+  bool ok = freq >= cfg_.min_accesses;
+  if (ok && cfg_.dwpd > 0.0) {
+    refill();
+    if (tokens_ < static_cast<double>(bytes)) {
+      ok = false;
+      ++stats_.rejected_budget;
+    }
+  }
+  if (!ok) {
+    ++stats_.rejected;
+    stats_.rejected_bytes += bytes;
+    return false;
+  }
+  ++stats_.admitted;
+  stats_.admitted_bytes += bytes;
+  if (cfg_.dwpd > 0.0)
+    tokens_ -= static_cast<double>(bytes);
+  return true;
+}
+
+void SsdAdmission::charge(std::size_t bytes) {
+  if (cfg_.dwpd <= 0.0)
+    return;
+  refill();
+  tokens_ -= static_cast<double>(bytes);
+}
+
+std::int64_t SsdAdmission::budget_bytes() const {
+  if (cfg_.dwpd <= 0.0)
+    return -1;
+  const double secs = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - last_refill_)
+                          .count();
+  return static_cast<std::int64_t>(
+      std::min(burst_, tokens_ + secs * rate_per_s_));
+}
+
+void SsdAdmission::refill() {
+  const auto now = std::chrono::steady_clock::now();
+  const double secs =
+      std::chrono::duration<double>(now - last_refill_).count();
+  last_refill_ = now;
+  tokens_ = std::min(burst_, tokens_ + secs * rate_per_s_);
+}
+
+} // namespace pomai_cache
@@ -0,0 +1,119 @@
+#include "pomai_cache/ssd_index.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace pomai_cache {
+namespace {
+constexpr std::size_t kMinCapacity = 16;
+constexpr std::size_t kMaxLoadPct = 90;
+} // namespace
+
+void SsdIndex::insert(std::uint32_t tag, std::uint64_t loc,
+                      std::int64_t deadline_ms) {
+  if ((size_ + 1) * 100 > slots_.size() * kMaxLoadPct)
+    rehash(std::max(kMinCapacity, slots_.size() + slots_.size() / 2));
+  if (deadline_ms >= 0 && deadlines_.empty())
+    deadlines_.assign(slots_.size(), Deadline{});
+  place({normalize(tag), static_cast<std::uint32_t>(loc),
+         static_cast<std::uint32_t>(loc >> 32)},
+        pack_deadline(deadline_ms));
+  ++size_;
+}
+
+void SsdIndex::place(Slot s, Deadline d) {
+  std::size_t pos = home(s.tag);
+  std::size_t dist = 0;
+  const bool timed = !deadlines_.empty();
+  while (true) {
+    Slot &cur = slots_[pos];
+    if (cur.tag == 0) {
+      cur = s;
+      if (timed)
+        deadlines_[pos] = d;
+      return;
+    }
+    const std::size_t cur_dist = displacement(pos, cur.tag);
+    if (cur_dist < dist) {
+      std::swap(cur, s);
+      if (timed)
+        std::swap(deadlines_[pos], d);
+      dist = cur_dist;
+    }
+    pos = next(pos);
+    ++dist;
+  }
+}
+
+void SsdIndex::erase_at(std::size_t pos) {
+  // Backward-shift deletion keeps probe runs contiguous without tombstones.
+  const bool timed = !deadlines_.empty();
+  std::size_t nxt = next(pos);
+  while (slots_[nxt].tag != 0 && displacement(nxt, slots_[nxt].tag) > 0) {
+    slots_[pos] = slots_[nxt];
+    if (timed)
+      deadlines_[pos] = deadlines_[nxt];
+    pos = nxt;
+    nxt = next(nxt);
+  }
+  slots_[pos] = Slot{0, 0, 0};
+  if (timed)
+    deadlines_[pos] = Deadline{};
+  --size_;
+}
+
+void SsdIndex::set_loc_at(std::size_t pos, std::uint64_t loc) {
+  slots_[pos].loc_lo = static_cast<std::uint32_t>(loc);
+  slots_[pos].loc_hi = static_cast<std::uint32_t>(loc >> 32);
+}
+
+std::int64_t SsdIndex::deadline_at(std::size_t pos) const {
+  if (deadlines_.empty())
+    return -1;
+  const auto &d = deadlines_[pos];
+  const auto ms = std::uint64_t{d.w[0]} | (std::uint64_t{d.w[1]} << 16) |
+                  (std::uint64_t{d.w[2]} << 32);
+  return ms == 0 ? -1 : static_cast<std::int64_t>(ms);
+}
+
+void SsdIndex::set_deadline_at(std::size_t pos, std::int64_t deadline_ms) {
+  if (deadline_ms < 0 && deadlines_.empty())
+    return;
+  if (deadlines_.empty())
+    deadlines_.assign(slots_.size(), Deadline{});
+  deadlines_[pos] = pack_deadline(deadline_ms);
+}
+
+SsdIndex::Deadline SsdIndex::pack_deadline(std::int64_t deadline_ms) {
+  const auto ms = static_cast<std::uint64_t>(std::max<std::int64_t>(
+      deadline_ms, 0));
+  return {static_cast<std::uint16_t>(ms), static_cast<std::uint16_t>(ms >> 16),
+          static_cast<std::uint16_t>(ms >> 32)};
+}
+
+void SsdIndex::reserve(std::size_t n) {
+  const std::size_t want = n * 100 / kMaxLoadPct + 1;
+  if (want > slots_.size())
+    rehash(std::max(kMinCapacity, want));
+}
+
+void SsdIndex::clear() {
+  slots_.clear();
+  slots_.shrink_to_fit();
+  deadlines_.clear();
+  deadlines_.shrink_to_fit();
+  size_ = 0;
+}
+
+void SsdIndex::rehash(std::size_t capacity) {
+  std::vector<Slot> old = std::move(slots_);
+  std::vector<Deadline> old_deadlines = std::move(deadlines_);
+  slots_.assign(capacity, Slot{0, 0, 0});
+  if (!old_deadlines.empty())
+    deadlines_.assign(capacity, Deadline{});
+  for (std::size_t i = 0; i < old.size(); ++i)
+    if (old[i].tag != 0)
+      place(old[i], old_deadlines.empty() ? Deadline{} : old_deadlines[i]);
+}
+
+} // namespace pomai_cache
@@ -0,0 +1,91 @@
+#include "pomai_cache/ssd_read_cache.hpp"
+
+namespace pomai_cache {
+
+SsdReadCache::SsdReadCache(std::size_t capacity_bytes)
+    : capacity_(capacity_bytes) {}
+
+std::optional<std::vector<std::uint8_t>>
+SsdReadCache::get(const std::string &key, TimePoint now) {
+  auto it = index_.find(key);
+  if (it == index_.end()) {
+    ++stats_.misses;
+    return std::nullopt;
+  }
+  auto &s = slots_[it->second];
+  if (s.ttl_deadline.has_value() && *s.ttl_deadline <= now) {
+    release(it->second);
+    ++stats_.misses;
+    return std::nullopt;
+  }
+  s.referenced = true;
+  ++stats_.hits;
+  return s.value;
+}
+
+void SsdReadCache::put(const std::string &key,
+                       const std::vector<std::uint8_t> &value,
+                       std::optional<TimePoint> ttl_deadline) {
+  if (value.size() > capacity_ / 4)
+    return;
+  erase(key);
+  while (stats_.bytes + value.size() > capacity_ && evict_one()) {
+  }
+  std::size_t slot = slots_.size();
+  if (!free_.empty()) {
+    slot = free_.back();
+    free_.pop_back();
+  } else {
+    slots_.emplace_back();
+  }
+  auto &s = slots_[slot];
+  s.key = key;
+  s.value = value;
+  s.ttl_deadline = ttl_deadline;
+  s.referenced = false;
+  s.used = true;
+  index_[key] = slot;
+  stats_.bytes += value.size();
+  ++stats_.entries;
+  ++stats_.inserts;
+}
+
+void SsdReadCache::erase(const std::string &key) {
+  auto it = index_.find(key);
+  if (it == index_.end())
+    return;
+  release(it->second);
+  ++stats_.invalidations;
+}
+
+void SsdReadCache::release(std::size_t slot) {
+  auto &s = slots_[slot];
+  index_.erase(s.key);
+  stats_.bytes -= s.value.size();
+  --stats_.entries;
+  s = Slot{};
+  free_.push_back(slot);
+}
+
+bool SsdReadCache::evict_one() {
+  if (stats_.entries == 0)
+    return false;
+  // Two sweeps clear every reference bit, so this always finds a victim.
+  for (std::size_t step = 0; step < 2 * slots_.size(); ++step) {
+    auto &s = slots_[hand_];
+    const auto slot = hand_;
+    hand_ = (hand_ + 1) % slots_.size();
+    if (!s.used)
+      continue;
+    if (s.referenced) {
+      s.referenced = false;
+      continue;
+    }
+    release(slot);
+    ++stats_.evictions;
+    return true;
+  }
+  return false;
+}
+
+} // namespace pomai_cache
@@ -1,87 +1,24 @@
 #include "pomai_cache/ssd_store.hpp"
 
+#include "pomai_cache/file_io.hpp"
+#include "pomai_cache/hash.hpp"
+
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <cstdio>
 #include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <mutex>
 #include <string_view>
-
-#ifdef _WIN32
-#include <fcntl.h>
-#include <io.h>
-#else
-#include <fcntl.h>
-#include <sys/stat.h>
-#include <unistd.h>
-#endif
+#include <thread>
+#include <utility>
 
 namespace pomai_cache {
 namespace {
-#ifdef _WIN32
-using ssize_t = std::ptrdiff_t;
-constexpr int PC_O_RDONLY = _O_RDONLY;
-constexpr int PC_O_RDWR = _O_RDWR;
-constexpr int PC_O_CREAT = _O_CREAT;
-constexpr int PC_O_APPEND = _O_APPEND;
-constexpr int PC_O_TRUNC = _O_TRUNC;
-#endif
-
-#ifndef _WIN32
-constexpr int PC_O_RDONLY = O_RDONLY;
-constexpr int PC_O_RDWR = O_RDWR;
-constexpr int PC_O_CREAT = O_CREAT;
-constexpr int PC_O_APPEND = O_APPEND;
-constexpr int PC_O_TRUNC = O_TRUNC;
-#endif
-
-#ifdef _WIN32
-int pc_open(const char *path, int flags) {
-  return _open(path, flags | _O_BINARY, _S_IREAD | _S_IWRITE);
-}
-int pc_close(int fd) { return _close(fd); }
-ssize_t pc_write(int fd, const void *buf, std::size_t len) {
-  return _write(fd, buf, static_cast<unsigned int>(len));
-}
-ssize_t pc_read(int fd, void *buf, std::size_t len) {
-  return _read(fd, buf, static_cast<unsigned int>(len));
-}
-std::int64_t pc_seek(int fd, std::int64_t off, int whence) {
-  return _lseeki64(fd, off, whence);
-}
-int pc_fsync(int fd) { return _commit(fd); }
-int pc_truncate(int fd, std::int64_t len) { return _chsize_s(fd, len); }
-ssize_t pc_pread(int fd, void *buf, std::size_t len, std::int64_t off) {
-  auto cur = pc_seek(fd, 0, SEEK_CUR);
-  if (cur < 0)
-    return -1;
-  if (pc_seek(fd, off, SEEK_SET) < 0)
-    return -1;
-  auto r = pc_read(fd, buf, len);
-  pc_seek(fd, cur, SEEK_SET);
-  return r;
-}
-#else
-int pc_open(const char *path, int flags) { return open(path, flags, 0644); }
-int pc_close(int fd) { return close(fd); }
-ssize_t pc_write(int fd, const void *buf, std::size_t len) {
-  return write(fd, buf, len);
-}
-ssize_t pc_read(int fd, void *buf, std::size_t len) {
-  return read(fd, buf, len);
-}
-std::int64_t pc_seek(int fd, std::int64_t off, int whence) {
-  return lseek(fd, off, whence);
-}
-int pc_fsync(int fd) { return fsync(fd); }
-int pc_truncate(int fd, std::int64_t len) { return ftruncate(fd, len); }
-ssize_t pc_pread(int fd, void *buf, std::size_t len, std::int64_t off) {
-  return pread(fd, buf, len, off);
-}
-#endif
-
 #pragma pack(push, 1)
 struct RecordHeader {
   std::uint32_t magic;
@@ -92,16 +29,29 @@ struct RecordHeader {
   std::int64_t ttl_epoch_ms;
   std::uint32_t key_len;
   std::uint32_t value_len;
-  std::uint8_t tombstone;
+  std::uint8_t type; // kRecordPut / kRecordTombstone / kRecordMeta
   std::uint8_t reserved[7];
 };
 #pragma pack(pop)
 
-constexpr std::uint32_t kMagic = 0x504d3443; // PMC4
+constexpr std::uint32_t kMagicV4 = 0x504d3443; // PMC4: FNV-1a checksum
+constexpr std::uint32_t kMagic = 0x504d3543;   // PMC5: CRC32C checksum
 
-std::uint32_t checksum32(const std::string &key,
-                         const std::vector<std::uint8_t> &value,
-                         const RecordHeader &h) {
+// Record types. Meta records carry only the key and replace the TTL of the
+// latest earlier put of that key (`ttl_epoch_ms` -1 clears it).
+constexpr std::uint8_t kRecordPut = 0;
+constexpr std::uint8_t kRecordTombstone = 1;
+constexpr std::uint8_t kRecordMeta = 2;
+// Filler written in direct I/O mode so the next flush starts 4 KiB-aligned.
+constexpr std::uint8_t kRecordPad = 3;
+
+bool known_magic(std::uint32_t magic) {
+  return magic == kMagic || magic == kMagicV4;
+}
+
+std::uint32_t checksum_v4(const std::uint8_t *key, std::size_t key_len,
+                          const std::uint8_t *value, std::size_t value_len,
+                          const RecordHeader &h) {
   std::uint32_t sum = 2166136261u;
   auto mix = [&](std::uint8_t b) {
     sum ^= b;
@@ -114,13 +64,104 @@ std::uint32_t checksum32(const std::string &key,
       continue;
     mix(p[i]);
   }
-  for (unsigned char c : key)
-    mix(c);
-  for (auto b : value)
-    mix(b);
+  for (std::size_t i = 0; i < key_len; ++i)
+    mix(key[i]);
+  for (std::size_t i = 0; i < value_len; ++i)
+    mix(value[i]);
   return sum;
 }
 
+// Checksum for the record format named by h.magic. The checksum field itself
+// is excluded; PMC5 covers the same bytes as PMC4 with CRC32C.
+std::uint32_t record_checksum(const std::uint8_t *key, std::size_t key_len,
+                              const std::uint8_t *value, std::size_t value_len,
+                              const RecordHeader &h) {
+  if (h.magic == kMagicV4)
+    return checksum_v4(key, key_len, value, value_len, h);
+  constexpr std::size_t kAfter =
+      offsetof(RecordHeader, checksum) + sizeof(h.checksum);
+  auto *p = reinterpret_cast<const std::uint8_t *>(&h);
+  std::uint32_t crc = crc32c(0, p, offsetof(RecordHeader, checksum));
+  crc = crc32c(crc, p + kAfter, sizeof(RecordHeader) - kAfter);
+  crc = crc32c(crc, key, key_len);
+  return crc32c(crc, value, value_len);
+}
+
+std::uint32_t checksum32(const std::string &key,
+                         const std::vector<std::uint8_t> &value,
+                         const RecordHeader &h) {
+  return record_checksum(reinterpret_cast<const std::uint8_t *>(key.data()),
+                         key.size(), value.data(), value.size(), h);
+}
+
+RecordHeader make_header(const std::string &key,
+                         const std::vector<std::uint8_t> &value,
+                         std::int64_t ttl_epoch_ms, std::uint64_t seq,
+                         std::uint8_t type, std::uint64_t key_hash) {
+  RecordHeader h{};
+  h.magic = kMagic;
+  h.key_hash = key_hash;
+  h.seq = seq;
+  h.ttl_epoch_ms = ttl_epoch_ms;
+  h.key_len = static_cast<std::uint32_t>(key.size());
+  h.value_len = static_cast<std::uint32_t>(value.size());
+  h.type = type;
+  h.offset_next = 0;
+  h.checksum = checksum32(key, value, h);
+  return h;
+}
+
+template <typename Buf>
+void append_bytes(Buf *buf, const void *data, std::size_t len) {
+  auto *p = static_cast<const std::uint8_t *>(data);
+  buf->insert(buf->end(), p, p + len);
+}
+
+// Appends a pad record taking a segment ending at `end` to the next
+// kDirectIoAlign boundary; returns its size, 0 when already aligned.
+template <typename Buf> std::size_t append_pad(Buf *buf, std::uint64_t end) {
+  std::size_t gap = (kDirectIoAlign - end % kDirectIoAlign) % kDirectIoAlign;
+  if (gap == 0)
+    return 0;
+  if (gap < sizeof(RecordHeader))
+    gap += kDirectIoAlign;
+  const std::vector<std::uint8_t> zeros(gap - sizeof(RecordHeader), 0);
+  const auto h = make_header({}, zeros, -1, 0, kRecordPad, 0);
+  append_bytes(buf, &h, sizeof(h));
+  append_bytes(buf, zeros.data(), zeros.size());
+  return gap;
+}
+
+// Reads [off, off + len) into `out`. With `direct` the read is widened to
+// aligned bounds through `bounce`. Returns bytes read from the device or -1.
+ssize_t read_span(int fd, bool direct, std::uint64_t off, std::size_t len,
+                  AlignedBytes *bounce, std::vector<std::uint8_t> *out) {
+  if (!direct) {
+    out->resize(len);
+    const auto r =
+        pc_pread(fd, out->data(), len, static_cast<std::int64_t>(off));
+    out->resize(r < 0 ? 0 : static_cast<std::size_t>(r));
+    return r;
+  }
+  const auto start = off & ~static_cast<std::uint64_t>(kDirectIoAlign - 1);
+  const auto end = (off + len + kDirectIoAlign - 1) &
+                   ~static_cast<std::uint64_t>(kDirectIoAlign - 1);
+  bounce->resize(end - start);
+  const auto r = pc_pread(fd, bounce->data(), bounce->size(),
+                          static_cast<std::int64_t>(start));
+  out->clear();
+  if (r < 0)
+    return r;
+  const auto skip = off - start;
+  if (static_cast<std::uint64_t>(r) > skip) {
+    const auto n =
+        std::min<std::size_t>(len, static_cast<std::size_t>(r) - skip);
+    out->assign(bounce->begin() + static_cast<std::ptrdiff_t>(skip),
+                bounce->begin() + static_cast<std::ptrdiff_t>(skip + n));
+  }
+  return r;
+}
+
 std::int64_t to_epoch_ms(std::optional<TimePoint> t) {
   if (!t.has_value())
     return -1;
@@ -130,348 +171,1348 @@ std::int64_t to_epoch_ms(std::optional<TimePoint> t) {
   return static_cast<std::int64_t>(ms);
 }
 
-bool fsync_dir(const std::string &dir) {
-#ifdef _WIN32
-  (void)dir;
-  return true;
-#else
-  int dfd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
-  if (dfd < 0)
-    return false;
-  bool ok = ::fsync(dfd) == 0;
-  close(dfd);
-  return ok;
-#endif
+// Index location layout (64 bits):
+//   [0, 32)  record offset within its segment
+//   [32, 52) segment slot
+//   [52, 62) record size code: (code & 31) << (code >> 5) >= record bytes,
+//            so a single read of that many bytes returns the whole record
+//   62       unused; TTL deadlines live beside the slot in SsdIndex
+//   63       read since it was written; eviction reinserts such records
+constexpr std::uint64_t kLocAccessedBit = 1ULL << 63;
+constexpr std::uint64_t kLocPosMask = (1ULL << 52) - 1;
+
+std::uint64_t size_code(std::uint64_t bytes) {
+  std::uint64_t e = 0;
+  while (((bytes + (1ULL << e) - 1) >> e) > 31)
+    ++e;
+  return (e << 5) | ((bytes + (1ULL << e) - 1) >> e);
+}
+
+std::uint64_t pack_loc(std::uint32_t slot, std::uint64_t offset,
+                       std::uint64_t record_bytes) {
+  return offset | (static_cast<std::uint64_t>(slot) << 32) |
+         (size_code(record_bytes) << 52);
+}
+std::uint32_t loc_slot(std::uint64_t loc) {
+  return static_cast<std::uint32_t>((loc >> 32) & 0xFFFFF);
+}
+std::uint64_t loc_offset(std::uint64_t loc) { return loc & 0xFFFFFFFFULL; }
+std::uint64_t loc_pos(std::uint64_t loc) { return loc & kLocPosMask; }
+std::size_t loc_span(std::uint64_t loc) {
+  const auto code = (loc >> 52) & 0x3FF;
+  return static_cast<std::size_t>((code & 31) << (code >> 5));
+}
+
+constexpr std::uint32_t kMaxSegmentSlots = 1u << 20;
+constexpr std::size_t kMaxSegmentBytes = 3ULL * 1024 * 1024 * 1024;
+constexpr std::size_t kKeyProbeBytes = 512;
+// Recovery reads segments sequentially in windows of this size.
+constexpr std::size_t kScanChunkBytes = 1 << 20;
+constexpr std::int64_t kExpiryBucketMs = 100;
+// An expiry bucket's map node: key, vector header and red-black links.
+constexpr std::size_t kExpiryNodeBytes =
+    sizeof(std::pair<const std::int64_t, std::vector<std::uint32_t>>) + 32;
+// Accessed records reinserted by one segment eviction, as a fraction of that
+// segment's size.
+constexpr double kMaxReinsertFraction = 0.5;
+
+// Scan entries ordered for replay.
+template <typename E> bool by_key_seq(const E &a, const E &b) {
+  if (a.key_hash != b.key_hash)
+    return a.key_hash < b.key_hash;
+  return a.seq < b.seq;
+}
+
+// Merges the sorted runs [bounds[i], bounds[i + 1]) of `v` pairwise in place
+// until `v` is sorted.
+template <typename E>
+void merge_runs(std::vector<E> *v, std::vector<std::size_t> bounds) {
+  while (bounds.size() > 2) {
+    std::vector<std::size_t> merged{0};
+    for (std::size_t i = 0; i + 1 < bounds.size(); i += 2) {
+      const auto end = i + 2 < bounds.size() ? bounds[i + 2] : bounds[i + 1];
+      const auto first = v->begin();
+      std::inplace_merge(first + static_cast<std::ptrdiff_t>(bounds[i]),
+                         first + static_cast<std::ptrdiff_t>(bounds[i + 1]),
+                         first + static_cast<std::ptrdiff_t>(end),
+                         by_key_seq<E>);
+      merged.push_back(end);
+    }
+    bounds = std::move(merged);
+  }
+}
+
+std::int64_t now_epoch_ms(TimePoint now) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             now.time_since_epoch())
+      .count();
 }
 
 } // namespace
 
+struct SsdStore::Record {
+  RecordHeader header{};
+  std::string key;
+  std::vector<std::uint8_t> value;
+  std::uint32_t bytes() const {
+    return static_cast<std::uint32_t>(sizeof(RecordHeader) + header.key_len +
+                                      header.value_len);
+  }
+};
+
+struct SsdStore::ScanEntry {
+  std::uint64_t key_hash;
+  std::uint64_t seq;
+  std::uint64_t loc;
+  std::int64_t ttl_epoch_ms;
+  std::uint32_t record_bytes;
+  std::uint8_t type;
+};
+
+// Online recovery state shared with the background scan thread. The worker
+// fills runs[ready..] in order and publishes each one by bumping `ready`
+// under `mu`; runs below `ready` are immutable after that.
+struct SsdStore::Recovery {
+  struct Run {
+    std::uint32_t slot{0};
+    std::uint32_t id{0};
+    std::uint64_t bytes{0};
+    std::vector<ScanEntry> entries; // sorted by (key hash, seq)
+  };
+  std::vector<Run> runs; // newest segment first
+  std::size_t ready{0};
+  std::chrono::nanoseconds verify{0};
+  std::mutex mu;
+  std::condition_variable cv;
+  std::atomic<bool> stop{false};
+  std::atomic<std::uint64_t> bytes_scanned{0};
+  // Key hashes already decided from the runs or written since restart;
+  // serving thread only.
+  std::unordered_set<std::uint64_t> settled;
+  std::chrono::steady_clock::time_point start;
+  std::chrono::steady_clock::time_point scan_start;
+  std::thread worker;
+};
+
+// read_threads - 1 helpers for multi_get. A batch is published under `mu`
+// with a new generation; each helper runs it at most once and the caller
+// waits until `busy` drops to zero.
+struct SsdStore::Readers {
+  std::mutex mu;
+  std::condition_variable work_cv;
+  std::condition_variable done_cv;
+  const std::function<void()> *job{nullptr};
+  std::uint64_t generation{0};
+  // Helpers that may still join the current batch / are still running it.
+  std::size_t wanted{0};
+  std::size_t busy{0};
+  bool stop{false};
+  std::vector<std::thread> threads;
+};
+
 SsdStore::SsdStore(SsdConfig cfg) : cfg_(std::move(cfg)) {
   token_refill_ = std::chrono::steady_clock::now();
   read_tokens_ = static_cast<double>(cfg_.max_read_mb_s) * 1024.0 * 1024.0;
   write_tokens_ = static_cast<double>(cfg_.max_write_mb_s) * 1024.0 * 1024.0;
+  // Eviction drops whole segments; keep each to at most 1/8 of the tier.
+  cfg_.segment_bytes = std::clamp<std::size_t>(
+      cfg_.segment_bytes, 4096,
+      std::max<std::size_t>(4096,
+                            std::min(kMaxSegmentBytes, cfg_.max_bytes / 8)));
+}
+
+SsdStore::~SsdStore() {
+  stop_recovery();
+  stop_readers();
+  for (std::uint32_t slot = 0; slot < read_fds_.size(); ++slot)
+    close_read_fd(slot);
+  if (active_fd_ < 0)
+    return;
+  flush_appends();
+  if (cfg_.fsync != FsyncMode::Never)
+    fsync_active();
+  pc_close(active_fd_);
 }
 
 bool SsdStore::init(std::string *err) {
   if (!cfg_.enabled)
     return true;
   std::filesystem::create_directories(cfg_.dir);
+  direct_ = cfg_.direct_io && pc_direct_io_supported(cfg_.dir);
+  stats_.direct_io = direct_;
+  if (cfg_.small_object_max_bytes > 0 && cfg_.small_store_bytes > 0) {
+    SmallObjectConfig soc;
+    soc.path = cfg_.dir + "/small_objects.dat";
+    soc.capacity_bytes = cfg_.small_store_bytes;
+    soc.log_bytes = cfg_.small_log_bytes;
+    small_ = std::make_unique<SmallObjectStore>(soc);
+    if (!small_->init(err))
+      return false;
+  }
   std::vector<std::uint32_t> segs;
   std::uint32_t active = 1;
   if (!load_manifest(&segs, &active)) {
     segs = {1};
     active = 1;
   }
+  std::sort(segs.begin(), segs.end());
+  segs.erase(std::unique(segs.begin(), segs.end()), segs.end());
+
+  stop_recovery();
   segments_.clear();
+  index_.clear();
+  expiry_buckets_.clear();
+  expiry_bytes_ = 0;
   total_segment_bytes_ = 0;
+  live_bytes_ = 0;
   auto start = std::chrono::steady_clock::now();
-  for (auto s : segs) {
-    if (!scan_segment(s, true)) {
-      if (err)
-        *err = "segment scan failed";
-      return false;
-    }
-    SegmentMeta sm;
-    sm.id = s;
-    sm.bytes = std::filesystem::exists(seg_path(s))
-                   ? std::filesystem::file_size(seg_path(s))
-                   : 0;
-    segments_.push_back(sm);
-    total_segment_bytes_ += sm.bytes;
-  }
-  if (segments_.empty())
-    segments_.push_back({1, 0});
-  active_segment_ = active;
-  bool found = false;
-  for (auto &s : segments_)
-    if (s.id == active_segment_)
-      found = true;
-  if (!found) {
-    active_segment_ = segments_.back().id;
+  std::vector<std::uint32_t> slots;
+  for (auto id : segs) {
+    slots.push_back(alloc_segment_slot(id));
+    next_segment_id_ = std::max(next_segment_id_, id + 1);
   }
-  auto p = seg_path(active_segment_);
-  active_fd_ = pc_open(p.c_str(), PC_O_CREAT | PC_O_RDWR | PC_O_APPEND);
-  if (active_fd_ < 0) {
+  std::vector<ScanEntry> scanned;
+  const bool ok = cfg_.online_recovery
+                      ? begin_online_recovery(slots, active, &scanned)
+                      : recover_segments(slots, active, &scanned);
+  if (!ok) {
     if (err)
-      *err = "failed to open active segment";
+      *err = "segment scan failed";
     return false;
   }
-  stats_.bytes = live_bytes_;
-  stats_.fragmentation_estimate =
-      total_segment_bytes_ == 0
-          ? 0.0
-          : 1.0 - static_cast<double>(live_bytes_) /
-                      static_cast<double>(total_segment_bytes_);
+  for (const auto slot : slots) {
+    const auto path = seg_path(segments_[slot].id);
+    segments_[slot].bytes = std::filesystem::exists(path)
+                                ? std::filesystem::file_size(path)
+                                : 0;
+    total_segment_bytes_ += segments_[slot].bytes;
+  }
+
+  const auto merge_start = std::chrono::steady_clock::now();
+  replay(&scanned, nullptr);
+  stats_.recovery_merge_ms += static_cast<std::size_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now() - merge_start)
+          .count());
+
+  // Appends always go to the newest segment so that segment id order matches
+  // write order; older layouts whose active segment was not the newest get a
+  // fresh one.
+  std::uint32_t newest = 0;
+  for (std::uint32_t s = 0; s < segments_.size(); ++s)
+    if (segments_[s].id > segments_[newest].id)
+      newest = s;
+  if (segments_[newest].id == active) {
+    active_slot_ = newest;
+    if (!open_active(err))
+      return false;
+  } else {
+    active_slot_ = alloc_segment_slot(next_segment_id_++);
+    if (!open_active(err))
+      return false;
+  }
   stats_.index_rebuild_ms = static_cast<std::size_t>(
       std::chrono::duration_cast<std::chrono::milliseconds>(
           std::chrono::steady_clock::now() - start)
           .count());
+  update_gauges();
   return write_manifest();
 }
 
+// Replays each key's records in seq order: a put sets value and TTL, a meta
+// record replaces the TTL, a tombstone clears the key. Keys that end up
+// deleted or expired, and key hashes in `skip`, are left out of the index.
+// `scanned` must be sorted by (key hash, seq) and is released.
+void SsdStore::replay(std::vector<ScanEntry> *scanned,
+                      const std::unordered_set<std::uint64_t> *skip) {
+  const auto &all = *scanned;
+  const auto now_ms = now_epoch_ms(Clock::now());
+  std::size_t groups = 0;
+  for (std::size_t i = 0; i < all.size(); ++i)
+    if (i + 1 == all.size() || all[i + 1].key_hash != all[i].key_hash)
+      ++groups;
+  index_.reserve(index_.size() + groups);
+  for (std::size_t i = 0; i < all.size();) {
+    const ScanEntry *put = nullptr;
+    std::int64_t ttl = -1;
+    std::size_t j = i;
+    for (; j < all.size() && all[j].key_hash == all[i].key_hash; ++j) {
+      const auto &e = all[j];
+      last_seq_ = std::max(last_seq_, e.seq);
+      auto &seg = segments_[loc_slot(e.loc)];
+      seg.min_seq = std::min(seg.min_seq, e.seq);
+      if (e.type == kRecordPut) {
+        put = &e;
+        ttl = e.ttl_epoch_ms;
+      } else if (e.type == kRecordTombstone) {
+        put = nullptr;
+      } else if (put) {
+        ttl = e.ttl_epoch_ms;
+      }
+    }
+    const auto hash = all[i].key_hash;
+    i = j;
+    if (!put || (ttl >= 0 && ttl <= now_ms) || (skip && skip->contains(hash)))
+      continue;
+    const auto tag = SsdIndex::tag_for_hash(put->key_hash);
+    index_.insert(tag, put->loc, ttl);
+    segments_[loc_slot(put->loc)].live_bytes += put->record_bytes;
+    live_bytes_ += put->record_bytes;
+    if (ttl >= 0)
+      track_ttl(tag, ttl);
+  }
+  scanned->clear();
+  scanned->shrink_to_fit();
+}
+
 bool SsdStore::put(const std::string &key,
                    const std::vector<std::uint8_t> &value,
                    std::optional<TimePoint> ttl_deadline, std::uint64_t seq,
                    std::string *err) {
   if (!cfg_.enabled)
     return false;
-  IndexEntry ie;
-  if (!append_record(key, value, to_epoch_ms(ttl_deadline), seq, false, &ie,
-                     err))
+  stats_.user_bytes_written += key.size() + value.size();
+  if (is_small(key, value.size())) {
+    // A key lives in exactly one of the two layouts.
+    del_from_log(key, seq, nullptr);
+    const bool ok = small_->put(key, value, to_epoch_ms(ttl_deadline), err);
+    update_gauges();
+    return ok;
+  }
+  if (!make_room(sizeof(RecordHeader) + key.size() + value.size())) {
+    if (err)
+      *err = "ssd tier full";
     return false;
-  auto it = index_.find(key);
-  if (it != index_.end() && !it->second.tombstone)
-    live_bytes_ -= it->second.len;
-  index_[key] = ie;
-  live_bytes_ += ie.len;
-  stats_.bytes = live_bytes_;
+  }
+  bool io_error = false;
+  // A put replaces whatever an unscanned segment holds, so it never waits.
+  auto old = find(key, false, nullptr, &io_error, nullptr, false);
+  if (!old && io_error) {
+    if (err)
+      *err = "ssd read failed";
+    return false;
+  }
+  seq = std::max(seq, last_seq_ + 1);
+  const auto ttl_ms = to_epoch_ms(ttl_deadline);
+  std::uint64_t loc = 0;
+  if (!append_record(key, value, ttl_ms, seq, kRecordPut, &loc, err))
+    return false;
+  last_seq_ = seq;
+  const auto tag = SsdIndex::tag_for_hash(fnv1a(key));
+  const auto bytes =
+      static_cast<std::uint32_t>(sizeof(RecordHeader) + key.size() +
+                                 value.size());
+  if (old) {
+    segments_[loc_slot(old->loc)].live_bytes -= old->record_bytes;
+    live_bytes_ -= old->record_bytes;
+    index_.set_loc_at(old->index_pos, loc);
+    index_.set_deadline_at(old->index_pos, ttl_ms);
+  } else {
+    index_.insert(tag, loc, ttl_ms);
+  }
+  segments_[loc_slot(loc)].live_bytes += bytes;
+  live_bytes_ += bytes;
+  if (ttl_ms >= 0)
+    track_ttl(tag, ttl_ms);
+  if (small_)
+    small_->erase(key);
+  update_gauges();
+  return true;
+}
+
+bool SsdStore::put_batch(const std::vector<SsdPut> &items,
+                         std::vector<bool> *ok, std::string *err) {
+  ok->assign(items.size(), false);
+  if (!cfg_.enabled)
+    return false;
+  in_batch_ = true;
+  for (std::size_t i = 0; i < items.size(); ++i)
+    (*ok)[i] = put(*items[i].key, *items[i].value, items[i].ttl_deadline,
+                   items[i].seq, err);
+  in_batch_ = false;
+  if (!commit(err)) {
+    ok->assign(items.size(), false);
+    return false;
+  }
   return true;
 }
 
 bool SsdStore::del(const std::string &key, std::uint64_t seq,
-                   std::string *err) {
+                   std::string *err, const SsdMeta *read) {
   if (!cfg_.enabled)
     return false;
-  IndexEntry ie;
+  // A key read from the log is not also a small object.
+  const bool from_log = read && read->record_bytes != 0;
+  if (!from_log && small_ && small_->erase(key, err)) {
+    update_gauges();
+    return true;
+  }
+  return del_from_log(key, seq, err, from_log ? read : nullptr);
+}
+
+bool SsdStore::del_from_log(const std::string &key, std::uint64_t seq,
+                            std::string *err, const SsdMeta *read) {
+  if (!make_room(sizeof(RecordHeader) + key.size())) {
+    if (err)
+      *err = "ssd tier full";
+    return false;
+  }
+  bool io_error = false;
+  bool unresolved = false;
+  std::optional<Found> found;
+  if (read) {
+    // Matching the location alone identifies the record; eviction or
+    // compaction since the read moves it, and then the probe below runs.
+    const auto tag = SsdIndex::tag_for_hash(fnv1a(key));
+    const auto pos = index_.find(tag, [read](std::uint64_t loc) {
+      return loc_pos(loc) == loc_pos(read->loc);
+    });
+    if (pos != SsdIndex::npos)
+      found = Found{pos, index_.loc_at(pos), read->record_bytes};
+  }
+  if (!found)
+    found = find(key, false, nullptr, &io_error, &unresolved);
   std::vector<std::uint8_t> empty;
-  if (!append_record(key, empty, -1, seq, true, &ie, err))
-    return false;
-  auto it = index_.find(key);
-  if (it != index_.end() && !it->second.tombstone)
-    live_bytes_ -= it->second.len;
-  ie.tombstone = true;
-  ie.len = 0;
-  index_[key] = ie;
-  stats_.bytes = live_bytes_;
+  if (!found) {
+    if (io_error && err)
+      *err = "ssd read failed";
+    // Online recovery could not rule the key out; the tombstone keeps an
+    // unscanned put from coming back when the index is completed.
+    if (unresolved) {
+      seq = std::max(seq, last_seq_ + 1);
+      if (append_record(key, empty, -1, seq, kRecordTombstone, nullptr, err))
+        last_seq_ = seq;
+    }
+    return false;
+  }
+  seq = std::max(seq, last_seq_ + 1);
+  if (!append_record(key, empty, -1, seq, kRecordTombstone, nullptr, err))
+    return false;
+  last_seq_ = seq;
+  forget(*found);
+  update_gauges();
   return true;
 }
 
 std::optional<std::vector<std::uint8_t>> SsdStore::get(const std::string &key,
                                                        SsdMeta *meta) {
   ++stats_.gets;
-  auto it = index_.find(key);
-  if (it == index_.end() || it->second.tombstone) {
-    ++stats_.misses;
-    return std::nullopt;
-  }
-  const auto now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-                          Clock::now().time_since_epoch())
-                          .count();
-  if (it->second.ttl_epoch_ms >= 0 && it->second.ttl_epoch_ms <= now_ms) {
-    index_.erase(it);
-    ++stats_.misses;
-    return std::nullopt;
+  Record rec;
+  bool io_error = false;
+  auto found = find(key, true, &rec, &io_error);
+  if (!found) {
+    std::int64_t ttl = -1;
+    auto small = small_ ? small_->get(key, &ttl) : std::nullopt;
+    if (!small) {
+      ++stats_.misses;
+      return std::nullopt;
+    }
+    if (meta) {
+      meta->seq = 0;
+      meta->ttl_epoch_ms = ttl;
+      meta->len = small->size();
+      meta->record_bytes = 0;
+    }
+    ++stats_.hits;
+    return small;
   }
-  std::vector<std::uint8_t> out;
-  if (!read_entry(it->second, &out)) {
+  const auto ttl = index_.deadline_at(found->index_pos);
+  if (ttl >= 0 && ttl <= now_epoch_ms(Clock::now())) {
+    forget(*found);
+    update_gauges();
     ++stats_.misses;
     return std::nullopt;
   }
   if (meta) {
-    meta->seq = it->second.seq;
-    meta->ttl_epoch_ms = it->second.ttl_epoch_ms;
-    meta->len = it->second.len;
+    meta->seq = rec.header.seq;
+    meta->ttl_epoch_ms = ttl;
+    meta->len = rec.value.size();
+    meta->loc = found->loc;
+    meta->record_bytes = found->record_bytes;
   }
+  index_.set_loc_at(found->index_pos, found->loc | kLocAccessedBit);
   ++stats_.hits;
-  return out;
-}
-
-bool SsdStore::contains(const std::string &key) const {
-  auto it = index_.find(key);
-  return it != index_.end() && !it->second.tombstone;
-}
-
-std::size_t SsdStore::erase_expired(std::size_t max_items, TimePoint now) {
-  const auto now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-                          now.time_since_epoch())
-                          .count();
-  std::size_t removed = 0;
-  for (auto it = index_.begin(); it != index_.end() && removed < max_items;) {
-    if (!it->second.tombstone && it->second.ttl_epoch_ms >= 0 &&
-        it->second.ttl_epoch_ms <= now_ms) {
-      live_bytes_ -= it->second.len;
-      it = index_.erase(it);
-      ++removed;
-    } else {
-      ++it;
-    }
-  }
-  stats_.bytes = live_bytes_;
-  return removed;
+  return std::move(rec.value);
 }
 
-void SsdStore::maybe_compact() {
+std::vector<std::optional<std::vector<std::uint8_t>>>
+SsdStore::multi_get(const std::vector<std::string> &keys,
+                    std::vector<SsdMeta> *metas) {
+  std::vector<std::optional<std::vector<std::uint8_t>>> out(keys.size());
+  if (metas)
+    metas->assign(keys.size(), SsdMeta{});
   if (!cfg_.enabled)
-    return;
-  if (segments_.size() < 2)
-    return;
-  stats_.fragmentation_estimate =
-      total_segment_bytes_ == 0
-          ? 0.0
-          : 1.0 - static_cast<double>(live_bytes_) /
-                      static_cast<double>(total_segment_bytes_);
-  if (stats_.fragmentation_estimate < cfg_.gc_fragmentation_threshold)
-    return;
-
-  auto start = std::chrono::steady_clock::now();
-  const std::uint32_t compact_id = segments_.back().id + 1;
-  const std::string compact_path = seg_path(compact_id);
-  int fd = pc_open(compact_path.c_str(),
-                   PC_O_CREAT | PC_O_RDWR | PC_O_TRUNC | PC_O_APPEND);
-  if (fd < 0)
-    return;
+    return out;
+  ++stats_.multi_gets;
+  if (recovery_) {
+    // One wait budget for the whole batch.
+    const auto deadline = std::chrono::steady_clock::now() +
+                          std::chrono::milliseconds(cfg_.recovery_wait_ms);
+    for (const auto &k : keys)
+      settle(k, deadline);
+  }
 
-  std::size_t copied = 0;
-  std::size_t reclaimed_before = total_segment_bytes_;
-  std::unordered_map<std::string, IndexEntry> new_index;
-  for (const auto &[k, e] : index_) {
-    if (copied >= cfg_.compaction_batch)
-      break;
-    if (e.tombstone)
+  struct Read {
+    std::size_t key_idx;
+    std::size_t index_pos;
+    std::uint64_t loc;
+    int fd;
+    std::vector<std::uint8_t> buf;
+    bool ok;
+  };
+  std::vector<Read> reads;
+  std::vector<std::size_t> slow;
+  const auto now_ms = now_epoch_ms(Clock::now());
+  refill_tokens();
+  for (std::size_t i = 0; i < keys.size(); ++i) {
+    const auto tag = SsdIndex::tag_for_hash(fnv1a(keys[i]));
+    const auto pos = index_.find(tag, [](std::uint64_t) { return true; });
+    if (pos == SsdIndex::npos) {
+      if (small_) {
+        slow.push_back(i);
+      } else {
+        ++stats_.gets;
+        ++stats_.misses;
+      }
       continue;
-    std::vector<std::uint8_t> val;
-    if (!read_entry(e, &val))
+    }
+    const auto loc = index_.loc_at(pos);
+    const auto ttl = index_.deadline_at(pos);
+    if (ttl >= 0 && ttl <= now_ms) {
+      slow.push_back(i);
       continue;
-    RecordHeader h{};
-    h.magic = kMagic;
-    h.key_hash = fnv1a(k);
-    h.seq = e.seq;
-    h.ttl_epoch_ms = e.ttl_epoch_ms;
-    h.key_len = static_cast<std::uint32_t>(k.size());
-    h.value_len = static_cast<std::uint32_t>(val.size());
-    h.tombstone = 0;
-    h.offset_next = 0;
-    h.checksum = checksum32(k, val, h);
-    auto off = pc_seek(fd, 0, SEEK_END);
-    if (off < 0)
+    }
+    ++stats_.gets;
+    if (!consume_read_budget(loc_span(loc))) {
+      ++stats_.misses;
       continue;
-    pc_write(fd, &h, sizeof(h));
-    pc_write(fd, k.data(), k.size());
-    if (!val.empty())
-      pc_write(fd, val.data(), val.size());
-    IndexEntry ne;
-    ne.segment_id = compact_id;
-    ne.offset = static_cast<std::uint64_t>(off);
-    ne.len = h.value_len;
-    ne.seq = h.seq;
-    ne.ttl_epoch_ms = h.ttl_epoch_ms;
-    ne.tombstone = false;
-    new_index[k] = ne;
-    ++copied;
-  }
-  pc_fsync(fd);
-  pc_close(fd);
-  if (copied == 0) {
-    std::filesystem::remove(compact_path);
-    return;
+    }
+    reads.push_back({i, pos, loc, -1, {}, false});
   }
 
-  for (const auto &[k, e] : new_index)
-    index_[k] = e;
-
-  std::vector<SegmentMeta> keep;
-  for (auto &s : segments_)
-    if (s.id == active_segment_)
-      keep.push_back(s);
-  keep.push_back({compact_id, std::filesystem::file_size(compact_path)});
-  segments_ = keep;
-  total_segment_bytes_ = 0;
-  for (const auto &s : segments_)
-    total_segment_bytes_ += s.bytes;
-  write_manifest();
+  // Buffered records are copied here; the rest are read by the pool.
+  std::sort(reads.begin(), reads.end(), [](const Read &a, const Read &b) {
+    return loc_pos(a.loc) < loc_pos(b.loc);
+  });
+  std::vector<Read *> disk;
+  for (auto &r : reads) {
+    const auto slot = loc_slot(r.loc);
+    if (slot == active_slot_ && loc_offset(r.loc) >= flushed_end_) {
+      r.ok = read_at(slot, loc_offset(r.loc), loc_span(r.loc), &r.buf);
+      continue;
+    }
+    r.fd = read_fd(slot);
+    if (r.fd >= 0)
+      disk.push_back(&r);
+  }
+  if (read_pool_.size() < disk.size())
+    read_pool_.resize(disk.size());
+  std::atomic<std::size_t> next{0};
+  const bool direct = direct_;
+  auto worker = [this, &disk, &next, direct] {
+    for (auto i = next++; i < disk.size(); i = next++) {
+      auto &r = *disk[i];
+      r.ok = read_span(r.fd, direct, loc_offset(r.loc), loc_span(r.loc),
+                       &read_pool_[i], &r.buf) >= 0;
+    }
+  };
+  const auto threads = std::min(cfg_.read_threads, disk.size());
+  if (threads > 1)
+    run_readers(threads - 1, worker);
+  else
+    worker();
+  stats_.multi_get_reads += disk.size();
 
-  stats_.gc_runs++;
-  std::size_t reclaimed_after = total_segment_bytes_;
-  if (reclaimed_before > reclaimed_after)
-    stats_.gc_bytes_reclaimed += reclaimed_before - reclaimed_after;
-  stats_.gc_time_ms += static_cast<std::uint64_t>(
-      std::chrono::duration_cast<std::chrono::milliseconds>(
-          std::chrono::steady_clock::now() - start)
-          .count());
+  for (auto &r : reads) {
+    if (r.fd >= 0)
+      stats_.read_mb += static_cast<double>(r.buf.size()) / (1024.0 * 1024.0);
+    Record rec;
+    if (!r.ok || !decode_record(r.buf, true, should_verify_read(), &rec)) {
+      ++stats_.misses;
+      continue;
+    }
+    if (rec.key != keys[r.key_idx]) {
+      // Tag collision: let get() walk the remaining candidates.
+      --stats_.gets;
+      slow.push_back(r.key_idx);
+      continue;
+    }
+    if (metas) {
+      auto &m = (*metas)[r.key_idx];
+      m.seq = rec.header.seq;
+      m.ttl_epoch_ms = index_.deadline_at(r.index_pos);
+      m.len = rec.value.size();
+      m.loc = r.loc;
+      m.record_bytes = rec.bytes();
+    }
+    index_.set_loc_at(r.index_pos, r.loc | kLocAccessedBit);
+    ++stats_.hits;
+    out[r.key_idx] = std::move(rec.value);
+  }
+  // Only now: get() may erase expired entries, which moves index positions.
+  for (const auto i : slow)
+    out[i] = get(keys[i], metas ? &(*metas)[i] : nullptr);
+  return out;
 }
 
-std::string SsdStore::seg_path(std::uint32_t id) const {
-  return cfg_.dir + "/segment_" + std::to_string(id) + ".log";
+bool SsdStore::contains(const std::string &key) {
+  bool io_error = false;
+  if (find(key, false, nullptr, &io_error))
+    return true;
+  return small_ && small_->get(key).has_value();
 }
 
-bool SsdStore::append_record(const std::string &key,
-                             const std::vector<std::uint8_t> &value,
-                             std::int64_t ttl_epoch_ms, std::uint64_t seq,
-                             bool tombstone, IndexEntry *entry,
-                             std::string *err) {
-  refill_tokens();
-  const std::size_t need = sizeof(RecordHeader) + key.size() + value.size();
-  if (!consume_write_budget(need)) {
-    if (err)
-      *err = "ssd write rate limited";
-    return false;
+bool SsdStore::stat(const std::string &key, SsdMeta *meta) {
+  Record rec;
+  bool io_error = false;
+  auto found = find(key, false, &rec, &io_error);
+  if (!found) {
+    std::int64_t ttl = -1;
+    auto small = small_ ? small_->get(key, &ttl) : std::nullopt;
+    if (!small)
+      return false;
+    if (meta) {
+      meta->seq = 0;
+      meta->ttl_epoch_ms = ttl;
+      meta->len = small->size();
+    }
+    return true;
   }
-  if (stats_.bytes + value.size() > cfg_.max_bytes) {
-    if (err)
-      *err = "ssd tier full";
+  const auto ttl = index_.deadline_at(found->index_pos);
+  if (ttl >= 0 && ttl <= now_epoch_ms(Clock::now())) {
+    forget(*found);
+    update_gauges();
     return false;
   }
-  RecordHeader h{};
-  h.magic = kMagic;
-  h.key_hash = fnv1a(key);
-  h.seq = seq;
-  h.ttl_epoch_ms = ttl_epoch_ms;
-  h.key_len = static_cast<std::uint32_t>(key.size());
-  h.value_len = static_cast<std::uint32_t>(value.size());
-  h.tombstone = tombstone ? 1 : 0;
-  h.offset_next = 0;
-  h.checksum = checksum32(key, value, h);
+  if (meta) {
+    meta->seq = rec.header.seq;
+    meta->ttl_epoch_ms = ttl;
+    meta->len = rec.header.value_len;
+  }
+  return true;
+}
 
-  auto off = pc_seek(active_fd_, 0, SEEK_END);
-  if (off < 0)
-    return false;
-  if (pc_write(active_fd_, &h, sizeof(h)) != static_cast<ssize_t>(sizeof(h)))
+bool SsdStore::set_ttl(const std::string &key,
+                       std::optional<TimePoint> ttl_deadline,
+                       std::uint64_t seq, std::string *err) {
+  if (!cfg_.enabled)
     return false;
-  if (pc_write(active_fd_, key.data(), key.size()) !=
-      static_cast<ssize_t>(key.size()))
+  if (!make_room(sizeof(RecordHeader) + key.size())) {
+    if (err)
+      *err = "ssd tier full";
     return false;
-  if (!value.empty() && pc_write(active_fd_, value.data(), value.size()) !=
-                            static_cast<ssize_t>(value.size()))
+  }
+  bool io_error = false;
+  auto found = find(key, false, nullptr, &io_error);
+  if (!found) {
+    if (io_error && err)
+      *err = "ssd read failed";
+    auto small = small_ ? small_->get(key) : std::nullopt;
+    return small && small_->put(key, *small, to_epoch_ms(ttl_deadline), err);
+  }
+  const auto old_ttl = index_.deadline_at(found->index_pos);
+  if (old_ttl >= 0 && old_ttl <= now_epoch_ms(Clock::now())) {
+    forget(*found);
+    update_gauges();
     return false;
-  if (!sync_for_policy())
+  }
+  seq = std::max(seq, last_seq_ + 1);
+  const auto ttl_ms = to_epoch_ms(ttl_deadline);
+  std::vector<std::uint8_t> empty;
+  if (!append_record(key, empty, ttl_ms, seq, kRecordMeta, nullptr, err))
     return false;
+  last_seq_ = seq;
+  index_.set_deadline_at(found->index_pos, ttl_ms);
+  if (ttl_ms >= 0)
+    track_ttl(SsdIndex::tag_for_hash(fnv1a(key)), ttl_ms);
+  return true;
+}
 
-  stats_.write_mb += static_cast<double>(need) / (1024.0 * 1024.0);
-  if (entry) {
-    entry->segment_id = active_segment_;
-    entry->offset = static_cast<std::uint64_t>(off);
-    entry->len = static_cast<std::uint32_t>(value.size());
-    entry->seq = seq;
-    entry->ttl_epoch_ms = ttl_epoch_ms;
-    entry->tombstone = tombstone;
-  }
-  for (auto &s : segments_) {
-    if (s.id == active_segment_) {
-      s.bytes += need;
-      total_segment_bytes_ += need;
+// Pops tags from expiry buckets whose whole time range has passed and erases
+// the slot carrying that tag with a deadline in the bucket's range. Work
+// (including stale tags of overwritten or deleted records) is bounded by
+// `max_items`; the record's bytes, read back from its header, become dead in
+// its segment for GC.
+std::size_t SsdStore::erase_expired(std::size_t max_items, TimePoint now) {
+  const auto now_ms = now_epoch_ms(now);
+  std::size_t work = 0;
+  std::size_t erased = 0;
+  while (work < max_items && !expiry_buckets_.empty()) {
+    auto it = expiry_buckets_.begin();
+    if ((it->first + 1) * kExpiryBucketMs > now_ms)
       break;
+    const auto lo = it->first * kExpiryBucketMs;
+    auto &bucket = it->second;
+    while (!bucket.empty() && work < max_items) {
+      const auto tag = bucket.back();
+      bucket.pop_back();
+      ++work;
+      const auto idx = index_.find_slot(tag, [&](std::size_t pos) {
+        const auto ttl = index_.deadline_at(pos);
+        return ttl >= lo && ttl < lo + kExpiryBucketMs;
+      });
+      if (idx == SsdIndex::npos)
+        continue;
+      // On a failed read the slot stays; get() or GC drops it later.
+      const auto loc = index_.loc_at(idx);
+      Record rec;
+      if (!read_record(loc, false, &rec))
+        continue;
+      forget({idx, loc, rec.bytes()});
+      ++erased;
+    }
+    if (bucket.empty()) {
+      expiry_bytes_ -= bucket.capacity() * sizeof(std::uint32_t) +
+                       kExpiryNodeBytes;
+      expiry_buckets_.erase(it);
     }
   }
-  return true;
+  if (erased > 0)
+    update_gauges();
+  return erased;
 }
 
-bool SsdStore::sync_for_policy() {
-  if (cfg_.fsync == FsyncMode::Never)
-    return true;
-  if (cfg_.fsync == FsyncMode::Always)
-    return pc_fsync(active_fd_) == 0;
-  const auto now_s = static_cast<std::uint64_t>(
-      std::chrono::duration_cast<std::chrono::seconds>(
-          std::chrono::system_clock::now().time_since_epoch())
-          .count());
-  if (now_s != last_fsync_epoch_s_) {
-    last_fsync_epoch_s_ = now_s;
-    return pc_fsync(active_fd_) == 0;
-  }
-  return true;
+void SsdStore::track_ttl(std::uint32_t tag, std::int64_t deadline_ms) {
+  auto [it, added] =
+      expiry_buckets_.try_emplace(deadline_ms / kExpiryBucketMs);
+  auto &bucket = it->second;
+  const auto cap = bucket.capacity();
+  bucket.push_back(tag);
+  expiry_bytes_ += (bucket.capacity() - cap) * sizeof(std::uint32_t) +
+                   (added ? kExpiryNodeBytes : 0);
 }
 
-bool SsdStore::load_manifest(std::vector<std::uint32_t> *segments,
+void SsdStore::maybe_compact() {
+  // Online recovery: segments still being scanned must not move.
+  if (!cfg_.enabled || recovery_)
+    return;
+  if (!gc_active_) {
+    const auto slot = gc_candidate_slot();
+    if (slot == active_slot_)
+      return;
+    gc_slot_ = slot;
+    gc_offset_ = 0;
+    gc_elapsed_ = {};
+    gc_active_ = true;
+  }
+  const auto start = std::chrono::steady_clock::now();
+  const bool done = compact_step(cfg_.compaction_batch);
+  gc_elapsed_ += std::chrono::steady_clock::now() - start;
+  if (!done)
+    return;
+
+  auto &seg = segments_[gc_slot_];
+  close_read_fd(gc_slot_);
+  std::filesystem::remove(seg_path(seg.id));
+  total_segment_bytes_ -= seg.bytes;
+  stats_.gc_bytes_reclaimed += seg.bytes;
+  seg = SegmentMeta{};
+  gc_active_ = false;
+  write_manifest();
+  stats_.gc_runs++;
+  stats_.gc_time_ms += static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(gc_elapsed_)
+          .count());
+  update_gauges();
+}
+
+// Copies live records of the segment under GC to the active segment, at most
+// `budget` records per call. Returns true once the whole segment has been
+// processed and may be deleted.
+bool SsdStore::compact_step(std::size_t budget) {
+  const auto slot = gc_slot_;
+  const std::string path = seg_path(segments_[slot].id);
+  int fd = pc_open(path.c_str(), PC_O_RDONLY);
+  if (fd < 0)
+    return true;
+  const auto now_ms = now_epoch_ms(Clock::now());
+  // Copies shrink the tier; evicting here would move index entries under us.
+  suppress_eviction_ = true;
+  bool done = false;
+  for (std::size_t n = 0; n < budget; ++n) {
+    RecordHeader h{};
+    const auto off = static_cast<std::int64_t>(gc_offset_);
+    if (gc_offset_ >= segments_[slot].bytes ||
+        pc_pread(fd, &h, sizeof(h), off) != static_cast<ssize_t>(sizeof(h)) ||
+        !known_magic(h.magic)) {
+      done = true;
+      break;
+    }
+    std::string key(h.key_len, '\0');
+    if (pc_pread(fd, key.data(), h.key_len,
+                 off + static_cast<std::int64_t>(sizeof(h))) !=
+        static_cast<ssize_t>(h.key_len)) {
+      done = true;
+      break;
+    }
+    const auto rec_bytes =
+        static_cast<std::uint32_t>(sizeof(h) + h.key_len + h.value_len);
+    const auto tag = SsdIndex::tag_for_hash(fnv1a(key));
+    const auto here = pack_loc(slot, gc_offset_, rec_bytes);
+    std::size_t idx = SsdIndex::npos;
+    if (h.type == kRecordPut)
+      idx = index_.find(tag, [&](std::uint64_t loc) {
+        return loc_pos(loc) == loc_pos(here);
+      });
+
+    if (idx == SsdIndex::npos) {
+      // Dead record. Tombstones survive while an older segment may still
+      // hold a version of the key; meta records survive while the put they
+      // retime lives in another segment.
+      std::uint8_t carry = kRecordPut;
+      if (h.type == kRecordTombstone && shadows_older(slot, h.seq)) {
+        carry = kRecordTombstone;
+      } else if (h.type == kRecordMeta) {
+        Record live;
+        bool io_error = false;
+        auto f = find(key, false, &live, &io_error);
+        if (!f && io_error)
+          break;
+        if (f && live.header.seq < h.seq && loc_slot(f->loc) != slot)
+          carry = kRecordMeta;
+        else if (!f && shadows_older(slot, h.seq))
+          carry = kRecordTombstone;
+      }
+      if (carry != kRecordPut) {
+        std::vector<std::uint8_t> empty;
+        const auto ttl = carry == kRecordMeta ? h.ttl_epoch_ms : -1;
+        if (!append_record(key, empty, ttl, h.seq, carry, nullptr, nullptr))
+          break;
+      }
+      gc_offset_ += rec_bytes;
+      continue;
+    }
+
+    const auto old_loc = index_.loc_at(idx);
+    const std::int64_t ttl = index_.deadline_at(idx);
+    if (ttl >= 0 && ttl <= now_ms) {
+      forget({idx, old_loc, rec_bytes});
+      if (shadows_older(slot, h.seq)) {
+        std::vector<std::uint8_t> empty;
+        if (!append_record(key, empty, -1, h.seq, kRecordTombstone, nullptr,
+                           nullptr))
+          break;
+      }
+      gc_offset_ += rec_bytes;
+      continue;
+    }
+    std::vector<std::uint8_t> value(h.value_len);
+    if (h.value_len > 0 &&
+        pc_pread(fd, value.data(), h.value_len,
+                 off + static_cast<std::int64_t>(sizeof(h) + h.key_len)) !=
+            static_cast<ssize_t>(h.value_len)) {
+      done = true;
+      break;
+    }
+    if (checksum32(key, value, h) != h.checksum) {
+      ++stats_.checksum_failures;
+      forget({idx, old_loc, rec_bytes});
+      gc_offset_ += rec_bytes;
+      continue;
+    }
+    // Fresh seq keeps segment order equal to seq order, which lets eviction
+    // drop the oldest segment without resurrecting anything it shadowed.
+    std::uint64_t new_loc = 0;
+    if (!append_record(key, value, ttl, last_seq_ + 1, kRecordPut, &new_loc,
+                       nullptr))
+      break;
+    ++last_seq_;
+    new_loc |= old_loc & kLocAccessedBit;
+    segments_[slot].live_bytes -= rec_bytes;
+    segments_[loc_slot(new_loc)].live_bytes += rec_bytes;
+    index_.set_loc_at(idx, new_loc);
+    gc_offset_ += rec_bytes;
+  }
+  suppress_eviction_ = false;
+  if (direct_)
+    pc_drop_cache(fd);
+  pc_close(fd);
+  return done;
+}
+
+bool SsdStore::shadows_older(std::uint32_t slot, std::uint64_t seq) const {
+  for (std::uint32_t s = 0; s < segments_.size(); ++s)
+    if (s != slot && segments_[s].id != 0 && segments_[s].min_seq < seq)
+      return true;
+  return false;
+}
+
+std::uint32_t SsdStore::oldest_sealed_slot() const {
+  std::uint32_t best = active_slot_;
+  for (std::uint32_t s = 0; s < segments_.size(); ++s) {
+    if (s == active_slot_ || segments_[s].id == 0)
+      continue;
+    if (best == active_slot_ || segments_[s].id < segments_[best].id)
+      best = s;
+  }
+  return best;
+}
+
+// Sealed segment with the highest dead-byte ratio, if that ratio reaches the
+// GC threshold; active_slot_ otherwise.
+std::uint32_t SsdStore::gc_candidate_slot() const {
+  std::uint32_t best = active_slot_;
+  double best_ratio = cfg_.gc_fragmentation_threshold;
+  for (std::uint32_t s = 0; s < segments_.size(); ++s) {
+    const auto &seg = segments_[s];
+    if (s == active_slot_ || seg.id == 0)
+      continue;
+    const double dead =
+        seg.bytes == 0 ? 1.0
+                       : 1.0 - static_cast<double>(seg.live_bytes) /
+                                   static_cast<double>(seg.bytes);
+    if (dead >= best_ratio) {
+      best = s;
+      best_ratio = dead;
+    }
+  }
+  return best;
+}
+
+std::optional<SsdStore::Found> SsdStore::find(const std::string &key,
+                                              bool want_value,
+                                              Record *rec_out, bool *io_error,
+                                              bool *unresolved, bool wait) {
+  if (recovery_) {
+    auto deadline = std::chrono::steady_clock::now();
+    if (wait)
+      deadline += std::chrono::milliseconds(cfg_.recovery_wait_ms);
+    if (!settle(key, deadline) && unresolved)
+      *unresolved = true;
+  }
+  Record local;
+  Record &rec = rec_out ? *rec_out : local;
+  const auto tag = SsdIndex::tag_for_hash(fnv1a(key));
+  const auto pos = index_.find(tag, [&](std::uint64_t loc) {
+    if (!read_record(loc, want_value, &rec)) {
+      *io_error = true;
+      return false;
+    }
+    return rec.key == key;
+  });
+  if (pos == SsdIndex::npos)
+    return std::nullopt;
+  return Found{pos, index_.loc_at(pos), rec.bytes()};
+}
+
+void SsdStore::forget(const Found &f) {
+  segments_[loc_slot(f.loc)].live_bytes -= f.record_bytes;
+  live_bytes_ -= f.record_bytes;
+  index_.erase_at(f.index_pos);
+}
+
+bool SsdStore::is_small(const std::string &key, std::size_t value_len) const {
+  return small_ && key.size() + value_len <= cfg_.small_object_max_bytes &&
+         SmallObjectStore::fits(key.size(), value_len);
+}
+
+void SsdStore::update_gauges() {
+  if (small_) {
+    const auto &ss = small_->stats();
+    stats_.small_objects = ss.objects;
+    stats_.small_page_writes = ss.page_writes;
+    stats_.small_bloom_false_positives = ss.bloom_false_positives;
+    stats_.small_evicted = ss.evicted_objects;
+    stats_.small_ram_bytes = ss.ram_bytes;
+  }
+  stats_.device_bytes_written =
+      log_bytes_written_ +
+      stats_.small_page_writes * SmallObjectStore::kPageBytes;
+  stats_.write_amplification =
+      stats_.user_bytes_written == 0
+          ? 0.0
+          : static_cast<double>(stats_.device_bytes_written) /
+                static_cast<double>(stats_.user_bytes_written);
+  stats_.bytes = live_bytes_;
+  stats_.index_keys = index_.size();
+  stats_.index_bytes = index_.memory_bytes() + expiry_bytes_;
+  stats_.index_bytes_per_key =
+      stats_.index_keys == 0 ? 0.0
+                             : static_cast<double>(stats_.index_bytes) /
+                                   static_cast<double>(stats_.index_keys);
+  std::size_t n = 0;
+  for (const auto &s : segments_)
+    if (s.id != 0)
+      ++n;
+  stats_.segments = n;
+  stats_.fragmentation_estimate =
+      total_segment_bytes_ == 0
+          ? 0.0
+          : 1.0 - static_cast<double>(live_bytes_) /
+                      static_cast<double>(total_segment_bytes_);
+}
+
+// FIFO eviction: drops the oldest sealed segments until `need` more bytes fit.
+// Callers holding an index position must call this before looking the key up,
+// since eviction moves index entries.
+bool SsdStore::make_room(std::size_t need) {
+  if (suppress_eviction_)
+    return true;
+  while (total_segment_bytes_ + need > cfg_.max_bytes) {
+    // Nothing is evicted until online recovery has indexed every segment.
+    if (recovery_)
+      return false;
+    auto victim = oldest_sealed_slot();
+    if (victim == active_slot_) {
+      if (active_end_ == 0 || !rotate_segment(nullptr))
+        return false;
+      continue;
+    }
+    evict_segment(victim);
+  }
+  return true;
+}
+
+// Drops every record of `slot` from the index and deletes the file. Records
+// read since they were written are first re-appended, up to
+// kMaxReinsertFraction of the segment, and lose their accessed bit.
+void SsdStore::evict_segment(std::uint32_t slot) {
+  if (gc_active_ && gc_slot_ == slot)
+    gc_active_ = false;
+  std::vector<std::pair<std::uint32_t, std::uint64_t>> victims;
+  index_.for_each([&](std::uint32_t tag, std::uint64_t loc) {
+    if (loc_slot(loc) == slot)
+      victims.emplace_back(tag, loc);
+  });
+
+  suppress_eviction_ = true;
+  auto reinsert_budget = static_cast<std::size_t>(
+      static_cast<double>(segments_[slot].bytes) * kMaxReinsertFraction);
+  const auto now_ms = now_epoch_ms(Clock::now());
+  Record rec;
+  for (const auto &[tag, loc] : victims) {
+    auto idx = index_.find(tag, [&](std::uint64_t l) { return l == loc; });
+    if (idx == SsdIndex::npos)
+      continue;
+    const auto ttl = index_.deadline_at(idx);
+    const auto span = loc_span(loc);
+    if ((loc & kLocAccessedBit) != 0 && span <= reinsert_budget &&
+        (ttl < 0 || ttl > now_ms) && read_record(loc, true, &rec)) {
+      std::uint64_t new_loc = 0;
+      if (append_record(rec.key, rec.value, ttl, last_seq_ + 1, kRecordPut,
+                        &new_loc, nullptr)) {
+        ++last_seq_;
+        const auto bytes = rec.bytes();
+        segments_[slot].live_bytes -= bytes;
+        segments_[loc_slot(new_loc)].live_bytes += bytes;
+        index_.set_loc_at(idx, new_loc);
+        reinsert_budget -= span;
+        ++stats_.reinserted_keys;
+        continue;
+      }
+      // A failed flush may have forgotten entries and shifted this one.
+      idx = index_.find(tag, [&](std::uint64_t l) { return l == loc; });
+      if (idx == SsdIndex::npos)
+        continue;
+    }
+    index_.erase_at(idx);
+    ++stats_.evicted_keys;
+  }
+  suppress_eviction_ = false;
+
+  auto &seg = segments_[slot];
+  live_bytes_ -= seg.live_bytes;
+  close_read_fd(slot);
+  std::filesystem::remove(seg_path(seg.id));
+  total_segment_bytes_ -= seg.bytes;
+  stats_.evicted_bytes += seg.bytes;
+  ++stats_.evicted_segments;
+  seg = SegmentMeta{};
+  write_manifest();
+  update_gauges();
+}
+
+std::string SsdStore::seg_path(std::uint32_t id) const {
+  return cfg_.dir + "/segment_" + std::to_string(id) + ".log";
+}
+
+std::uint32_t SsdStore::alloc_segment_slot(std::uint32_t id) {
+  for (std::uint32_t s = 0; s < segments_.size(); ++s) {
+    if (segments_[s].id == 0) {
+      segments_[s] = SegmentMeta{};
+      segments_[s].id = id;
+      return s;
+    }
+  }
+  segments_.push_back(SegmentMeta{});
+  segments_.back().id = id;
+  return static_cast<std::uint32_t>(segments_.size() - 1);
+}
+
+bool SsdStore::open_active(std::string *err) {
+  const auto p = seg_path(segments_[active_slot_].id);
+  if (direct_)
+    pad_active_tail();
+  active_fd_ = pc_open(p.c_str(), PC_O_CREAT | PC_O_RDWR | PC_O_APPEND |
+                                      (direct_ ? PC_O_DIRECT : 0));
+  if (active_fd_ < 0) {
+    if (err)
+      *err = "failed to open active segment";
+    return false;
+  }
+  const auto end = pc_seek(active_fd_, 0, SEEK_END);
+  active_end_ = end < 0 ? 0 : static_cast<std::uint64_t>(end);
+  flushed_end_ = active_end_;
+  append_buf_.reserve(cfg_.append_buffer_bytes + 2 * kDirectIoAlign);
+  return true;
+}
+
+// A segment last written without O_DIRECT (or cut back by tail repair) may
+// end mid-block; pad it once through a buffered descriptor.
+void SsdStore::pad_active_tail() {
+  const auto p = seg_path(segments_[active_slot_].id);
+  const int fd = pc_open(p.c_str(), PC_O_CREAT | PC_O_RDWR | PC_O_APPEND);
+  if (fd < 0)
+    return;
+  const auto end = pc_seek(fd, 0, SEEK_END);
+  std::vector<std::uint8_t> pad;
+  const auto n =
+      end < 0 ? 0 : append_pad(&pad, static_cast<std::uint64_t>(end));
+  IoSlice slice{pad.data(), pad.size()};
+  if (n > 0 && pc_write_all(fd, &slice, 1) && pc_fsync(fd) == 0) {
+    segments_[active_slot_].bytes += n;
+    total_segment_bytes_ += n;
+    stats_.pad_bytes += n;
+    log_bytes_written_ += n;
+  }
+  pc_close(fd);
+}
+
+bool SsdStore::rotate_segment(std::string *err) {
+  std::size_t used = 0;
+  for (const auto &s : segments_)
+    if (s.id != 0)
+      ++used;
+  if (used >= kMaxSegmentSlots) {
+    if (err)
+      *err = "ssd segment table full";
+    return false;
+  }
+  if (!flush_appends()) {
+    if (err)
+      *err = "ssd write failed";
+    return false;
+  }
+  if (cfg_.fsync != FsyncMode::Never && unsynced_)
+    fsync_active();
+  pc_close(active_fd_);
+  active_fd_ = -1;
+  active_slot_ = alloc_segment_slot(next_segment_id_++);
+  if (!open_active(err))
+    return false;
+  return write_manifest();
+}
+
+bool SsdStore::append_record(const std::string &key,
+                             const std::vector<std::uint8_t> &value,
+                             std::int64_t ttl_epoch_ms, std::uint64_t seq,
+                             std::uint8_t type, std::uint64_t *loc_out,
+                             std::string *err) {
+  refill_tokens();
+  const std::size_t need = sizeof(RecordHeader) + key.size() + value.size();
+  if (!consume_write_budget(need)) {
+    if (err)
+      *err = "ssd write rate limited";
+    return false;
+  }
+  if (!suppress_eviction_ && !make_room(need)) {
+    if (err)
+      *err = "ssd tier full";
+    return false;
+  }
+  if (active_end_ > 0 && active_end_ + need > cfg_.segment_bytes &&
+      !rotate_segment(err))
+    return false;
+  const auto key_hash = fnv1a(key);
+  const auto h = make_header(key, value, ttl_epoch_ms, seq, type, key_hash);
+  const std::uint64_t off = active_end_;
+
+  if (append_buf_.empty())
+    oldest_pending_ = std::chrono::steady_clock::now();
+  // Direct I/O writes only whole aligned blocks, so values are always copied
+  // into the (aligned) append buffer there.
+  if (direct_ || append_buf_.size() + need <= cfg_.append_buffer_bytes) {
+    append_bytes(&append_buf_, &h, sizeof(h));
+    append_bytes(&append_buf_, key.data(), key.size());
+    append_bytes(&append_buf_, value.data(), value.size());
+    active_end_ += need;
+    if (append_buf_.size() >= cfg_.append_buffer_bytes && !flush_appends()) {
+      if (err)
+        *err = "ssd write failed";
+      return false;
+    }
+  } else {
+    // Too large to coalesce: hand the pending buffer, the header+key and the
+    // caller's value to one writev instead of copying the value.
+    std::vector<std::uint8_t> head;
+    head.reserve(sizeof(h) + key.size());
+    append_bytes(&head, &h, sizeof(h));
+    append_bytes(&head, key.data(), key.size());
+    active_end_ += need;
+    if (!flush_appends(head.data(), head.size(), value.data(),
+                       value.size())) {
+      if (err)
+        *err = "ssd write failed";
+      return false;
+    }
+  }
+  unsynced_ = true;
+  if (cfg_.fsync == FsyncMode::Always && !in_batch_ && !commit(err))
+    return false;
+
+  // Written since restart: the index holds this key's current state.
+  if (recovery_)
+    recovery_->settled.insert(key_hash);
+  stats_.write_mb += static_cast<double>(need) / (1024.0 * 1024.0);
+  log_bytes_written_ += need;
+  if (loc_out)
+    *loc_out = pack_loc(active_slot_, off, need);
+  auto &seg = segments_[active_slot_];
+  seg.bytes += need;
+  seg.min_seq = std::min(seg.min_seq, seq);
+  total_segment_bytes_ += need;
+  return true;
+}
+
+bool SsdStore::flush_appends(const void *tail_a, std::size_t tail_a_len,
+                             const void *tail_b, std::size_t tail_b_len) {
+  if (active_fd_ < 0)
+    return false;
+  if (append_buf_.empty() && tail_a_len == 0 && tail_b_len == 0)
+    return true;
+  if (direct_) {
+    const auto pad = append_pad(&append_buf_, active_end_);
+    active_end_ += pad;
+    segments_[active_slot_].bytes += pad;
+    total_segment_bytes_ += pad;
+    stats_.pad_bytes += pad;
+    log_bytes_written_ += pad;
+  }
+  IoSlice slices[3] = {{append_buf_.data(), append_buf_.size()},
+                       {tail_a, tail_a_len},
+                       {tail_b, tail_b_len}};
+  const std::uint64_t end = flushed_end_ + append_buf_.size() + tail_a_len +
+                            tail_b_len;
+  if (!pc_write_all(active_fd_, slices, 3)) {
+    drop_unflushed();
+    return false;
+  }
+  append_buf_.clear();
+  flushed_end_ = end;
+  ++stats_.append_flushes;
+  return true;
+}
+
+// After a failed flush: cuts the active segment back to the last flushed
+// record, or failing that keeps whatever whole records reached the file, and
+// forgets the buffered puts past that point so their index entries and bytes
+// do not outlive them. Later appends then reuse those offsets safely.
+void SsdStore::drop_unflushed() {
+  std::uint64_t end = flushed_end_;
+  if (pc_truncate(active_fd_, static_cast<std::int64_t>(end)) != 0) {
+    const auto real_end = pc_seek(active_fd_, 0, SEEK_END);
+    if (real_end >= 0)
+      end = std::max(end, static_cast<std::uint64_t>(real_end));
+  }
+  bool forgot = false;
+  for (std::size_t at = 0; at + sizeof(RecordHeader) <= append_buf_.size();) {
+    RecordHeader h{};
+    std::memcpy(&h, append_buf_.data() + at, sizeof(h));
+    const std::uint64_t off = flushed_end_ + at;
+    const auto bytes =
+        static_cast<std::uint32_t>(sizeof(h) + h.key_len + h.value_len);
+    at += bytes;
+    if (h.type != kRecordPut || off + bytes <= end)
+      continue;
+    const auto here = loc_pos(pack_loc(active_slot_, off, bytes));
+    const auto idx = index_.find(
+        SsdIndex::tag_for_hash(h.key_hash),
+        [&](std::uint64_t loc) { return loc_pos(loc) == here; });
+    if (idx == SsdIndex::npos)
+      continue;
+    forget({idx, index_.loc_at(idx), bytes});
+    forgot = true;
+  }
+  auto &seg = segments_[active_slot_];
+  if (seg.bytes > end) {
+    total_segment_bytes_ -= seg.bytes - end;
+    seg.bytes = end;
+  }
+  append_buf_.clear();
+  flushed_end_ = end;
+  active_end_ = end;
+  if (forgot)
+    update_gauges();
+}
+
+bool SsdStore::fsync_active() {
+  ++stats_.fsyncs;
+  unsynced_ = false;
+  last_fsync_epoch_s_ = static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::seconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count());
+  return pc_fsync(active_fd_) == 0;
+}
+
+bool SsdStore::commit(std::string *err) {
+  if (!cfg_.enabled || active_fd_ < 0)
+    return true;
+  if (!flush_appends()) {
+    if (err)
+      *err = "ssd write failed";
+    return false;
+  }
+  if (small_ && cfg_.fsync != FsyncMode::Never && !small_->sync()) {
+    if (err)
+      *err = "ssd fsync failed";
+    return false;
+  }
+  if (!unsynced_)
+    return true;
+  bool ok = true;
+  if (cfg_.fsync == FsyncMode::Group || cfg_.fsync == FsyncMode::Always) {
+    if (cfg_.fsync == FsyncMode::Group)
+      ++stats_.group_commits;
+    ok = fsync_active();
+  } else {
+    ok = sync_for_policy();
+  }
+  if (!ok && err)
+    *err = "ssd fsync failed";
+  return ok;
+}
+
+void SsdStore::maybe_commit() {
+  if (!cfg_.enabled || active_fd_ < 0)
+    return;
+  if (!append_buf_.empty()) {
+    const auto waited = std::chrono::steady_clock::now() - oldest_pending_;
+    if (waited < std::chrono::milliseconds(cfg_.group_commit_window_ms))
+      return;
+  } else if (!unsynced_ || cfg_.fsync != FsyncMode::EverySec) {
+    return;
+  }
+  commit();
+}
+
+bool SsdStore::sync_for_policy() {
+  if (cfg_.fsync == FsyncMode::Never) {
+    unsynced_ = false;
+    return true;
+  }
+  if (cfg_.fsync == FsyncMode::Always || cfg_.fsync == FsyncMode::Group)
+    return fsync_active();
+  const auto now_s = static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::seconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count());
+  if (now_s != last_fsync_epoch_s_)
+    return fsync_active();
+  return true;
+}
+
+bool SsdStore::load_manifest(std::vector<std::uint32_t> *segments,
                              std::uint32_t *active) {
   std::ifstream in(cfg_.dir + "/manifest.txt");
   if (!in.is_open())
@@ -496,9 +1537,10 @@ bool SsdStore::write_manifest() {
     std::ofstream out(tmp, std::ios::trunc);
     if (!out.is_open())
       return false;
-    out << "active=" << active_segment_ << "\n";
+    out << "active=" << segments_[active_slot_].id << "\n";
     for (const auto &s : segments_)
-      out << "segment=" << s.id << "\n";
+      if (s.id != 0)
+        out << "segment=" << s.id << "\n";
     out.flush();
   }
   int fd = pc_open(tmp.c_str(), PC_O_RDONLY);
@@ -513,99 +1555,548 @@ bool SsdStore::write_manifest() {
   return fsync_dir(cfg_.dir);
 }
 
-bool SsdStore::scan_segment(std::uint32_t id, bool repair_tail) {
+// Scans `slots` on a pool of threads, largest files first. Each thread keeps
+// its own entry list and sorts it by (key hash, seq); the sorted runs are then
+// merged so `out` comes back in replay order. Only the segment the manifest
+// marks active can have a torn tail, so only it is repaired.
+bool SsdStore::recover_segments(const std::vector<std::uint32_t> &slots,
+                                std::uint32_t active_id,
+                                std::vector<ScanEntry> *out) {
+  std::vector<std::pair<std::uint64_t, std::uint32_t>> order;
+  for (const auto slot : slots) {
+    std::error_code ec;
+    const auto size = std::filesystem::file_size(seg_path(segments_[slot].id),
+                                                 ec);
+    order.push_back({ec ? 0 : size, slot});
+  }
+  std::sort(order.rbegin(), order.rend());
+
+  std::size_t threads = cfg_.recovery_threads;
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  threads = std::max<std::size_t>(1, std::min(threads, order.size()));
+  struct Part {
+    std::vector<ScanEntry> entries;
+    std::chrono::nanoseconds verify{0};
+    bool ok{true};
+  };
+  std::vector<Part> parts(threads);
+  std::atomic<std::size_t> next{0};
+  std::atomic<std::int64_t> sort_ns{0};
+  auto worker = [&](Part *part) {
+    for (auto i = next++; i < order.size(); i = next++) {
+      const auto slot = order[i].second;
+      const auto id = segments_[slot].id;
+      if (!scan_segment(slot, id, id == active_id, &part->entries,
+                        &part->verify))
+        part->ok = false;
+    }
+    const auto t0 = std::chrono::steady_clock::now();
+    std::sort(part->entries.begin(), part->entries.end(),
+              by_key_seq<ScanEntry>);
+    sort_ns += (std::chrono::steady_clock::now() - t0).count();
+  };
+  const auto scan_start = std::chrono::steady_clock::now();
+  std::vector<std::thread> pool;
+  for (std::size_t t = 1; t < threads; ++t)
+    pool.emplace_back(worker, &parts[t]);
+  worker(&parts[0]);
+  for (auto &t : pool)
+    t.join();
+  const auto scan_wall = std::chrono::steady_clock::now() - scan_start;
+
+  const auto merge_start = std::chrono::steady_clock::now();
+  std::chrono::nanoseconds verify{0};
+  std::vector<std::size_t> bounds{0};
+  out->clear();
+  for (auto &p : parts) {
+    if (!p.ok)
+      return false;
+    verify += p.verify;
+    out->insert(out->end(), p.entries.begin(), p.entries.end());
+    bounds.push_back(out->size());
+    p.entries = {};
+  }
+  merge_runs(out, std::move(bounds));
+
+  using std::chrono::duration_cast;
+  using std::chrono::milliseconds;
+  // Per-thread sort time counts as merge work, not scan.
+  const auto sort_wall =
+      std::chrono::nanoseconds(sort_ns.load() / static_cast<long>(threads));
+  stats_.recovery_threads = threads;
+  stats_.recovery_scan_ms = static_cast<std::size_t>(
+      duration_cast<milliseconds>(scan_wall - sort_wall).count());
+  stats_.recovery_verify_ms =
+      static_cast<std::size_t>(duration_cast<milliseconds>(verify).count());
+  stats_.recovery_merge_ms = static_cast<std::size_t>(
+      duration_cast<milliseconds>(std::chrono::steady_clock::now() -
+                                  merge_start + sort_wall)
+          .count());
+  return true;
+}
+
+// Online mode: scans segments newest first, which repairs the active tail,
+// until one holds a put. Puts and the records written after them take fresh
+// seqs, so the highest seq on disk is in the runs scanned by then; only
+// records GC copied forward with their old seq sit in newer segments. The
+// scanned records come back in `out` if nothing else is left; otherwise all
+// runs are kept for settle() and the rest are scanned by a background thread.
+bool SsdStore::begin_online_recovery(const std::vector<std::uint32_t> &slots,
+                                     std::uint32_t active_id,
+                                     std::vector<ScanEntry> *out) {
+  auto rc = std::make_unique<Recovery>();
+  rc->start = std::chrono::steady_clock::now();
+  for (const auto slot : slots) {
+    std::error_code ec;
+    const auto size = std::filesystem::file_size(seg_path(segments_[slot].id),
+                                                 ec);
+    rc->runs.push_back({slot, segments_[slot].id, ec ? 0 : size, {}});
+  }
+  std::sort(rc->runs.begin(), rc->runs.end(),
+            [](const auto &a, const auto &b) { return a.id > b.id; });
+  std::chrono::nanoseconds verify{0};
+  while (rc->ready < rc->runs.size()) {
+    auto &run = rc->runs[rc->ready++];
+    if (!scan_segment(run.slot, run.id, run.id == active_id, &run.entries,
+                      &verify))
+      return false;
+    std::sort(run.entries.begin(), run.entries.end(), by_key_seq<ScanEntry>);
+    bool has_put = false;
+    for (const auto &e : run.entries) {
+      last_seq_ = std::max(last_seq_, e.seq);
+      has_put = has_put || e.type == kRecordPut;
+    }
+    rc->bytes_scanned += run.bytes;
+    if (has_put)
+      break;
+  }
+  stats_.recovery_threads = 1;
+  stats_.recovery_segments_total = rc->runs.size();
+  stats_.recovery_bytes_total = 0;
+  for (const auto &run : rc->runs)
+    stats_.recovery_bytes_total += run.bytes;
+  if (rc->ready == rc->runs.size()) {
+    std::vector<std::size_t> bounds{0};
+    for (auto &run : rc->runs) {
+      out->insert(out->end(), run.entries.begin(), run.entries.end());
+      bounds.push_back(out->size());
+    }
+    merge_runs(out, std::move(bounds));
+    stats_.recovery_segments_ready = rc->runs.size();
+    stats_.recovery_bytes_scanned = stats_.recovery_bytes_total;
+    return true;
+  }
+  rc->verify = verify;
+  stats_.recovery_segments_ready = rc->ready;
+  stats_.recovery_bytes_scanned = rc->bytes_scanned;
+  recovery_ = std::move(rc);
+  stats_.recovering = true;
+  recovery_->scan_start = std::chrono::steady_clock::now();
+  recovery_->worker = std::thread([this] { recovery_worker(); });
+  return true;
+}
+
+void SsdStore::recovery_worker() {
+  auto &rc = *recovery_;
+  for (auto i = rc.ready; i < rc.runs.size() && !rc.stop; ++i) {
+    auto &run = rc.runs[i];
+    std::chrono::nanoseconds verify{0};
+    // A segment that cannot be opened contributes nothing, as a torn one
+    // contributes only its valid prefix.
+    scan_segment(run.slot, run.id, false, &run.entries, &verify);
+    std::sort(run.entries.begin(), run.entries.end(), by_key_seq<ScanEntry>);
+    rc.bytes_scanned += run.bytes;
+    {
+      std::lock_guard<std::mutex> lock(rc.mu);
+      rc.verify += verify;
+      rc.ready = i + 1;
+    }
+    rc.cv.notify_all();
+  }
+}
+
+void SsdStore::poll_recovery() {
+  if (!recovery_)
+    return;
+  std::size_t ready = 0;
+  {
+    std::lock_guard<std::mutex> lock(recovery_->mu);
+    ready = recovery_->ready;
+  }
+  stats_.recovery_segments_ready = ready;
+  stats_.recovery_bytes_scanned = recovery_->bytes_scanned;
+  if (ready == recovery_->runs.size())
+    finish_recovery();
+}
+
+// Merges every run into the index, skipping keys settled or written since
+// restart: the index already holds their current state.
+void SsdStore::finish_recovery() {
+  auto &rc = *recovery_;
+  rc.worker.join();
+  const auto scan_end = std::chrono::steady_clock::now();
+  std::vector<ScanEntry> scanned;
+  std::vector<std::size_t> bounds{0};
+  for (auto &run : rc.runs) {
+    scanned.insert(scanned.end(), run.entries.begin(), run.entries.end());
+    bounds.push_back(scanned.size());
+    run.entries = {};
+  }
+  merge_runs(&scanned, std::move(bounds));
+  replay(&scanned, &rc.settled);
+
+  using std::chrono::duration_cast;
+  using std::chrono::milliseconds;
+  const auto now = std::chrono::steady_clock::now();
+  stats_.recovery_scan_ms = static_cast<std::size_t>(
+      duration_cast<milliseconds>(scan_end - rc.scan_start).count());
+  stats_.recovery_verify_ms =
+      static_cast<std::size_t>(duration_cast<milliseconds>(rc.verify).count());
+  stats_.recovery_merge_ms = static_cast<std::size_t>(
+      duration_cast<milliseconds>(now - scan_end).count());
+  stats_.index_rebuild_ms = static_cast<std::size_t>(
+      duration_cast<milliseconds>(now - rc.start).count());
+  stats_.recovery_segments_ready = rc.runs.size();
+  stats_.recovery_bytes_scanned = stats_.recovery_bytes_total;
+  stats_.recovering = false;
+  recovery_.reset();
+  update_gauges();
+}
+
+void SsdStore::run_readers(std::size_t helpers,
+                           const std::function<void()> &job) {
+  if (!readers_) {
+    readers_ = std::make_unique<Readers>();
+    auto &rd = *readers_;
+    const auto n = std::max<std::size_t>(cfg_.read_threads, 1) - 1;
+    for (std::size_t t = 0; t < n; ++t)
+      rd.threads.emplace_back([&rd] {
+        std::uint64_t seen = 0;
+        std::unique_lock<std::mutex> lock(rd.mu);
+        while (true) {
+          rd.work_cv.wait(lock,
+                          [&] { return rd.stop || rd.generation != seen; });
+          if (rd.stop)
+            return;
+          seen = rd.generation;
+          if (rd.wanted == 0)
+            continue;
+          --rd.wanted;
+          const auto *j = rd.job;
+          lock.unlock();
+          (*j)();
+          lock.lock();
+          if (--rd.busy == 0)
+            rd.done_cv.notify_one();
+        }
+      });
+  }
+  auto &rd = *readers_;
+  helpers = std::min(helpers, rd.threads.size());
+  {
+    std::lock_guard<std::mutex> lock(rd.mu);
+    rd.job = &job;
+    rd.wanted = helpers;
+    rd.busy = helpers;
+    ++rd.generation;
+  }
+  if (helpers > 0)
+    rd.work_cv.notify_all();
+  job();
+  std::unique_lock<std::mutex> lock(rd.mu);
+  // Helpers that never woke for this batch are not waited for.
+  rd.busy -= rd.wanted;
+  rd.wanted = 0;
+  rd.done_cv.wait(lock, [&] { return rd.busy == 0; });
+  rd.job = nullptr;
+}
+
+void SsdStore::stop_readers() {
+  if (!readers_)
+    return;
+  {
+    std::lock_guard<std::mutex> lock(readers_->mu);
+    readers_->stop = true;
+  }
+  readers_->work_cv.notify_all();
+  for (auto &t : readers_->threads)
+    t.join();
+  readers_.reset();
+}
+
+void SsdStore::stop_recovery() {
+  if (!recovery_)
+    return;
+  recovery_->stop = true;
+  recovery_->worker.join();
+  recovery_.reset();
+  stats_.recovering = false;
+}
+
+// Decides `key` from the scanned runs, newest segment first, with the same
+// outcome as replay(). Puts are always written with a fresh seq, so the first
+// put found is the newest one; GC copies tombstones and meta records forward
+// with their original seq, so those found on the way only count if their seq
+// is higher. A key without a put is decided once every run is scanned. A live
+// put is installed in the index. Waits for further runs until `deadline`;
+// returns false if the key is still undecided then.
+bool SsdStore::settle(const std::string &key,
+                      std::chrono::steady_clock::time_point deadline) {
+  auto &rc = *recovery_;
+  const auto hash = fnv1a(key);
+  if (rc.settled.contains(hash))
+    return true;
+  std::size_t ready = 0;
+  {
+    std::lock_guard<std::mutex> lock(rc.mu);
+    ready = rc.ready;
+  }
+  const ScanEntry *put = nullptr;
+  const ScanEntry *meta = nullptr;
+  std::uint64_t tombstone_seq = 0;
+  bool waited = false;
+  std::size_t r = 0;
+  while (true) {
+    for (; r < ready && !put; ++r) {
+      const auto &entries = rc.runs[r].entries;
+      auto it = std::upper_bound(
+          entries.begin(), entries.end(), hash,
+          [](std::uint64_t h, const ScanEntry &e) { return h < e.key_hash; });
+      for (; it != entries.begin() && (it - 1)->key_hash == hash; --it) {
+        const auto &e = *(it - 1);
+        if (e.type == kRecordPut) {
+          put = &e;
+          break;
+        }
+        if (e.type == kRecordTombstone)
+          tombstone_seq = std::max(tombstone_seq, e.seq);
+        else if (e.type == kRecordMeta && (!meta || e.seq > meta->seq))
+          meta = &e;
+      }
+    }
+    if (put || ready == rc.runs.size())
+      break;
+    std::unique_lock<std::mutex> lock(rc.mu);
+    if (!rc.cv.wait_until(lock, deadline, [&] { return rc.ready > ready; })) {
+      ++stats_.recovery_unresolved;
+      return false;
+    }
+    ready = rc.ready;
+    waited = true;
+  }
+  if (waited)
+    ++stats_.recovery_waits;
+  rc.settled.insert(hash);
+  if (!put || tombstone_seq > put->seq)
+    return true;
+  const auto ttl =
+      meta && meta->seq > put->seq ? meta->ttl_epoch_ms : put->ttl_epoch_ms;
+  if (ttl >= 0 && ttl <= now_epoch_ms(Clock::now()))
+    return true;
+  const auto tag = SsdIndex::tag_for_hash(hash);
+  index_.insert(tag, put->loc, ttl);
+  segments_[loc_slot(put->loc)].live_bytes += put->record_bytes;
+  live_bytes_ += put->record_bytes;
+  if (ttl >= 0)
+    track_ttl(tag, ttl);
+  return true;
+}
+
+// Parses segment `id` (at `slot`) front to back through a large sequential
+// buffer. Only `repair_tail` truncates at the first bad record; sealed
+// segments are never modified here. Touches no member state, so it is safe to
+// run concurrently for different segments and alongside the serving thread.
+bool SsdStore::scan_segment(std::uint32_t slot, std::uint32_t id,
+                            bool repair_tail, std::vector<ScanEntry> *out,
+                            std::chrono::nanoseconds *verify_time) const {
   const std::string path = seg_path(id);
   int fd = pc_open(path.c_str(), PC_O_CREAT | PC_O_RDWR);
   if (fd < 0)
     return false;
-  std::int64_t off = 0;
-  while (true) {
-    RecordHeader h{};
-    ssize_t r = pc_pread(fd, &h, sizeof(h), off);
-    if (r == 0)
-      break;
-    if (r != static_cast<ssize_t>(sizeof(h)) || h.magic != kMagic) {
-      if (repair_tail)
-        pc_truncate(fd, off);
-      break;
+  const auto size_or_err = pc_seek(fd, 0, SEEK_END);
+  const auto file_size =
+      size_or_err < 0 ? 0 : static_cast<std::uint64_t>(size_or_err);
+  std::vector<std::uint8_t> buf;
+  std::uint64_t buf_off = 0; // file offset of buf[0]
+  std::uint64_t off = 0;     // next record
+  // Makes buf cover [off, off + need), sliding the window forward.
+  auto ensure = [&](std::size_t need) {
+    if (off + need <= buf_off + buf.size())
+      return true;
+    if (off + need > file_size)
+      return false;
+    buf.erase(buf.begin(), buf.begin() + static_cast<std::ptrdiff_t>(
+                                              off - buf_off));
+    buf_off = off;
+    const auto have = buf.size();
+    const auto want = std::min<std::uint64_t>(
+        std::max<std::size_t>(need, kScanChunkBytes), file_size - off);
+    buf.resize(static_cast<std::size_t>(want));
+    auto got = have;
+    while (got < buf.size()) {
+      const auto r = pc_pread(fd, buf.data() + got, buf.size() - got,
+                              static_cast<std::int64_t>(buf_off + got));
+      if (r <= 0)
+        break;
+      got += static_cast<std::size_t>(r);
     }
-    std::string key(h.key_len, '\0');
-    std::vector<std::uint8_t> value(h.value_len);
-    if (pc_pread(fd, key.data(), h.key_len,
-                 off + static_cast<std::int64_t>(sizeof(h))) !=
-        static_cast<ssize_t>(h.key_len)) {
-      if (repair_tail)
-        pc_truncate(fd, off);
-      break;
+    buf.resize(got);
+    return need <= buf.size();
+  };
+
+  std::string key;
+  while (off < file_size) {
+    RecordHeader h{};
+    bool ok = ensure(sizeof(h));
+    if (ok) {
+      std::memcpy(&h, buf.data() + (off - buf_off), sizeof(h));
+      ok = known_magic(h.magic) &&
+           ensure(sizeof(h) + std::size_t{h.key_len} + h.value_len);
     }
-    if (h.value_len > 0 &&
-        pc_pread(fd, value.data(), h.value_len,
-                 off + static_cast<std::int64_t>(sizeof(h) + h.key_len)) !=
-            static_cast<ssize_t>(h.value_len)) {
-      if (repair_tail)
-        pc_truncate(fd, off);
-      break;
+    if (ok) {
+      const auto *p = buf.data() + (off - buf_off) + sizeof(h);
+      const auto t0 = std::chrono::steady_clock::now();
+      ok = record_checksum(p, h.key_len, p + h.key_len, h.value_len, h) ==
+           h.checksum;
+      *verify_time += std::chrono::steady_clock::now() - t0;
+      key.assign(reinterpret_cast<const char *>(p), h.key_len);
     }
-    const auto sum = checksum32(key, value, h);
-    if (sum != h.checksum) {
+    if (!ok) {
       if (repair_tail)
-        pc_truncate(fd, off);
+        pc_truncate(fd, static_cast<std::int64_t>(off));
       break;
     }
-    IndexEntry e;
-    e.segment_id = id;
-    e.offset = static_cast<std::uint64_t>(off);
-    e.len = h.value_len;
-    e.seq = h.seq;
-    e.ttl_epoch_ms = h.ttl_epoch_ms;
-    e.tombstone = h.tombstone != 0;
-    auto it = index_.find(key);
-    if (it == index_.end() || it->second.seq <= e.seq)
-      index_[key] = e;
-    off += static_cast<std::int64_t>(sizeof(h) + h.key_len + h.value_len);
+    const auto bytes =
+        static_cast<std::uint32_t>(sizeof(h) + h.key_len + h.value_len);
+    const auto at = off;
+    off += bytes;
+    if (h.type == kRecordPad)
+      continue;
+    // Rehash the key rather than trusting header.key_hash so older writers
+    // that left it unset still land in the right index slot.
+    out->push_back({fnv1a(key), h.seq, pack_loc(slot, at, bytes),
+                    h.ttl_epoch_ms, bytes, h.type});
   }
+  if (direct_)
+    pc_drop_cache(fd);
   pc_close(fd);
-
-  live_bytes_ = 0;
-  for (const auto &[_, e] : index_)
-    if (!e.tombstone)
-      live_bytes_ += e.len;
   return true;
 }
 
-bool SsdStore::read_entry(const IndexEntry &e,
-                          std::vector<std::uint8_t> *value_out) {
-  refill_tokens();
-  if (!consume_read_budget(e.len + sizeof(RecordHeader)))
-    return false;
-  const std::string path = seg_path(e.segment_id);
-  int fd = pc_open(path.c_str(), PC_O_RDONLY);
+int SsdStore::read_fd(std::uint32_t slot) {
+  if (read_fds_.size() <= slot)
+    read_fds_.resize(slot + 1, -1);
+  if (read_fds_[slot] < 0)
+    read_fds_[slot] = pc_open(seg_path(segments_[slot].id).c_str(),
+                              PC_O_RDONLY | (direct_ ? PC_O_DIRECT : 0));
+  return read_fds_[slot];
+}
+
+void SsdStore::close_read_fd(std::uint32_t slot) {
+  if (slot >= read_fds_.size() || read_fds_[slot] < 0)
+    return;
+  pc_close(read_fds_[slot]);
+  read_fds_[slot] = -1;
+}
+
+bool SsdStore::read_at(std::uint32_t slot, std::uint64_t offset,
+                       std::size_t len, std::vector<std::uint8_t> *out) {
+  out->clear();
+  if (slot == active_slot_ && offset >= flushed_end_) {
+    // Still in the append buffer.
+    const auto rel = offset - flushed_end_;
+    if (rel >= append_buf_.size())
+      return false;
+    const auto n = std::min<std::size_t>(len, append_buf_.size() - rel);
+    out->assign(append_buf_.begin() + static_cast<std::ptrdiff_t>(rel),
+                append_buf_.begin() + static_cast<std::ptrdiff_t>(rel + n));
+    return true;
+  }
+  const int fd = read_fd(slot);
   if (fd < 0)
     return false;
-  RecordHeader h{};
-  if (pc_pread(fd, &h, sizeof(h), static_cast<std::int64_t>(e.offset)) !=
-      static_cast<ssize_t>(sizeof(h))) {
-    pc_close(fd);
+  const auto r = read_span(fd, direct_, offset, len, &read_bounce_, out);
+  if (r < 0)
     return false;
+  stats_.read_mb += static_cast<double>(r) / (1024.0 * 1024.0);
+  return true;
+}
+
+// Reads the record at `loc`. Key-only reads (used to confirm a tag match) are
+// not charged to the read budget; with want_value the whole record is fetched
+// in one read sized from the location's size code.
+bool SsdStore::read_record(std::uint64_t loc, bool want_value, Record *out) {
+  const auto slot = loc_slot(loc);
+  const auto offset = loc_offset(loc);
+  const std::size_t span = loc_span(loc);
+  const std::size_t first = want_value ? span : std::min(span, kKeyProbeBytes);
+  if (want_value) {
+    refill_tokens();
+    if (!consume_read_budget(first))
+      return false;
   }
-  std::string key(h.key_len, '\0');
-  if (pc_pread(fd, key.data(), h.key_len,
-               static_cast<std::int64_t>(e.offset + sizeof(h))) !=
-      static_cast<ssize_t>(h.key_len)) {
-    pc_close(fd);
+  std::vector<std::uint8_t> buf;
+  if (!read_at(slot, offset, first, &buf) || buf.size() < sizeof(RecordHeader))
+    return false;
+  RecordHeader h{};
+  std::memcpy(&h, buf.data(), sizeof(h));
+  if (!known_magic(h.magic))
     return false;
+  const std::size_t need =
+      sizeof(h) + h.key_len + (want_value ? h.value_len : 0);
+  if (buf.size() < need) {
+    std::vector<std::uint8_t> rest;
+    const auto have = buf.size();
+    if (!read_at(slot, offset + have, need - have, &rest) ||
+        rest.size() != need - have)
+      return false;
+    buf.insert(buf.end(), rest.begin(), rest.end());
   }
-  value_out->assign(h.value_len, 0);
-  if (h.value_len > 0 &&
-      pc_pread(fd, value_out->data(), h.value_len,
-               static_cast<std::int64_t>(e.offset + sizeof(h) + h.key_len)) !=
-          static_cast<ssize_t>(h.value_len)) {
-    pc_close(fd);
+  return decode_record(buf, want_value, want_value && should_verify_read(),
+                       out);
+}
+
+// Fills `out` from a buffer holding at least the header and key (and the
+// value when `want_value`), checking the checksum when `verify`.
+bool SsdStore::decode_record(const std::vector<std::uint8_t> &buf,
+                             bool want_value, bool verify, Record *out) {
+  if (buf.size() < sizeof(RecordHeader))
+    return false;
+  RecordHeader h{};
+  std::memcpy(&h, buf.data(), sizeof(h));
+  if (!known_magic(h.magic))
     return false;
+  if (buf.size() < sizeof(h) + h.key_len + (want_value ? h.value_len : 0))
+    return false;
+  out->header = h;
+  const auto *p = buf.data() + sizeof(h);
+  out->key.assign(reinterpret_cast<const char *>(p), h.key_len);
+  if (!want_value) {
+    out->value.clear();
+    return true;
   }
-  pc_close(fd);
-  stats_.read_mb +=
-      static_cast<double>(h.value_len + sizeof(h)) / (1024.0 * 1024.0);
+  out->value.assign(p + h.key_len, p + h.key_len + h.value_len);
+  if (verify) {
+    ++stats_.checksum_verifies;
+    if (checksum32(out->key, out->value, h) != h.checksum) {
+      ++stats_.checksum_failures;
+      out->value.clear();
+      return false;
+    }
+  }
+  return true;
+}
+
+bool SsdStore::should_verify_read() {
+  if (cfg_.verify_read_sample_rate >= 1.0)
+    return true;
+  if (cfg_.verify_read_sample_rate <= 0.0)
+    return false;
+  verify_credit_ += cfg_.verify_read_sample_rate;
+  if (verify_credit_ < 1.0)
+    return false;
+  verify_credit_ -= 1.0;
   return true;
 }
 
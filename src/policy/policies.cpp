@@ -9,6 +9,55 @@
 namespace pomai_cache {
 namespace {
 
+using EntryMap = std::unordered_map<std::string, Entry>;
+using EntryRef = const EntryMap::value_type *;
+
+struct ScoredRef {
+  double score;
+  EntryRef ref;
+};
+
+EntryRef entry_of(EntryRef r) { return r; }
+EntryRef entry_of(const ScoredRef &r) { return r.ref; }
+
+// Partially sorts `refs` by `less` and keeps the shortest prefix whose sizes
+// reach `bytes_to_free`, capped at `max_victims`.
+template <typename Ref, typename Less>
+std::vector<std::string> take_victims(std::vector<Ref> refs,
+                                      std::size_t bytes_to_free,
+                                      std::size_t max_victims, Less less) {
+  const auto n = std::min(max_victims, refs.size());
+  std::partial_sort(refs.begin(), refs.begin() + static_cast<long>(n),
+                    refs.end(), less);
+  std::vector<std::string> out;
+  std::size_t freed = 0;
+  for (std::size_t i = 0; i < n && freed < bytes_to_free; ++i) {
+    out.push_back(entry_of(refs[i])->first);
+    freed += entry_of(refs[i])->second.size_bytes;
+  }
+  return out;
+}
+
+std::vector<EntryRef> all_refs(const EntryMap &entries) {
+  std::vector<EntryRef> refs;
+  refs.reserve(entries.size());
+  for (const auto &kv : entries)
+    refs.push_back(&kv);
+  return refs;
+}
+
+bool lru_less(EntryRef a, EntryRef b) {
+  if (a->second.last_access == b->second.last_access)
+    return a->first < b->first;
+  return a->second.last_access < b->second.last_access;
+}
+
+bool lfu_less(EntryRef a, EntryRef b) {
+  if (a->second.hit_count == b->second.hit_count)
+    return lru_less(a, b);
+  return a->second.hit_count < b->second.hit_count;
+}
+
 class LruPolicy final : public IEvictionPolicy {
 public:
   std::string name() const override { return "lru"; }
@@ -22,13 +71,16 @@ public:
     if (entries.empty())
       return std::nullopt;
     auto it = std::min_element(
-        entries.begin(), entries.end(), [](const auto &a, const auto &b) {
-          if (a.second.last_access == b.second.last_access)
-            return a.first < b.first;
-          return a.second.last_access < b.second.last_access;
-        });
+        entries.begin(), entries.end(),
+        [](const auto &a, const auto &b) { return lru_less(&a, &b); });
     return it->first;
   }
+  std::vector<std::string> pick_victims(const EntryMap &entries, std::size_t,
+                                        std::size_t, std::size_t bytes_to_free,
+                                        std::size_t max_victims) override {
+    return take_victims(all_refs(entries), bytes_to_free, max_victims,
+                        lru_less);
+  }
   void set_params(const PolicyParams &params) override { params_ = params; }
   const PolicyParams &params() const override { return params_; }
 
@@ -49,16 +101,16 @@ public:
     if (entries.empty())
       return std::nullopt;
     auto it = std::min_element(
-        entries.begin(), entries.end(), [](const auto &a, const auto &b) {
-          if (a.second.hit_count == b.second.hit_count) {
-            if (a.second.last_access == b.second.last_access)
-              return a.first < b.first;
-            return a.second.last_access < b.second.last_access;
-          }
-          return a.second.hit_count < b.second.hit_count;
-        });
+        entries.begin(), entries.end(),
+        [](const auto &a, const auto &b) { return lfu_less(&a, &b); });
     return it->first;
   }
+  std::vector<std::string> pick_victims(const EntryMap &entries, std::size_t,
+                                        std::size_t, std::size_t bytes_to_free,
+                                        std::size_t max_victims) override {
+    return take_victims(all_refs(entries), bytes_to_free, max_victims,
+                        lfu_less);
+  }
   void set_params(const PolicyParams &params) override { params_ = params; }
   const PolicyParams &params() const override { return params_; }
 
@@ -113,6 +165,36 @@ public:
     return victim->first;
   }
 
+  std::vector<std::string> pick_victims(const EntryMap &entries,
+                                        std::size_t memory_used,
+                                        std::size_t memory_limit,
+                                        std::size_t bytes_to_free,
+                                        std::size_t max_victims) override {
+    refresh_window();
+    if (evictions_this_window_ >= params_.max_evictions_per_second)
+      return {};
+    if (memory_limit > 0 &&
+        memory_used <
+            static_cast<std::size_t>(static_cast<double>(memory_limit) *
+                                     params_.evict_pressure)) {
+      return {};
+    }
+    max_victims = std::min<std::size_t>(
+        max_victims, params_.max_evictions_per_second - evictions_this_window_);
+    std::vector<ScoredRef> scored;
+    scored.reserve(entries.size());
+    for (const auto &kv : entries)
+      scored.push_back({benefit(kv.first, kv.second, 1.0), &kv});
+    auto out = take_victims(std::move(scored), bytes_to_free, max_victims,
+                            [](const ScoredRef &a, const ScoredRef &b) {
+                              if (a.score == b.score)
+                                return a.ref->first < b.ref->first;
+                              return a.score < b.score;
+                            });
+    evictions_this_window_ += out.size();
+    return out;
+  }
+
   void set_params(const PolicyParams &params) override { params_ = params; }
   const PolicyParams &params() const override { return params_; }
 
@@ -1,29 +1,243 @@
 #include "pomai_cache/ai_cache.hpp"
 
+#include "pomai_cache/hash.hpp"
+#include "pomai_cache/json.hpp"
+
 #include <algorithm>
+#include <charconv>
 #include <chrono>
-#include <regex>
+#include <cmath>
+#include <cstring>
 #include <sstream>
 #include <tuple>
 
 namespace pomai_cache {
 namespace {
-std::optional<std::string> find_string(const std::string &json,
-                                       const std::string &key) {
-  std::regex re("\"" + key + "\"\\s*:\\s*\"([^\"]*)\"");
-  std::smatch m;
-  if (!std::regex_search(json, m, re))
-    return std::nullopt;
-  return m[1].str();
+struct StringField {
+  std::string_view name;
+  std::string ArtifactMeta::*member;
+};
+constexpr StringField kStringFields[] = {
+    {"artifact_type", &ArtifactMeta::artifact_type},
+    {"owner", &ArtifactMeta::owner},
+    {"schema_version", &ArtifactMeta::schema_version},
+    {"model_id", &ArtifactMeta::model_id},
+    {"tokenizer_id", &ArtifactMeta::tokenizer_id},
+    {"dataset_id", &ArtifactMeta::dataset_id},
+    {"snapshot_epoch", &ArtifactMeta::snapshot_epoch},
+    {"source_rev", &ArtifactMeta::source_rev},
+    {"source_id", &ArtifactMeta::source_id},
+    {"chunk_id", &ArtifactMeta::chunk_id},
+    {"content_hash", &ArtifactMeta::content_hash},
+};
+// Bits of kStringFields entries that must be present.
+constexpr unsigned kRequiredFields = 0x7;
+
+const std::string kBlobPrefix = "blob:";
+
+// vector_index_ key for responses; model ids never hold a newline, so it
+// cannot collide with an embedding model's own index.
+std::string response_scope(const std::string &model_id,
+                           const std::string &params_hash) {
+  return "rsp\n" + model_id + "\n" + params_hash;
 }
-std::optional<std::uint64_t> find_u64(const std::string &json,
-                                      const std::string &key) {
-  std::regex re("\"" + key + "\"\\s*:\\s*([0-9]+)");
-  std::smatch m;
-  if (!std::regex_search(json, m, re))
-    return std::nullopt;
-  return static_cast<std::uint64_t>(std::stoull(m[1].str()));
+
+// False if a float or float16 vector holds NaN or infinity; such an element
+// would poison the index's centroid sums for as long as its list exists.
+bool finite_vector(const std::vector<std::uint8_t> &v, VectorType type) {
+  const std::size_t width = vector_type_width(type);
+  for (std::size_t i = 0; i + width <= v.size(); i += width) {
+    if (type == VectorType::Float32) {
+      float f = 0;
+      std::memcpy(&f, v.data() + i, sizeof(f));
+      if (!std::isfinite(f))
+        return false;
+    } else if (type == VectorType::Float16) {
+      std::uint16_t h = 0;
+      std::memcpy(&h, v.data() + i, sizeof(h));
+      if ((h & 0x7C00) == 0x7C00)
+        return false;
+    }
+  }
+  return true;
+}
+
+// False if a float32 vector holds an element beyond float16's largest finite
+// value; narrowing would turn it into infinity, which finite_vector() cannot
+// see on the input.
+bool fits_float16(const std::vector<std::uint8_t> &v) {
+  constexpr float kFloat16Max = 65504.0f;
+  for (std::size_t i = 0; i + sizeof(float) <= v.size(); i += sizeof(float)) {
+    float f = 0;
+    std::memcpy(&f, v.data() + i, sizeof(f));
+    if (std::fabs(f) > kFloat16Max)
+      return false;
+  }
+  return true;
+}
+
+// The element type an index over `input` vectors holds under emb_store.
+VectorType index_type(VectorType input, VectorCodec store) {
+  if (input != VectorType::Float32)
+    return input;
+  if (store == VectorCodec::Float16)
+    return VectorType::Float16;
+  if (store == VectorCodec::Int8Scaled)
+    return VectorType::Int8;
+  return input;
+}
+
+// A float32 vector as `to`; other types pass through. Int8 keeps only the
+// codes, which is enough for cosine similarity.
+std::vector<std::uint8_t> narrow_vector(const std::vector<std::uint8_t> &v,
+                                        VectorType from, VectorType to) {
+  if (from != VectorType::Float32 || to == from)
+    return v;
+  const auto *f = reinterpret_cast<const float *>(v.data());
+  const std::size_t dim = v.size() / sizeof(float);
+  std::vector<std::uint8_t> out(dim * vector_type_width(to));
+  if (to == VectorType::Float16)
+    f32_to_f16(f, reinterpret_cast<std::uint16_t *>(out.data()), dim);
+  else
+    quantize_i8(f, reinterpret_cast<std::int8_t *>(out.data()), dim);
+  return out;
+}
+
+// A float32 vector in `codec`; only Float16 and Int8Scaled change it.
+std::vector<std::uint8_t> encode_embedding(const std::vector<std::uint8_t> &v,
+                                           VectorCodec codec) {
+  const auto *f = reinterpret_cast<const float *>(v.data());
+  const std::size_t dim = v.size() / sizeof(float);
+  if (codec == VectorCodec::Float16)
+    return narrow_vector(v, VectorType::Float32, VectorType::Float16);
+  if (codec != VectorCodec::Int8Scaled)
+    return v;
+  std::vector<std::uint8_t> out(sizeof(float) + dim);
+  const float scale = quantize_i8(
+      f, reinterpret_cast<std::int8_t *>(out.data() + sizeof(float)), dim);
+  std::memcpy(out.data(), &scale, sizeof(float));
+  return out;
+}
+
+// A stored embedding payload as dim float32 values.
+std::vector<float> decode_embedding(const std::vector<std::uint8_t> &p,
+                                    std::size_t dim, VectorCodec codec) {
+  std::vector<float> out(dim);
+  switch (codec) {
+  case VectorCodec::Float32:
+    std::memcpy(out.data(), p.data(), dim * sizeof(float));
+    break;
+  case VectorCodec::Float16:
+    f16_to_f32(reinterpret_cast<const std::uint16_t *>(p.data()), out.data(),
+               dim);
+    break;
+  case VectorCodec::Int8:
+    dequantize_i8(reinterpret_cast<const std::int8_t *>(p.data()), 1.0f,
+                  out.data(), dim);
+    break;
+  case VectorCodec::Int8Scaled: {
+    float scale = 0;
+    std::memcpy(&scale, p.data(), sizeof(float));
+    dequantize_i8(reinterpret_cast<const std::int8_t *>(p.data() + 4), scale,
+                  out.data(), dim);
+    break;
+  }
+  }
+  return out;
+}
+
+// "0.01=n,0.02=n,...,inf=n"
+std::string format_histogram(const DistanceHistogram &h) {
+  std::ostringstream os;
+  for (std::size_t i = 0; i < h.size(); ++i) {
+    if (i > 0)
+      os << ",";
+    if (i < kRspDistanceBounds.size())
+      os << kRspDistanceBounds[i];
+    else
+      os << "inf";
+    os << "=" << h[i];
+  }
+  return os.str();
+}
+
+// Fills tags from an object ("k=v") or array ("v") of scalars.
+bool parse_tags(std::string_view raw, std::vector<std::string> *tags) {
+  JsonReader r(raw);
+  std::string value;
+  std::string_view name;
+  tags->clear();
+  if (r.begin_object()) {
+    while (r.next_member(&name))
+      if (r.read_scalar(&value))
+        tags->push_back(std::string(name) + "=" + value);
+  } else if (r.begin_array()) {
+    while (r.next_element())
+      if (r.read_scalar(&value))
+        tags->push_back(value);
+  }
+  return r.ok();
+}
+
+// Rebuilds the "tags" member from its entries: an object when every entry
+// is "k=v", an array of strings otherwise.
+std::string tags_to_json(const std::vector<std::string> &tags) {
+  const bool object = std::all_of(tags.begin(), tags.end(), [](auto &t) {
+    return t.find('=') != std::string::npos;
+  });
+  std::string s(1, object ? '{' : '[');
+  for (const auto &t : tags) {
+    if (s.size() > 1)
+      s += ',';
+    if (object) {
+      const auto eq = t.find('=');
+      append_json_string(&s, std::string_view(t).substr(0, eq));
+      s += ':';
+      append_json_string(&s, std::string_view(t).substr(eq + 1));
+    } else {
+      append_json_string(&s, t);
+    }
+  }
+  s += object ? '}' : ']';
+  return s;
+}
+
+// Binary meta, little-endian: u8 version, u64 created_at_ms, u64 ttl_ms,
+// u64 size_bytes, f64 miss_cost, the kStringFields strings in table order,
+// then a u32 tag count and the tags. Strings are a u32 length and the bytes.
+constexpr std::uint8_t kMetaBinaryVersion = 1;
+
+template <typename T> void append_pod(std::string *out, T v) {
+  char b[sizeof(T)];
+  std::memcpy(b, &v, sizeof(T));
+  out->append(b, sizeof(T));
 }
+
+void append_bin_string(std::string *out, std::string_view v) {
+  append_pod(out, static_cast<std::uint32_t>(v.size()));
+  out->append(v);
+}
+
+struct BinReader {
+  std::string_view in;
+
+  template <typename T> bool pod(T *v) {
+    if (in.size() < sizeof(T))
+      return false;
+    std::memcpy(v, in.data(), sizeof(T));
+    in.remove_prefix(sizeof(T));
+    return true;
+  }
+  bool str(std::string *v) {
+    std::uint32_t n = 0;
+    if (!pod(&n) || in.size() < n)
+      return false;
+    v->assign(in.data(), n);
+    in.remove_prefix(n);
+    return true;
+  }
+};
+
 double default_miss_cost(const std::string &type) {
   if (type == "embedding")
     return 8.0;
@@ -66,7 +280,28 @@ std::string canonical_response_key(const std::string &prompt_hash,
   return "rsp:" + prompt_hash + ":" + params_hash + ":" + model_id;
 }
 
-AiArtifactCache::AiArtifactCache(Engine &engine) : engine_(engine) {
+std::size_t ArtifactValue::payload_size() const {
+  if (payload)
+    return payload->size();
+  std::size_t n = 0;
+  for (const auto &c : chunks)
+    n += c->size();
+  return n;
+}
+
+std::vector<std::uint8_t> ArtifactValue::payload_bytes() const {
+  if (payload)
+    return *payload;
+  std::vector<std::uint8_t> out;
+  out.reserve(payload_size());
+  for (const auto &c : chunks)
+    out.insert(out.end(), c->begin(), c->end());
+  return out;
+}
+
+AiArtifactCache::AiArtifactCache(Engine &engine, AiCacheConfig cfg)
+    : engine_(engine), cfg_(cfg),
+      chunk_params_(chunk_params_for(cfg.chunk_avg_bytes)) {
   owner_ttl_defaults_["rerank"] = 5 * 60 * 1000ULL;
   owner_ttl_defaults_["response"] = 60 * 60 * 1000ULL;
   owner_ttl_defaults_["prompt"] = 24 * 60 * 60 * 1000ULL;
@@ -74,68 +309,144 @@ AiArtifactCache::AiArtifactCache(Engine &engine) : engine_(engine) {
   owner_ttl_defaults_["rag"] = 6 * 60 * 60 * 1000ULL;
 }
 
+// One pass over the top-level object. Members of the wrong type are ignored,
+// as are unknown members.
 bool AiArtifactCache::parse_meta_json(const std::string &json,
                                       ArtifactMeta &out, std::string *err) {
-  auto type = find_string(json, "artifact_type");
-  auto owner = find_string(json, "owner");
-  auto schema = find_string(json, "schema_version");
-  if (!type || !owner || !schema) {
+  JsonReader r(json);
+  unsigned seen = 0;
+  std::string_view name;
+  std::uint64_t u = 0;
+  if (r.begin_object()) {
+    while (r.next_member(&name)) {
+      std::size_t i = 0;
+      while (i < std::size(kStringFields) && kStringFields[i].name != name)
+        ++i;
+      if (i < std::size(kStringFields)) {
+        if (r.read_string(&(out.*kStringFields[i].member)))
+          seen |= 1u << i;
+      } else if (name == "created_at") {
+        r.read_u64(&out.created_at_ms);
+      } else if (name == "ttl_deadline") {
+        r.read_u64(&out.ttl_ms);
+      } else if (name == "size_bytes") {
+        if (r.read_u64(&u))
+          out.size_bytes = static_cast<std::size_t>(u);
+      } else if (name == "miss_cost") {
+        r.read_double(&out.miss_cost);
+      } else if (name == "tags") {
+        std::string_view raw;
+        if (r.read_raw(&raw) && parse_tags(raw, &out.tags))
+          out.tags_json.assign(raw);
+      } else {
+        r.skip();
+      }
+    }
+  }
+  if (!r.at_end()) {
+    if (err)
+      *err = "meta_json malformed";
+    return false;
+  }
+  if ((seen & kRequiredFields) != kRequiredFields) {
     if (err)
       *err = "meta_json missing required fields";
     return false;
   }
-  out.artifact_type = *type;
-  out.owner = *owner;
-  out.schema_version = *schema;
-  if (auto v = find_string(json, "model_id"))
-    out.model_id = *v;
-  if (auto v = find_string(json, "tokenizer_id"))
-    out.tokenizer_id = *v;
-  if (auto v = find_string(json, "dataset_id"))
-    out.dataset_id = *v;
-  if (auto v = find_string(json, "snapshot_epoch"))
-    out.snapshot_epoch = *v;
-  if (auto v = find_string(json, "source_rev"))
-    out.source_rev = *v;
-  if (auto v = find_string(json, "source_id"))
-    out.source_id = *v;
-  if (auto v = find_string(json, "chunk_id"))
-    out.chunk_id = *v;
-  if (auto v = find_u64(json, "created_at"))
-    out.created_at_ms = *v;
-  if (auto v = find_u64(json, "ttl_deadline"))
-    out.ttl_ms = *v;
-  if (auto v = find_u64(json, "size_bytes"))
-    out.size_bytes = static_cast<std::size_t>(*v);
-  if (auto v = find_string(json, "content_hash"))
-    out.content_hash = *v;
-  if (auto v = find_u64(json, "miss_cost"))
-    out.miss_cost = static_cast<double>(*v);
   return true;
 }
 
-std::string AiArtifactCache::fast_hash_hex(const std::vector<std::uint8_t> &p) {
-  std::uint64_t h = 1469598103934665603ULL;
-  for (auto b : p) {
-    h ^= static_cast<std::uint64_t>(b);
-    h *= 1099511628211ULL;
+bool AiArtifactCache::parse_meta_binary(std::string_view bin,
+                                        ArtifactMeta &out, std::string *err) {
+  BinReader r{bin};
+  std::uint8_t version = 0;
+  std::uint64_t size = 0;
+  std::uint32_t ntags = 0;
+  bool ok = r.pod(&version) && version == kMetaBinaryVersion &&
+            r.pod(&out.created_at_ms) && r.pod(&out.ttl_ms) && r.pod(&size) &&
+            r.pod(&out.miss_cost);
+  for (const auto &f : kStringFields)
+    ok = ok && r.str(&(out.*f.member));
+  // Each tag takes at least its length prefix.
+  ok = ok && r.pod(&ntags) && ntags <= r.in.size() / sizeof(std::uint32_t);
+  out.tags.assign(ok ? ntags : 0, std::string());
+  for (auto &t : out.tags)
+    ok = ok && r.str(&t);
+  if (!ok || !r.in.empty()) {
+    if (err)
+      *err = "meta_bin malformed";
+    return false;
   }
-  std::ostringstream os;
-  os << std::hex << h;
-  return os.str();
+  out.size_bytes = static_cast<std::size_t>(size);
+  out.tags_json = tags_to_json(out.tags);
+  for (std::size_t i = 0; i < std::size(kStringFields); ++i) {
+    const bool required = (kRequiredFields >> i) & 1;
+    if (required && (out.*kStringFields[i].member).empty()) {
+      if (err)
+        *err = "meta_bin missing required fields";
+      return false;
+    }
+  }
+  return true;
+}
+
+std::string AiArtifactCache::meta_to_binary(const ArtifactMeta &m) {
+  std::string s;
+  s.reserve(64 + 4 * std::size(kStringFields) + m.tags_json.size());
+  s.push_back(static_cast<char>(kMetaBinaryVersion));
+  append_pod(&s, m.created_at_ms);
+  append_pod(&s, m.ttl_ms);
+  append_pod(&s, static_cast<std::uint64_t>(m.size_bytes));
+  append_pod(&s, m.miss_cost);
+  for (const auto &f : kStringFields)
+    append_bin_string(&s, m.*f.member);
+  append_pod(&s, static_cast<std::uint32_t>(m.tags.size()));
+  for (const auto &t : m.tags)
+    append_bin_string(&s, t);
+  return s;
+}
+
+// 32 hex digits of hash128. Older servers produced 16-digit FNV-1a hashes;
+// those still work as client-supplied content_hash values, and the lengths
+// keep the two blob key spaces apart.
+std::string AiArtifactCache::fast_hash_hex(const std::vector<std::uint8_t> &p) {
+  std::string hex(32, '0');
+  hash128_hex(hash128(p.data(), p.size()), hex.data());
+  return hex;
 }
 
 std::string AiArtifactCache::meta_to_json(const ArtifactMeta &m) {
-  std::ostringstream os;
-  os << "{\"artifact_type\":\"" << m.artifact_type << "\",\"owner\":\""
-     << m.owner << "\",\"schema_version\":\"" << m.schema_version
-     << "\",\"model_id\":\"" << m.model_id
-     << "\",\"created_at\":" << m.created_at_ms
-     << ",\"ttl_deadline\":" << m.ttl_ms << ",\"size_bytes\":" << m.size_bytes
-     << ",\"content_hash\":\"" << m.content_hash
-     << "\",\"tenant\":\"local\",\"snapshot_epoch\":\"" << m.snapshot_epoch
-     << "\",\"source_rev\":\"" << m.source_rev << "\"}";
-  return os.str();
+  std::string s;
+  s.reserve(256 + m.tags_json.size());
+  auto field = [&s](std::string_view name, std::string_view value) {
+    s += s.empty() ? "{\"" : ",\"";
+    s += name;
+    s += "\":";
+    append_json_string(&s, value);
+  };
+  auto number = [&s](std::string_view name, std::string_view value) {
+    s += ",\"";
+    s += name;
+    s += "\":";
+    s += value;
+  };
+  field("artifact_type", m.artifact_type);
+  field("owner", m.owner);
+  field("schema_version", m.schema_version);
+  field("model_id", m.model_id);
+  number("created_at", std::to_string(m.created_at_ms));
+  number("ttl_deadline", std::to_string(m.ttl_ms));
+  number("size_bytes", std::to_string(m.size_bytes));
+  field("content_hash", m.content_hash);
+  field("tenant", "local");
+  field("snapshot_epoch", m.snapshot_epoch);
+  field("source_rev", m.source_rev);
+  char cost[32];
+  const auto end = std::to_chars(cost, cost + sizeof(cost), m.miss_cost).ptr;
+  number("miss_cost", std::string_view(cost, end - cost));
+  number("tags", m.tags_json);
+  s += '}';
+  return s;
 }
 
 std::uint64_t AiArtifactCache::ttl_default_ms(const std::string &owner) const {
@@ -152,6 +463,24 @@ bool AiArtifactCache::put(const std::string &type, const std::string &key,
   ArtifactMeta meta;
   if (!parse_meta_json(meta_json, meta, err))
     return false;
+  return put(type, key, std::move(meta), payload, err);
+}
+
+bool AiArtifactCache::put_binary(const std::string &type,
+                                 const std::string &key,
+                                 std::string_view meta_bin,
+                                 const std::vector<std::uint8_t> &payload,
+                                 std::string *err) {
+  ArtifactMeta meta;
+  if (!parse_meta_binary(meta_bin, meta, err))
+    return false;
+  return put(type, key, std::move(meta), payload, err);
+}
+
+bool AiArtifactCache::put(const std::string &type, const std::string &key,
+                          ArtifactMeta meta,
+                          const std::vector<std::uint8_t> &payload,
+                          std::string *err) {
   if (meta.artifact_type != type) {
     if (err)
       *err = "artifact type mismatch";
@@ -171,154 +500,644 @@ bool AiArtifactCache::put(const std::string &type, const std::string &key,
   if (meta.miss_cost <= 0)
     meta.miss_cost = default_miss_cost(type);
 
-  const auto blob_key = "blob:" + meta.content_hash;
   std::optional<std::uint64_t> ttl_ms = meta.ttl_ms;
+  const bool chunked = cfg_.chunk_min_payload > 0 &&
+                       payload.size() >= cfg_.chunk_min_payload;
 
-  if (key_index_.contains(key)) {
-    auto prev = key_index_[key];
-    deindex_key(key, prev);
-    auto itb = blob_index_.find(prev.blob_hash);
-    if (itb != blob_index_.end() && itb->second.refcount > 0)
-      --itb->second.refcount;
-  }
-
+  // (hash, size) of each blob the payload is stored as, in order.
+  std::vector<std::pair<std::string, std::size_t>> parts;
   std::string set_err;
-  if (!engine_.set(blob_key, payload, ttl_ms, "vector", &set_err)) {
-    if (err)
-      *err = "blob put failed: " + set_err;
-    return false;
+  if (chunked) {
+    if (!store_chunks(payload, ttl_ms, &parts, &set_err)) {
+      if (err)
+        *err = "chunk put failed: " + set_err;
+      return false;
+    }
+  } else {
+    if (!engine_.set(kBlobPrefix + meta.content_hash, payload, ttl_ms,
+                     "vector", &set_err)) {
+      if (err)
+        *err = "blob put failed: " + set_err;
+      return false;
+    }
+    parts.emplace_back(meta.content_hash, payload.size());
   }
   std::vector<std::uint8_t> blob_ref(meta.content_hash.begin(),
                                      meta.content_hash.end());
   if (!engine_.set(key, blob_ref, ttl_ms, meta.owner, &set_err)) {
+    // Chunks no key references yet would only wait to be evicted.
+    for (const auto &[hash, size] : parts)
+      if (chunked && !blob_index_.contains(hash))
+        engine_.del({kBlobPrefix + hash});
     if (err)
       *err = "key put failed: " + set_err;
     return false;
   }
 
-  auto &bi = blob_index_[meta.content_hash];
-  if (bi.refcount > 0)
-    ++stats_.dedup_hits;
-  bi.refcount += 1;
-  bi.size_bytes = payload.size();
+  auto [kit, added] = key_index_.try_emplace(key);
+  auto &ki = kit->second;
+  if (added) {
+    if (free_ids_.empty()) {
+      ki.id = static_cast<std::uint32_t>(id_keys_.size());
+      id_keys_.push_back(key);
+    } else {
+      ki.id = free_ids_.back();
+      free_ids_.pop_back();
+      id_keys_[ki.id] = key;
+    }
+  }
+  // Take the new references before dropping the old ones, so re-putting a
+  // key with the same content never frees its blobs.
+  std::vector<BlobInfo *> refs;
+  refs.reserve(parts.size());
+  for (auto &[hash, size] : parts) {
+    auto [bit, fresh] = blob_index_.try_emplace(hash);
+    auto &bi = bit->second;
+    if (fresh)
+      bi.engine_key = kBlobPrefix + hash;
+    const bool own =
+        !added && (ki.blob == &bi || std::find(ki.chunks.begin(),
+                                               ki.chunks.end(),
+                                               &bi) != ki.chunks.end());
+    if (bi.refcount > (own ? 1u : 0u))
+      ++(chunked ? stats_.chunk_dedup_hits : stats_.dedup_hits);
+    bi.refcount += 1;
+    bi.size_bytes = size;
+    if (chunked && !bi.chunk) {
+      bi.chunk = true;
+      ++stats_.chunk_blobs;
+      stats_.chunk_stored_bytes += size;
+    }
+    refs.push_back(&bi);
+  }
+  if (!added) {
+    deindex_key(key, ki);
+    release_blobs(ki);
+    ki.vector_scope.clear();
+    ki.vector_dim = 0;
+  }
+  if (chunked) {
+    ki.blob = nullptr;
+    ki.chunks = std::move(refs);
+    ++stats_.chunked_puts;
+    stats_.chunk_logical_bytes += payload.size();
+  } else {
+    ki.blob = refs.front();
+    ki.chunks.clear();
+  }
 
-  auto &ki = key_index_[key];
-  ki.meta = meta;
-  ki.blob_hash = meta.content_hash;
+  ki.meta_json = std::make_shared<const std::string>(meta_to_json(meta));
+  ki.meta_bin = std::make_shared<const std::string>(meta_to_binary(meta));
   ki.explain = "admit:score>threshold owner=" + meta.owner +
                " type=" + meta.artifact_type;
-  index_key(key, meta);
+  index_key(key, ki, meta);
 
   ++stats_.puts;
   stats_.dedup_blobs = blob_index_.size();
   return true;
 }
 
-std::optional<ArtifactValue> AiArtifactCache::get(const std::string &key) {
+bool AiArtifactCache::check_vector(const std::string &scope, std::size_t dim,
+                                   VectorType type,
+                                   const std::vector<std::uint8_t> &vec,
+                                   std::string *err) const {
+  if (dim == 0 || vec.size() != dim * vector_type_width(type)) {
+    if (err)
+      *err = "vector size does not match dim and dtype";
+    return false;
+  }
+  if (!finite_vector(vec, type)) {
+    if (err)
+      *err = "vector holds NaN or infinite elements";
+    return false;
+  }
+  if (type == VectorType::Float32 &&
+      index_type(type, cfg_.emb_store) == VectorType::Float16 &&
+      !fits_float16(vec)) {
+    if (err)
+      *err = "vector holds elements beyond the float16 range";
+    return false;
+  }
+  auto it = vector_index_.find(scope);
+  if (it != vector_index_.end() &&
+      (it->second.index.dim() != dim || it->second.input != type)) {
+    if (err)
+      *err = "index holds " + std::to_string(it->second.index.dim()) +
+             "-dim " + vector_type_name(it->second.input) + " vectors";
+    return false;
+  }
+  return true;
+}
+
+// Called after put(), which may have dropped the scope's index along with
+// the key's old vector.
+void AiArtifactCache::add_vector(const std::string &key,
+                                 const std::string &scope, std::size_t dim,
+                                 VectorType type,
+                                 const std::vector<std::uint8_t> &vec) {
+  auto &ki = key_index_.at(key);
+  const auto stored = index_type(type, cfg_.emb_store);
+  auto it = vector_index_.find(scope);
+  if (it == vector_index_.end())
+    it = vector_index_
+             .emplace(scope, VectorScope{type, VectorIndex(dim, stored,
+                                                           cfg_.vector_index)})
+             .first;
+  it->second.index.add(ki.id, narrow_vector(vec, type, stored).data());
+  ki.vector_scope = scope;
+}
+
+bool AiArtifactCache::search_scope(const std::string &scope,
+                                   const std::vector<std::uint8_t> &query,
+                                   std::size_t k,
+                                   std::vector<EmbeddingHit> *out,
+                                   std::string *err) {
+  out->clear();
+  auto it = vector_index_.find(scope);
+  if (it == vector_index_.end())
+    return true;
+  const auto &vs = it->second;
+  if (query.size() != vs.index.dim() * vector_type_width(vs.input)) {
+    if (err)
+      *err = "query size does not match the index's dim and dtype";
+    return false;
+  }
+  if (!finite_vector(query, vs.input)) {
+    if (err)
+      *err = "query holds NaN or infinite elements";
+    return false;
+  }
+  if (vs.input == VectorType::Float32 &&
+      vs.index.type() == VectorType::Float16 && !fits_float16(query)) {
+    if (err)
+      *err = "query holds elements beyond the float16 range";
+    return false;
+  }
+  const auto q = narrow_vector(query, vs.input, vs.index.type());
+  auto live = [this](const KeyInfo &ki, const std::string &key) {
+    if (!engine_.contains(key))
+      return false;
+    const auto blobs = blob_keys(ki);
+    return std::all_of(blobs.begin(), blobs.end(), [this](const auto &b) {
+      return engine_.contains(b);
+    });
+  };
+  // The engine evicts without telling this cache; candidates it has dropped
+  // are invalidated as they turn up and the search is run again.
+  while (it != vector_index_.end()) {
+    bool reaped = false;
+    for (const auto &[id, score] : it->second.index.search(q.data(), k)) {
+      const auto key = id_keys_[id];
+      if (live(key_index_.at(key), key)) {
+        out->push_back({key, score});
+        continue;
+      }
+      invalidate_key(key);
+      ++stats_.vector_reaped;
+      reaped = true;
+    }
+    if (!reaped)
+      break;
+    out->clear();
+    it = vector_index_.find(scope);
+  }
+  return true;
+}
+
+bool AiArtifactCache::put_embedding(const std::string &key,
+                                    const std::string &model_id,
+                                    std::size_t dim, VectorType type,
+                                    std::uint64_t ttl_ms,
+                                    const std::vector<std::uint8_t> &vec,
+                                    std::string *err) {
+  if (model_id.empty()) {
+    if (err)
+      *err = "model_id required";
+    return false;
+  }
+  if (!check_vector(model_id, dim, type, vec, err))
+    return false;
+  ArtifactMeta meta;
+  meta.artifact_type = "embedding";
+  meta.owner = "vector";
+  meta.model_id = model_id;
+  meta.ttl_ms = ttl_ms;
+  const auto codec = type == VectorType::Float32 ? cfg_.emb_store
+                     : type == VectorType::Float16 ? VectorCodec::Float16
+                                                   : VectorCodec::Int8;
+  const auto stored = encode_embedding(vec, codec);
+  if (!put("embedding", key, std::move(meta), stored, err))
+    return false;
+  stats_.emb_bytes_in += vec.size();
+  stats_.emb_bytes_stored += stored.size();
+  add_vector(key, model_id, dim, type, vec);
+  auto &ki = key_index_.at(key);
+  ki.vector_dim = static_cast<std::uint32_t>(dim);
+  ki.vector_codec = codec;
+  return true;
+}
+
+bool AiArtifactCache::get_embedding(const std::string &key, VectorType as,
+                                    std::optional<ArtifactValue> *out,
+                                    std::string *err) {
+  out->reset();
+  if (as == VectorType::Int8) {
+    if (err)
+      *err = "embeddings convert to float or float16 only";
+    return false;
+  }
+  auto it = key_index_.find(key);
+  if (it != key_index_.end() && it->second.vector_dim == 0) {
+    if (err)
+      *err = "not an AI.EMB.PUT embedding";
+    return false;
+  }
+  const std::size_t dim = it == key_index_.end() ? 0 : it->second.vector_dim;
+  const auto codec =
+      it == key_index_.end() ? VectorCodec::Float32 : it->second.vector_codec;
+  auto v = get(key);
+  if (!v)
+    return true;
+  const auto want = as == VectorType::Float16 ? VectorCodec::Float16
+                                              : VectorCodec::Float32;
+  if (codec != want) {
+    std::vector<std::uint8_t> joined;
+    const auto *p = v->payload.get();
+    if (!p) {
+      joined = v->payload_bytes();
+      p = &joined;
+    }
+    const auto f = decode_embedding(*p, dim, codec);
+    std::vector<std::uint8_t> bytes(f.size() * sizeof(float));
+    std::memcpy(bytes.data(), f.data(), bytes.size());
+    v->payload = std::make_shared<const std::vector<std::uint8_t>>(
+        narrow_vector(bytes, VectorType::Float32, as));
+    v->chunks.clear();
+    ++stats_.emb_conversions;
+  }
+  *out = std::move(v);
+  return true;
+}
+
+bool AiArtifactCache::search_embeddings(const std::string &model_id,
+                                        const std::vector<std::uint8_t> &query,
+                                        std::size_t k,
+                                        std::vector<EmbeddingHit> *out,
+                                        std::string *err) {
+  ++stats_.vector_searches;
+  return search_scope(model_id, query, k, out, err);
+}
+
+bool AiArtifactCache::put_response(const std::string &model_id,
+                                   const std::string &params_hash,
+                                   const std::string &prompt_hash,
+                                   std::size_t dim, VectorType type,
+                                   std::uint64_t ttl_ms,
+                                   const std::vector<std::uint8_t> &prompt_vec,
+                                   const std::vector<std::uint8_t> &response,
+                                   std::string *err) {
+  if (model_id.empty() || prompt_hash.empty()) {
+    if (err)
+      *err = "model_id and prompt_hash required";
+    return false;
+  }
+  const auto scope = response_scope(model_id, params_hash);
+  if (!check_vector(scope, dim, type, prompt_vec, err))
+    return false;
+  const auto key = canonical_response_key(prompt_hash, params_hash, model_id);
+  ArtifactMeta meta;
+  meta.artifact_type = "response";
+  meta.owner = "response";
+  meta.model_id = model_id;
+  meta.ttl_ms = ttl_ms;
+  if (!put("response", key, std::move(meta), response, err))
+    return false;
+  add_vector(key, scope, dim, type, prompt_vec);
+  return true;
+}
+
+bool AiArtifactCache::lookup_response(const std::string &model_id,
+                                      const std::string &params_hash,
+                                      const std::vector<std::uint8_t> &query,
+                                      float max_distance,
+                                      std::optional<ResponseMatch> *out,
+                                      std::string *err) {
+  out->reset();
+  std::vector<EmbeddingHit> nearest;
+  std::optional<ArtifactValue> v;
+  float distance = 0;
+  while (true) {
+    if (!search_scope(response_scope(model_id, params_hash), query, 1,
+                      &nearest, err))
+      return false;
+    if (nearest.empty())
+      break;
+    distance = std::max(0.0f, 1.0f - nearest[0].score);
+    if (distance > max_distance || (v = get(nearest[0].key)))
+      break;
+    // Lost since search_scope() saw it live (an SSD read failed or it just
+    // expired): reap it the same way and look again, so the lookup is
+    // judged by the nearest response that can still be served.
+    invalidate_key(nearest[0].key);
+    ++stats_.vector_reaped;
+  }
+  ++stats_.rsp_lookups;
+  if (nearest.empty()) {
+    ++stats_.rsp_misses;
+    return true;
+  }
+  const auto bucket = static_cast<std::size_t>(
+      std::lower_bound(kRspDistanceBounds.begin(), kRspDistanceBounds.end(),
+                       distance) -
+      kRspDistanceBounds.begin());
+  if (v) {
+    ++stats_.rsp_hits;
+    ++stats_.rsp_hit_distance[bucket];
+    *out = ResponseMatch{nearest[0].key, distance, std::move(*v)};
+  } else if (distance <= 2 * max_distance) {
+    ++stats_.rsp_near_misses;
+    ++stats_.rsp_near_miss_distance[bucket];
+  } else {
+    ++stats_.rsp_misses;
+    ++stats_.rsp_miss_distance[bucket];
+  }
+  return true;
+}
+
+std::optional<ArtifactValue> AiArtifactCache::get(const std::string &key,
+                                                  MetaEncoding enc) {
   ++stats_.gets;
   auto it = key_index_.find(key);
   if (it == key_index_.end()) {
     ++stats_.misses;
     return std::nullopt;
   }
-  auto ref = engine_.get(key);
-  if (!ref.has_value()) {
-    ++stats_.misses;
-    return std::nullopt;
+  // The ref entry's value is the content hash, already known here: it is
+  // only touched so the policy sees the access.
+  auto &ki = it->second;
+  ValueRef blob;
+  std::vector<ValueRef> chunks;
+  bool ok = engine_.touch(key);
+  if (ok && ki.blob) {
+    ok = (blob = engine_.get_ref(ki.blob->engine_key)) != nullptr;
+  } else if (ok) {
+    chunks = engine_.mget_ref(blob_keys(ki));
+    ok = std::all_of(chunks.begin(), chunks.end(),
+                     [](const ValueRef &c) { return c != nullptr; });
   }
-  auto blob = engine_.get("blob:" + it->second.blob_hash);
-  if (!blob.has_value()) {
+  if (!ok) {
     ++stats_.misses;
     return std::nullopt;
   }
   ++stats_.hits;
-  ++it->second.hits;
-  return ArtifactValue{it->second.meta, *blob};
+  ++ki.hits;
+  return ArtifactValue{std::move(blob), std::move(chunks),
+                       enc == MetaEncoding::Json ? ki.meta_json : ki.meta_bin};
 }
 
 std::vector<std::optional<ArtifactValue>>
-AiArtifactCache::mget(const std::vector<std::string> &keys) {
-  std::vector<std::optional<ArtifactValue>> out;
-  out.reserve(keys.size());
-  for (const auto &k : keys)
-    out.push_back(get(k));
+AiArtifactCache::mget(const std::vector<std::string> &keys,
+                      MetaEncoding enc) {
+  std::vector<std::optional<ArtifactValue>> out(keys.size());
+  // Refs are touched one by one; every blob and chunk goes to the engine as
+  // one batch so SSD-resident payloads are read together. Key i owns
+  // blobs [first[i], first[i + 1]).
+  std::vector<KeyInfo *> infos(keys.size(), nullptr);
+  std::vector<std::size_t> first(keys.size() + 1, 0);
+  std::vector<std::string> batch;
+  for (std::size_t i = 0; i < keys.size(); ++i) {
+    ++stats_.gets;
+    first[i] = batch.size();
+    auto it = key_index_.find(keys[i]);
+    if (it == key_index_.end() || !engine_.touch(keys[i])) {
+      ++stats_.misses;
+      continue;
+    }
+    infos[i] = &it->second;
+    for (auto &k : blob_keys(it->second))
+      batch.push_back(std::move(k));
+  }
+  first[keys.size()] = batch.size();
+  auto blobs = engine_.mget_ref(batch);
+  for (std::size_t i = 0; i < keys.size(); ++i) {
+    if (!infos[i])
+      continue;
+    const auto b = blobs.begin() + static_cast<std::ptrdiff_t>(first[i]);
+    const auto e = blobs.begin() + static_cast<std::ptrdiff_t>(first[i + 1]);
+    if (std::any_of(b, e, [](const ValueRef &c) { return c == nullptr; })) {
+      ++stats_.misses;
+      continue;
+    }
+    auto &ki = *infos[i];
+    ++stats_.hits;
+    ++ki.hits;
+    ArtifactValue v{nullptr, {},
+                    enc == MetaEncoding::Json ? ki.meta_json : ki.meta_bin};
+    if (ki.blob)
+      v.payload = std::move(*b);
+    else
+      v.chunks.assign(std::make_move_iterator(b), std::make_move_iterator(e));
+    out[i] = std::move(v);
+  }
   return out;
 }
 
-void AiArtifactCache::index_key(const std::string &key,
+// Engine keys of the blobs holding ki's payload, in payload order.
+std::vector<std::string> AiArtifactCache::blob_keys(const KeyInfo &ki) const {
+  if (ki.blob)
+    return {ki.blob->engine_key};
+  std::vector<std::string> keys;
+  keys.reserve(ki.chunks.size());
+  for (const auto *c : ki.chunks)
+    keys.push_back(c->engine_key);
+  return keys;
+}
+
+// Splits `payload` at content-defined cut points and writes every chunk as
+// blob:<hash128>. Chunks already present are rewritten, which refreshes
+// their TTL like a whole-blob put does.
+bool AiArtifactCache::store_chunks(
+    const std::vector<std::uint8_t> &payload,
+    std::optional<std::uint64_t> ttl_ms,
+    std::vector<std::pair<std::string, std::size_t>> *parts,
+    std::string *err) {
+  const auto t0 = std::chrono::steady_clock::now();
+  const auto ends = cdc_chunk_ends(payload.data(), payload.size(),
+                                   chunk_params_);
+  parts->reserve(ends.size());
+  std::size_t off = 0;
+  for (const auto end : ends) {
+    std::string hex(32, '0');
+    hash128_hex(hash128(payload.data() + off, end - off), hex.data());
+    parts->emplace_back(std::move(hex), end - off);
+    off = end;
+  }
+  stats_.chunking_ns += static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - t0)
+          .count());
+  stats_.chunked_bytes += payload.size();
+
+  off = 0;
+  for (std::size_t i = 0; i < parts->size(); ++i) {
+    const auto &[hash, size] = (*parts)[i];
+    const auto begin = payload.begin() + static_cast<std::ptrdiff_t>(off);
+    const std::vector<std::uint8_t> chunk(
+        begin, begin + static_cast<std::ptrdiff_t>(size));
+    off += size;
+    if (!engine_.set(kBlobPrefix + hash, chunk, ttl_ms, "vector", err)) {
+      for (std::size_t j = 0; j < i; ++j)
+        if (!blob_index_.contains((*parts)[j].first))
+          engine_.del({kBlobPrefix + (*parts)[j].first});
+      return false;
+    }
+  }
+  return true;
+}
+
+// ki's metadata, decoded from the binary form it was stored in.
+ArtifactMeta AiArtifactCache::decode_meta(const KeyInfo &ki) {
+  ArtifactMeta meta;
+  if (ki.meta_bin)
+    parse_meta_binary(*ki.meta_bin, meta);
+  return meta;
+}
+
+void AiArtifactCache::index_key(const std::string &key, const KeyInfo &ki,
                                 const ArtifactMeta &meta) {
   if (!meta.snapshot_epoch.empty())
-    epoch_index_[meta.snapshot_epoch].insert(key);
+    epoch_index_[meta.snapshot_epoch].add(ki.id);
   if (!meta.model_id.empty())
-    model_index_[meta.model_id].insert(key);
-  for (std::size_t i = 1; i <= key.size() && i <= 32; ++i) {
-    auto prefix = key.substr(0, i);
-    auto &bucket = prefix_index_[prefix];
-    if (bucket.size() < prefix_index_cap_)
-      bucket.insert(key);
-  }
+    model_index_[meta.model_id].add(ki.id);
+  for (const auto &tag : meta.tags)
+    tag_index_[tag].add(ki.id);
+  key_tree_.insert(key);
 }
 
 void AiArtifactCache::deindex_key(const std::string &key, const KeyInfo &ki) {
-  if (!ki.meta.snapshot_epoch.empty() &&
-      epoch_index_.contains(ki.meta.snapshot_epoch))
-    epoch_index_[ki.meta.snapshot_epoch].erase(key);
-  if (!ki.meta.model_id.empty() && model_index_.contains(ki.meta.model_id))
-    model_index_[ki.meta.model_id].erase(key);
-  for (std::size_t i = 1; i <= key.size() && i <= 32; ++i) {
-    auto prefix = key.substr(0, i);
-    if (prefix_index_.contains(prefix))
-      prefix_index_[prefix].erase(key);
-  }
+  auto drop = [&ki](std::unordered_map<std::string, RoaringBitmap> &index,
+                    const std::string &value) {
+    auto it = index.find(value);
+    if (it != index.end() && it->second.remove(ki.id) && it->second.empty())
+      index.erase(it);
+  };
+  const auto meta = decode_meta(ki);
+  drop(epoch_index_, meta.snapshot_epoch);
+  drop(model_index_, meta.model_id);
+  for (const auto &tag : meta.tags)
+    drop(tag_index_, tag);
+  auto vit = vector_index_.find(ki.vector_scope);
+  if (vit != vector_index_.end() && vit->second.index.remove(ki.id) &&
+      vit->second.index.size() == 0)
+    vector_index_.erase(vit);
+  key_tree_.erase(key);
 }
 
-std::size_t
-AiArtifactCache::invalidate_keys(const std::unordered_set<std::string> &keys) {
-  std::size_t removed = 0;
-  for (const auto &k : keys) {
-    auto it = key_index_.find(k);
-    if (it == key_index_.end())
-      continue;
-    auto old = it->second;
-    deindex_key(k, old);
-    auto bit = blob_index_.find(old.blob_hash);
-    if (bit != blob_index_.end() && bit->second.refcount > 0) {
-      --bit->second.refcount;
-      if (bit->second.refcount == 0) {
-        engine_.del({"blob:" + old.blob_hash});
-        blob_index_.erase(bit);
-      }
+// Drops ki's references to its blobs, deleting each with its last one.
+void AiArtifactCache::release_blobs(const KeyInfo &ki) {
+  auto release = [this](BlobInfo *bi) {
+    if (bi->refcount == 0 || --bi->refcount > 0)
+      return;
+    if (bi->chunk) {
+      --stats_.chunk_blobs;
+      stats_.chunk_stored_bytes -= bi->size_bytes;
     }
-    engine_.del({k});
-    key_index_.erase(it);
-    ++removed;
+    engine_.del({bi->engine_key});
+    blob_index_.erase(bi->engine_key.substr(kBlobPrefix.size()));
+  };
+  if (ki.blob) {
+    release(ki.blob);
+    return;
   }
+  for (auto *c : ki.chunks) {
+    stats_.chunk_logical_bytes -= c->size_bytes;
+    release(c);
+  }
+}
+
+bool AiArtifactCache::invalidate_key(const std::string &key) {
+  auto it = key_index_.find(key);
+  if (it == key_index_.end())
+    return false;
+  deindex_key(key, it->second);
+  release_blobs(it->second);
+  engine_.del({key});
+  const auto id = it->second.id;
+  key_index_.erase(it);
+  id_keys_[id].clear();
+  free_ids_.push_back(id);
   stats_.dedup_blobs = blob_index_.size();
+  return true;
+}
+
+std::size_t AiArtifactCache::invalidate_ids(const RoaringBitmap &ids) {
+  std::size_t removed = 0;
+  ids.for_each([&](std::uint32_t id) {
+    const auto key = std::move(id_keys_[id]);
+    removed += invalidate_key(key);
+  });
   return removed;
 }
 
+// The epoch's bitmap is detached from the index rather than copied.
 std::size_t AiArtifactCache::invalidate_epoch(const std::string &epoch) {
-  if (!epoch_index_.contains(epoch))
-    return 0;
-  auto keys = epoch_index_[epoch];
-  epoch_index_.erase(epoch);
-  return invalidate_keys(keys);
+  auto node = epoch_index_.extract(epoch);
+  return node.empty() ? 0 : invalidate_ids(node.mapped());
 }
 
 std::size_t AiArtifactCache::invalidate_model(const std::string &model_id) {
-  if (!model_index_.contains(model_id))
-    return 0;
-  auto keys = model_index_[model_id];
-  model_index_.erase(model_id);
-  return invalidate_keys(keys);
+  auto node = model_index_.extract(model_id);
+  return node.empty() ? 0 : invalidate_ids(node.mapped());
 }
 
+RoaringBitmap
+AiArtifactCache::match_tags(const std::vector<TagTerm> &expr) const {
+  RoaringBitmap out;
+  for (std::size_t i = 0; i < expr.size(); ++i) {
+    auto it = tag_index_.find(expr[i].tag);
+    if (i == 0) {
+      if (it != tag_index_.end())
+        out = it->second;
+    } else if (expr[i].op == TagOp::And) {
+      if (it == tag_index_.end())
+        out.clear();
+      else
+        out.intersect_with(it->second);
+    } else if (it != tag_index_.end()) {
+      out.union_with(it->second);
+    }
+  }
+  return out;
+}
+
+std::size_t AiArtifactCache::invalidate_tags(const std::vector<TagTerm> &expr) {
+  return invalidate_ids(match_tags(expr));
+}
+
+std::vector<std::string>
+AiArtifactCache::query_tags(const std::vector<TagTerm> &expr,
+                            std::size_t limit) const {
+  std::vector<std::string> out;
+  match_tags(expr).for_each([&](std::uint32_t id) {
+    if (out.size() < limit)
+      out.push_back(id_keys_[id]);
+  });
+  return out;
+}
+
+// The prefix's subtree is cut out of key_tree_ in one step; its keys are
+// then dropped from the other indexes one by one.
 std::size_t AiArtifactCache::invalidate_prefix(const std::string &prefix) {
-  if (!prefix_index_.contains(prefix))
-    return 0;
-  auto keys = prefix_index_[prefix];
-  prefix_index_.erase(prefix);
-  return invalidate_keys(keys);
+  std::size_t removed = 0;
+  for (const auto &k : key_tree_.erase_prefix(prefix))
+    removed += invalidate_key(k);
+  return removed;
+}
+
+std::vector<std::string> AiArtifactCache::scan(const std::string &prefix,
+                                               const std::string &after,
+                                               std::size_t count) const {
+  return key_tree_.scan(prefix, after, count);
 }
 
 std::string AiArtifactCache::stats() const {
@@ -329,10 +1148,59 @@ std::string AiArtifactCache::stats() const {
   os << "misses:" << stats_.misses << "\n";
   os << "dedup_hits:" << stats_.dedup_hits << "\n";
   os << "blob_count:" << blob_index_.size() << "\n";
+  os << "key_tree_nodes:" << key_tree_.node_count() << "\n";
+  std::size_t tag_bytes = 0;
+  for (const auto &[tag, ids] : tag_index_)
+    tag_bytes += ids.memory_bytes();
+  os << "tag_count:" << tag_index_.size() << "\n";
+  os << "tag_index_bytes:" << tag_bytes << "\n";
+  std::size_t vectors = 0, lists = 0;
+  for (const auto &[scope, vs] : vector_index_) {
+    vectors += vs.index.size();
+    lists += vs.index.list_count();
+  }
+  os << "vector_kernel_impl:" << vector_kernel_impl_name() << "\n";
+  os << "vector_indexes:" << vector_index_.size() << "\n";
+  os << "vector_count:" << vectors << "\n";
+  os << "vector_lists:" << lists << "\n";
+  os << "vector_searches:" << stats_.vector_searches << "\n";
+  os << "vector_reaped:" << stats_.vector_reaped << "\n";
+  os << "emb_store:" << vector_codec_name(cfg_.emb_store) << "\n";
+  os << "emb_bytes_in:" << stats_.emb_bytes_in << "\n";
+  os << "emb_bytes_stored:" << stats_.emb_bytes_stored << "\n";
+  os << "emb_conversions:" << stats_.emb_conversions << "\n";
+  os << "rsp_lookups:" << stats_.rsp_lookups << "\n";
+  os << "rsp_hits:" << stats_.rsp_hits << "\n";
+  os << "rsp_near_misses:" << stats_.rsp_near_misses << "\n";
+  os << "rsp_misses:" << stats_.rsp_misses << "\n";
+  os << "rsp_hit_distance:" << format_histogram(stats_.rsp_hit_distance)
+     << "\n";
+  os << "rsp_near_miss_distance:"
+     << format_histogram(stats_.rsp_near_miss_distance) << "\n";
+  os << "rsp_miss_distance:" << format_histogram(stats_.rsp_miss_distance)
+     << "\n";
+  os << "content_hash_impl:" << hash128_impl_name() << "\n";
+  os << "chunked_puts:" << stats_.chunked_puts << "\n";
+  os << "chunk_dedup_hits:" << stats_.chunk_dedup_hits << "\n";
+  os << "chunk_count:" << stats_.chunk_blobs << "\n";
+  os << "chunk_logical_bytes:" << stats_.chunk_logical_bytes << "\n";
+  os << "chunk_stored_bytes:" << stats_.chunk_stored_bytes << "\n";
+  os << "chunk_dedup_ratio:"
+     << (stats_.chunk_stored_bytes == 0
+             ? 0.0
+             : static_cast<double>(stats_.chunk_logical_bytes) /
+                   static_cast<double>(stats_.chunk_stored_bytes))
+     << "\n";
+  os << "chunking_ns_per_kb:"
+     << (stats_.chunked_bytes == 0
+             ? 0.0
+             : static_cast<double>(stats_.chunking_ns) * 1024.0 /
+                   static_cast<double>(stats_.chunked_bytes))
+     << "\n";
   std::vector<std::tuple<std::string, std::uint64_t, std::uint64_t>> by_type;
   std::unordered_map<std::string, std::uint64_t> cnt;
   for (const auto &[k, v] : key_index_)
-    cnt[v.meta.artifact_type]++;
+    cnt[decode_meta(v).artifact_type]++;
   for (const auto &[k, v] : cnt)
     by_type.emplace_back(k, v, 0);
   std::sort(by_type.begin(), by_type.end());
@@ -361,7 +1229,7 @@ std::string AiArtifactCache::top_costly(std::size_t n) const {
   std::vector<std::pair<std::string, double>> rows;
   rows.reserve(key_index_.size());
   for (const auto &[k, v] : key_index_)
-    rows.emplace_back(k, v.meta.miss_cost);
+    rows.emplace_back(k, decode_meta(v).miss_cost);
   std::sort(rows.begin(), rows.end(), [](const auto &a, const auto &b) {
     if (a.second == b.second)
       return a.first < b.first;
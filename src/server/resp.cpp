@@ -83,4 +83,22 @@ std::string resp_array(const std::vector<std::string> &items) {
   return out;
 }
 
+void resp_append_bulk_header(std::string *out, std::size_t len) {
+  *out += '$';
+  *out += std::to_string(len);
+  *out += "\r\n";
+}
+
+void resp_append_bulk(std::string *out, std::string_view s) {
+  resp_append_bulk_header(out, s.size());
+  *out += s;
+  *out += "\r\n";
+}
+
+void resp_append_array_header(std::string *out, std::size_t n) {
+  *out += '*';
+  *out += std::to_string(n);
+  *out += "\r\n";
+}
+
 } // namespace pomai_cache
@@ -25,6 +25,30 @@ std::string upper(std::string s) {
   return s;
 }
 
+// [meta, payload], the payload copied once from the cache's shared buffers;
+// chunks are gathered straight into the reply, never reassembled first.
+void append_artifact(std::string *out, const pomai_cache::ArtifactValue &v) {
+  pomai_cache::resp_append_array_header(out, 2);
+  pomai_cache::resp_append_bulk(out, *v.encoded_meta);
+  pomai_cache::resp_append_bulk_header(out, v.payload_size());
+  auto append = [out](const std::vector<std::uint8_t> &b) {
+    out->append(reinterpret_cast<const char *>(b.data()), b.size());
+  };
+  if (v.payload)
+    append(*v.payload);
+  for (const auto &c : v.chunks)
+    append(*c);
+  *out += "\r\n";
+}
+
+// An array of bulk strings holding raw items such as keys.
+void append_bulk_array(std::string *out,
+                       const std::vector<std::string> &items) {
+  pomai_cache::resp_append_array_header(out, items.size());
+  for (const auto &item : items)
+    pomai_cache::resp_append_bulk(out, item);
+}
+
 bool parse_u64(const std::string &s, std::uint64_t &out) {
   try {
     std::size_t idx = 0;
@@ -35,12 +59,62 @@ bool parse_u64(const std::string &s, std::uint64_t &out) {
   }
 }
 
+bool parse_f64(const std::string &s, double &out) {
+  try {
+    std::size_t idx = 0;
+    out = std::stod(s, &idx);
+    return idx == s.size();
+  } catch (...) {
+    return false;
+  }
+}
+
+// "t1 [AND|OR t2 ...]" from cmd[begin, end).
+bool parse_tag_expr(const std::vector<std::string> &cmd, std::size_t begin,
+                    std::size_t end, std::vector<pomai_cache::TagTerm> *out) {
+  if (begin >= end || (end - begin) % 2 == 0)
+    return false;
+  out->push_back({pomai_cache::TagOp::And, cmd[begin]});
+  for (std::size_t i = begin + 1; i < end; i += 2) {
+    auto op = upper(cmd[i]);
+    if (op != "AND" && op != "OR")
+      return false;
+    out->push_back({op == "AND" ? pomai_cache::TagOp::And
+                                : pomai_cache::TagOp::Or,
+                    cmd[i + 1]});
+  }
+  return true;
+}
+
+// Commands whose +OK promises the write reached the store; their replies
+// are withdrawn if this iteration's commit fails.
+bool is_write_command(const std::string &c) {
+  return c == "SET" || c == "DEL" || c == "EXPIRE" || c == "AI.PUT" ||
+         c == "AI.PUT.BIN" || c == "AI.EMB.PUT" || c == "AI.RSP.PUT" ||
+         c == "AI.INVALIDATE";
+}
+
 struct ClientState {
   pomai_cache::RespParser parser;
   std::string out;
   std::size_t bytes_pending{0};
+  // [begin, end) of write replies queued in `out` this iteration.
+  std::vector<std::pair<std::size_t, std::size_t>> write_replies;
 };
 
+// Replaces each successful write reply in st.out with `error`.
+void withdraw_write_replies(ClientState &st, const std::string &error) {
+  std::string out;
+  std::size_t pos = 0;
+  for (const auto &[begin, end] : st.write_replies) {
+    out.append(st.out, pos, begin - pos);
+    out += st.out[begin] == '-' ? st.out.substr(begin, end - begin) : error;
+    pos = end;
+  }
+  out.append(st.out, pos, std::string::npos);
+  st.out = std::move(out);
+}
+
 struct ServerStats {
   std::uint64_t rejected_requests{0};
   std::uint64_t total_request_bytes{0};
@@ -63,9 +137,26 @@ int main(int argc, char **argv) {
   std::size_t ssd_max_bytes = 2ULL * 1024 * 1024 * 1024;
   std::size_t promotion_hits = 3;
   double demotion_pressure = 0.90;
+  double demotion_target = 0.80;
+  std::size_t demotion_batch = 256;
   std::size_t ssd_read_mb_s = 256;
   std::size_t ssd_write_mb_s = 256;
   std::string fsync_policy = "never";
+  std::size_t ssd_append_buffer_bytes = 256 * 1024;
+  std::size_t ssd_group_commit_ms = 2;
+  double ssd_verify_reads = 1.0;
+  std::size_t ssd_segment_bytes = 256 * 1024 * 1024;
+  std::size_t ssd_small_object_bytes = 0;
+  std::size_t ssd_small_store_bytes = 64 * 1024 * 1024;
+  std::size_t ssd_read_cache_bytes = 0;
+  std::size_t ssd_read_threads = 8;
+  bool ssd_direct_io = false;
+  std::size_t ssd_recovery_threads = 0;
+  bool ssd_online_recovery = false;
+  std::size_t ssd_recovery_wait_ms = 10;
+  std::size_t ssd_admit_min_accesses = 2;
+  double ssd_dwpd = 0.0;
+  pomai_cache::AiCacheConfig ai_cfg{};
 
   for (int i = 1; i < argc; ++i) {
     std::string a = argv[i];
@@ -89,12 +180,54 @@ int main(int argc, char **argv) {
       promotion_hits = std::stoull(argv[++i]);
     else if (a == "--demotion-pressure" && i + 1 < argc)
       demotion_pressure = std::stod(argv[++i]);
+    else if (a == "--demotion-target" && i + 1 < argc)
+      demotion_target = std::stod(argv[++i]);
+    else if (a == "--demotion-batch" && i + 1 < argc)
+      demotion_batch = std::stoull(argv[++i]);
     else if (a == "--ssd-read-mb-s" && i + 1 < argc)
       ssd_read_mb_s = std::stoull(argv[++i]);
     else if (a == "--ssd-write-mb-s" && i + 1 < argc)
       ssd_write_mb_s = std::stoull(argv[++i]);
     else if (a == "--fsync" && i + 1 < argc)
       fsync_policy = argv[++i];
+    else if (a == "--ssd-append-buffer-bytes" && i + 1 < argc)
+      ssd_append_buffer_bytes = std::stoull(argv[++i]);
+    else if (a == "--ssd-group-commit-ms" && i + 1 < argc)
+      ssd_group_commit_ms = std::stoull(argv[++i]);
+    else if (a == "--ssd-verify-reads" && i + 1 < argc)
+      ssd_verify_reads = std::stod(argv[++i]);
+    else if (a == "--ssd-segment-bytes" && i + 1 < argc)
+      ssd_segment_bytes = std::stoull(argv[++i]);
+    else if (a == "--ssd-small-object-bytes" && i + 1 < argc)
+      ssd_small_object_bytes = std::stoull(argv[++i]);
+    else if (a == "--ssd-small-store-bytes" && i + 1 < argc)
+      ssd_small_store_bytes = std::stoull(argv[++i]);
+    else if (a == "--ssd-read-cache-bytes" && i + 1 < argc)
+      ssd_read_cache_bytes = std::stoull(argv[++i]);
+    else if (a == "--ssd-read-threads" && i + 1 < argc)
+      ssd_read_threads = std::stoull(argv[++i]);
+    else if (a == "--ssd-direct-io")
+      ssd_direct_io = true;
+    else if (a == "--ssd-recovery-threads" && i + 1 < argc)
+      ssd_recovery_threads = std::stoull(argv[++i]);
+    else if (a == "--ssd-online-recovery")
+      ssd_online_recovery = true;
+    else if (a == "--ssd-recovery-wait-ms" && i + 1 < argc)
+      ssd_recovery_wait_ms = std::stoull(argv[++i]);
+    else if (a == "--ssd-admit-min-accesses" && i + 1 < argc)
+      ssd_admit_min_accesses = std::stoull(argv[++i]);
+    else if (a == "--ssd-dwpd" && i + 1 < argc)
+      ssd_dwpd = std::stod(argv[++i]);
+    else if (a == "--ai-chunk-min-bytes" && i + 1 < argc)
+      ai_cfg.chunk_min_payload = std::stoull(argv[++i]);
+    else if (a == "--ai-chunk-avg-bytes" && i + 1 < argc)
+      ai_cfg.chunk_avg_bytes = std::stoull(argv[++i]);
+    else if (a == "--ai-emb-store" && i + 1 < argc) {
+      const std::string v = argv[++i];
+      ai_cfg.emb_store = v == "float16" ? pomai_cache::VectorCodec::Float16
+                         : v == "int8" ? pomai_cache::VectorCodec::Int8Scaled
+                                       : pomai_cache::VectorCodec::Float32;
+    }
   }
 
   auto policy = pomai_cache::make_policy_by_name(policy_mode);
@@ -105,17 +238,38 @@ int main(int argc, char **argv) {
   tier_cfg.ram_max_bytes = memory_limit;
   tier_cfg.promotion_hits = promotion_hits;
   tier_cfg.demotion_pressure = demotion_pressure;
+  tier_cfg.demotion_target = demotion_target;
+  tier_cfg.demotion_batch = demotion_batch;
   tier_cfg.ssd_max_read_mb_s = ssd_read_mb_s;
   tier_cfg.ssd_max_write_mb_s = ssd_write_mb_s;
+  tier_cfg.ssd_append_buffer_bytes = ssd_append_buffer_bytes;
+  tier_cfg.ssd_group_commit_ms =
+      static_cast<std::uint32_t>(ssd_group_commit_ms);
+  tier_cfg.ssd_verify_read_sample = ssd_verify_reads;
+  tier_cfg.ssd_segment_bytes = ssd_segment_bytes;
+  tier_cfg.ssd_small_object_bytes = ssd_small_object_bytes;
+  tier_cfg.ssd_small_store_bytes = ssd_small_store_bytes;
+  tier_cfg.ssd_read_cache_bytes = ssd_read_cache_bytes;
+  tier_cfg.ssd_read_threads = ssd_read_threads;
+  tier_cfg.ssd_direct_io = ssd_direct_io;
+  tier_cfg.ssd_recovery_threads = ssd_recovery_threads;
+  tier_cfg.ssd_online_recovery = ssd_online_recovery;
+  tier_cfg.ssd_recovery_wait_ms =
+      static_cast<std::uint32_t>(ssd_recovery_wait_ms);
+  tier_cfg.ssd_admit_min_accesses =
+      static_cast<std::uint32_t>(ssd_admit_min_accesses);
+  tier_cfg.ssd_dwpd = ssd_dwpd;
   pomai_cache::FsyncMode fsync_mode = pomai_cache::FsyncMode::EverySec;
   if (upper(fsync_policy) == "NEVER")
     fsync_mode = pomai_cache::FsyncMode::Never;
   else if (upper(fsync_policy) == "ALWAYS")
     fsync_mode = pomai_cache::FsyncMode::Always;
+  else if (upper(fsync_policy) == "GROUP")
+    fsync_mode = pomai_cache::FsyncMode::Group;
   pomai_cache::EngineConfig engine_cfg{
       memory_limit, 256, 1024 * 1024, 128, 64, data_dir, tier_cfg, fsync_mode};
   pomai_cache::Engine engine(engine_cfg, std::move(policy));
-  pomai_cache::AiArtifactCache ai_cache(engine);
+  pomai_cache::AiArtifactCache ai_cache(engine, ai_cfg);
   std::string reload_err;
   engine.reload_params(params_path, &reload_err);
 
@@ -203,6 +357,7 @@ int main(int argc, char **argv) {
           }
 
           const auto c = upper((*cmd)[0]);
+          const std::size_t reply_begin = st.out.size();
           if (c == "PING")
             st.out += pomai_cache::resp_simple("PONG");
           else if (c == "SET") {
@@ -343,61 +498,58 @@ int main(int argc, char **argv) {
               ++stats.rejected_requests;
               st.out += pomai_cache::resp_error("CONFIG GET|SET");
             }
-          } else if (c == "AI.PUT") {
+          } else if (c == "AI.PUT" || c == "AI.PUT.BIN") {
+            const bool bin = c == "AI.PUT.BIN";
             if (cmd->size() != 5) {
               ++stats.rejected_requests;
               st.out += pomai_cache::resp_error(
-                  "AI.PUT <type> <key> <meta_json> <payload_bytes>");
+                  bin ? "AI.PUT.BIN <type> <key> <meta_bin> <payload_bytes>"
+                      : "AI.PUT <type> <key> <meta_json> <payload_bytes>");
             } else {
               std::vector<std::uint8_t> payload((*cmd)[4].begin(),
                                                 (*cmd)[4].end());
               std::string err;
-              if (!ai_cache.put((*cmd)[1], (*cmd)[2], (*cmd)[3], payload,
-                                &err)) {
+              const bool ok =
+                  bin ? ai_cache.put_binary((*cmd)[1], (*cmd)[2], (*cmd)[3],
+                                            payload, &err)
+                      : ai_cache.put((*cmd)[1], (*cmd)[2], (*cmd)[3], payload,
+                                     &err);
+              if (!ok) {
                 ++stats.rejected_requests;
                 st.out += pomai_cache::resp_error(err);
               } else {
                 st.out += pomai_cache::resp_simple("OK");
               }
             }
-          } else if (c == "AI.GET") {
+          } else if (c == "AI.GET" || c == "AI.GET.BIN") {
+            const auto enc = c == "AI.GET" ? pomai_cache::MetaEncoding::Json
+                                           : pomai_cache::MetaEncoding::Binary;
             if (cmd->size() != 2) {
               ++stats.rejected_requests;
-              st.out += pomai_cache::resp_error("AI.GET <key>");
+              st.out += pomai_cache::resp_error(c + " <key>");
             } else {
-              auto v = ai_cache.get((*cmd)[1]);
-              if (!v.has_value()) {
+              auto v = ai_cache.get((*cmd)[1], enc);
+              if (!v.has_value())
                 st.out += pomai_cache::resp_null();
-              } else {
-                std::vector<std::string> arr{
-                    pomai_cache::resp_bulk(
-                        pomai_cache::AiArtifactCache::meta_to_json(v->meta)),
-                    pomai_cache::resp_bulk(
-                        std::string(v->payload.begin(), v->payload.end()))};
-                st.out += pomai_cache::resp_array(arr);
-              }
+              else
+                append_artifact(&st.out, *v);
             }
-          } else if (c == "AI.MGET") {
+          } else if (c == "AI.MGET" || c == "AI.MGET.BIN") {
+            const auto enc = c == "AI.MGET" ? pomai_cache::MetaEncoding::Json
+                                            : pomai_cache::MetaEncoding::Binary;
             if (cmd->size() < 2) {
               ++stats.rejected_requests;
-              st.out += pomai_cache::resp_error("AI.MGET <key...>");
+              st.out += pomai_cache::resp_error(c + " <key...>");
             } else {
               std::vector<std::string> keys(cmd->begin() + 1, cmd->end());
-              auto vals = ai_cache.mget(keys);
-              std::vector<std::string> arr;
-              for (auto &v : vals) {
-                if (!v.has_value()) {
-                  arr.push_back(pomai_cache::resp_null());
-                } else {
-                  std::vector<std::string> pair{
-                      pomai_cache::resp_bulk(
-                          pomai_cache::AiArtifactCache::meta_to_json(v->meta)),
-                      pomai_cache::resp_bulk(
-                          std::string(v->payload.begin(), v->payload.end()))};
-                  arr.push_back(pomai_cache::resp_array(pair));
-                }
+              auto vals = ai_cache.mget(keys, enc);
+              pomai_cache::resp_append_array_header(&st.out, vals.size());
+              for (const auto &v : vals) {
+                if (!v.has_value())
+                  st.out += pomai_cache::resp_null();
+                else
+                  append_artifact(&st.out, *v);
               }
-              st.out += pomai_cache::resp_array(arr);
             }
           } else if (c == "AI.EMB.PUT") {
             if (cmd->size() != 7) {
@@ -411,22 +563,17 @@ int main(int argc, char **argv) {
                 ++stats.rejected_requests;
                 st.out += pomai_cache::resp_error("invalid numeric argument");
               } else {
-                if ((*cmd)[4] != "float" && (*cmd)[4] != "float16" &&
-                    (*cmd)[4] != "int8") {
+                pomai_cache::VectorType type;
+                if (!pomai_cache::parse_vector_type((*cmd)[4], &type)) {
                   ++stats.rejected_requests;
                   st.out += pomai_cache::resp_error("invalid vector header");
                 } else {
                   std::vector<std::uint8_t> payload((*cmd)[6].begin(),
                                                     (*cmd)[6].end());
-                  std::ostringstream meta;
-                  meta << "{\"artifact_type\":\"embedding\",\"owner\":"
-                          "\"vector\",\"schema_version\":\"v1\","
-                       << "\"model_id\":\"" << (*cmd)[2] << "\",\"dim\":" << dim
-                       << ",\"dtype\":\"" << (*cmd)[4]
-                       << "\",\"ttl_deadline\":" << (ttl_s * 1000ULL) << "}";
                   std::string err;
-                  if (!ai_cache.put("embedding", (*cmd)[1], meta.str(), payload,
-                                    &err)) {
+                  if (!ai_cache.put_embedding(
+                          (*cmd)[1], (*cmd)[2], static_cast<std::size_t>(dim),
+                          type, ttl_s * 1000ULL, payload, &err)) {
                     ++stats.rejected_requests;
                     st.out += pomai_cache::resp_error(err);
                   } else {
@@ -435,32 +582,132 @@ int main(int argc, char **argv) {
                 }
               }
             }
+          } else if (c == "AI.EMB.SEARCH") {
+            // Replies key1, score1, key2, score2, ... best first.
+            std::uint64_t k = 0;
+            if (cmd->size() != 4 || !parse_u64((*cmd)[2], k)) {
+              ++stats.rejected_requests;
+              st.out += pomai_cache::resp_error(
+                  "AI.EMB.SEARCH <model_id> <k> <query_vector>");
+            } else {
+              std::vector<std::uint8_t> query((*cmd)[3].begin(),
+                                              (*cmd)[3].end());
+              std::vector<pomai_cache::EmbeddingHit> hits;
+              std::string err;
+              if (!ai_cache.search_embeddings((*cmd)[1], query,
+                                              static_cast<std::size_t>(k),
+                                              &hits, &err)) {
+                ++stats.rejected_requests;
+                st.out += pomai_cache::resp_error(err);
+              } else {
+                std::vector<std::string> items;
+                items.reserve(hits.size() * 2);
+                for (auto &h : hits) {
+                  items.push_back(std::move(h.key));
+                  items.push_back(std::to_string(h.score));
+                }
+                append_bulk_array(&st.out, items);
+              }
+            }
           } else if (c == "AI.EMB.GET") {
-            if (cmd->size() != 2) {
+            // Without AS the payload is returned as stored.
+            pomai_cache::VectorType as;
+            if ((cmd->size() != 2 && cmd->size() != 4) ||
+                (cmd->size() == 4 &&
+                 (upper((*cmd)[2]) != "AS" ||
+                  !pomai_cache::parse_vector_type((*cmd)[3], &as)))) {
               ++stats.rejected_requests;
-              st.out += pomai_cache::resp_error("AI.EMB.GET <key>");
+              st.out += pomai_cache::resp_error(
+                  "AI.EMB.GET <key> [AS float|float16]");
             } else {
-              auto v = ai_cache.get((*cmd)[1]);
-              if (!v.has_value()) {
+              std::optional<pomai_cache::ArtifactValue> v;
+              std::string err;
+              if (cmd->size() == 2)
+                v = ai_cache.get((*cmd)[1]);
+              if (cmd->size() == 4 &&
+                  !ai_cache.get_embedding((*cmd)[1], as, &v, &err)) {
+                ++stats.rejected_requests;
+                st.out += pomai_cache::resp_error(err);
+              } else if (!v.has_value()) {
                 st.out += pomai_cache::resp_null();
               } else {
-                std::vector<std::string> pair{
-                    pomai_cache::resp_bulk(
-                        pomai_cache::AiArtifactCache::meta_to_json(v->meta)),
-                    pomai_cache::resp_bulk(
-                        std::string(v->payload.begin(), v->payload.end()))};
-                st.out += pomai_cache::resp_array(pair);
+                append_artifact(&st.out, *v);
+              }
+            }
+          } else if (c == "AI.RSP.PUT") {
+            std::uint64_t dim = 0, ttl_s = 0;
+            pomai_cache::VectorType type;
+            if (cmd->size() != 9) {
+              ++stats.rejected_requests;
+              st.out += pomai_cache::resp_error(
+                  "AI.RSP.PUT <model_id> <params_hash> <prompt_hash> <dim> "
+                  "<dtype> <ttl_sec> <prompt_vector> <response>");
+            } else if (!parse_u64((*cmd)[4], dim) ||
+                       !parse_u64((*cmd)[6], ttl_s)) {
+              ++stats.rejected_requests;
+              st.out += pomai_cache::resp_error("invalid numeric argument");
+            } else if (!pomai_cache::parse_vector_type((*cmd)[5], &type)) {
+              ++stats.rejected_requests;
+              st.out += pomai_cache::resp_error("invalid vector header");
+            } else {
+              std::vector<std::uint8_t> vec((*cmd)[7].begin(),
+                                            (*cmd)[7].end());
+              std::vector<std::uint8_t> response((*cmd)[8].begin(),
+                                                 (*cmd)[8].end());
+              std::string err;
+              if (!ai_cache.put_response((*cmd)[1], (*cmd)[2], (*cmd)[3],
+                                         static_cast<std::size_t>(dim), type,
+                                         ttl_s * 1000ULL, vec, response,
+                                         &err)) {
+                ++stats.rejected_requests;
+                st.out += pomai_cache::resp_error(err);
+              } else {
+                st.out += pomai_cache::resp_simple("OK");
+              }
+            }
+          } else if (c == "AI.RSP.LOOKUP") {
+            // [key, distance, [meta, payload]] on a hit, null otherwise.
+            double max_distance = 0;
+            if (cmd->size() != 5 || !parse_f64((*cmd)[3], max_distance)) {
+              ++stats.rejected_requests;
+              st.out += pomai_cache::resp_error(
+                  "AI.RSP.LOOKUP <model_id> <params_hash> <max_distance> "
+                  "<query_vector>");
+            } else {
+              std::vector<std::uint8_t> query((*cmd)[4].begin(),
+                                              (*cmd)[4].end());
+              std::optional<pomai_cache::ResponseMatch> match;
+              std::string err;
+              if (!ai_cache.lookup_response((*cmd)[1], (*cmd)[2], query,
+                                            static_cast<float>(max_distance),
+                                            &match, &err)) {
+                ++stats.rejected_requests;
+                st.out += pomai_cache::resp_error(err);
+              } else if (!match) {
+                st.out += pomai_cache::resp_null();
+              } else {
+                pomai_cache::resp_append_array_header(&st.out, 3);
+                pomai_cache::resp_append_bulk(&st.out, match->key);
+                pomai_cache::resp_append_bulk(
+                    &st.out, std::to_string(match->distance));
+                append_artifact(&st.out, match->value);
               }
             }
           } else if (c == "AI.INVALIDATE") {
-            if (cmd->size() != 3) {
+            std::vector<pomai_cache::TagTerm> expr;
+            const bool tag = cmd->size() >= 3 && upper((*cmd)[1]) == "TAG";
+            if (tag ? !parse_tag_expr(*cmd, 2, cmd->size(), &expr)
+                    : cmd->size() != 3) {
               ++stats.rejected_requests;
               st.out += pomai_cache::resp_error(
-                  "AI.INVALIDATE EPOCH|MODEL|PREFIX <value>");
+                  "AI.INVALIDATE EPOCH|MODEL|PREFIX <value> | "
+                  "TAG <k=v> [AND|OR <k=v> ...]");
             } else {
               auto mode = upper((*cmd)[1]);
               std::size_t n = 0;
-              if (mode == "EPOCH")
+              if (tag)
+                n = ai_cache.invalidate_tags(expr);
+              else if (mode == "EPOCH")
                 n = ai_cache.invalidate_epoch((*cmd)[2]);
               else if (mode == "MODEL")
                 n = ai_cache.invalidate_model((*cmd)[2]);
@@ -475,6 +722,55 @@ int main(int argc, char **argv) {
               if (n != static_cast<std::size_t>(-1))
                 st.out += pomai_cache::resp_integer(static_cast<long long>(n));
             }
+          } else if (c == "AI.QUERY") {
+            // AI.QUERY TAG <k=v> [AND|OR <k=v> ...] [LIMIT n]
+            std::uint64_t limit = 100;
+            std::size_t end = cmd->size();
+            bool valid = true;
+            if (end >= 2 && upper((*cmd)[end - 2]) == "LIMIT") {
+              valid = parse_u64((*cmd)[end - 1], limit);
+              end -= 2;
+            }
+            std::vector<pomai_cache::TagTerm> expr;
+            valid = valid && cmd->size() >= 3 && upper((*cmd)[1]) == "TAG" &&
+                    parse_tag_expr(*cmd, 2, end, &expr);
+            if (!valid) {
+              ++stats.rejected_requests;
+              st.out += pomai_cache::resp_error(
+                  "AI.QUERY TAG <k=v> [AND|OR <k=v> ...] [LIMIT n]");
+            } else {
+              auto keys =
+                  ai_cache.query_tags(expr, static_cast<std::size_t>(limit));
+              append_bulk_array(&st.out, keys);
+            }
+          } else if (c == "AI.SCAN") {
+            // AI.SCAN <cursor> [PREFIX p] [COUNT n]; the cursor is the last
+            // key of the previous page, "" to start and "" when done.
+            std::string prefix;
+            std::uint64_t count = 10;
+            bool valid = cmd->size() >= 2 && cmd->size() % 2 == 0;
+            for (std::size_t i = 2; valid && i + 1 < cmd->size(); i += 2) {
+              auto opt = upper((*cmd)[i]);
+              if (opt == "PREFIX")
+                prefix = (*cmd)[i + 1];
+              else if (opt == "COUNT")
+                valid = parse_u64((*cmd)[i + 1], count) && count > 0;
+              else
+                valid = false;
+            }
+            if (!valid) {
+              ++stats.rejected_requests;
+              st.out += pomai_cache::resp_error(
+                  "AI.SCAN <cursor> [PREFIX p] [COUNT n]");
+            } else {
+              auto keys = ai_cache.scan(prefix, (*cmd)[1],
+                                        static_cast<std::size_t>(count));
+              const std::string next =
+                  keys.size() == count ? keys.back() : std::string();
+              pomai_cache::resp_append_array_header(&st.out, 2);
+              pomai_cache::resp_append_bulk(&st.out, next);
+              append_bulk_array(&st.out, keys);
+            }
           } else if (c == "AI.STATS") {
             st.out += pomai_cache::resp_bulk(ai_cache.stats());
           } else if (c == "AI.TOP") {
@@ -511,6 +807,8 @@ int main(int argc, char **argv) {
             ++stats.rejected_requests;
             st.out += pomai_cache::resp_error("unknown command");
           }
+          if (is_write_command(c))
+            st.write_replies.emplace_back(reply_begin, st.out.size());
           if (st.out.size() > max_pending_out) {
             ++stats.rejected_requests;
             to_close.push_back(fd);
@@ -518,6 +816,23 @@ int main(int argc, char **argv) {
           }
         }
       }
+    }
+
+    // Group commit: one flush (and fsync in group mode) covers every write
+    // processed this iteration; replies are only released afterwards. If it
+    // fails, write acknowledgements become errors rather than lies.
+    std::string commit_err;
+    const bool committed = engine.commit(&commit_err);
+    if (!committed)
+      std::cerr << "ssd commit failed: " << commit_err << "\n";
+    for (auto &[fd, st] : clients) {
+      if (!committed && !st.write_replies.empty())
+        withdraw_write_replies(
+            st, pomai_cache::resp_error("ssd commit failed: " + commit_err));
+      st.write_replies.clear();
+    }
+
+    for (auto &[fd, st] : clients) {
       if (FD_ISSET(fd, &writefds) && !st.out.empty()) {
         const std::size_t send_bytes =
             std::min<std::size_t>(st.out.size(), 8192);
@@ -0,0 +1,234 @@
+#include "pomai_cache/bitmap.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+namespace pomai_cache {
+namespace {
+constexpr std::size_t kWords = 65536 / 64;
+
+std::uint16_t high_of(std::uint32_t v) {
+  return static_cast<std::uint16_t>(v >> 16);
+}
+std::uint16_t low_of(std::uint32_t v) {
+  return static_cast<std::uint16_t>(v & 0xFFFF);
+}
+} // namespace
+
+bool RoaringBitmap::Container::test(std::uint16_t low) const {
+  if (is_bitmap())
+    return (words[low >> 6] >> (low & 63)) & 1;
+  return std::binary_search(array.begin(), array.end(), low);
+}
+
+void RoaringBitmap::Container::to_bitmap() {
+  words.assign(kWords, 0);
+  for (const auto low : array)
+    words[low >> 6] |= std::uint64_t{1} << (low & 63);
+  array.clear();
+  array.shrink_to_fit();
+}
+
+void RoaringBitmap::Container::to_array() {
+  array.clear();
+  array.reserve(card);
+  for (std::size_t w = 0; w < kWords; ++w) {
+    for (auto bits = words[w]; bits != 0; bits &= bits - 1)
+      array.push_back(
+          static_cast<std::uint16_t>(w * 64 + std::countr_zero(bits)));
+  }
+  words.clear();
+  words.shrink_to_fit();
+}
+
+std::vector<RoaringBitmap::Container>::iterator
+RoaringBitmap::find(std::uint16_t key) {
+  return std::lower_bound(
+      containers_.begin(), containers_.end(), key,
+      [](const Container &c, std::uint16_t k) { return c.key < k; });
+}
+
+std::vector<RoaringBitmap::Container>::const_iterator
+RoaringBitmap::find(std::uint16_t key) const {
+  return std::lower_bound(
+      containers_.begin(), containers_.end(), key,
+      [](const Container &c, std::uint16_t k) { return c.key < k; });
+}
+
+bool RoaringBitmap::add(std::uint32_t v) {
+  const auto key = high_of(v);
+  const auto low = low_of(v);
+  auto it = find(key);
+  if (it == containers_.end() || it->key != key) {
+    it = containers_.insert(it, Container{});
+    it->key = key;
+  }
+  auto &c = *it;
+  if (c.is_bitmap()) {
+    auto &w = c.words[low >> 6];
+    const auto bit = std::uint64_t{1} << (low & 63);
+    if (w & bit)
+      return false;
+    w |= bit;
+  } else {
+    auto pos = std::lower_bound(c.array.begin(), c.array.end(), low);
+    if (pos != c.array.end() && *pos == low)
+      return false;
+    c.array.insert(pos, low);
+    if (c.array.size() > kArrayMax)
+      c.to_bitmap();
+  }
+  ++c.card;
+  return true;
+}
+
+bool RoaringBitmap::remove(std::uint32_t v) {
+  const auto key = high_of(v);
+  const auto low = low_of(v);
+  auto it = find(key);
+  if (it == containers_.end() || it->key != key)
+    return false;
+  auto &c = *it;
+  if (c.is_bitmap()) {
+    auto &w = c.words[low >> 6];
+    const auto bit = std::uint64_t{1} << (low & 63);
+    if (!(w & bit))
+      return false;
+    w &= ~bit;
+    if (c.card - 1 <= kArrayMax) {
+      --c.card;
+      c.to_array();
+      return true;
+    }
+  } else {
+    auto pos = std::lower_bound(c.array.begin(), c.array.end(), low);
+    if (pos == c.array.end() || *pos != low)
+      return false;
+    c.array.erase(pos);
+  }
+  if (--c.card == 0)
+    containers_.erase(it);
+  return true;
+}
+
+bool RoaringBitmap::contains(std::uint32_t v) const {
+  const auto key = high_of(v);
+  auto it = find(key);
+  return it != containers_.end() && it->key == key && it->test(low_of(v));
+}
+
+std::uint64_t RoaringBitmap::cardinality() const {
+  std::uint64_t n = 0;
+  for (const auto &c : containers_)
+    n += c.card;
+  return n;
+}
+
+std::size_t RoaringBitmap::memory_bytes() const {
+  std::size_t n = containers_.capacity() * sizeof(Container);
+  for (const auto &c : containers_)
+    n += c.array.capacity() * sizeof(std::uint16_t) +
+         c.words.capacity() * sizeof(std::uint64_t);
+  return n;
+}
+
+RoaringBitmap::Container RoaringBitmap::intersect(const Container &a,
+                                                  const Container &b) {
+  Container out;
+  out.key = a.key;
+  if (a.is_bitmap() && b.is_bitmap()) {
+    out.words.resize(kWords);
+    for (std::size_t w = 0; w < kWords; ++w) {
+      out.words[w] = a.words[w] & b.words[w];
+      out.card += static_cast<std::uint32_t>(std::popcount(out.words[w]));
+    }
+    if (out.card <= kArrayMax)
+      out.to_array();
+    return out;
+  }
+  if (a.is_bitmap() || b.is_bitmap()) {
+    const auto &arr = a.is_bitmap() ? b : a;
+    const auto &bm = a.is_bitmap() ? a : b;
+    for (const auto low : arr.array)
+      if (bm.test(low))
+        out.array.push_back(low);
+  } else {
+    std::set_intersection(a.array.begin(), a.array.end(), b.array.begin(),
+                          b.array.end(), std::back_inserter(out.array));
+  }
+  out.card = static_cast<std::uint32_t>(out.array.size());
+  return out;
+}
+
+RoaringBitmap::Container RoaringBitmap::unite(const Container &a,
+                                              const Container &b) {
+  Container out;
+  out.key = a.key;
+  if (!a.is_bitmap() && !b.is_bitmap() &&
+      a.array.size() + b.array.size() <= kArrayMax) {
+    std::set_union(a.array.begin(), a.array.end(), b.array.begin(),
+                   b.array.end(), std::back_inserter(out.array));
+    out.card = static_cast<std::uint32_t>(out.array.size());
+    return out;
+  }
+  out.words.assign(kWords, 0);
+  for (const auto *c : {&a, &b}) {
+    if (c->is_bitmap()) {
+      for (std::size_t w = 0; w < kWords; ++w)
+        out.words[w] |= c->words[w];
+    } else {
+      for (const auto low : c->array)
+        out.words[low >> 6] |= std::uint64_t{1} << (low & 63);
+    }
+  }
+  for (const auto w : out.words)
+    out.card += static_cast<std::uint32_t>(std::popcount(w));
+  if (out.card <= kArrayMax)
+    out.to_array();
+  return out;
+}
+
+void RoaringBitmap::intersect_with(const RoaringBitmap &other) {
+  std::vector<Container> out;
+  auto a = containers_.begin();
+  auto b = other.containers_.begin();
+  while (a != containers_.end() && b != other.containers_.end()) {
+    if (a->key < b->key) {
+      ++a;
+    } else if (b->key < a->key) {
+      ++b;
+    } else {
+      auto c = intersect(*a++, *b++);
+      if (c.card > 0)
+        out.push_back(std::move(c));
+    }
+  }
+  containers_ = std::move(out);
+}
+
+void RoaringBitmap::union_with(const RoaringBitmap &other) {
+  std::vector<Container> out;
+  out.reserve(containers_.size() + other.containers_.size());
+  auto a = containers_.begin();
+  auto b = other.containers_.begin();
+  while (a != containers_.end() || b != other.containers_.end()) {
+    if (b == other.containers_.end() ||
+        (a != containers_.end() && a->key < b->key)) {
+      out.push_back(std::move(*a++));
+    } else if (a == containers_.end() || b->key < a->key) {
+      out.push_back(*b++);
+    } else {
+      out.push_back(unite(*a++, *b++));
+    }
+  }
+  containers_ = std::move(out);
+}
+
+std::vector<std::uint32_t> RoaringBitmap::to_vector() const {
+  std::vector<std::uint32_t> out;
+  out.reserve(cardinality());
+  for_each([&out](std::uint32_t v) { out.push_back(v); });
+  return out;
+}
+
+} // namespace pomai_cache
@@ -0,0 +1,76 @@
+#include "pomai_cache/chunking.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+
+namespace pomai_cache {
+namespace {
+
+struct GearTable {
+  std::array<std::uint64_t, 256> t{};
+  constexpr GearTable() {
+    std::uint64_t x = 0x2545F4914F6CDD1Dull;
+    for (auto &v : t) {
+      // splitmix64
+      x += 0x9E3779B97F4A7C15ull;
+      std::uint64_t z = x;
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+      v = z ^ (z >> 31);
+    }
+  }
+};
+
+constexpr GearTable kGear{};
+
+// `bits` ones in the top of the word, where the gear hash has seen the last
+// 64 bytes; the low bits only reflect the last few.
+std::uint64_t top_mask(unsigned bits) {
+  return bits == 0 ? 0 : ~0ull << (64 - std::min(bits, 63u));
+}
+
+} // namespace
+
+ChunkParams chunk_params_for(std::size_t avg_bytes) {
+  avg_bytes = std::max<std::size_t>(avg_bytes, 256);
+  return {avg_bytes / 4, avg_bytes, avg_bytes * 4};
+}
+
+std::size_t cdc_next_cut(const std::uint8_t *data, std::size_t len,
+                         const ChunkParams &p) {
+  if (len <= p.min_bytes)
+    return len;
+  const std::size_t end = std::min(len, p.max_bytes);
+  const std::size_t normal = std::min(end, p.avg_bytes);
+  const auto bits = static_cast<unsigned>(std::bit_width(p.avg_bytes) - 1);
+  const std::uint64_t mask_s = top_mask(bits + 2);
+  const std::uint64_t mask_l = top_mask(bits > 2 ? bits - 2 : 0);
+  std::uint64_t h = 0;
+  std::size_t i = p.min_bytes;
+  for (; i < normal; ++i) {
+    h = (h << 1) + kGear.t[data[i]];
+    if ((h & mask_s) == 0)
+      return i + 1;
+  }
+  for (; i < end; ++i) {
+    h = (h << 1) + kGear.t[data[i]];
+    if ((h & mask_l) == 0)
+      return i + 1;
+  }
+  return end;
+}
+
+std::vector<std::size_t> cdc_chunk_ends(const std::uint8_t *data,
+                                        std::size_t len, const ChunkParams &p) {
+  std::vector<std::size_t> ends;
+  ends.reserve(len / std::max<std::size_t>(p.avg_bytes, 1) + 1);
+  std::size_t off = 0;
+  while (off < len) {
+    off += cdc_next_cut(data + off, len - off, p);
+    ends.push_back(off);
+  }
+  return ends;
+}
+
+} // namespace pomai_cache
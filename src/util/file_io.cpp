@@ -0,0 +1,166 @@
+#include "pomai_cache/file_io.hpp"
+
+#include <array>
+#include <cstring>
+#include <filesystem>
+
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace pomai_cache {
+
+#ifdef _WIN32
+int pc_open(const char *path, int flags) {
+  return _open(path, flags | _O_BINARY, _S_IREAD | _S_IWRITE);
+}
+int pc_close(int fd) { return _close(fd); }
+ssize_t pc_write(int fd, const void *buf, std::size_t len) {
+  return _write(fd, buf, static_cast<unsigned int>(len));
+}
+ssize_t pc_read(int fd, void *buf, std::size_t len) {
+  return _read(fd, buf, static_cast<unsigned int>(len));
+}
+std::int64_t pc_seek(int fd, std::int64_t off, int whence) {
+  return _lseeki64(fd, off, whence);
+}
+int pc_fsync(int fd) { return _commit(fd); }
+int pc_truncate(int fd, std::int64_t len) { return _chsize_s(fd, len); }
+ssize_t pc_pread(int fd, void *buf, std::size_t len, std::int64_t off) {
+  auto cur = pc_seek(fd, 0, SEEK_CUR);
+  if (cur < 0)
+    return -1;
+  if (pc_seek(fd, off, SEEK_SET) < 0)
+    return -1;
+  auto r = pc_read(fd, buf, len);
+  pc_seek(fd, cur, SEEK_SET);
+  return r;
+}
+#else
+int pc_open(const char *path, int flags) { return open(path, flags, 0644); }
+int pc_close(int fd) { return close(fd); }
+ssize_t pc_write(int fd, const void *buf, std::size_t len) {
+  return write(fd, buf, len);
+}
+ssize_t pc_read(int fd, void *buf, std::size_t len) {
+  return read(fd, buf, len);
+}
+std::int64_t pc_seek(int fd, std::int64_t off, int whence) {
+  return lseek(fd, off, whence);
+}
+int pc_fsync(int fd) { return fsync(fd); }
+int pc_truncate(int fd, std::int64_t len) { return ftruncate(fd, len); }
+ssize_t pc_pread(int fd, void *buf, std::size_t len, std::int64_t off) {
+  return pread(fd, buf, len, off);
+}
+#endif
+
+bool pc_pwrite_all(int fd, const void *buf, std::size_t len,
+                   std::int64_t off) {
+  auto *p = static_cast<const std::uint8_t *>(buf);
+  while (len > 0) {
+#ifdef _WIN32
+    if (pc_seek(fd, off, SEEK_SET) < 0)
+      return false;
+    auto w = pc_write(fd, p, len);
+#else
+    auto w = ::pwrite(fd, p, len, off);
+#endif
+    if (w <= 0)
+      return false;
+    p += w;
+    off += w;
+    len -= static_cast<std::size_t>(w);
+  }
+  return true;
+}
+
+bool pc_write_all(int fd, IoSlice *slices, int count) {
+#ifdef _WIN32
+  for (int i = 0; i < count; ++i) {
+    auto *p = static_cast<const std::uint8_t *>(slices[i].data);
+    std::size_t left = slices[i].len;
+    while (left > 0) {
+      auto w = pc_write(fd, p, left);
+      if (w <= 0)
+        return false;
+      p += w;
+      left -= static_cast<std::size_t>(w);
+    }
+  }
+  return true;
+#else
+  std::array<iovec, 4> iov{};
+  int n = 0;
+  for (int i = 0; i < count && n < static_cast<int>(iov.size()); ++i) {
+    if (slices[i].len == 0)
+      continue;
+    iov[n].iov_base = const_cast<void *>(slices[i].data);
+    iov[n].iov_len = slices[i].len;
+    ++n;
+  }
+  int first = 0;
+  while (first < n) {
+    auto w = ::writev(fd, iov.data() + first, n - first);
+    if (w < 0)
+      return false;
+    auto done = static_cast<std::size_t>(w);
+    while (first < n && done >= iov[first].iov_len) {
+      done -= iov[first].iov_len;
+      ++first;
+    }
+    if (first < n) {
+      iov[first].iov_base =
+          static_cast<std::uint8_t *>(iov[first].iov_base) + done;
+      iov[first].iov_len -= done;
+    }
+  }
+  return true;
+#endif
+}
+
+bool fsync_dir(const std::string &dir) {
+#ifdef _WIN32
+  (void)dir;
+  return true;
+#else
+  int dfd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if (dfd < 0)
+    return false;
+  bool ok = ::fsync(dfd) == 0;
+  close(dfd);
+  return ok;
+#endif
+}
+
+void pc_drop_cache(int fd) {
+#if defined(POSIX_FADV_DONTNEED)
+  ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#else
+  (void)fd;
+#endif
+}
+
+bool pc_direct_io_supported(const std::string &dir) {
+  if (PC_O_DIRECT == 0)
+    return false;
+  const auto path = dir + "/.direct_io_probe";
+  const int fd = pc_open(path.c_str(), PC_O_CREAT | PC_O_RDWR | PC_O_DIRECT);
+  if (fd < 0)
+    return false;
+  AlignedBytes block(kDirectIoAlign, 0x5a);
+  AlignedBytes back(kDirectIoAlign, 0);
+  const bool ok =
+      pc_pwrite_all(fd, block.data(), block.size(), 0) &&
+      pc_pread(fd, back.data(), back.size(), 0) ==
+          static_cast<ssize_t>(back.size()) &&
+      std::memcmp(block.data(), back.data(), block.size()) == 0;
+  pc_close(fd);
+  std::error_code ec;
+  std::filesystem::remove(path, ec);
+  return ok;
+}
+
+} // namespace pomai_cache
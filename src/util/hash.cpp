@@ -0,0 +1,418 @@
+#include "pomai_cache/hash.hpp"
+
+#include <array>
+#include <cstring>
+#include <string_view>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define POMAI_CRC_X86 1
+#include <immintrin.h>
+#include <nmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define POMAI_CRC_ARM 1
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+#if defined(__linux__)
+#include <sys/auxv.h>
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+#endif
+#endif
+
+namespace pomai_cache {
+namespace {
+
+constexpr std::uint32_t kCrc32cPoly = 0x82f63b78u;
+
+struct Crc32cTables {
+  std::array<std::array<std::uint32_t, 256>, 8> t{};
+  constexpr Crc32cTables() {
+    for (std::uint32_t i = 0; i < 256; ++i) {
+      std::uint32_t c = i;
+      for (int k = 0; k < 8; ++k)
+        c = (c & 1) ? (c >> 1) ^ kCrc32cPoly : c >> 1;
+      t[0][i] = c;
+    }
+    for (std::size_t s = 1; s < 8; ++s)
+      for (std::size_t i = 0; i < 256; ++i)
+        t[s][i] = (t[s - 1][i] >> 8) ^ t[0][t[s - 1][i] & 0xff];
+  }
+};
+
+constexpr Crc32cTables kTables{};
+
+std::uint32_t crc32c_sw(std::uint32_t crc, const std::uint8_t *p,
+                        std::size_t len) {
+  const auto &t = kTables.t;
+  while (len >= 8) {
+    std::uint32_t lo = 0;
+    std::uint32_t hi = 0;
+    std::memcpy(&lo, p, 4);
+    std::memcpy(&hi, p + 4, 4);
+    lo ^= crc;
+    crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^
+          t[4][lo >> 24] ^ t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^
+          t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+    p += 8;
+    len -= 8;
+  }
+  while (len-- > 0)
+    crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xff];
+  return crc;
+}
+
+#if defined(POMAI_CRC_X86)
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((target("sse4.2")))
+#endif
+std::uint32_t
+crc32c_hw(std::uint32_t crc, const std::uint8_t *p, std::size_t len) {
+  std::uint64_t c = crc;
+  while (len >= 8) {
+    std::uint64_t v = 0;
+    std::memcpy(&v, p, 8);
+    c = _mm_crc32_u64(c, v);
+    p += 8;
+    len -= 8;
+  }
+  auto c32 = static_cast<std::uint32_t>(c);
+  while (len-- > 0)
+    c32 = _mm_crc32_u8(c32, *p++);
+  return c32;
+}
+
+bool detect_hw() {
+#if defined(_MSC_VER)
+  int info[4] = {0, 0, 0, 0};
+  __cpuid(info, 1);
+  return (info[2] & (1 << 20)) != 0;
+#else
+  return __builtin_cpu_supports("sse4.2");
+#endif
+}
+constexpr const char *kHwName = "sse4.2";
+#elif defined(POMAI_CRC_ARM) && (defined(__GNUC__) || defined(__clang__))
+// Built with +crc (always so on Apple arm64) the ACLE intrinsics need no
+// attribute; otherwise enable the feature per function, in each compiler's
+// own spelling and with its own builtins.
+#if defined(__ARM_FEATURE_CRC32)
+#define POMAI_CRC_TARGET
+#define POMAI_CRC32CD __crc32cd
+#define POMAI_CRC32CB __crc32cb
+#elif defined(__clang__)
+#define POMAI_CRC_TARGET __attribute__((target("crc")))
+#define POMAI_CRC32CD __builtin_arm_crc32cd
+#define POMAI_CRC32CB __builtin_arm_crc32cb
+#else
+#define POMAI_CRC_TARGET __attribute__((target("+crc")))
+#define POMAI_CRC32CD __builtin_aarch64_crc32cx
+#define POMAI_CRC32CB __builtin_aarch64_crc32cb
+#endif
+POMAI_CRC_TARGET std::uint32_t crc32c_hw(std::uint32_t crc,
+                                         const std::uint8_t *p,
+                                         std::size_t len) {
+  while (len >= 8) {
+    std::uint64_t v = 0;
+    std::memcpy(&v, p, 8);
+    crc = POMAI_CRC32CD(crc, v);
+    p += 8;
+    len -= 8;
+  }
+  while (len-- > 0)
+    crc = POMAI_CRC32CB(crc, *p++);
+  return crc;
+}
+
+bool detect_hw() {
+#if defined(__ARM_FEATURE_CRC32) || defined(__APPLE__)
+  return true;
+#elif defined(__linux__)
+  return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#else
+  return false;
+#endif
+}
+constexpr const char *kHwName = "armv8";
+#else
+std::uint32_t crc32c_hw(std::uint32_t crc, const std::uint8_t *p,
+                        std::size_t len) {
+  return crc32c_sw(crc, p, len);
+}
+bool detect_hw() { return false; }
+constexpr const char *kHwName = "software";
+#endif
+
+const bool kHasHw = detect_hw();
+
+} // namespace
+
+std::uint32_t crc32c(std::uint32_t crc, const void *data, std::size_t len) {
+  const auto *p = static_cast<const std::uint8_t *>(data);
+  crc = ~crc;
+  crc = kHasHw ? crc32c_hw(crc, p, len) : crc32c_sw(crc, p, len);
+  return ~crc;
+}
+
+const char *crc32c_impl_name() { return kHasHw ? kHwName : "software"; }
+
+namespace {
+
+constexpr std::uint64_t kPrime32_1 = 0x9E3779B1u;
+constexpr std::uint64_t kPrime64_1 = 0x9E3779B185EBCA87ull;
+constexpr std::uint64_t kPrime64_2 = 0xC2B2AE3D27D4EB4Full;
+
+constexpr std::size_t kStripe = 64;
+constexpr std::size_t kLanes = kStripe / 8;
+constexpr std::size_t kSecretSize = 192;
+// Stripe n of a block is keyed by secret bytes [8n, 8n + 64); the lanes are
+// scrambled once per block with the last 64 secret bytes.
+constexpr std::size_t kStripesPerBlock = (kSecretSize - kStripe) / 8;
+constexpr std::size_t kBlock = kStripe * kStripesPerBlock;
+
+struct Secret {
+  alignas(64) std::uint8_t b[kSecretSize]{};
+  constexpr Secret() {
+    std::uint64_t x = 0x5851F42D4C957F2Dull;
+    for (std::size_t i = 0; i < kSecretSize; i += 8) {
+      // splitmix64
+      x += 0x9E3779B97F4A7C15ull;
+      std::uint64_t z = x;
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+      z ^= z >> 31;
+      for (std::size_t k = 0; k < 8; ++k)
+        b[i + k] = static_cast<std::uint8_t>(z >> (8 * k));
+    }
+  }
+};
+
+constexpr Secret kSecret{};
+
+std::uint64_t load64(const std::uint8_t *p) {
+  std::uint64_t v = 0;
+  std::memcpy(&v, p, 8);
+  return v;
+}
+
+void accumulate_scalar(std::uint64_t *acc, const std::uint8_t *p,
+                       const std::uint8_t *secret) {
+  for (std::size_t i = 0; i < kLanes; ++i) {
+    const std::uint64_t d = load64(p + 8 * i);
+    const std::uint64_t k = d ^ load64(secret + 8 * i);
+    acc[i ^ 1] += d;
+    acc[i] += (k & 0xFFFFFFFFu) * (k >> 32);
+  }
+}
+
+void scramble_scalar(std::uint64_t *acc, const std::uint8_t *secret) {
+  for (std::size_t i = 0; i < kLanes; ++i) {
+    std::uint64_t a = acc[i];
+    a ^= a >> 47;
+    a ^= load64(secret + 8 * i);
+    acc[i] = a * kPrime32_1;
+  }
+}
+
+#if defined(POMAI_CRC_X86)
+void accumulate_sse2(std::uint64_t *acc, const std::uint8_t *p,
+                     const std::uint8_t *secret) {
+  auto *a = reinterpret_cast<__m128i *>(acc);
+  for (std::size_t i = 0; i < kLanes / 2; ++i) {
+    const __m128i d =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(p) + i);
+    const __m128i k = _mm_xor_si128(
+        d, _mm_loadu_si128(reinterpret_cast<const __m128i *>(secret) + i));
+    const __m128i k_hi = _mm_shuffle_epi32(k, _MM_SHUFFLE(0, 3, 0, 1));
+    const __m128i prod = _mm_mul_epu32(k, k_hi);
+    const __m128i swapped = _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2));
+    a[i] = _mm_add_epi64(a[i], _mm_add_epi64(prod, swapped));
+  }
+}
+
+void scramble_sse2(std::uint64_t *acc, const std::uint8_t *secret) {
+  auto *a = reinterpret_cast<__m128i *>(acc);
+  const __m128i prime = _mm_set1_epi32(static_cast<int>(kPrime32_1));
+  for (std::size_t i = 0; i < kLanes / 2; ++i) {
+    __m128i v = _mm_xor_si128(a[i], _mm_srli_epi64(a[i], 47));
+    v = _mm_xor_si128(
+        v, _mm_loadu_si128(reinterpret_cast<const __m128i *>(secret) + i));
+    const __m128i lo = _mm_mul_epu32(v, prime);
+    const __m128i hi = _mm_mul_epu32(_mm_srli_epi64(v, 32), prime);
+    a[i] = _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+  }
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+#define POMAI_HASH_AVX2 1
+__attribute__((target("avx2"))) void
+accumulate_avx2(std::uint64_t *acc, const std::uint8_t *p,
+                const std::uint8_t *secret) {
+  auto *a = reinterpret_cast<__m256i *>(acc);
+  for (std::size_t i = 0; i < kLanes / 4; ++i) {
+    const __m256i d =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p) + i);
+    const __m256i k = _mm256_xor_si256(
+        d,
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(secret) + i));
+    const __m256i k_hi = _mm256_shuffle_epi32(k, _MM_SHUFFLE(0, 3, 0, 1));
+    const __m256i prod = _mm256_mul_epu32(k, k_hi);
+    const __m256i swapped = _mm256_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2));
+    a[i] = _mm256_add_epi64(a[i], _mm256_add_epi64(prod, swapped));
+  }
+}
+
+__attribute__((target("avx2"))) void
+scramble_avx2(std::uint64_t *acc, const std::uint8_t *secret) {
+  auto *a = reinterpret_cast<__m256i *>(acc);
+  const __m256i prime = _mm256_set1_epi32(static_cast<int>(kPrime32_1));
+  for (std::size_t i = 0; i < kLanes / 4; ++i) {
+    __m256i v = _mm256_xor_si256(a[i], _mm256_srli_epi64(a[i], 47));
+    v = _mm256_xor_si256(
+        v,
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(secret) + i));
+    const __m256i lo = _mm256_mul_epu32(v, prime);
+    const __m256i hi = _mm256_mul_epu32(_mm256_srli_epi64(v, 32), prime);
+    a[i] = _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32));
+  }
+}
+#endif
+#endif
+
+using AccumulateFn = void (*)(std::uint64_t *, const std::uint8_t *,
+                              const std::uint8_t *);
+using ScrambleFn = void (*)(std::uint64_t *, const std::uint8_t *);
+
+struct HashKernel {
+  AccumulateFn accumulate;
+  ScrambleFn scramble;
+  const char *name;
+};
+
+constexpr HashKernel kScalarKernel{accumulate_scalar, scramble_scalar,
+                                   "scalar"};
+
+// The kernel named `impl` if it is built and this CPU can run it.
+const HashKernel *find_kernel(const char *impl) {
+  const std::string_view name(impl);
+#if defined(POMAI_HASH_AVX2)
+  static constexpr HashKernel kAvx2{accumulate_avx2, scramble_avx2, "avx2"};
+  if (name == kAvx2.name)
+    return __builtin_cpu_supports("avx2") ? &kAvx2 : nullptr;
+#endif
+#if defined(POMAI_CRC_X86)
+  static constexpr HashKernel kSse2{accumulate_sse2, scramble_sse2, "sse2"};
+  if (name == kSse2.name)
+    return &kSse2;
+#endif
+  return name == kScalarKernel.name ? &kScalarKernel : nullptr;
+}
+
+HashKernel pick_kernel() {
+  for (const char *impl : {"avx2", "sse2"})
+    if (const auto *k = find_kernel(impl))
+      return *k;
+  return kScalarKernel;
+}
+
+const HashKernel kKernel = pick_kernel();
+
+std::uint64_t mul_fold64(std::uint64_t a, std::uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+  const auto p = static_cast<unsigned __int128>(a) * b;
+  return static_cast<std::uint64_t>(p) ^ static_cast<std::uint64_t>(p >> 64);
+#else
+  const std::uint64_t a_lo = a & 0xFFFFFFFFu, a_hi = a >> 32;
+  const std::uint64_t b_lo = b & 0xFFFFFFFFu, b_hi = b >> 32;
+  const std::uint64_t ll = a_lo * b_lo, lh = a_lo * b_hi;
+  const std::uint64_t hl = a_hi * b_lo, hh = a_hi * b_hi;
+  const std::uint64_t mid = (ll >> 32) + (lh & 0xFFFFFFFFu) + hl;
+  const std::uint64_t lo = (mid << 32) | (ll & 0xFFFFFFFFu);
+  const std::uint64_t hi = hh + (lh >> 32) + (mid >> 32);
+  return lo ^ hi;
+#endif
+}
+
+std::uint64_t avalanche(std::uint64_t h) {
+  h ^= h >> 37;
+  h *= 0x165667919E3779F9ull;
+  return h ^ (h >> 32);
+}
+
+std::uint64_t merge_lanes(const std::uint64_t *acc, const std::uint8_t *secret,
+                          std::uint64_t start) {
+  std::uint64_t r = start;
+  for (std::size_t i = 0; i < kLanes; i += 2)
+    r += mul_fold64(acc[i] ^ load64(secret + 8 * i),
+                    acc[i + 1] ^ load64(secret + 8 * i + 8));
+  return avalanche(r);
+}
+
+Hash128 hash128_with(const HashKernel &kernel, const void *data,
+                     std::size_t len) {
+  const auto *p = static_cast<const std::uint8_t *>(data);
+  const auto *secret = kSecret.b;
+  alignas(32) std::uint64_t acc[kLanes] = {
+      0xC2B2AE3Du,          kPrime64_1,           kPrime64_2,
+      0x165667B19E3779F9ull, 0x85EBCA77C2B2AE63ull, 0x85EBCA77u,
+      0x27D4EB2F165667C5ull, kPrime32_1};
+  if (len <= kStripe) {
+    // One zero-padded stripe; the length in the finish tells "a" and "a\0"
+    // apart.
+    alignas(32) std::uint8_t last[kStripe] = {};
+    if (len > 0)
+      std::memcpy(last, p, len);
+    kernel.accumulate(acc, last, secret);
+  } else {
+    // Full blocks, the remaining whole stripes, then the final 64 bytes
+    // (overlapping the previous stripe) under their own secret offset.
+    const std::size_t blocks = (len - 1) / kBlock;
+    for (std::size_t b = 0; b < blocks; ++b) {
+      for (std::size_t s = 0; s < kStripesPerBlock; ++s)
+        kernel.accumulate(acc, p + b * kBlock + s * kStripe, secret + 8 * s);
+      kernel.scramble(acc, secret + kSecretSize - kStripe);
+    }
+    const std::size_t stripes = ((len - 1) - blocks * kBlock) / kStripe;
+    for (std::size_t s = 0; s < stripes; ++s)
+      kernel.accumulate(acc, p + blocks * kBlock + s * kStripe,
+                         secret + 8 * s);
+    kernel.accumulate(acc, p + len - kStripe,
+                       secret + kSecretSize - kStripe - 7);
+  }
+  Hash128 h;
+  h.lo = merge_lanes(acc, secret + 11, len * kPrime64_1);
+  h.hi = merge_lanes(acc, secret + kSecretSize - kStripe - 11,
+                     ~(len * kPrime64_2));
+  return h;
+}
+
+} // namespace
+
+Hash128 hash128(const void *data, std::size_t len) {
+  return hash128_with(kKernel, data, len);
+}
+
+bool hash128_using(const char *impl, const void *data, std::size_t len,
+                   Hash128 *out) {
+  const auto *kernel = find_kernel(impl);
+  if (!kernel)
+    return false;
+  *out = hash128_with(*kernel, data, len);
+  return true;
+}
+
+const char *hash128_impl_name() { return kKernel.name; }
+
+void hash128_hex(const Hash128 &h, char *out) {
+  static constexpr char kHex[] = "0123456789abcdef";
+  for (int i = 0; i < 16; ++i) {
+    out[i] = kHex[(h.hi >> (60 - 4 * i)) & 0xF];
+    out[16 + i] = kHex[(h.lo >> (60 - 4 * i)) & 0xF];
+  }
+}
+
+} // namespace pomai_cache
@@ -0,0 +1,420 @@
+#include "pomai_cache/json.hpp"
+
+#include <charconv>
+
+namespace pomai_cache {
+namespace {
+// Nesting beyond this is rejected rather than recursed into.
+constexpr int kMaxDepth = 64;
+
+bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+int hex_value(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+void append_utf8(std::string *out, std::uint32_t cp) {
+  if (cp < 0x80) {
+    out->push_back(static_cast<char>(cp));
+  } else if (cp < 0x800) {
+    out->push_back(static_cast<char>(0xC0 | (cp >> 6)));
+    out->push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  } else if (cp < 0x10000) {
+    out->push_back(static_cast<char>(0xE0 | (cp >> 12)));
+    out->push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  } else {
+    out->push_back(static_cast<char>(0xF0 | (cp >> 18)));
+    out->push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  }
+}
+} // namespace
+
+char JsonReader::peek() {
+  while (pos_ < text_.size()) {
+    const char c = text_[pos_];
+    if (c != ' ' && c != '\t' && c != '\n' && c != '\r')
+      return c;
+    ++pos_;
+  }
+  return '\0';
+}
+
+bool JsonReader::fail() {
+  failed_ = true;
+  return false;
+}
+
+bool JsonReader::value_done() {
+  after_value_ = true;
+  return true;
+}
+
+bool JsonReader::at_end() {
+  peek();
+  return !failed_ && pos_ == text_.size();
+}
+
+bool JsonReader::begin_object() {
+  if (failed_ || peek() != '{')
+    return false;
+  ++pos_;
+  after_value_ = false;
+  return true;
+}
+
+bool JsonReader::begin_array() {
+  if (failed_ || peek() != '[')
+    return false;
+  ++pos_;
+  after_value_ = false;
+  return true;
+}
+
+bool JsonReader::next_member(std::string_view *name) {
+  if (failed_)
+    return false;
+  char c = peek();
+  if (c == '}') {
+    ++pos_;
+    value_done();
+    return false;
+  }
+  if (after_value_) {
+    if (c != ',')
+      return fail();
+    ++pos_;
+    c = peek();
+  }
+  if (c != '"')
+    return fail();
+  std::size_t end = 0;
+  bool escaped = false;
+  if (!scan_string(&end, &escaped))
+    return fail();
+  *name = text_.substr(pos_ + 1, end - pos_ - 1);
+  pos_ = end + 1;
+  if (peek() != ':')
+    return fail();
+  ++pos_;
+  after_value_ = false;
+  return true;
+}
+
+bool JsonReader::next_element() {
+  if (failed_)
+    return false;
+  const char c = peek();
+  if (c == ']') {
+    ++pos_;
+    value_done();
+    return false;
+  }
+  if (after_value_) {
+    if (c != ',')
+      return fail();
+    ++pos_;
+    after_value_ = false;
+  }
+  return true;
+}
+
+// Finds the closing quote of the string starting at pos_.
+bool JsonReader::scan_string(std::size_t *end, bool *escaped) const {
+  for (std::size_t i = pos_ + 1; i < text_.size(); ++i) {
+    const auto c = static_cast<unsigned char>(text_[i]);
+    if (c == '"') {
+      *end = i;
+      return true;
+    }
+    if (c == '\\') {
+      *escaped = true;
+      if (++i >= text_.size())
+        return false;
+      const char e = text_[i];
+      if (e == 'u') {
+        for (std::size_t k = 1; k <= 4; ++k)
+          if (i + k >= text_.size() || hex_value(text_[i + k]) < 0)
+            return false;
+        i += 4;
+      } else if (std::string_view("\"\\/bfnrt").find(e) ==
+                 std::string_view::npos) {
+        return false;
+      }
+    } else if (c < 0x20) {
+      return false;
+    }
+  }
+  return false;
+}
+
+// Validates the number starting at pos_ against the JSON grammar.
+bool JsonReader::scan_number(std::size_t *end) const {
+  std::size_t i = pos_;
+  const auto n = text_.size();
+  if (i < n && text_[i] == '-')
+    ++i;
+  if (i < n && text_[i] == '0') {
+    ++i;
+  } else {
+    if (i >= n || !is_digit(text_[i]))
+      return false;
+    while (i < n && is_digit(text_[i]))
+      ++i;
+  }
+  if (i < n && text_[i] == '.') {
+    if (++i >= n || !is_digit(text_[i]))
+      return false;
+    while (i < n && is_digit(text_[i]))
+      ++i;
+  }
+  if (i < n && (text_[i] == 'e' || text_[i] == 'E')) {
+    ++i;
+    if (i < n && (text_[i] == '+' || text_[i] == '-'))
+      ++i;
+    if (i >= n || !is_digit(text_[i]))
+      return false;
+    while (i < n && is_digit(text_[i]))
+      ++i;
+  }
+  *end = i;
+  return true;
+}
+
+bool JsonReader::decode_string(std::size_t begin, std::size_t end,
+                               std::string *out) {
+  out->clear();
+  out->reserve(end - begin);
+  for (std::size_t i = begin; i < end; ++i) {
+    const char c = text_[i];
+    if (c != '\\') {
+      out->push_back(c);
+      continue;
+    }
+    const char e = text_[++i];
+    switch (e) {
+    case '"':
+    case '\\':
+    case '/':
+      out->push_back(e);
+      break;
+    case 'b':
+      out->push_back('\b');
+      break;
+    case 'f':
+      out->push_back('\f');
+      break;
+    case 'n':
+      out->push_back('\n');
+      break;
+    case 'r':
+      out->push_back('\r');
+      break;
+    case 't':
+      out->push_back('\t');
+      break;
+    case 'u': {
+      auto read_hex4 = [&](std::size_t at, std::uint32_t *cp) {
+        if (at + 4 > end)
+          return false;
+        *cp = 0;
+        for (std::size_t k = at; k < at + 4; ++k) {
+          const int v = hex_value(text_[k]);
+          if (v < 0)
+            return false;
+          *cp = (*cp << 4) | static_cast<std::uint32_t>(v);
+        }
+        return true;
+      };
+      std::uint32_t cp = 0;
+      if (!read_hex4(i + 1, &cp))
+        return false;
+      i += 4;
+      // A high surrogate pairs with a following \uDC00-\uDFFF escape.
+      std::uint32_t lo = 0;
+      if (cp >= 0xD800 && cp < 0xDC00 && i + 2 < end &&
+          text_[i + 1] == '\\' && text_[i + 2] == 'u' &&
+          read_hex4(i + 3, &lo) && lo >= 0xDC00 && lo < 0xE000) {
+        cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+        i += 6;
+      }
+      append_utf8(out, cp);
+      break;
+    }
+    default:
+      return false;
+    }
+  }
+  return true;
+}
+
+bool JsonReader::read_string(std::string *out) {
+  if (failed_)
+    return false;
+  if (peek() != '"') {
+    skip_value();
+    return false;
+  }
+  std::size_t end = 0;
+  bool escaped = false;
+  if (!scan_string(&end, &escaped))
+    return fail();
+  if (!escaped)
+    out->assign(text_.data() + pos_ + 1, end - pos_ - 1);
+  else if (!decode_string(pos_ + 1, end, out))
+    return fail();
+  pos_ = end + 1;
+  return value_done();
+}
+
+bool JsonReader::read_u64(std::uint64_t *out) {
+  if (failed_)
+    return false;
+  const char c = peek();
+  if (c != '-' && !is_digit(c)) {
+    skip_value();
+    return false;
+  }
+  std::size_t end = 0;
+  if (!scan_number(&end))
+    return fail();
+  const char *first = text_.data() + pos_;
+  const char *last = text_.data() + end;
+  pos_ = end;
+  value_done();
+  std::uint64_t v = 0;
+  const auto r = std::from_chars(first, last, v);
+  if (r.ec != std::errc() || r.ptr != last)
+    return false;
+  *out = v;
+  return true;
+}
+
+bool JsonReader::read_double(double *out) {
+  if (failed_)
+    return false;
+  const char c = peek();
+  if (c != '-' && !is_digit(c)) {
+    skip_value();
+    return false;
+  }
+  std::size_t end = 0;
+  if (!scan_number(&end))
+    return fail();
+  const char *first = text_.data() + pos_;
+  const char *last = text_.data() + end;
+  pos_ = end;
+  value_done();
+  double v = 0;
+  const auto r = std::from_chars(first, last, v);
+  if (r.ec != std::errc() || r.ptr != last)
+    return false;
+  *out = v;
+  return true;
+}
+
+bool JsonReader::read_scalar(std::string *out) {
+  if (failed_)
+    return false;
+  const char c = peek();
+  if (c == '"')
+    return read_string(out);
+  if (c == '{' || c == '[') {
+    skip_value();
+    return false;
+  }
+  const auto begin = pos_;
+  if (!skip_value())
+    return false;
+  out->assign(text_.data() + begin, pos_ - begin);
+  return true;
+}
+
+bool JsonReader::read_raw(std::string_view *out) {
+  if (failed_)
+    return false;
+  peek();
+  const auto begin = pos_;
+  if (!skip_value())
+    return false;
+  *out = text_.substr(begin, pos_ - begin);
+  return true;
+}
+
+bool JsonReader::skip() { return skip_value(); }
+
+bool JsonReader::skip_value() {
+  if (failed_)
+    return false;
+  const char c = peek();
+  if (c == '"') {
+    std::size_t end = 0;
+    bool escaped = false;
+    if (!scan_string(&end, &escaped))
+      return fail();
+    pos_ = end + 1;
+    return value_done();
+  }
+  if (c == '{' || c == '[') {
+    if (depth_ >= kMaxDepth)
+      return fail();
+    ++depth_;
+    std::string_view name;
+    if (c == '{') {
+      begin_object();
+      while (next_member(&name))
+        if (!skip_value())
+          break;
+    } else {
+      begin_array();
+      while (next_element())
+        if (!skip_value())
+          break;
+    }
+    --depth_;
+    return !failed_ && value_done();
+  }
+  if (c == '-' || is_digit(c)) {
+    std::size_t end = 0;
+    if (!scan_number(&end))
+      return fail();
+    pos_ = end;
+    return value_done();
+  }
+  for (std::string_view lit : {"true", "false", "null"}) {
+    if (text_.substr(pos_, lit.size()) == lit) {
+      pos_ += lit.size();
+      return value_done();
+    }
+  }
+  return fail();
+}
+
+void append_json_string(std::string *out, std::string_view s) {
+  static constexpr char kHex[] = "0123456789abcdef";
+  out->push_back('"');
+  for (const char c : s) {
+    const auto u = static_cast<unsigned char>(c);
+    if (c == '"' || c == '\\') {
+      out->push_back('\\');
+      out->push_back(c);
+    } else if (u < 0x20) {
+      out->append("\\u00");
+      out->push_back(kHex[u >> 4]);
+      out->push_back(kHex[u & 15]);
+    } else {
+      out->push_back(c);
+    }
+  }
+  out->push_back('"');
+}
+
+} // namespace pomai_cache
@@ -0,0 +1,228 @@
+#include "pomai_cache/radix_tree.hpp"
+
+#include <algorithm>
+
+namespace pomai_cache {
+
+struct RadixTree::Node {
+  // Bytes on the edge into this node; empty only at the root.
+  std::string edge;
+  bool terminal{false};
+  // Sorted by the first byte of their edge, compared unsigned.
+  std::vector<std::unique_ptr<Node>> children;
+
+  static bool before(const std::unique_ptr<Node> &n, char c) {
+    return static_cast<unsigned char>(n->edge[0]) <
+           static_cast<unsigned char>(c);
+  }
+  std::vector<std::unique_ptr<Node>>::iterator lower(char c) {
+    return std::lower_bound(children.begin(), children.end(), c, before);
+  }
+  Node *child(char c) const {
+    auto it = std::lower_bound(children.begin(), children.end(), c, before);
+    return it != children.end() && (*it)->edge[0] == c ? it->get() : nullptr;
+  }
+};
+
+// Where a prefix ends: the first node whose path starts with it, that path,
+// and the node's parent (null at the root).
+struct RadixTree::Hit {
+  Node *node{nullptr};
+  Node *parent{nullptr};
+  std::string path;
+};
+
+namespace {
+
+std::size_t common_prefix(std::string_view a, std::string_view b) {
+  const auto n = std::min(a.size(), b.size());
+  std::size_t i = 0;
+  while (i < n && a[i] == b[i])
+    ++i;
+  return i;
+}
+
+template <typename NodeT>
+std::size_t count_nodes(const NodeT &n) {
+  std::size_t c = 1;
+  for (const auto &ch : n.children)
+    c += count_nodes(*ch);
+  return c;
+}
+
+// Appends every key under `n`, whose path is `path`, in order. `limit` 0 is
+// unbounded; `after` prunes subtrees that sort entirely before it.
+template <typename NodeT>
+void collect(const NodeT &n, std::string &path, std::string_view after,
+             std::size_t limit, std::vector<std::string> *out) {
+  if (limit != 0 && out->size() >= limit)
+    return;
+  if (!after.empty()) {
+    // path diverges from `after` with a smaller byte: every key here sorts
+    // before it.
+    const auto common = common_prefix(path, after);
+    if (common < path.size() && common < after.size() &&
+        static_cast<unsigned char>(path[common]) <
+            static_cast<unsigned char>(after[common]))
+      return;
+  }
+  if (n.terminal && (after.empty() || std::string_view(path) > after))
+    out->push_back(path);
+  for (const auto &c : n.children) {
+    const auto len = path.size();
+    path += c->edge;
+    collect(*c, path, after, limit, out);
+    path.resize(len);
+    if (limit != 0 && out->size() >= limit)
+      return;
+  }
+}
+
+} // namespace
+
+RadixTree::RadixTree() : root_(std::make_unique<Node>()) {}
+RadixTree::~RadixTree() = default;
+
+void RadixTree::clear() {
+  root_ = std::make_unique<Node>();
+  size_ = 0;
+  nodes_ = 1;
+}
+
+bool RadixTree::insert(std::string_view key) {
+  Node *n = root_.get();
+  std::size_t i = 0;
+  while (i < key.size()) {
+    auto it = n->lower(key[i]);
+    if (it == n->children.end() || (*it)->edge[0] != key[i]) {
+      auto leaf = std::make_unique<Node>();
+      leaf->edge.assign(key.substr(i));
+      leaf->terminal = true;
+      n->children.insert(it, std::move(leaf));
+      ++nodes_;
+      ++size_;
+      return true;
+    }
+    Node *c = it->get();
+    const auto common = common_prefix(c->edge, key.substr(i));
+    if (common < c->edge.size()) {
+      // Split c's edge at the divergence point.
+      auto mid = std::make_unique<Node>();
+      mid->edge = c->edge.substr(0, common);
+      c->edge.erase(0, common);
+      mid->children.push_back(std::move(*it));
+      *it = std::move(mid);
+      ++nodes_;
+      c = it->get();
+    }
+    n = c;
+    i += common;
+  }
+  if (n->terminal)
+    return false;
+  n->terminal = true;
+  ++size_;
+  return true;
+}
+
+bool RadixTree::contains(std::string_view key) const {
+  const Node *n = root_.get();
+  std::size_t i = 0;
+  while (i < key.size()) {
+    n = n->child(key[i]);
+    if (n == nullptr || key.substr(i, n->edge.size()) != n->edge)
+      return false;
+    i += n->edge.size();
+  }
+  return n->terminal;
+}
+
+// Folds n's only child into n. n must be a non-root, non-terminal node.
+void RadixTree::merge_into(Node *n) {
+  auto child = std::move(n->children.front());
+  n->edge += child->edge;
+  n->terminal = child->terminal;
+  n->children = std::move(child->children);
+  --nodes_;
+}
+
+bool RadixTree::erase(std::string_view key) {
+  Node *parent = nullptr;
+  Node *n = root_.get();
+  std::size_t i = 0;
+  while (i < key.size()) {
+    Node *c = n->child(key[i]);
+    if (c == nullptr || key.substr(i, c->edge.size()) != c->edge)
+      return false;
+    parent = n;
+    n = c;
+    i += c->edge.size();
+  }
+  if (!n->terminal)
+    return false;
+  n->terminal = false;
+  --size_;
+  if (parent == nullptr)
+    return true;
+  if (n->children.empty()) {
+    parent->children.erase(parent->lower(n->edge[0]));
+    --nodes_;
+    if (parent != root_.get() && !parent->terminal &&
+        parent->children.size() == 1)
+      merge_into(parent);
+  } else if (n->children.size() == 1) {
+    merge_into(n);
+  }
+  return true;
+}
+
+RadixTree::Hit RadixTree::locate(std::string_view prefix) const {
+  Hit h;
+  h.node = root_.get();
+  std::size_t i = 0;
+  while (i < prefix.size()) {
+    Node *c = h.node->child(prefix[i]);
+    if (c == nullptr)
+      return {};
+    const auto want = std::min(c->edge.size(), prefix.size() - i);
+    if (prefix.substr(i, want) != std::string_view(c->edge).substr(0, want))
+      return {};
+    h.parent = h.node;
+    h.node = c;
+    h.path += c->edge;
+    i += c->edge.size();
+  }
+  return h;
+}
+
+std::vector<std::string> RadixTree::erase_prefix(std::string_view prefix) {
+  std::vector<std::string> keys;
+  auto h = locate(prefix);
+  if (h.node == nullptr)
+    return keys;
+  collect(*h.node, h.path, {}, 0, &keys);
+  if (h.parent == nullptr) {
+    clear();
+    return keys;
+  }
+  nodes_ -= count_nodes(*h.node);
+  size_ -= keys.size();
+  Node *parent = h.parent;
+  parent->children.erase(parent->lower(h.node->edge[0]));
+  if (parent != root_.get() && !parent->terminal &&
+      parent->children.size() == 1)
+    merge_into(parent);
+  return keys;
+}
+
+std::vector<std::string> RadixTree::scan(std::string_view prefix,
+                                         std::string_view after,
+                                         std::size_t limit) const {
+  std::vector<std::string> keys;
+  auto h = locate(prefix);
+  if (h.node != nullptr && limit > 0)
+    collect(*h.node, h.path, after, limit, &keys);
+  return keys;
+}
+
+} // namespace pomai_cache
@@ -0,0 +1,61 @@
+#include "pomai_cache/sketch.hpp"
+
+#include <algorithm>
+
+namespace pomai_cache {
+namespace {
+std::uint64_t mix64(std::uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+} // namespace
+
+CountMinSketch::CountMinSketch(std::size_t width) {
+  std::size_t w = 64;
+  while (w < width)
+    w <<= 1;
+  mask_ = w - 1;
+  counters_.assign(w * kRows, 0);
+  sample_size_ = 10 * static_cast<std::uint64_t>(w);
+}
+
+std::size_t CountMinSketch::slot(int row, std::uint64_t key_hash) const {
+  const auto h = mix64(key_hash + static_cast<std::uint64_t>(row) *
+                                      0x9E3779B97F4A7C15ULL);
+  return static_cast<std::size_t>(row) * (mask_ + 1) + (h & mask_);
+}
+
+void CountMinSketch::increment(std::uint64_t key_hash) {
+  for (int r = 0; r < kRows; ++r) {
+    auto &c = counters_[slot(r, key_hash)];
+    if (c < UINT8_MAX)
+      ++c;
+  }
+  if (++additions_ >= sample_size_)
+    halve();
+}
+
+std::uint32_t CountMinSketch::estimate(std::uint64_t key_hash) const {
+  std::uint32_t best = UINT8_MAX;
+  for (int r = 0; r < kRows; ++r)
+    best = std::min<std::uint32_t>(best, counters_[slot(r, key_hash)]);
+  return best;
+}
+
+void CountMinSketch::clear() {
+  std::fill(counters_.begin(), counters_.end(), 0);
+  additions_ = 0;
+}
+
+void CountMinSketch::halve() {
+  for (auto &c : counters_)
+    c = static_cast<std::uint8_t>(c >> 1);
+  additions_ /= 2;
+  ++resets_;
+}
+
+} // namespace pomai_cache
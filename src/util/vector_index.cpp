@@ -0,0 +1,264 @@
+#include "pomai_cache/vector_index.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+namespace pomai_cache {
+
+VectorIndex::VectorIndex(std::size_t dim, VectorType type,
+                         VectorIndexConfig cfg)
+    : dim_(dim), type_(type), bytes_(dim * vector_type_width(type)),
+      cfg_(cfg) {
+  cfg_.max_list = std::max<std::size_t>(cfg_.max_list, 2);
+  cfg_.nprobe = std::max<std::size_t>(cfg_.nprobe, 1);
+}
+
+float VectorIndex::dot(const std::uint8_t *a, const std::uint8_t *b) const {
+  switch (type_) {
+  case VectorType::Float32:
+    return dot_f32(reinterpret_cast<const float *>(a),
+                   reinterpret_cast<const float *>(b), dim_);
+  case VectorType::Float16:
+    return dot_f16(reinterpret_cast<const std::uint16_t *>(a),
+                   reinterpret_cast<const std::uint16_t *>(b), dim_);
+  case VectorType::Int8:
+    return static_cast<float>(dot_i8(reinterpret_cast<const std::int8_t *>(a),
+                                     reinterpret_cast<const std::int8_t *>(b),
+                                     dim_));
+  }
+  return 0;
+}
+
+// `v` decoded to float and scaled to unit length (left zero if it is zero).
+void VectorIndex::unit(const std::uint8_t *v, float *out) const {
+  switch (type_) {
+  case VectorType::Float32:
+    std::memcpy(out, v, bytes_);
+    break;
+  case VectorType::Float16:
+    for (std::size_t i = 0; i < dim_; ++i) {
+      std::uint16_t h = 0;
+      std::memcpy(&h, v + 2 * i, 2);
+      out[i] = half_to_float(h);
+    }
+    break;
+  case VectorType::Int8:
+    for (std::size_t i = 0; i < dim_; ++i)
+      out[i] = static_cast<float>(static_cast<std::int8_t>(v[i]));
+    break;
+  }
+  const float n = std::sqrt(dot_f32(out, out, dim_));
+  if (n > 0 && std::isfinite(n))
+    for (std::size_t i = 0; i < dim_; ++i)
+      out[i] /= n;
+}
+
+std::uint32_t VectorIndex::nearest_list(const float *u) const {
+  std::uint32_t best = 0;
+  float best_sim = -2;
+  for (std::uint32_t l = 0; l < lists_.size(); ++l) {
+    const float sim = dot_f32(u, lists_[l].centroid.data(), dim_);
+    if (sim > best_sim) {
+      best_sim = sim;
+      best = l;
+    }
+  }
+  return best;
+}
+
+void VectorIndex::refresh_centroid(List &l) const {
+  const float n = std::sqrt(dot_f32(l.sum.data(), l.sum.data(), dim_));
+  for (std::size_t i = 0; i < dim_; ++i)
+    l.centroid[i] = n > 0 ? l.sum[i] / n : 0;
+}
+
+void VectorIndex::attach(std::uint32_t slot, std::uint32_t list,
+                         const float *u) {
+  auto &l = lists_[list];
+  slots_[slot].list = list;
+  slots_[slot].pos = static_cast<std::uint32_t>(l.slots.size());
+  l.slots.push_back(slot);
+  for (std::size_t i = 0; i < dim_; ++i)
+    l.sum[i] += u[i];
+  refresh_centroid(l);
+}
+
+void VectorIndex::detach(std::uint32_t slot, const float *u) {
+  const auto list = slots_[slot].list;
+  auto &l = lists_[list];
+  const auto last = l.slots.back();
+  l.slots[slots_[slot].pos] = last;
+  slots_[last].pos = slots_[slot].pos;
+  l.slots.pop_back();
+  for (std::size_t i = 0; i < dim_; ++i)
+    l.sum[i] -= u[i];
+  refresh_centroid(l);
+  if (!l.slots.empty() || lists_.size() == 1)
+    return;
+  // Drop the empty list, moving the last one into its place.
+  if (list + 1 != lists_.size()) {
+    lists_[list] = std::move(lists_.back());
+    for (const auto s : lists_[list].slots)
+      slots_[s].list = list;
+  }
+  lists_.pop_back();
+}
+
+// 2-means over one list's members, seeded with the member farthest from the
+// centroid and the member farthest from that one.
+void VectorIndex::split(std::uint32_t list) {
+  const auto members = lists_[list].slots;
+  const std::size_t n = members.size();
+  std::vector<float> units(n * dim_);
+  for (std::size_t i = 0; i < n; ++i)
+    unit(vec(members[i]), &units[i * dim_]);
+  auto farthest = [&](const float *from) {
+    std::size_t best = 0;
+    float best_sim = 2;
+    for (std::size_t i = 0; i < n; ++i) {
+      const float sim = dot_f32(from, &units[i * dim_], dim_);
+      if (sim < best_sim) {
+        best_sim = sim;
+        best = i;
+      }
+    }
+    return best;
+  };
+  const auto a = farthest(lists_[list].centroid.data());
+  const auto b = farthest(&units[a * dim_]);
+  std::vector<float> c0(units.begin() + a * dim_,
+                        units.begin() + (a + 1) * dim_);
+  std::vector<float> c1(units.begin() + b * dim_,
+                        units.begin() + (b + 1) * dim_);
+  std::vector<std::uint8_t> side(n, 0);
+  bool separated = false;
+  for (int iter = 0; iter < 4; ++iter) {
+    std::vector<float> s0(dim_, 0), s1(dim_, 0);
+    std::size_t n1 = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+      const float *u = &units[i * dim_];
+      side[i] = dot_f32(u, c1.data(), dim_) > dot_f32(u, c0.data(), dim_);
+      auto &s = side[i] ? s1 : s0;
+      for (std::size_t d = 0; d < dim_; ++d)
+        s[d] += u[d];
+      n1 += side[i];
+    }
+    separated = n1 > 0 && n1 < n;
+    if (!separated)
+      break;
+    const float l0 = std::sqrt(dot_f32(s0.data(), s0.data(), dim_));
+    const float l1 = std::sqrt(dot_f32(s1.data(), s1.data(), dim_));
+    for (std::size_t d = 0; d < dim_; ++d) {
+      c0[d] = l0 > 0 ? s0[d] / l0 : 0;
+      c1[d] = l1 > 0 ? s1[d] / l1 : 0;
+    }
+  }
+  // Identical vectors cannot be told apart; halve the list anyway so it
+  // stays scannable.
+  if (!separated)
+    for (std::size_t i = 0; i < n; ++i)
+      side[i] = i % 2;
+
+  const auto fresh = static_cast<std::uint32_t>(lists_.size());
+  lists_.push_back({{}, std::vector<float>(dim_, 0),
+                    std::vector<float>(dim_, 0)});
+  auto &old = lists_[list];
+  old.slots.clear();
+  std::fill(old.sum.begin(), old.sum.end(), 0.0f);
+  for (std::size_t i = 0; i < n; ++i)
+    attach(members[i], side[i] ? fresh : list, &units[i * dim_]);
+}
+
+void VectorIndex::add(std::uint32_t id, const std::uint8_t *v) {
+  remove(id);
+  std::uint32_t slot = 0;
+  if (!free_slots_.empty()) {
+    slot = free_slots_.back();
+    free_slots_.pop_back();
+  } else {
+    slot = static_cast<std::uint32_t>(slots_.size());
+    slots_.emplace_back();
+    data_.resize(slots_.size() * bytes_);
+  }
+  std::memcpy(data_.data() + std::size_t{slot} * bytes_, v, bytes_);
+  slots_[slot].id = id;
+  slots_[slot].norm = std::sqrt(std::max(0.0f, dot(vec(slot), vec(slot))));
+  slot_of_[id] = slot;
+
+  std::vector<float> u(dim_);
+  unit(vec(slot), u.data());
+  if (lists_.empty())
+    lists_.push_back({{}, std::vector<float>(dim_, 0),
+                      std::vector<float>(dim_, 0)});
+  const auto list = nearest_list(u.data());
+  attach(slot, list, u.data());
+  if (lists_[list].slots.size() > cfg_.max_list)
+    split(list);
+}
+
+bool VectorIndex::remove(std::uint32_t id) {
+  auto it = slot_of_.find(id);
+  if (it == slot_of_.end())
+    return false;
+  const auto slot = it->second;
+  slot_of_.erase(it);
+  if (slot_of_.empty()) {
+    // Start over rather than carry centroid drift into an empty index.
+    data_.clear();
+    slots_.clear();
+    free_slots_.clear();
+    lists_.clear();
+    return true;
+  }
+  std::vector<float> u(dim_);
+  unit(vec(slot), u.data());
+  detach(slot, u.data());
+  free_slots_.push_back(slot);
+  return true;
+}
+
+std::vector<std::pair<std::uint32_t, float>>
+VectorIndex::search(const std::uint8_t *query, std::size_t k) const {
+  using Hit = std::pair<std::uint32_t, float>;
+  std::vector<Hit> out;
+  if (k == 0 || slot_of_.empty())
+    return out;
+  std::vector<std::uint32_t> probe(lists_.size());
+  std::iota(probe.begin(), probe.end(), 0u);
+  if (lists_.size() > cfg_.nprobe) {
+    std::vector<float> u(dim_);
+    unit(query, u.data());
+    std::vector<float> sim(lists_.size());
+    for (std::size_t l = 0; l < lists_.size(); ++l)
+      sim[l] = dot_f32(u.data(), lists_[l].centroid.data(), dim_);
+    const auto mid = probe.begin() + static_cast<std::ptrdiff_t>(cfg_.nprobe);
+    std::partial_sort(probe.begin(), mid, probe.end(),
+                      [&sim](auto x, auto y) { return sim[x] > sim[y]; });
+    probe.resize(cfg_.nprobe);
+  }
+
+  // Min-heap on similarity holding the best k so far.
+  auto better = [](const Hit &x, const Hit &y) { return x.second > y.second; };
+  const float qnorm = std::sqrt(std::max(0.0f, dot(query, query)));
+  for (const auto l : probe) {
+    for (const auto slot : lists_[l].slots) {
+      const auto &s = slots_[slot];
+      const float denom = qnorm * s.norm;
+      const float sim = denom > 0 ? dot(query, vec(slot)) / denom : 0;
+      if (out.size() < k) {
+        out.emplace_back(s.id, sim);
+        std::push_heap(out.begin(), out.end(), better);
+      } else if (sim > out.front().second) {
+        std::pop_heap(out.begin(), out.end(), better);
+        out.back() = {s.id, sim};
+        std::push_heap(out.begin(), out.end(), better);
+      }
+    }
+  }
+  std::sort_heap(out.begin(), out.end(), better);
+  return out;
+}
+
+} // namespace pomai_cache
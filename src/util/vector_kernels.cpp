@@ -0,0 +1,491 @@
+#include "pomai_cache/vector_index.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define POMAI_VEC_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define POMAI_VEC_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace pomai_cache {
+
+bool parse_vector_type(std::string_view name, VectorType *out) {
+  if (name == "float")
+    *out = VectorType::Float32;
+  else if (name == "float16")
+    *out = VectorType::Float16;
+  else if (name == "int8")
+    *out = VectorType::Int8;
+  else
+    return false;
+  return true;
+}
+
+const char *vector_type_name(VectorType type) {
+  switch (type) {
+  case VectorType::Float32:
+    return "float";
+  case VectorType::Float16:
+    return "float16";
+  case VectorType::Int8:
+    return "int8";
+  }
+  return "unknown";
+}
+
+std::size_t vector_type_width(VectorType type) {
+  switch (type) {
+  case VectorType::Float32:
+    return 4;
+  case VectorType::Float16:
+    return 2;
+  case VectorType::Int8:
+    return 1;
+  }
+  return 0;
+}
+
+const char *vector_codec_name(VectorCodec codec) {
+  switch (codec) {
+  case VectorCodec::Float32:
+    return "float";
+  case VectorCodec::Float16:
+    return "float16";
+  case VectorCodec::Int8:
+    return "int8";
+  case VectorCodec::Int8Scaled:
+    return "int8_scaled";
+  }
+  return "unknown";
+}
+
+float half_to_float(std::uint16_t h) {
+  const std::uint32_t sign = std::uint32_t{h & 0x8000u} << 16;
+  std::uint32_t exp = (h >> 10) & 0x1F;
+  std::uint32_t man = h & 0x3FF;
+  std::uint32_t bits = 0;
+  if (exp == 0 && man == 0) {
+    bits = sign;
+  } else if (exp == 0) {
+    // Subnormal: renormalize into a float exponent.
+    exp = 127 - 15 + 1;
+    while (!(man & 0x400)) {
+      man <<= 1;
+      --exp;
+    }
+    bits = sign | (exp << 23) | ((man & 0x3FF) << 13);
+  } else if (exp == 31) {
+    bits = sign | 0x7F800000u | (man << 13);
+  } else {
+    bits = sign | ((exp + 127 - 15) << 23) | (man << 13);
+  }
+  return std::bit_cast<float>(bits);
+}
+
+std::uint16_t float_to_half(float f) {
+  const auto x = std::bit_cast<std::uint32_t>(f);
+  const auto sign = static_cast<std::uint16_t>((x >> 16) & 0x8000);
+  const int exp = static_cast<int>((x >> 23) & 0xFF);
+  std::uint32_t man = x & 0x7FFFFF;
+  if (exp == 0xFF)
+    return sign | 0x7C00 | (man ? 0x200 : 0);
+  const int e = exp - 127 + 15;
+  if (e >= 31)
+    return sign | 0x7C00;
+  std::uint32_t half = 0;
+  std::uint32_t rem = 0;
+  std::uint32_t mid = 0;
+  if (e <= 0) {
+    if (e < -10)
+      return sign;
+    man |= 0x800000;
+    const int shift = 14 - e;
+    half = man >> shift;
+    rem = man & ((1u << shift) - 1);
+    mid = 1u << (shift - 1);
+  } else {
+    half = (static_cast<std::uint32_t>(e) << 10) | (man >> 13);
+    rem = man & 0x1FFF;
+    mid = 0x1000;
+  }
+  // A carry out of the mantissa correctly bumps the exponent, up to inf.
+  if (rem > mid || (rem == mid && (half & 1)))
+    ++half;
+  return static_cast<std::uint16_t>(sign | half);
+}
+
+namespace {
+
+float dot_f32_scalar(const float *a, const float *b, std::size_t n) {
+  float s = 0;
+  for (std::size_t i = 0; i < n; ++i)
+    s += a[i] * b[i];
+  return s;
+}
+
+float dot_f16_scalar(const std::uint16_t *a, const std::uint16_t *b,
+                     std::size_t n) {
+  float s = 0;
+  for (std::size_t i = 0; i < n; ++i)
+    s += half_to_float(a[i]) * half_to_float(b[i]);
+  return s;
+}
+
+std::int32_t dot_i8_scalar(const std::int8_t *a, const std::int8_t *b,
+                           std::size_t n) {
+  std::int32_t s = 0;
+  for (std::size_t i = 0; i < n; ++i)
+    s += std::int32_t{a[i]} * std::int32_t{b[i]};
+  return s;
+}
+
+void to_f16_scalar(const float *in, std::uint16_t *out, std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i)
+    out[i] = float_to_half(in[i]);
+}
+
+void from_f16_scalar(const std::uint16_t *in, float *out, std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i)
+    out[i] = half_to_float(in[i]);
+}
+
+std::int8_t quantize_one(float x, float inv) {
+  const float q = std::nearbyint(x * inv);
+  return static_cast<std::int8_t>(std::clamp(q, -127.0f, 127.0f));
+}
+
+// Returns 1/scale for max|x| = m, or 0 when the vector cannot be scaled.
+float quantize_inv(float m) {
+  return m > 0 && std::isfinite(m) ? 127.0f / m : 0.0f;
+}
+
+float quantize_scalar(const float *in, std::int8_t *out, std::size_t n) {
+  float m = 0;
+  for (std::size_t i = 0; i < n; ++i)
+    m = std::max(m, std::abs(in[i]));
+  const float inv = quantize_inv(m);
+  for (std::size_t i = 0; i < n; ++i)
+    out[i] = inv > 0 ? quantize_one(in[i], inv) : 0;
+  return inv > 0 ? m / 127.0f : 0.0f;
+}
+
+void dequantize_scalar(const std::int8_t *in, float scale, float *out,
+                       std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i)
+    out[i] = static_cast<float>(in[i]) * scale;
+}
+
+#if defined(POMAI_VEC_X86) && (defined(__GNUC__) || defined(__clang__))
+#define POMAI_VEC_AVX2 1
+__attribute__((target("avx2,fma"))) float hsum256(__m256 v) {
+  __m128 s =
+      _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+  s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+  return _mm_cvtss_f32(s);
+}
+
+__attribute__((target("avx2,fma"))) float
+dot_f32_avx2(const float *a, const float *b, std::size_t n) {
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i),
+                           acc0);
+    acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8),
+                           _mm256_loadu_ps(b + i + 8), acc1);
+  }
+  for (; i + 8 <= n; i += 8)
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i),
+                           acc0);
+  float s = hsum256(_mm256_add_ps(acc0, acc1));
+  for (; i < n; ++i)
+    s += a[i] * b[i];
+  return s;
+}
+
+__attribute__((target("avx2,fma,f16c"))) float
+dot_f16_avx2(const std::uint16_t *a, const std::uint16_t *b, std::size_t n) {
+  __m256 acc = _mm256_setzero_ps();
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256 x = _mm256_cvtph_ps(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i)));
+    const __m256 y = _mm256_cvtph_ps(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i)));
+    acc = _mm256_fmadd_ps(x, y, acc);
+  }
+  float s = hsum256(acc);
+  for (; i < n; ++i)
+    s += half_to_float(a[i]) * half_to_float(b[i]);
+  return s;
+}
+
+__attribute__((target("avx2"))) std::int32_t
+dot_i8_avx2(const std::int8_t *a, const std::int8_t *b, std::size_t n) {
+  // Widen 16 bytes to int16 lanes; madd sums adjacent products into int32.
+  __m256i acc = _mm256_setzero_si256();
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const __m256i x = _mm256_cvtepi8_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i)));
+    const __m256i y = _mm256_cvtepi8_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i)));
+    acc = _mm256_add_epi32(acc, _mm256_madd_epi16(x, y));
+  }
+  __m128i s = _mm_add_epi32(_mm256_castsi256_si128(acc),
+                            _mm256_extracti128_si256(acc, 1));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+  std::int32_t r = _mm_cvtsi128_si32(s);
+  for (; i < n; ++i)
+    r += std::int32_t{a[i]} * std::int32_t{b[i]};
+  return r;
+}
+
+__attribute__((target("avx2,f16c"))) void
+to_f16_avx2(const float *in, std::uint16_t *out, std::size_t n) {
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i *>(out + i),
+        _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT));
+  for (; i < n; ++i)
+    out[i] = float_to_half(in[i]);
+}
+
+__attribute__((target("avx2,f16c"))) void
+from_f16_avx2(const std::uint16_t *in, float *out, std::size_t n) {
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    _mm256_storeu_ps(out + i,
+                     _mm256_cvtph_ps(_mm_loadu_si128(
+                         reinterpret_cast<const __m128i *>(in + i))));
+  for (; i < n; ++i)
+    out[i] = half_to_float(in[i]);
+}
+
+__attribute__((target("avx2"))) float
+quantize_avx2(const float *in, std::int8_t *out, std::size_t n) {
+  const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+  __m256 mx = _mm256_setzero_ps();
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    mx = _mm256_max_ps(mx, _mm256_and_ps(abs_mask, _mm256_loadu_ps(in + i)));
+  __m128 m4 = _mm_max_ps(_mm256_castps256_ps128(mx),
+                         _mm256_extractf128_ps(mx, 1));
+  m4 = _mm_max_ps(m4, _mm_movehl_ps(m4, m4));
+  m4 = _mm_max_ss(m4, _mm_shuffle_ps(m4, m4, 1));
+  float m = _mm_cvtss_f32(m4);
+  for (; i < n; ++i)
+    m = std::max(m, std::abs(in[i]));
+  const float inv = quantize_inv(m);
+  if (inv == 0) {
+    std::memset(out, 0, n);
+    return 0;
+  }
+  // Round to nearest even as the scalar path does; saturating packs keep
+  // the codes within int8, and the permute undoes the packs' lane split.
+  const __m256 vinv = _mm256_set1_ps(inv);
+  i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const __m256i a =
+        _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(in + i), vinv));
+    const __m256i b =
+        _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(in + i + 8), vinv));
+    const __m256i w = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b),
+                                               _MM_SHUFFLE(3, 1, 2, 0));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i),
+                     _mm_packs_epi16(_mm256_castsi256_si128(w),
+                                     _mm256_extracti128_si256(w, 1)));
+  }
+  for (; i < n; ++i)
+    out[i] = quantize_one(in[i], inv);
+  return m / 127.0f;
+}
+
+__attribute__((target("avx2"))) void
+dequantize_avx2(const std::int8_t *in, float scale, float *out,
+                std::size_t n) {
+  const __m256 vs = _mm256_set1_ps(scale);
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256i q = _mm256_cvtepi8_epi32(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i *>(in + i)));
+    _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(q), vs));
+  }
+  for (; i < n; ++i)
+    out[i] = static_cast<float>(in[i]) * scale;
+}
+#endif
+
+#if defined(POMAI_VEC_NEON)
+float dot_f32_neon(const float *a, const float *b, std::size_t n) {
+  float32x4_t acc = vdupq_n_f32(0);
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    acc = vfmaq_f32(acc, vld1q_f32(a + i), vld1q_f32(b + i));
+  float s = vaddvq_f32(acc);
+  for (; i < n; ++i)
+    s += a[i] * b[i];
+  return s;
+}
+
+float dot_f16_neon(const std::uint16_t *a, const std::uint16_t *b,
+                   std::size_t n) {
+  auto load = [](const std::uint16_t *p) {
+    return vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(p)));
+  };
+  float32x4_t acc = vdupq_n_f32(0);
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    acc = vfmaq_f32(acc, load(a + i), load(b + i));
+  float s = vaddvq_f32(acc);
+  for (; i < n; ++i)
+    s += half_to_float(a[i]) * half_to_float(b[i]);
+  return s;
+}
+
+std::int32_t dot_i8_neon(const std::int8_t *a, const std::int8_t *b,
+                         std::size_t n) {
+  int32x4_t acc = vdupq_n_s32(0);
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const int8x16_t x = vld1q_s8(a + i);
+    const int8x16_t y = vld1q_s8(b + i);
+    acc = vpadalq_s16(acc, vmull_s8(vget_low_s8(x), vget_low_s8(y)));
+    acc = vpadalq_s16(acc, vmull_high_s8(x, y));
+  }
+  std::int32_t r = vaddvq_s32(acc);
+  for (; i < n; ++i)
+    r += std::int32_t{a[i]} * std::int32_t{b[i]};
+  return r;
+}
+
+void to_f16_neon(const float *in, std::uint16_t *out, std::size_t n) {
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    vst1_u16(out + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(in + i))));
+  for (; i < n; ++i)
+    out[i] = float_to_half(in[i]);
+}
+
+void from_f16_neon(const std::uint16_t *in, float *out, std::size_t n) {
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    vst1q_f32(out + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(in + i))));
+  for (; i < n; ++i)
+    out[i] = half_to_float(in[i]);
+}
+
+float quantize_neon(const float *in, std::int8_t *out, std::size_t n) {
+  float32x4_t mx = vdupq_n_f32(0);
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    mx = vmaxq_f32(mx, vabsq_f32(vld1q_f32(in + i)));
+  float m = vmaxvq_f32(mx);
+  for (; i < n; ++i)
+    m = std::max(m, std::abs(in[i]));
+  const float inv = quantize_inv(m);
+  if (inv == 0) {
+    std::memset(out, 0, n);
+    return 0;
+  }
+  i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const int32x4_t a = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(in + i), inv));
+    const int32x4_t b =
+        vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(in + i + 4), inv));
+    vst1_s8(out + i, vqmovn_s16(vcombine_s16(vqmovn_s32(a), vqmovn_s32(b))));
+  }
+  for (; i < n; ++i)
+    out[i] = quantize_one(in[i], inv);
+  return m / 127.0f;
+}
+
+void dequantize_neon(const std::int8_t *in, float scale, float *out,
+                     std::size_t n) {
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const int16x8_t w = vmovl_s8(vld1_s8(in + i));
+    vst1q_f32(out + i,
+              vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(w))), scale));
+    vst1q_f32(out + i + 4,
+              vmulq_n_f32(vcvtq_f32_s32(vmovl_high_s16(w)), scale));
+  }
+  for (; i < n; ++i)
+    out[i] = static_cast<float>(in[i]) * scale;
+}
+#endif
+
+struct VectorKernel {
+  float (*f32)(const float *, const float *, std::size_t);
+  float (*f16)(const std::uint16_t *, const std::uint16_t *, std::size_t);
+  std::int32_t (*i8)(const std::int8_t *, const std::int8_t *, std::size_t);
+  void (*to_f16)(const float *, std::uint16_t *, std::size_t);
+  void (*from_f16)(const std::uint16_t *, float *, std::size_t);
+  float (*quantize)(const float *, std::int8_t *, std::size_t);
+  void (*dequantize)(const std::int8_t *, float, float *, std::size_t);
+  const char *name;
+};
+
+VectorKernel pick_kernel() {
+#if defined(POMAI_VEC_AVX2)
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") &&
+      __builtin_cpu_supports("f16c"))
+    return {dot_f32_avx2, dot_f16_avx2, dot_i8_avx2, to_f16_avx2,
+            from_f16_avx2, quantize_avx2, dequantize_avx2, "avx2"};
+#endif
+#if defined(POMAI_VEC_NEON)
+  return {dot_f32_neon, dot_f16_neon, dot_i8_neon, to_f16_neon,
+          from_f16_neon, quantize_neon, dequantize_neon, "neon"};
+#else
+  return {dot_f32_scalar, dot_f16_scalar, dot_i8_scalar, to_f16_scalar,
+          from_f16_scalar, quantize_scalar, dequantize_scalar, "scalar"};
+#endif
+}
+
+const VectorKernel kKernel = pick_kernel();
+
+} // namespace
+
+float dot_f32(const float *a, const float *b, std::size_t n) {
+  return kKernel.f32(a, b, n);
+}
+
+float dot_f16(const std::uint16_t *a, const std::uint16_t *b, std::size_t n) {
+  return kKernel.f16(a, b, n);
+}
+
+std::int32_t dot_i8(const std::int8_t *a, const std::int8_t *b,
+                    std::size_t n) {
+  return kKernel.i8(a, b, n);
+}
+
+void f32_to_f16(const float *in, std::uint16_t *out, std::size_t n) {
+  kKernel.to_f16(in, out, n);
+}
+
+void f16_to_f32(const std::uint16_t *in, float *out, std::size_t n) {
+  kKernel.from_f16(in, out, n);
+}
+
+float quantize_i8(const float *in, std::int8_t *out, std::size_t n) {
+  return kKernel.quantize(in, out, n);
+}
+
+void dequantize_i8(const std::int8_t *in, float scale, float *out,
+                   std::size_t n) {
+  kKernel.dequantize(in, scale, out, n);
+}
+
+const char *vector_kernel_impl_name() { return kKernel.name; }
+
+} // namespace pomai_cache
@@ -1,7 +1,14 @@
 #include "pomai_cache/ai_cache.hpp"
+#include "pomai_cache/hash.hpp"
 
 #include <catch2/catch_test_macros.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+
 using namespace pomai_cache;
 
 TEST_CASE("AI canonical keys deterministic", "[ai][keys]") {
@@ -27,7 +34,7 @@ TEST_CASE("AI PUT/GET roundtrip and dedup", "[ai][roundtrip]") {
 
   auto got = ai.get("k1");
   REQUIRE(got.has_value());
-  REQUIRE(got->payload == payload);
+  REQUIRE(*got->payload == payload);
 
   auto stats = ai.stats();
   REQUIRE(stats.find("dedup_hits:1") != std::string::npos);
@@ -72,3 +79,671 @@ TEST_CASE("AI meta and caps validation", "[ai][adversarial]") {
                   payload, &err));
   REQUIRE(err.find("blob put failed") != std::string::npos);
 }
+
+TEST_CASE("AI meta parser handles escapes, float costs and tags",
+          "[ai][meta]") {
+  ArtifactMeta m;
+  std::string err;
+  REQUIRE(AiArtifactCache::parse_meta_json(
+      R"({"artifact_type":"rag_chunk","owner":"rag","schema_version":"v1",
+          "note":{"nested":[1,"}",{"x":null}]},
+          "source_id":"doc \"7\"\\a\u00e9","miss_cost":2.5,
+          "created_at":"not-a-number","size_bytes":12,
+          "tags":{"lang":"en","tier":3}})",
+      m, &err));
+  CHECK(m.artifact_type == "rag_chunk");
+  CHECK(m.source_id == "doc \"7\"\\a\xc3\xa9");
+  CHECK(m.miss_cost == 2.5);
+  CHECK(m.created_at_ms == 0);
+  CHECK(m.size_bytes == 12);
+  CHECK((m.tags == std::vector<std::string>{"lang=en", "tier=3"}));
+  CHECK(m.tags_json == R"({"lang":"en","tier":3})");
+
+  // meta_to_json escapes what the parser decoded.
+  ArtifactMeta back;
+  REQUIRE(AiArtifactCache::parse_meta_json(AiArtifactCache::meta_to_json(m),
+                                           back));
+  CHECK(back.source_rev == m.source_rev);
+  CHECK(back.miss_cost == 2.5);
+  CHECK(back.tags == m.tags);
+
+  CHECK_FALSE(AiArtifactCache::parse_meta_json(
+      R"({"artifact_type":"a","owner":"o","schema_version":"v1",})", m,
+      &err));
+  CHECK(err.find("malformed") != std::string::npos);
+  CHECK_FALSE(AiArtifactCache::parse_meta_json(
+      R"({"artifact_type":"a","owner":"o","schema_version":"v1"} x)", m));
+  CHECK_FALSE(AiArtifactCache::parse_meta_json(
+      R"({"artifact_type":"a","owner":"o","schema_version":"v1","s":"\q"})",
+      m));
+}
+
+TEST_CASE("AI binary meta round-trips and is served pre-encoded",
+          "[ai][meta]") {
+  Engine e({4 * 1024 * 1024, 256, 1024 * 1024},
+           make_policy_by_name("pomai_cost"));
+  AiArtifactCache ai(e);
+
+  ArtifactMeta m;
+  m.artifact_type = "embedding";
+  m.owner = "vector";
+  m.model_id = "m\"1";
+  m.snapshot_epoch = "ep1";
+  m.miss_cost = 6.5;
+  m.tags = {"lang=en", "tier=gold"};
+  const auto bin = AiArtifactCache::meta_to_binary(m);
+  std::vector<std::uint8_t> payload{1, 2, 3};
+  REQUIRE(ai.put_binary("embedding", "k1", bin, payload));
+
+  auto got = ai.get("k1", MetaEncoding::Binary);
+  REQUIRE(got.has_value());
+  CHECK(*got->payload == payload);
+  ArtifactMeta back;
+  REQUIRE(AiArtifactCache::parse_meta_binary(*got->encoded_meta, back));
+  CHECK(back.model_id == "m\"1");
+  CHECK(back.miss_cost == 6.5);
+  CHECK(back.size_bytes == 3);
+  CHECK(back.tags == m.tags);
+  CHECK(back.tags_json == R"({"lang":"en","tier":"gold"})");
+
+  // The JSON form of the same entry parses to the same fields.
+  auto json = ai.mget({"k1"}, MetaEncoding::Json);
+  REQUIRE(json[0].has_value());
+  ArtifactMeta from_json;
+  REQUIRE(AiArtifactCache::parse_meta_json(*json[0]->encoded_meta, from_json));
+  CHECK(from_json.model_id == back.model_id);
+  CHECK(from_json.tags == back.tags);
+  // Hits share the encoding stored at put time instead of copying it.
+  CHECK(ai.get("k1", MetaEncoding::Binary)->encoded_meta ==
+        got->encoded_meta);
+  CHECK(ai.get("k1")->encoded_meta == json[0]->encoded_meta);
+  CHECK(ai.invalidate_epoch("ep1") == 1);
+
+  std::string err;
+  CHECK_FALSE(AiArtifactCache::parse_meta_binary(
+      std::string_view(bin).substr(0, bin.size() - 1), back, &err));
+  CHECK(err.find("malformed") != std::string::npos);
+  CHECK_FALSE(AiArtifactCache::parse_meta_binary(bin + "x", back));
+  m.owner.clear();
+  CHECK_FALSE(ai.put_binary("embedding", "k2",
+                            AiArtifactCache::meta_to_binary(m), payload, &err));
+  CHECK(err.find("missing") != std::string::npos);
+}
+
+TEST_CASE("AI GET shares the blob buffer and accounts key and blob",
+          "[ai][zerocopy]") {
+  Engine e({4 * 1024 * 1024, 256, 1024 * 1024},
+           make_policy_by_name("pomai_cost"));
+  AiArtifactCache ai(e);
+  const std::string meta =
+      R"({"artifact_type":"embedding","owner":"vector","schema_version":"v1"})";
+  std::vector<std::uint8_t> payload(4096, 7);
+  REQUIRE(ai.put("embedding", "k1", meta, payload));
+  REQUIRE(ai.put("embedding", "k2", meta, payload));
+
+  const auto hits = e.stats().hits;
+  auto a = ai.get("k1");
+  auto b = ai.mget({"k2", "nope"});
+  REQUIRE(a.has_value());
+  REQUIRE(b[0].has_value());
+  CHECK_FALSE(b[1].has_value());
+  // Both keys name one blob, served from the engine's own buffer.
+  CHECK(a->payload.get() == b[0]->payload.get());
+  CHECK(*a->payload == payload);
+  CHECK(e.stats().hits == hits + 4);
+
+  // Re-putting a key with new content drops the old blob once unreferenced.
+  std::vector<std::uint8_t> other(16, 1);
+  REQUIRE(ai.put("embedding", "k1", meta, other));
+  REQUIRE(ai.put("embedding", "k2", meta, other));
+  CHECK(ai.stats().find("blob_count:1\n") != std::string::npos);
+  CHECK(*ai.get("k2")->payload == other);
+  // The buffer handed out earlier outlives the blob.
+  CHECK(*a->payload == payload);
+
+  // A ref deleted behind the cache's back is a miss.
+  e.del({"k1"});
+  CHECK_FALSE(ai.get("k1").has_value());
+}
+
+TEST_CASE("AI content hash is 128-bit and legacy hashes still dedup",
+          "[ai][hash]") {
+  // Pinned: blob keys are derived from these digits.
+  char hex[32];
+  hash128_hex(hash128("a", 1), hex);
+  CHECK(std::string(hex, 32) == "92a663ea9d05d22bb9d0519b8e1a416b");
+  CHECK_FALSE(hash128("a", 1) == hash128("a\0", 2));
+
+  // Every stripe/block boundary path is covered, and one flipped byte in a
+  // long input changes the hash.
+  std::vector<std::uint8_t> buf(5000);
+  for (std::size_t i = 0; i < buf.size(); ++i)
+    buf[i] = static_cast<std::uint8_t>(i * 131 + 7);
+  for (std::size_t len : {63, 64, 65, 1024, 1025, 5000}) {
+    const auto h = hash128(buf.data(), len);
+    buf[len / 2] ^= 1;
+    CHECK_FALSE(hash128(buf.data(), len) == h);
+    buf[len / 2] ^= 1;
+    CHECK(hash128(buf.data(), len) == h);
+  }
+  CHECK(AiArtifactCache::fast_hash_hex(buf).size() == 32);
+
+  // Every kernel built here gives the scalar result, over lengths up to two
+  // 1 KiB blocks.
+  for (std::size_t len = 0; len <= 2048; ++len) {
+    Hash128 scalar;
+    REQUIRE(hash128_using("scalar", buf.data(), len, &scalar));
+    CHECK(hash128(buf.data(), len) == scalar);
+    for (const char *impl : {"sse2", "avx2"}) {
+      Hash128 h;
+      if (hash128_using(impl, buf.data(), len, &h))
+        CHECK(h == scalar);
+    }
+  }
+  Hash128 none;
+  CHECK_FALSE(hash128_using("sse9", buf.data(), 1, &none));
+
+  Engine e({4 * 1024 * 1024, 256, 1024 * 1024},
+           make_policy_by_name("pomai_cost"));
+  AiArtifactCache ai(e);
+  const std::string legacy =
+      R"({"artifact_type":"prompt","owner":"prompt","schema_version":"v1",)"
+      R"("content_hash":"cbf29ce484222325"})";
+  std::vector<std::uint8_t> payload{4, 5, 6};
+  REQUIRE(ai.put("prompt", "p1", legacy, payload));
+  REQUIRE(ai.put("prompt", "p2", legacy, payload));
+  CHECK(ai.get("p2").has_value());
+  CHECK(ai.stats().find("dedup_hits:1\n") != std::string::npos);
+}
+
+TEST_CASE("AI chunked blobs dedup near-duplicate payloads", "[ai][chunking]") {
+  std::vector<std::uint8_t> base(96 * 1024);
+  std::uint64_t x = 88172645463325252ULL;
+  for (auto &b : base) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    b = static_cast<std::uint8_t>(x);
+  }
+  // Cut points follow content: inserting bytes near the front leaves the
+  // later boundaries where they were, shifted by the insertion.
+  const auto params = chunk_params_for(4096);
+  const auto ends = cdc_chunk_ends(base.data(), base.size(), params);
+  REQUIRE(ends.size() > 8);
+  auto edited = base;
+  edited.insert(edited.begin() + 100, {1, 2, 3});
+  const auto ends2 = cdc_chunk_ends(edited.data(), edited.size(), params);
+  std::size_t shared = 0;
+  for (auto e : ends)
+    shared += std::count(ends2.begin(), ends2.end(), e + 3);
+  CHECK(shared + 2 >= ends.size());
+  for (std::size_t i = 1; i + 1 < ends.size(); ++i) {
+    CHECK(ends[i] - ends[i - 1] >= params.min_bytes);
+    CHECK(ends[i] - ends[i - 1] <= params.max_bytes);
+  }
+
+  Engine e({8 * 1024 * 1024, 256, 1024 * 1024},
+           make_policy_by_name("pomai_cost"));
+  AiArtifactCache ai(e, {16 * 1024, 4096});
+  const std::string meta =
+      R"({"artifact_type":"rag_chunk","owner":"rag","schema_version":"v1",)"
+      R"("snapshot_epoch":"ep"})";
+  auto rev2 = base;
+  rev2[50 * 1024] ^= 0xFF;
+  REQUIRE(ai.put("rag_chunk", "rag:a", meta, base));
+  REQUIRE(ai.put("rag_chunk", "rag:b", meta, rev2));
+  // Small payloads keep the whole-blob path.
+  REQUIRE(ai.put("rag_chunk", "rag:s", meta, {1, 2, 3}));
+
+  auto a = ai.get("rag:a");
+  auto b = ai.mget({"rag:b", "rag:s"});
+  REQUIRE(a.has_value());
+  REQUIRE(b[0].has_value());
+  REQUIRE(b[1].has_value());
+  CHECK(a->payload == nullptr);
+  CHECK(a->chunks.size() == ends.size());
+  CHECK(a->payload_bytes() == base);
+  CHECK(b[0]->payload_bytes() == rev2);
+  CHECK((*b[1]->payload == std::vector<std::uint8_t>{1, 2, 3}));
+
+  const auto stats = ai.stats();
+  CHECK(stats.find("chunked_puts:2\n") != std::string::npos);
+  CHECK(stats.find("chunk_logical_bytes:" +
+                   std::to_string(2 * base.size()) + "\n") !=
+        std::string::npos);
+  // rev2 differs in one chunk, so it adds about one chunk of storage.
+  const auto pos = stats.find("chunk_stored_bytes:");
+  REQUIRE(pos != std::string::npos);
+  const auto stored = std::stoull(stats.substr(pos + 19));
+  CHECK(stored < base.size() + params.max_bytes);
+  CHECK(stats.find("chunk_dedup_ratio:1.") != std::string::npos);
+
+  // Losing one chunk is a miss for its key.
+  e.del({"blob:" + AiArtifactCache::fast_hash_hex(std::vector<std::uint8_t>(
+                       base.begin(), base.begin() + ends[0]))});
+  CHECK_FALSE(ai.get("rag:a").has_value());
+  CHECK(ai.invalidate_epoch("ep") == 3);
+  CHECK(ai.stats().find("chunk_count:0\nchunk_logical_bytes:0\n"
+                        "chunk_stored_bytes:0\n") != std::string::npos);
+}
+
+TEST_CASE("AI prefix invalidation and scan walk the key tree",
+          "[ai][invalidate]") {
+  // LRU admits everything: pomai_cost's per-second admission cap would
+  // reject some of the puts below on a fast run.
+  Engine e({16 * 1024 * 1024, 256, 1024 * 1024}, make_policy_by_name("lru"));
+  AiArtifactCache ai(e);
+  const std::string meta =
+      R"({"artifact_type":"embedding","owner":"vector","schema_version":"v1",)"
+      R"("model_id":"m","snapshot_epoch":"ep"})";
+  // More keys under one prefix than the old per-prefix cap, with a shared
+  // prefix longer than the old 32-byte limit.
+  const std::string deep = "emb:model-with-a-long-name:ih:768:";
+  for (int i = 0; i < 5000; ++i)
+    REQUIRE(ai.put("embedding", deep + std::to_string(i), meta,
+                   {static_cast<std::uint8_t>(i)}));
+  REQUIRE(ai.put("embedding", "emb:other:1", meta, {1}));
+  REQUIRE(ai.put("embedding", "emb:model-with-a-long-name:x", meta, {2}));
+
+  auto page = ai.scan("emb:", "", 2);
+  CHECK((page == std::vector<std::string>{deep + "0", deep + "1"}));
+  page = ai.scan("emb:", page.back(), 3);
+  CHECK((page == std::vector<std::string>{deep + "10", deep + "100",
+                                          deep + "1000"}));
+  CHECK((ai.scan("emb:o", "", 10) == std::vector<std::string>{"emb:other:1"}));
+  CHECK(ai.scan("emb:", "emb:other:1", 10).empty());
+
+  CHECK(ai.invalidate_prefix(deep + "49") == 111);
+  CHECK(ai.invalidate_prefix(deep) == 4889);
+  CHECK_FALSE(ai.get(deep + "4999").has_value());
+  CHECK(ai.get("emb:model-with-a-long-name:x").has_value());
+  CHECK(ai.get("emb:other:1").has_value());
+  CHECK(ai.invalidate_prefix(deep) == 0);
+  CHECK(ai.invalidate_epoch("ep") == 2);
+  CHECK(ai.stats().find("key_tree_nodes:1\n") != std::string::npos);
+}
+
+TEST_CASE("Roaring bitmap converts containers and combines sets",
+          "[ai][bitmap]") {
+  RoaringBitmap evens;
+  RoaringBitmap threes;
+  for (std::uint32_t v = 0; v < 200000; v += 2)
+    REQUIRE(evens.add(v));
+  for (std::uint32_t v = 0; v < 200000; v += 3)
+    threes.add(v);
+  CHECK_FALSE(evens.add(10));
+  CHECK(evens.cardinality() == 100000);
+  CHECK(evens.contains(131072));
+  CHECK_FALSE(evens.contains(131073));
+
+  auto both = evens;
+  both.intersect_with(threes);
+  CHECK(both.cardinality() == 33334);
+  auto either = evens;
+  either.union_with(threes);
+  CHECK(either.cardinality() == 100000 + 66667 - 33334);
+  const auto ids = both.to_vector();
+  CHECK(std::is_sorted(ids.begin(), ids.end()));
+  CHECK(ids.back() == 199998);
+
+  // A dense container shrinks back to an array as it empties.
+  for (std::uint32_t v = 0; v < 65536; v += 2)
+    REQUIRE(evens.remove(v));
+  CHECK_FALSE(evens.remove(0));
+  CHECK(evens.cardinality() == 100000 - 32768);
+  CHECK(evens.memory_bytes() < 3 * 8192 + 4096);
+}
+
+TEST_CASE("AI tag index answers AND/OR queries and invalidations",
+          "[ai][invalidate]") {
+  // LRU for the same reason as the key tree test: 12,000 sets.
+  Engine e({16 * 1024 * 1024, 256, 1024 * 1024}, make_policy_by_name("lru"));
+  AiArtifactCache ai(e);
+  auto meta = [](const std::string &tags) {
+    return R"({"artifact_type":"rag_chunk","owner":"rag",)"
+           R"("schema_version":"v1","snapshot_epoch":"ep","tags":)" +
+           tags + "}";
+  };
+  for (int i = 0; i < 6000; ++i) {
+    const auto tenant = "\"tenant\":\"t" + std::to_string(i % 3) + "\"";
+    const auto lang = i % 2 ? "\"lang\":\"en\"" : "\"lang\":\"de\"";
+    REQUIRE(ai.put("rag_chunk", "rag:" + std::to_string(i),
+                   meta("{" + tenant + "," + lang + "}"), {1}));
+  }
+  REQUIRE(ai.put("rag_chunk", "rag:x", meta(R"(["pinned"])"), {2}));
+
+  const std::vector<TagTerm> t0_en{{TagOp::And, "tenant=t0"},
+                                   {TagOp::And, "lang=en"}};
+  auto hits = ai.query_tags(t0_en, 3);
+  CHECK((hits == std::vector<std::string>{"rag:3", "rag:9", "rag:15"}));
+  CHECK(ai.query_tags(t0_en, 10000).size() == 1000);
+  CHECK(ai.query_tags({{TagOp::And, "pinned"}, {TagOp::Or, "nope"}}, 10) ==
+        std::vector<std::string>{"rag:x"});
+  CHECK(ai.query_tags({{TagOp::And, "nope"}, {TagOp::Or, "pinned"}}, 10) ==
+        std::vector<std::string>{"rag:x"});
+  CHECK(ai.query_tags({{TagOp::And, "pinned"}, {TagOp::And, "nope"}}, 10)
+            .empty());
+
+  CHECK(ai.invalidate_tags(t0_en) == 1000);
+  CHECK_FALSE(ai.get("rag:3").has_value());
+  CHECK(ai.get("rag:0").has_value());
+  CHECK(ai.query_tags({{TagOp::And, "tenant=t0"}}, 10000).size() == 1000);
+  // Freed ids are reused, and their old tags do not leak onto new keys.
+  REQUIRE(ai.put("rag_chunk", "rag:new", meta(R"(["fresh"])"), {3}));
+  CHECK(ai.query_tags(t0_en, 10).empty());
+  CHECK(ai.query_tags({{TagOp::And, "fresh"}}, 10) ==
+        std::vector<std::string>{"rag:new"});
+
+  CHECK(ai.invalidate_tags({{TagOp::And, "tenant=t1"},
+                            {TagOp::Or, "tenant=t2"}}) == 4000);
+  CHECK(ai.invalidate_epoch("ep") == 1002);
+  CHECK(ai.stats().find("tag_count:0\ntag_index_bytes:0\n") !=
+        std::string::npos);
+}
+
+TEST_CASE("Vector kernels and IVF index match exhaustive search",
+          "[ai][vector]") {
+  std::uint32_t seed = 7;
+  auto rnd = [&seed] {
+    seed = seed * 1664525u + 1013904223u;
+    return static_cast<float>(seed >> 8) / 16777216.0f - 0.5f;
+  };
+  std::vector<float> fa(37), fb(37);
+  std::vector<std::uint16_t> ha(37), hb(37);
+  std::vector<std::int8_t> ia(37), ib(37);
+  float f_ref = 0, h_ref = 0;
+  std::int32_t i_ref = 0;
+  for (std::size_t i = 0; i < 37; ++i) {
+    fa[i] = rnd();
+    fb[i] = rnd();
+    ha[i] = float_to_half(fa[i]);
+    hb[i] = float_to_half(fb[i]);
+    ia[i] = static_cast<std::int8_t>(fa[i] * 250);
+    ib[i] = static_cast<std::int8_t>(fb[i] * 250);
+    f_ref += fa[i] * fb[i];
+    h_ref += half_to_float(ha[i]) * half_to_float(hb[i]);
+    i_ref += ia[i] * ib[i];
+  }
+  CHECK(std::abs(dot_f32(fa.data(), fb.data(), 37) - f_ref) < 1e-4f);
+  CHECK(std::abs(dot_f16(ha.data(), hb.data(), 37) - h_ref) < 1e-4f);
+  CHECK(dot_i8(ia.data(), ib.data(), 37) == i_ref);
+  CHECK(half_to_float(float_to_half(1.5f)) == 1.5f);
+  CHECK(half_to_float(float_to_half(-65504.0f)) == -65504.0f);
+  CHECK(half_to_float(float_to_half(6e-8f)) == half_to_float(1));
+  CHECK(float_to_half(1e6f) == 0x7C00);
+
+  // Clustered data; each query is a slightly perturbed stored vector.
+  constexpr std::size_t kDim = 24, kCount = 4000;
+  std::vector<float> centers(40 * kDim);
+  for (auto &c : centers)
+    c = rnd();
+  std::vector<float> data(kCount * kDim);
+  VectorIndex index(kDim, VectorType::Float32, {128, 8});
+  for (std::size_t v = 0; v < kCount; ++v) {
+    for (std::size_t d = 0; d < kDim; ++d)
+      data[v * kDim + d] = centers[(v % 40) * kDim + d] + rnd() * 0.3f;
+    index.add(static_cast<std::uint32_t>(v),
+              reinterpret_cast<const std::uint8_t *>(&data[v * kDim]));
+  }
+  CHECK(index.size() == kCount);
+  CHECK(index.list_count() > 8);
+  int found = 0;
+  for (std::size_t q = 0; q < 100; ++q) {
+    const std::size_t target = q * 37 % kCount;
+    std::vector<float> query(data.begin() + target * kDim,
+                             data.begin() + (target + 1) * kDim);
+    for (auto &x : query)
+      x += rnd() * 0.01f;
+    const auto hits = index.search(
+        reinterpret_cast<const std::uint8_t *>(query.data()), 5);
+    REQUIRE(hits.size() == 5);
+    CHECK(hits[0].second >= hits[4].second);
+    found += hits[0].first == target;
+  }
+  CHECK(found >= 90);
+
+  // Removal keeps lists consistent down to an empty index.
+  for (std::uint32_t v = 0; v < kCount; v += 2)
+    REQUIRE(index.remove(v));
+  CHECK_FALSE(index.remove(0));
+  const auto hits =
+      index.search(reinterpret_cast<const std::uint8_t *>(&data[0]), 3);
+  for (const auto &h : hits)
+    CHECK(h.first % 2 == 1);
+  for (std::uint32_t v = 1; v < kCount; v += 2)
+    REQUIRE(index.remove(v));
+  CHECK(index.size() == 0);
+  CHECK(index.list_count() == 0);
+}
+
+TEST_CASE("AI embedding search follows puts, invalidation and eviction",
+          "[ai][vector]") {
+  Engine e({16 * 1024 * 1024, 256, 1024 * 1024},
+           make_policy_by_name("pomai_cost"));
+  AiArtifactCache ai(e);
+  auto vec = [](std::initializer_list<std::int8_t> v) {
+    std::vector<std::uint8_t> out;
+    for (const auto x : v)
+      out.push_back(static_cast<std::uint8_t>(x));
+    return out;
+  };
+  std::string err;
+  REQUIRE(ai.put_embedding("emb:a", "m", 4, VectorType::Int8, 0,
+                           vec({100, 0, 0, 0}), &err));
+  REQUIRE(ai.put_embedding("emb:b", "m", 4, VectorType::Int8, 0,
+                           vec({90, 40, 0, 0})));
+  REQUIRE(ai.put_embedding("emb:c", "m", 4, VectorType::Int8, 0,
+                           vec({0, 0, 100, 0})));
+  CHECK_FALSE(ai.put_embedding("emb:d", "m", 3, VectorType::Int8, 0,
+                               vec({1, 2, 3}), &err));
+  CHECK(err.find("4-dim int8") != std::string::npos);
+  CHECK_FALSE(ai.put_embedding("emb:d", "m", 4, VectorType::Float16, 0,
+                               vec({1, 2, 3}), &err));
+  const float bad[2] = {1.0f, std::numeric_limits<float>::quiet_NaN()};
+  std::vector<std::uint8_t> nan_vec(sizeof(bad));
+  std::memcpy(nan_vec.data(), bad, sizeof(bad));
+  CHECK_FALSE(ai.put_embedding("emb:n", "f", 2, VectorType::Float32, 0,
+                               nan_vec, &err));
+  CHECK(err.find("NaN") != std::string::npos);
+  CHECK_FALSE(ai.put_embedding("emb:n", "h", 1, VectorType::Float16, 0,
+                               {0x00, 0x7C}, &err));
+
+  std::vector<EmbeddingHit> hits;
+  REQUIRE(ai.search_embeddings("m", vec({50, 5, 0, 0}), 2, &hits));
+  REQUIRE(hits.size() == 2);
+  CHECK(hits[0].key == "emb:a");
+  CHECK(hits[1].key == "emb:b");
+  CHECK(hits[0].score > 0.99f);
+  CHECK_FALSE(ai.search_embeddings("m", vec({1, 2}), 2, &hits, &err));
+  REQUIRE(ai.search_embeddings("other", vec({1}), 2, &hits));
+  CHECK(hits.empty());
+
+  // Re-putting moves the vector; an evicted key is dropped when found.
+  REQUIRE(ai.put_embedding("emb:a", "m", 4, VectorType::Int8, 0,
+                           vec({0, 0, 0, 100})));
+  e.del({"emb:b"});
+  REQUIRE(ai.search_embeddings("m", vec({50, 5, 0, 0}), 3, &hits));
+  REQUIRE(hits.size() == 2);
+  CHECK(hits[0].key != "emb:b");
+  CHECK(hits[1].key != "emb:b");
+  CHECK(ai.stats().find("vector_reaped:1\n") != std::string::npos);
+  CHECK(ai.invalidate_model("m") == 2);
+  CHECK(ai.stats().find("vector_indexes:0\nvector_count:0\n") !=
+        std::string::npos);
+}
+
+TEST_CASE("AI response lookup matches near-duplicate prompts per scope",
+          "[ai][vector]") {
+  Engine e({16 * 1024 * 1024, 256, 1024 * 1024},
+           make_policy_by_name("pomai_cost"));
+  AiArtifactCache ai(e);
+  auto vec = [](std::initializer_list<float> v) {
+    std::vector<std::uint8_t> out(v.size() * sizeof(float));
+    std::memcpy(out.data(), std::data(v), out.size());
+    return out;
+  };
+  auto text = [](const std::string &s) {
+    return std::vector<std::uint8_t>(s.begin(), s.end());
+  };
+  REQUIRE(ai.put_response("m", "p1", "weather", 3, VectorType::Float32, 0,
+                          vec({1, 0, 0}), text("sunny")));
+  REQUIRE(ai.put_response("m", "p1", "capital", 3, VectorType::Float32, 0,
+                          vec({0, 1, 0}), text("Paris")));
+  REQUIRE(ai.put_response("m", "p2", "weather", 3, VectorType::Float32, 0,
+                          vec({0, 0, 1}), text("rainy")));
+
+  std::optional<ResponseMatch> match;
+  REQUIRE(ai.lookup_response("m", "p1", vec({0.99f, 0.1f, 0}), 0.05f,
+                             &match));
+  REQUIRE(match.has_value());
+  CHECK(match->key == canonical_response_key("weather", "p1", "m"));
+  CHECK(match->distance < 0.01f);
+  CHECK(match->value.payload_bytes() == text("sunny"));
+
+  // Same prompt, other params: only p2's response is in scope.
+  REQUIRE(ai.lookup_response("m", "p2", vec({0.99f, 0.1f, 0}), 0.05f,
+                             &match));
+  CHECK_FALSE(match.has_value());
+  // Distance 1 - cos(45 deg) ~ 0.29: within 2x a 0.2 threshold.
+  REQUIRE(ai.lookup_response("m", "p1", vec({1, 1, 0}), 0.2f, &match));
+  CHECK_FALSE(match.has_value());
+  REQUIRE(ai.lookup_response("m", "p3", vec({1, 1, 0}), 0.2f, &match));
+  std::string err;
+  CHECK_FALSE(ai.lookup_response("m", "p1", vec({1, 1}), 0.2f, &match, &err));
+
+  const auto stats = ai.stats();
+  CHECK(stats.find("rsp_lookups:4\nrsp_hits:1\nrsp_near_misses:1\n"
+                   "rsp_misses:2\n") != std::string::npos);
+  CHECK(stats.find("rsp_hit_distance:0.01=1,") != std::string::npos);
+  CHECK(stats.find("rsp_near_miss_distance:0.01=0,0.02=0,0.05=0,0.1=0,"
+                   "0.2=0,0.3=1,") != std::string::npos);
+  CHECK(stats.find("rsp_miss_distance:0.01=0,0.02=0,0.05=0,0.1=0,0.2=0,"
+                   "0.3=0,0.5=0,1=1,inf=0\n") != std::string::npos);
+  CHECK(ai.invalidate_model("m") == 3);
+  CHECK(ai.stats().find("vector_indexes:0\n") != std::string::npos);
+}
+
+TEST_CASE("AI response lookup reaps a nearest response it cannot read",
+          "[ai][vector][tier]") {
+  const std::string dir = "test_ai_rsp_lost_data";
+  std::filesystem::remove_all(dir);
+  EngineConfig cfg;
+  cfg.memory_limit_bytes = 1024 * 1024;
+  cfg.max_value_size = 256 * 1024;
+  cfg.data_dir = dir;
+  cfg.tier.ssd_enabled = true;
+  cfg.tier.ssd_value_min_bytes = 1024;
+  cfg.fsync_mode = FsyncMode::Always;
+  Engine e(cfg, make_policy_by_name("lru"));
+  AiArtifactCache ai(e);
+  const float prompt[2] = {1, 0};
+  std::vector<std::uint8_t> vec(sizeof(prompt));
+  std::memcpy(vec.data(), prompt, sizeof(prompt));
+  REQUIRE(ai.put_response("m", "p", "lost", 2, VectorType::Float32, 0, vec,
+                          std::vector<std::uint8_t>(4096, 'r')));
+  // The response's key still reads back from its segment, its value no
+  // longer does: the index thinks it is live but get() misses.
+  const auto seg = dir + "/segment_1.log";
+  std::filesystem::resize_file(seg, std::filesystem::file_size(seg) - 2048);
+
+  std::optional<ResponseMatch> match;
+  REQUIRE(ai.lookup_response("m", "p", vec, 0.05f, &match));
+  CHECK_FALSE(match.has_value());
+  const auto stats = ai.stats();
+  CHECK(stats.find("rsp_lookups:1\nrsp_hits:0\nrsp_near_misses:0\n"
+                   "rsp_misses:1\n") != std::string::npos);
+  CHECK(stats.find("vector_reaped:1\n") != std::string::npos);
+  CHECK(stats.find("vector_indexes:0\n") != std::string::npos);
+}
+
+TEST_CASE("AI embeddings store quantized and convert on get", "[ai][vector]") {
+  std::vector<float> f(37);
+  for (std::size_t i = 0; i < f.size(); ++i)
+    f[i] = std::sin(static_cast<float>(i)) * 3.0f;
+  std::vector<std::uint16_t> h(f.size());
+  std::vector<float> back(f.size());
+  f32_to_f16(f.data(), h.data(), f.size());
+  f16_to_f32(h.data(), back.data(), f.size());
+  for (std::size_t i = 0; i < f.size(); ++i) {
+    CHECK(h[i] == float_to_half(f[i]));
+    CHECK(std::fabs(back[i] - f[i]) <= 3.0f / 1024);
+  }
+  std::vector<std::int8_t> q(f.size());
+  const float scale = quantize_i8(f.data(), q.data(), f.size());
+  dequantize_i8(q.data(), scale, back.data(), f.size());
+  for (std::size_t i = 0; i < f.size(); ++i)
+    CHECK(std::fabs(back[i] - f[i]) <= scale / 2 + 1e-6f);
+  std::vector<float> zero(5, 0.0f);
+  CHECK(quantize_i8(zero.data(), q.data(), zero.size()) == 0.0f);
+  CHECK(q[0] == 0);
+
+  std::vector<std::uint8_t> bytes(f.size() * sizeof(float));
+  std::memcpy(bytes.data(), f.data(), bytes.size());
+  for (const auto codec : {VectorCodec::Float16, VectorCodec::Int8Scaled}) {
+    Engine e({16 * 1024 * 1024, 256, 1024 * 1024},
+             make_policy_by_name("pomai_cost"));
+    AiCacheConfig cfg;
+    cfg.emb_store = codec;
+    AiArtifactCache ai(e, cfg);
+    REQUIRE(ai.put_embedding("emb:a", "m", f.size(), VectorType::Float32, 0,
+                             bytes));
+    const std::size_t stored =
+        codec == VectorCodec::Float16 ? f.size() * 2 : 4 + f.size();
+    CHECK(ai.get("emb:a")->payload_size() == stored);
+
+    std::optional<ArtifactValue> v;
+    REQUIRE(ai.get_embedding("emb:a", VectorType::Float32, &v));
+    REQUIRE(v->payload_size() == bytes.size());
+    std::memcpy(back.data(), v->payload->data(), bytes.size());
+    for (std::size_t i = 0; i < f.size(); ++i)
+      CHECK(std::fabs(back[i] - f[i]) <= 3.0f / 127);
+    REQUIRE(ai.get_embedding("emb:a", VectorType::Float16, &v));
+    CHECK(v->payload_size() == f.size() * 2);
+    std::string err;
+    CHECK_FALSE(ai.get_embedding("emb:a", VectorType::Int8, &v, &err));
+    REQUIRE(ai.get_embedding("emb:none", VectorType::Float32, &v));
+    CHECK_FALSE(v.has_value());
+
+    // The index holds the narrow form but takes float queries.
+    std::vector<EmbeddingHit> hits;
+    REQUIRE(ai.search_embeddings("m", bytes, 1, &hits));
+    REQUIRE(hits.size() == 1);
+    CHECK(hits[0].score > 0.99f);
+    const auto stats = ai.stats();
+    CHECK(stats.find(std::string("emb_store:") + vector_codec_name(codec)) !=
+          std::string::npos);
+    CHECK(stats.find("emb_bytes_stored:" + std::to_string(stored)) !=
+          std::string::npos);
+  }
+
+  // float16 storage cannot hold 1e6; storing it as inf would poison the
+  // index, so such vectors and queries are refused.
+  Engine e({16 * 1024 * 1024, 256, 1024 * 1024},
+           make_policy_by_name("pomai_cost"));
+  AiCacheConfig cfg;
+  cfg.emb_store = VectorCodec::Float16;
+  AiArtifactCache ai(e, cfg);
+  auto floats = [](std::vector<float> v) {
+    std::vector<std::uint8_t> out(v.size() * sizeof(float));
+    std::memcpy(out.data(), v.data(), out.size());
+    return out;
+  };
+  REQUIRE(ai.put_embedding("emb:x", "m", 2, VectorType::Float32, 0,
+                           floats({1, 0})));
+  REQUIRE(ai.put_embedding("emb:y", "m", 2, VectorType::Float32, 0,
+                           floats({0, 1})));
+  std::string err;
+  CHECK_FALSE(ai.put_embedding("emb:big", "m", 2, VectorType::Float32, 0,
+                               floats({1e6f, 1}), &err));
+  CHECK(err.find("float16 range") != std::string::npos);
+  CHECK_FALSE(ai.get("emb:big").has_value());
+  REQUIRE(ai.put_embedding("emb:max", "m", 2, VectorType::Float32, 0,
+                           floats({-65504.0f, 0})));
+  std::vector<EmbeddingHit> hits;
+  CHECK_FALSE(ai.search_embeddings("m", floats({1e6f, 0}), 3, &hits, &err));
+  REQUIRE(ai.search_embeddings("m", floats({1, 0}), 3, &hits));
+  REQUIRE(hits.size() == 3);
+  CHECK(hits[0].key == "emb:x");
+  for (const auto &h : hits)
+    CHECK(std::isfinite(h.score));
+}
@@ -1,8 +1,12 @@
 #include "pomai_cache/engine.hpp"
+#include "pomai_cache/hash.hpp"
 
 #include <catch2/catch_test_macros.hpp>
 
+#include <algorithm>
 #include <chrono>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <thread>
 
@@ -116,3 +120,853 @@ TEST_CASE("Tiered SSD placement and recovery metadata in INFO",
   CHECK(i.find("ssd_gets:") != std::string::npos);
   CHECK(i.find("ssd_index_rebuild_ms:") != std::string::npos);
 }
+
+TEST_CASE("Group commit coalesces SSD appends and survives reopen",
+          "[engine][tier][durability]") {
+  const std::string dir = "test_group_commit_data";
+  std::filesystem::remove_all(dir);
+  EngineConfig cfg;
+  cfg.memory_limit_bytes = 1024 * 1024;
+  cfg.max_value_size = 256 * 1024;
+  cfg.data_dir = dir;
+  cfg.tier.ssd_enabled = true;
+  cfg.tier.ssd_value_min_bytes = 64;
+  cfg.tier.ram_max_bytes = 1024 * 1024;
+  cfg.tier.ssd_group_commit_ms = 60 * 1000;
+  cfg.fsync_mode = FsyncMode::Group;
+
+  {
+    Engine e(cfg, make_policy_by_name("lru"));
+    for (int i = 0; i < 50; ++i) {
+      std::vector<std::uint8_t> v(128, static_cast<std::uint8_t>(i));
+      REQUIRE(e.set("k" + std::to_string(i), v, std::nullopt, "default"));
+    }
+    REQUIRE(e.del({"k7"}) == 1);
+    REQUIRE(e.commit());
+    auto i = e.info();
+    CHECK(i.find("ssd_fsyncs:1\n") != std::string::npos);
+    CHECK(i.find("ssd_group_commits:1\n") != std::string::npos);
+    auto v = e.get("k3");
+    REQUIRE(v.has_value());
+    CHECK((*v)[0] == 3);
+  }
+
+  Engine reopened(cfg, make_policy_by_name("lru"));
+  auto v = reopened.get("k49");
+  REQUIRE(v.has_value());
+  CHECK(v->size() == 128);
+  CHECK((*v)[0] == 49);
+  CHECK_FALSE(reopened.get("k7").has_value());
+}
+
+TEST_CASE("A failed SSD flush forgets the buffered records it dropped",
+          "[engine][tier][durability]") {
+  // Writes to /dev/full fail with ENOSPC; without it there is nothing to
+  // inject the failure with.
+  if (!std::filesystem::exists("/dev/full"))
+    return;
+  const std::string dir = "test_ssd_flush_failure_data";
+  std::filesystem::remove_all(dir);
+  SsdConfig sc;
+  sc.enabled = true;
+  sc.dir = dir;
+  sc.segment_bytes = 8 * 1024;
+  sc.fsync = FsyncMode::Never;
+  SsdStore s(sc);
+  REQUIRE(s.init());
+  // The next segment rotated to cannot be written.
+  std::filesystem::create_symlink("/dev/full", dir + "/segment_2.log");
+  const std::vector<std::uint8_t> v(200, 'v');
+  std::uint64_t seq = 0;
+  std::size_t keys = 0;
+  std::size_t live = 0;
+  for (int i = 0; s.stats().segments < 2; ++i) {
+    keys = s.size();
+    live = s.stats().bytes;
+    REQUIRE(s.put("k" + std::to_string(i), v, std::nullopt, ++seq));
+  }
+  for (int i = 0; i < 5; ++i)
+    REQUIRE(s.put("late" + std::to_string(i), v, std::nullopt, ++seq));
+  CHECK(s.size() == keys + 6);
+
+  std::string err;
+  CHECK_FALSE(s.commit(&err));
+  CHECK(s.size() == keys);
+  CHECK(s.stats().index_keys == keys);
+  CHECK(s.stats().bytes == live);
+  CHECK_FALSE(s.get("late0").has_value());
+  CHECK(s.get("k0") == v);
+  std::filesystem::remove(dir + "/segment_2.log");
+}
+
+TEST_CASE("CRC32C matches reference and PMC4 segments stay readable",
+          "[engine][tier][format]") {
+  const std::string check = "123456789";
+  CHECK(crc32c(0, check.data(), check.size()) == 0xE3069283u);
+  CHECK(crc32c(crc32c(0, check.data(), 4), check.data() + 4, 5) ==
+        0xE3069283u);
+
+  const std::string dir = "test_pmc4_data";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  {
+    // Hand-built PMC4 record: 56-byte header, FNV-1a checksum.
+    const std::string key = "legacy";
+    const std::vector<std::uint8_t> value(100, 'L');
+    std::vector<std::uint8_t> h(56, 0);
+    auto put32 = [&](std::size_t off, std::uint32_t v) {
+      std::memcpy(h.data() + off, &v, 4);
+    };
+    auto put64 = [&](std::size_t off, std::uint64_t v) {
+      std::memcpy(h.data() + off, &v, 8);
+    };
+    put32(0, 0x504d3443u);
+    put64(16, 1);
+    put64(32, static_cast<std::uint64_t>(-1));
+    put32(40, static_cast<std::uint32_t>(key.size()));
+    put32(44, static_cast<std::uint32_t>(value.size()));
+    std::uint32_t sum = 2166136261u;
+    auto mix = [&](std::uint8_t b) {
+      sum ^= b;
+      sum *= 16777619u;
+    };
+    for (std::size_t i = 0; i < h.size(); ++i)
+      if (i < 4 || i >= 8)
+        mix(h[i]);
+    for (unsigned char c : key)
+      mix(c);
+    for (auto b : value)
+      mix(b);
+    put32(4, sum);
+    std::ofstream seg(dir + "/segment_1.log", std::ios::binary);
+    seg.write(reinterpret_cast<const char *>(h.data()), 56);
+    seg << key;
+    seg.write(reinterpret_cast<const char *>(value.data()), 100);
+  }
+
+  EngineConfig cfg;
+  cfg.data_dir = dir;
+  cfg.max_value_size = 256 * 1024;
+  cfg.tier.ssd_enabled = true;
+  cfg.tier.ssd_value_min_bytes = 64;
+  cfg.tier.ssd_verify_read_sample = 0.5;
+  Engine e(cfg, make_policy_by_name("lru"));
+  auto v = e.get("legacy");
+  REQUIRE(v.has_value());
+  CHECK(v->size() == 100);
+  REQUIRE(e.set("fresh", std::vector<std::uint8_t>(100, 'F'), std::nullopt,
+                "default"));
+  CHECK(e.get("fresh").has_value());
+  CHECK(e.get("legacy").has_value());
+  auto i = e.info();
+  CHECK(i.find("ssd_checksum_verifies:1\n") != std::string::npos);
+  CHECK(i.find("ssd_checksum_failures:0\n") != std::string::npos);
+}
+
+TEST_CASE("Compact SSD index survives rotation, GC and reopen",
+          "[engine][tier][index]") {
+  const std::string dir = "test_ssd_index_data";
+  std::filesystem::remove_all(dir);
+  SsdConfig sc;
+  sc.enabled = true;
+  sc.dir = dir;
+  sc.segment_bytes = 8 * 1024;
+  sc.fsync = FsyncMode::Never;
+  sc.gc_fragmentation_threshold = 0.2;
+
+  {
+    SsdStore s(sc);
+    REQUIRE(s.init());
+    std::uint64_t seq = 0;
+    for (int round = 0; round < 3; ++round)
+      for (int i = 0; i < 400; ++i) {
+        std::vector<std::uint8_t> v(100, static_cast<std::uint8_t>(round));
+        REQUIRE(s.put("key:" + std::to_string(i), v, std::nullopt, ++seq));
+      }
+    CHECK(s.stats().index_bytes <= s.stats().index_keys * 24);
+    for (int i = 0; i < 400; i += 4)
+      REQUIRE(s.del("key:" + std::to_string(i), ++seq));
+    CHECK_FALSE(s.del("key:0", ++seq));
+    CHECK(s.size() == 300);
+    CHECK(s.stats().segments > 1);
+    for (int n = 0; n < 100 && s.stats().gc_runs < 3; ++n)
+      s.maybe_compact();
+    CHECK(s.stats().gc_runs >= 3);
+    auto v = s.get("key:5");
+    REQUIRE(v.has_value());
+    CHECK((*v)[0] == 2);
+    REQUIRE(s.commit());
+  }
+
+  SsdStore reopened(sc);
+  REQUIRE(reopened.init());
+  CHECK(reopened.size() == 300);
+  CHECK_FALSE(reopened.contains("key:8"));
+  auto v = reopened.get("key:399");
+  REQUIRE(v.has_value());
+  CHECK(v->size() == 100);
+  CHECK((*v)[0] == 2);
+}
+
+TEST_CASE("SSD expiry buckets erase only expired keys and feed GC",
+          "[engine][tier][ttl]") {
+  const std::string dir = "test_ssd_expiry_data";
+  std::filesystem::remove_all(dir);
+  SsdConfig sc;
+  sc.enabled = true;
+  sc.dir = dir;
+  sc.segment_bytes = 16 * 1024;
+  sc.fsync = FsyncMode::Never;
+  sc.gc_fragmentation_threshold = 0.5;
+
+  SsdStore s(sc);
+  REQUIRE(s.init());
+  std::uint64_t seq = 0;
+  const auto soon = Clock::now() + std::chrono::milliseconds(20);
+  std::vector<std::uint8_t> v(200, 'x');
+  for (int i = 0; i < 200; ++i)
+    REQUIRE(s.put("short:" + std::to_string(i), v, soon, ++seq));
+  for (int i = 0; i < 20; ++i)
+    REQUIRE(s.put("long:" + std::to_string(i), v,
+                  Clock::now() + std::chrono::hours(1), ++seq));
+  for (int i = 0; i < 20; ++i)
+    REQUIRE(s.put("plain:" + std::to_string(i), v, std::nullopt, ++seq));
+  CHECK(s.erase_expired(1000, Clock::now()) == 0);
+  // Slots, their deadlines and the expiry buckets are all counted.
+  CHECK(s.stats().index_bytes_per_key >= 18.0);
+  CHECK(s.stats().index_bytes_per_key < 40.0);
+
+  const auto later = Clock::now() + std::chrono::milliseconds(500);
+  CHECK(s.erase_expired(50, later) == 50);
+  CHECK(s.erase_expired(1000, later) == 150);
+  CHECK(s.erase_expired(1000, later) == 0);
+  CHECK(s.size() == 40);
+
+  for (int n = 0; n < 20; ++n)
+    s.maybe_compact();
+  CHECK(s.stats().gc_runs >= 1);
+  CHECK(s.contains("long:3"));
+  CHECK(s.contains("plain:19"));
+  // Deadlines follow their keys through rehash, erase shifts and GC moves.
+  SsdMeta m;
+  REQUIRE(s.stat("long:3", &m));
+  CHECK(m.ttl_epoch_ms > 0);
+  REQUIRE(s.stat("plain:19", &m));
+  CHECK(m.ttl_epoch_ms == -1);
+}
+
+TEST_CASE("SSD EXPIRE appends a meta record instead of rewriting the value",
+          "[engine][tier][ttl]") {
+  const std::string dir = "test_ssd_meta_data";
+  std::filesystem::remove_all(dir);
+  SsdConfig sc;
+  sc.enabled = true;
+  sc.dir = dir;
+  sc.fsync = FsyncMode::Never;
+  const std::vector<std::uint8_t> big(1024 * 1024, 'b');
+  const auto deadline = Clock::now() + std::chrono::hours(2);
+
+  {
+    SsdStore s(sc);
+    REQUIRE(s.init());
+    REQUIRE(s.put("big", big, std::nullopt, 1));
+    REQUIRE(s.put("gone", big, std::nullopt, 2));
+    REQUIRE(s.commit());
+    const auto read_before = s.stats().read_mb;
+    const auto write_before = s.stats().write_mb;
+    REQUIRE(s.set_ttl("big", deadline, 3));
+    REQUIRE(s.set_ttl("gone", Clock::now() + std::chrono::hours(1), 4));
+    REQUIRE(s.set_ttl("gone", std::nullopt, 5));
+    CHECK_FALSE(s.set_ttl("missing", deadline, 6));
+    SsdMeta m;
+    REQUIRE(s.stat("big", &m));
+    CHECK(m.len == big.size());
+    CHECK(m.ttl_epoch_ms > 0);
+    REQUIRE(s.stat("gone", &m));
+    CHECK(m.ttl_epoch_ms == -1);
+    REQUIRE(s.commit());
+    CHECK((s.stats().write_mb - write_before) * 1024 * 1024 < 256);
+    CHECK((s.stats().read_mb - read_before) * 1024 * 1024 < 4096);
+    REQUIRE(s.set_ttl("gone", Clock::now() - std::chrono::seconds(1), 7));
+    REQUIRE(s.commit());
+  }
+
+  SsdStore reopened(sc);
+  REQUIRE(reopened.init());
+  SsdMeta m;
+  REQUIRE(reopened.stat("big", &m));
+  CHECK(m.ttl_epoch_ms ==
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline.time_since_epoch())
+            .count());
+  CHECK_FALSE(reopened.stat("gone", &m));
+  auto v = reopened.get("big");
+  REQUIRE(v.has_value());
+  CHECK(v->size() == big.size());
+}
+
+TEST_CASE("Full SSD tier evicts oldest segments and reinserts hot keys",
+          "[engine][tier][eviction]") {
+  const std::string dir = "test_ssd_evict_data";
+  std::filesystem::remove_all(dir);
+  SsdConfig sc;
+  sc.enabled = true;
+  sc.dir = dir;
+  sc.max_bytes = 64 * 1024;
+  sc.fsync = FsyncMode::Never;
+
+  SsdStore s(sc);
+  REQUIRE(s.init());
+  std::vector<std::uint8_t> v(1000, 'v');
+  std::uint64_t seq = 0;
+  for (int i = 0; i < 300; ++i) {
+    REQUIRE(s.put("k" + std::to_string(i), v, std::nullopt, ++seq));
+    if (i % 10 == 9)
+      REQUIRE(s.get("k0").has_value());
+  }
+  CHECK(s.stats().evicted_segments > 0);
+  CHECK(s.stats().evicted_keys > 0);
+  CHECK(s.stats().reinserted_keys > 0);
+  CHECK(s.stats().bytes <= sc.max_bytes);
+  CHECK(s.get("k0").has_value());
+  CHECK(s.get("k299").has_value());
+  CHECK_FALSE(s.get("k1").has_value());
+  CHECK(s.size() + s.stats().evicted_keys == 300);
+}
+
+TEST_CASE("Small objects share 4 KiB pages with a few bits of RAM each",
+          "[engine][tier][small]") {
+  const std::string dir = "test_ssd_small_data";
+  std::filesystem::remove_all(dir);
+  SsdConfig sc;
+  sc.enabled = true;
+  sc.dir = dir;
+  sc.fsync = FsyncMode::Never;
+  sc.small_object_max_bytes = 512;
+  sc.small_store_bytes = 512 * 1024;
+  sc.small_log_bytes = 64 * 1024;
+
+  {
+    SsdStore s(sc);
+    REQUIRE(s.init());
+    std::uint64_t seq = 0;
+    for (int i = 0; i < 4000; ++i) {
+      std::vector<std::uint8_t> v(100, static_cast<std::uint8_t>(i & 0xFF));
+      REQUIRE(s.put("p" + std::to_string(i), v, std::nullopt, ++seq));
+    }
+    CHECK(s.stats().index_keys == 0);
+    CHECK(s.stats().small_page_writes > 0);
+    CHECK(s.stats().small_ram_bytes * 8 <= s.stats().small_objects * 6);
+    auto v = s.get("p3999");
+    REQUIRE(v.has_value());
+    CHECK((*v)[0] == (3999 & 0xFF));
+
+    // Growing past the threshold moves the key into the segment log.
+    REQUIRE(s.put("p3995", std::vector<std::uint8_t>(4096, 'L'), std::nullopt,
+                  ++seq));
+    CHECK(s.stats().index_keys == 1);
+    REQUIRE(s.del("p3990", ++seq));
+    CHECK_FALSE(s.contains("p3990"));
+  }
+
+  SsdStore reopened(sc);
+  REQUIRE(reopened.init());
+  CHECK(reopened.stats().small_objects > 3000);
+  auto v = reopened.get("p3995");
+  REQUIRE(v.has_value());
+  CHECK(v->size() == 4096);
+  CHECK_FALSE(reopened.contains("p3990"));
+  v = reopened.get("p3998");
+  REQUIRE(v.has_value());
+  CHECK(v->size() == 100);
+}
+
+TEST_CASE("SSD admission keeps one-hit wonders off flash",
+          "[engine][tier][admission]") {
+  CountMinSketch sketch(1024);
+  for (int i = 0; i < 5; ++i)
+    sketch.increment(42);
+  CHECK(sketch.estimate(42) >= 5);
+  CHECK(sketch.estimate(7) <= 1);
+
+  const std::string dir = "test_ssd_admission_data";
+  std::filesystem::remove_all(dir);
+  EngineConfig cfg;
+  cfg.data_dir = dir;
+  cfg.max_value_size = 256 * 1024;
+  cfg.tier.ssd_enabled = true;
+  cfg.tier.ssd_value_min_bytes = 64 * 1024;
+  cfg.tier.ram_max_bytes = 4096;
+  cfg.fsync_mode = FsyncMode::Never;
+  Engine e(cfg, make_policy_by_name("lru"));
+
+  const std::vector<std::uint8_t> v(200, 'a');
+  for (int i = 0; i < 5; ++i) {
+    const auto key = "hot" + std::to_string(i);
+    REQUIRE(e.set(key, v, std::nullopt, "default"));
+    REQUIRE(e.get(key).has_value());
+  }
+  for (int i = 0; i < 60; ++i)
+    REQUIRE(e.set("cold" + std::to_string(i), v, std::nullopt, "default"));
+  for (int i = 0; i < 200; ++i)
+    e.tick();
+
+  for (int i = 0; i < 5; ++i)
+    CHECK(e.get("hot" + std::to_string(i)).has_value());
+  CHECK_FALSE(e.get("cold0").has_value());
+  auto info = e.info();
+  CHECK(info.find("ssd_admitted:5\n") != std::string::npos);
+  CHECK(info.find("ssd_rejected:0\n") == std::string::npos);
+  CHECK(info.find("ssd_write_amplification:") != std::string::npos);
+}
+
+TEST_CASE("SSD promotion reuses the read that triggered it",
+          "[engine][tier][promotion]") {
+  const std::string dir = "test_ssd_promotion_data";
+  std::filesystem::remove_all(dir);
+  EngineConfig cfg;
+  cfg.data_dir = dir;
+  cfg.tier.ssd_enabled = true;
+  cfg.tier.ram_max_bytes = 4096;
+  cfg.tier.ssd_admit_min_accesses = 1;
+  cfg.tier.promotion_hits = 3;
+  cfg.fsync_mode = FsyncMode::Never;
+  Engine e(cfg, make_policy_by_name("lru"));
+
+  const std::vector<std::uint8_t> v(200, 'w');
+  REQUIRE(e.set("warm", v, std::nullopt, "default"));
+  for (int i = 0; i < 30; ++i) {
+    REQUIRE(e.set("k" + std::to_string(i), v, std::nullopt, "default"));
+    e.tick();
+  }
+  for (int i = 0; i < 50; ++i)
+    e.tick();
+  REQUIRE(e.info().find("ssd_gets:0\n") != std::string::npos);
+  REQUIRE(e.commit());
+
+  auto read_mb = [&e] {
+    const auto info = e.info();
+    const auto at = info.find("ssd_read_mb:") + 12;
+    return std::stod(info.substr(at, info.find('\n', at) - at));
+  };
+  std::vector<double> read_per_get;
+  for (int i = 0; i < 3; ++i) {
+    const double before = read_mb();
+    auto got = e.get("warm");
+    REQUIRE(got.has_value());
+    CHECK(*got == v);
+    read_per_get.push_back(read_mb() - before);
+    const auto gets = "ssd_gets:" + std::to_string(i + 1) + "\n";
+    CHECK(e.info().find(gets) != std::string::npos);
+  }
+  // The promoting read drops the SSD copy without reading the record again.
+  CHECK(read_per_get[0] > 0);
+  CHECK(read_per_get[2] < read_per_get[0] * 1.5);
+  // Installed in RAM by the third read: later gets never touch the SSD.
+  CHECK(e.get("warm").has_value());
+  auto info = e.info();
+  CHECK(info.find("ssd_gets:3\n") != std::string::npos);
+  CHECK(info.find("promotions:1\n") != std::string::npos);
+}
+
+TEST_CASE("Bursty ingest demotes victims in batches within the RAM limit",
+          "[engine][tier][demotion]") {
+  auto lru = make_policy_by_name("lru");
+  std::unordered_map<std::string, Entry> entries;
+  for (int i = 0; i < 10; ++i) {
+    Entry en;
+    en.size_bytes = 100;
+    en.last_access = TimePoint(std::chrono::seconds(100 - i));
+    entries["e" + std::to_string(i)] = en;
+  }
+  auto victims = lru->pick_victims(entries, 1000, 1000, 250, 8);
+  REQUIRE(victims.size() == 3);
+  CHECK(victims[0] == "e9");
+  CHECK(victims[2] == "e7");
+  CHECK(lru->pick_victims(entries, 1000, 1000, 10000, 4).size() == 4);
+
+  const std::string dir = "test_ssd_demotion_data";
+  std::filesystem::remove_all(dir);
+  EngineConfig cfg;
+  cfg.data_dir = dir;
+  cfg.tier.ssd_enabled = true;
+  cfg.tier.ram_max_bytes = 8192;
+  cfg.tier.ssd_admit_min_accesses = 1;
+  cfg.fsync_mode = FsyncMode::Never;
+  Engine e(cfg, make_policy_by_name("lru"));
+
+  const std::vector<std::uint8_t> v(200, 'b');
+  for (int i = 0; i < 500; ++i) {
+    REQUIRE(e.set("b" + std::to_string(i), v, std::nullopt, "default"));
+    CHECK(e.memory_used() <= cfg.tier.ram_max_bytes);
+  }
+  CHECK(e.get("b0").has_value());
+  CHECK(e.get("b499").has_value());
+  const auto &st = e.stats();
+  CHECK(st.evictions == 0);
+  CHECK(st.demotions >= 450);
+  CHECK(st.demotion_batches * 4 < st.demotions);
+}
+
+TEST_CASE("Hot large SSD values are served from the CLOCK read cache",
+          "[engine][tier][read_cache]") {
+  SsdReadCache cache(4 * 1000);
+  const std::vector<std::uint8_t> kb(1000, 'c');
+  cache.put("a", kb, std::nullopt);
+  cache.put("b", kb, std::nullopt);
+  cache.put("c", kb, std::nullopt);
+  REQUIRE(cache.get("a", Clock::now()).has_value());
+  cache.put("d", kb, std::nullopt);
+  cache.put("e", kb, std::nullopt); // evicts b: a was referenced
+  CHECK(cache.get("a", Clock::now()).has_value());
+  CHECK_FALSE(cache.get("b", Clock::now()).has_value());
+  CHECK(cache.stats().bytes <= 4000);
+  cache.put("big", std::vector<std::uint8_t>(1001, 'x'), std::nullopt);
+  CHECK_FALSE(cache.get("big", Clock::now()).has_value());
+  cache.put("t", kb, Clock::now() - std::chrono::seconds(1));
+  CHECK_FALSE(cache.get("t", Clock::now()).has_value());
+
+  const std::string dir = "test_ssd_read_cache_data";
+  std::filesystem::remove_all(dir);
+  EngineConfig cfg;
+  cfg.data_dir = dir;
+  cfg.max_value_size = 256 * 1024;
+  cfg.tier.ssd_enabled = true;
+  cfg.tier.ssd_value_min_bytes = 32 * 1024;
+  cfg.tier.ssd_read_cache_bytes = 1024 * 1024;
+  cfg.fsync_mode = FsyncMode::Never;
+  Engine e(cfg, make_policy_by_name("lru"));
+
+  const std::vector<std::uint8_t> v1(64 * 1024, '1');
+  const std::vector<std::uint8_t> v2(64 * 1024, '2');
+  REQUIRE(e.set("emb", v1, std::nullopt, "default"));
+  for (int i = 0; i < 10; ++i)
+    REQUIRE(e.get("emb") == v1);
+  auto info = e.info();
+  CHECK(info.find("ssd_gets:1\n") != std::string::npos);
+  CHECK(info.find("ssd_read_cache_hits:9\n") != std::string::npos);
+  CHECK(e.memory_used() == 0);
+
+  REQUIRE(e.set("emb", v2, std::nullopt, "default"));
+  CHECK(e.get("emb") == v2);
+  REQUIRE(e.del({"emb"}) == 1);
+  CHECK_FALSE(e.get("emb").has_value());
+}
+
+TEST_CASE("MGET batches SSD reads across segments and the append buffer",
+          "[engine][tier][mget]") {
+  const std::string dir = "test_ssd_mget_data";
+  std::filesystem::remove_all(dir);
+  EngineConfig cfg;
+  cfg.data_dir = dir;
+  cfg.max_value_size = 64 * 1024;
+  cfg.tier.ssd_enabled = true;
+  cfg.tier.ssd_value_min_bytes = 4096;
+  cfg.tier.ssd_segment_bytes = 64 * 1024;
+  cfg.tier.ssd_read_threads = 4;
+  cfg.fsync_mode = FsyncMode::Never;
+  Engine e(cfg, make_policy_by_name("lru"));
+
+  std::vector<std::string> keys;
+  for (int i = 0; i < 40; ++i) {
+    keys.push_back("chunk" + std::to_string(i));
+    REQUIRE(e.set(keys.back(),
+                  std::vector<std::uint8_t>(5000 + i,
+                                            static_cast<std::uint8_t>(i)),
+                  std::nullopt, "default"));
+  }
+  REQUIRE(e.set("ram", {1, 2, 3}, std::nullopt, "default"));
+  keys.insert(keys.begin() + 7, "ram");
+  keys.insert(keys.begin() + 20, "missing");
+  std::reverse(keys.begin(), keys.end());
+
+  auto vals = e.mget(keys);
+  REQUIRE(vals.size() == keys.size());
+  for (std::size_t i = 0; i < keys.size(); ++i) {
+    if (keys[i] == "missing") {
+      CHECK_FALSE(vals[i].has_value());
+      continue;
+    }
+    REQUIRE(vals[i].has_value());
+    CHECK(*vals[i] == *e.get(keys[i]));
+  }
+  auto info = e.info();
+  CHECK(info.find("ssd_multi_gets:1\n") != std::string::npos);
+  CHECK(info.find("ssd_multi_get_reads:") != std::string::npos);
+  CHECK(info.find("ssd_multi_get_reads:0\n") == std::string::npos);
+
+  // Later batches, large and small, reuse the same reader threads.
+  for (std::size_t n : {keys.size(), std::size_t{2}, keys.size()}) {
+    const std::vector<std::string> batch(keys.begin(), keys.begin() + n);
+    auto again = e.mget(batch);
+    for (std::size_t i = 0; i < n; ++i)
+      CHECK(again[i] == vals[i]);
+  }
+  CHECK(e.info().find("ssd_multi_gets:4\n") != std::string::npos);
+}
+
+TEST_CASE("Direct I/O mode keeps segment flushes 4 KiB-aligned",
+          "[engine][tier][direct_io]") {
+  const std::string dir = "test_ssd_direct_data";
+  std::filesystem::remove_all(dir);
+  EngineConfig cfg;
+  cfg.data_dir = dir;
+  cfg.max_value_size = 64 * 1024;
+  cfg.tier.ssd_enabled = true;
+  cfg.tier.ssd_value_min_bytes = 1000;
+  cfg.fsync_mode = FsyncMode::Never;
+  auto value_for = [](int i) {
+    return std::vector<std::uint8_t>(1000 + 37 * i,
+                                     static_cast<std::uint8_t>(i));
+  };
+  {
+    // Written buffered first, so the reopen below must pad a ragged tail.
+    Engine e(cfg, make_policy_by_name("lru"));
+    REQUIRE(e.set("k0", value_for(0), std::nullopt, "default"));
+    REQUIRE(e.commit());
+  }
+  cfg.tier.ssd_direct_io = true;
+  bool direct = false;
+  {
+    Engine e(cfg, make_policy_by_name("lru"));
+    direct = e.info().find("ssd_direct_io:1\n") != std::string::npos;
+    for (int i = 1; i < 30; ++i) {
+      REQUIRE(e.set("k" + std::to_string(i), value_for(i), std::nullopt,
+                    "default"));
+      if (i % 7 == 0)
+        REQUIRE(e.commit());
+    }
+    REQUIRE(e.expire("k3", 3600));
+    REQUIRE(e.del({"k4"}) == 1);
+    REQUIRE(e.commit());
+    CHECK(e.get("k0") == value_for(0));
+    CHECK(e.get("k12") == value_for(12));
+    if (direct)
+      CHECK(e.info().find("ssd_pad_bytes:0\n") == std::string::npos);
+  }
+  if (direct) {
+    for (const auto &f : std::filesystem::directory_iterator(dir))
+      if (f.path().extension() == ".log")
+        CHECK(std::filesystem::file_size(f.path()) % 4096 == 0);
+  }
+
+  Engine e(cfg, make_policy_by_name("lru"));
+  for (int i = 0; i < 30; ++i) {
+    if (i == 4) {
+      CHECK_FALSE(e.get("k4").has_value());
+      continue;
+    }
+    CHECK(e.get("k" + std::to_string(i)) == value_for(i));
+  }
+  CHECK(e.ttl("k3").value_or(-1) > 0);
+  auto vals = e.mget({"k1", "k2", "k29"});
+  CHECK(vals[2] == value_for(29));
+}
+
+TEST_CASE("Parallel recovery repairs only the active segment tail",
+          "[engine][tier][recovery]") {
+  const std::string dir = "test_ssd_recovery_data";
+  std::filesystem::remove_all(dir);
+  EngineConfig cfg;
+  cfg.data_dir = dir;
+  cfg.tier.ssd_enabled = true;
+  cfg.tier.ssd_value_min_bytes = 1000;
+  cfg.tier.ssd_segment_bytes = 16 * 1024;
+  cfg.tier.ssd_admit_min_accesses = 0;
+  cfg.fsync_mode = FsyncMode::Never;
+  auto value_for = [](int i) {
+    return std::vector<std::uint8_t>(1000 + 13 * i,
+                                     static_cast<std::uint8_t>(i));
+  };
+  {
+    Engine e(cfg, make_policy_by_name("lru"));
+    for (int i = 0; i < 120; ++i)
+      REQUIRE(e.set("k" + std::to_string(i), value_for(i), std::nullopt,
+                    "default"));
+    REQUIRE(e.del({"k7"}) == 1);
+    REQUIRE(e.commit());
+  }
+
+  std::vector<std::filesystem::path> logs;
+  for (const auto &f : std::filesystem::directory_iterator(dir))
+    if (f.path().extension() == ".log")
+      logs.push_back(f.path());
+  REQUIRE(logs.size() >= 4);
+  auto id_of = [](const std::filesystem::path &p) {
+    return std::stoul(p.stem().string().substr(p.stem().string().find('_') +
+                                               1));
+  };
+  std::sort(logs.begin(), logs.end(), [&](const auto &a, const auto &b) {
+    return id_of(a) < id_of(b);
+  });
+  const auto sealed = logs.front();
+  const auto active = logs.back();
+  const auto sealed_size = std::filesystem::file_size(sealed);
+  const auto active_size = std::filesystem::file_size(active);
+  for (const auto &p : {sealed, active}) {
+    std::ofstream out(p, std::ios::binary | std::ios::app);
+    out << std::string(100, '\x5a');
+  }
+
+  cfg.tier.ssd_recovery_threads = 4;
+  Engine e(cfg, make_policy_by_name("lru"));
+  CHECK(std::filesystem::file_size(sealed) == sealed_size + 100);
+  CHECK(std::filesystem::file_size(active) == active_size);
+  for (int i = 0; i < 120; ++i) {
+    const auto v = e.get("k" + std::to_string(i));
+    if (i == 7)
+      CHECK_FALSE(v.has_value());
+    else
+      CHECK(v == value_for(i));
+  }
+  const auto info = e.info();
+  CHECK(info.find("ssd_recovery_threads:4\n") != std::string::npos);
+  CHECK(info.find("ssd_recovery_scan_ms:") != std::string::npos);
+  CHECK(info.find("ssd_recovery_verify_ms:") != std::string::npos);
+  CHECK(info.find("ssd_recovery_merge_ms:") != std::string::npos);
+}
+
+TEST_CASE("Online recovery serves SSD keys while segments are scanned",
+          "[engine][tier][recovery]") {
+  const std::string dir = "test_ssd_online_recovery_data";
+  std::filesystem::remove_all(dir);
+  SsdConfig sc;
+  sc.enabled = true;
+  sc.dir = dir;
+  sc.segment_bytes = 8 * 1024;
+  sc.fsync = FsyncMode::Never;
+  auto value_for = [](int i) {
+    return std::vector<std::uint8_t>(100 + i % 50,
+                                     static_cast<std::uint8_t>(i));
+  };
+  std::uint64_t seq = 0;
+  {
+    SsdStore s(sc);
+    REQUIRE(s.init());
+    for (int i = 0; i < 400; ++i)
+      REQUIRE(s.put("key:" + std::to_string(i), value_for(i), std::nullopt,
+                    ++seq));
+    REQUIRE(s.del("key:7", ++seq));
+    REQUIRE(s.commit());
+  }
+
+  sc.online_recovery = true;
+  sc.recovery_wait_ms = 10000;
+  const std::vector<std::uint8_t> fresh(64, 0xee);
+  {
+    // Seqs restart low, as after a process restart; the store must still
+    // order these writes after everything on disk.
+    seq = 0;
+    SsdStore s(sc);
+    REQUIRE(s.init());
+    // Nothing merges into the index until poll_recovery(); until then every
+    // lookup is settled from the scanned segments.
+    CHECK(s.stats().recovering);
+    CHECK(s.get("key:3") == value_for(3));
+    CHECK_FALSE(s.get("key:7").has_value());
+    CHECK(s.del("key:5", ++seq));
+    REQUIRE(s.put("key:10", fresh, std::nullopt, ++seq));
+    CHECK(s.set_ttl("key:11", Clock::now() + std::chrono::hours(1), ++seq));
+    auto vals = s.multi_get({"key:1", "key:10", "key:399", "missing"});
+    CHECK(vals[0] == value_for(1));
+    CHECK(vals[1] == fresh);
+    CHECK(vals[2] == value_for(399));
+    CHECK_FALSE(vals[3].has_value());
+    CHECK(s.stats().recovery_unresolved == 0);
+
+    const auto until =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (s.stats().recovering && std::chrono::steady_clock::now() < until) {
+      s.poll_recovery();
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    REQUIRE_FALSE(s.stats().recovering);
+    CHECK(s.stats().recovery_segments_ready ==
+          s.stats().recovery_segments_total);
+    CHECK(s.size() == 398);
+    CHECK_FALSE(s.get("key:5").has_value());
+    CHECK(s.get("key:10") == fresh);
+    CHECK(s.get("key:200") == value_for(200));
+    REQUIRE(s.commit());
+  }
+
+  sc.online_recovery = false;
+  SsdStore reopened(sc);
+  REQUIRE(reopened.init());
+  CHECK(reopened.size() == 398);
+  CHECK_FALSE(reopened.contains("key:5"));
+  CHECK(reopened.get("key:10") == fresh);
+  SsdMeta meta;
+  REQUIRE(reopened.stat("key:11", &meta));
+  CHECK(meta.ttl_epoch_ms > 0);
+  CHECK(reopened.get("key:0") == value_for(0));
+}
+
+TEST_CASE("Online recovery is not fooled by tombstones copied forward by GC",
+          "[engine][tier][recovery]") {
+  const std::string dir = "test_ssd_online_gc_data";
+  std::filesystem::remove_all(dir);
+  SsdConfig sc;
+  sc.enabled = true;
+  sc.dir = dir;
+  sc.segment_bytes = 8 * 1024;
+  sc.fsync = FsyncMode::Never;
+  sc.gc_fragmentation_threshold = 0.5;
+  const std::vector<std::uint8_t> v(200, 'v');
+  const std::vector<std::uint8_t> v1(32, '1');
+  const std::vector<std::uint8_t> v2(32, '2');
+  std::uint64_t seq = 0;
+  {
+    SsdStore s(sc);
+    REQUIRE(s.init());
+    // The live first segment keeps the tombstone worth copying; GC then
+    // moves it past the segment holding the later put.
+    REQUIRE(s.put("k", v1, std::nullopt, ++seq));
+    for (int i = 0; s.stats().segments < 2; ++i)
+      REQUIRE(s.put("old:" + std::to_string(i), v, std::nullopt, ++seq));
+    REQUIRE(s.del("k", ++seq));
+    int fills = 0;
+    while (s.stats().segments < 3)
+      REQUIRE(s.put("fill:" + std::to_string(fills++), v, std::nullopt,
+                    ++seq));
+    REQUIRE(s.put("k", v2, std::nullopt, ++seq));
+    for (int i = 0; s.stats().segments < 4; ++i)
+      REQUIRE(s.put("live:" + std::to_string(i), v, std::nullopt, ++seq));
+    for (int round = 0; round < 2; ++round)
+      for (int i = 0; i < fills; ++i)
+        REQUIRE(s.put("fill:" + std::to_string(i), v, std::nullopt, ++seq));
+    for (int n = 0; n < 200; ++n)
+      s.maybe_compact();
+    REQUIRE(s.stats().gc_runs >= 1);
+    CHECK(s.get("k") == v2);
+    REQUIRE(s.commit());
+  }
+
+  sc.online_recovery = true;
+  sc.recovery_wait_ms = 10000;
+  {
+    SsdStore s(sc);
+    REQUIRE(s.init());
+    CHECK(s.get("k") == v2);
+    const auto until =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (s.stats().recovering && std::chrono::steady_clock::now() < until) {
+      s.poll_recovery();
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    REQUIRE_FALSE(s.stats().recovering);
+    CHECK(s.get("k") == v2);
+  }
+  {
+    // A key looked up only after the merge must survive it too.
+    SsdStore s(sc);
+    REQUIRE(s.init());
+    const auto until =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (s.stats().recovering && std::chrono::steady_clock::now() < until) {
+      s.poll_recovery();
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK(s.get("k") == v2);
+  }
+}
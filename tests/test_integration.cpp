@@ -207,6 +207,30 @@ TEST_CASE("integration: AI artifact commands", "[integration][ai]") {
   REQUIRE(miss.has_value());
   CHECK(miss->rfind("$-1", 0) == 0);
 
+  const std::string meta =
+      "{\"artifact_type\":\"embedding\",\"owner\":\"vector\",\"schema_"
+      "version\":\"v1\",\"model_id\":\"m\",\"tags\":[\"t\"]}";
+  REQUIRE(send_cmd({"AI.PUT", "embedding", "emb:m:a:3:float", meta, "abc"})
+              .value()
+              .rfind("+OK", 0) == 0);
+  REQUIRE(send_cmd({"AI.PUT", "embedding", "emb:m:b:3:float", meta, "abc"})
+              .value()
+              .rfind("+OK", 0) == 0);
+  CHECK(send_cmd({"AI.SCAN", "", "PREFIX", "emb:m:", "COUNT", "1"}) ==
+        "*2\r\n$15\r\nemb:m:a:3:float\r\n*1\r\n$15\r\nemb:m:a:3:float\r\n");
+  CHECK(send_cmd({"AI.SCAN", "emb:m:a:3:float", "PREFIX", "emb:m:"}) ==
+        "*2\r\n$0\r\n\r\n*1\r\n$15\r\nemb:m:b:3:float\r\n");
+  CHECK(send_cmd({"AI.QUERY", "TAG", "t", "LIMIT", "1"}) ==
+        "*1\r\n$15\r\nemb:m:a:3:float\r\n");
+
+  const float unit[2] = {1.0f, 0.0f};
+  const std::string v(reinterpret_cast<const char *>(unit), sizeof(unit));
+  REQUIRE(send_cmd({"AI.EMB.PUT", "e1", "mv", "2", "float", "0", v})
+              .value()
+              .rfind("+OK", 0) == 0);
+  CHECK(send_cmd({"AI.EMB.SEARCH", "mv", "1", v}) ==
+        "*2\r\n$2\r\ne1\r\n$8\r\n1.000000\r\n");
+
   close(fd);
   stop_server(s);
 }